@@ -1,9 +1,17 @@
 #include <unistd.h>
 #include <stdlib.h>
+#include <poll.h>
+#include <signal.h>
+#include <chrono>
 #include <memory>
 #include <iostream>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <vector>
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
+#include <X11/keysym.h>
 
 #define GL_GLEXT_PROTOTYPES
 #include <EGL/egl.h>
@@ -11,9 +19,20 @@
 
 #include <IRendererFactory.h>
 #include <IRenderer.h>
+#include <AssetArchive.h>
 #include <Context.h>
-
-#include "Bootstrap.h"
+#include <Compositor.h>
+#include <PostProcessChain.h>
+#include <SpscQueue.h>
+#include <ShaderCache.h>
+#include <FrameProfiler.h>
+#include <FramePacer.h>
+#include <GlResourceRegistry.h>
+#include <FixedTimestep.h>
+#include <PartialPresenter.h>
+#include <PluginLoader.h>
+
+#include <Bootstrap.h>
 
 // Name of the application
 const char* ApplicationName       = "Simple Triangle";
@@ -22,6 +41,36 @@ const char* ApplicationName       = "Simple Triangle";
 const unsigned int WindowWidth     = 1024;
 const unsigned int WindowHeight    = 768;
 
+// Rate the host wakes up at to look for damage when it neither swaps nor paces
+const unsigned int IdleFrameRate   = 60;
+
+// Messages sent by the X11 event pump to the render thread
+struct HostMessage
+{
+	enum Type { Resize, ToggleLayer, DumpTrace, Redraw, Close };
+	Type type;
+	int width;
+	int height;
+	int layer;
+};
+typedef Common::SpscQueue<HostMessage, 64> HostMessageQueue;
+
+// Frame pacing and simulation clock, used by the thread that renders
+struct FrameLoop
+{
+	Common::FramePacer pacer;
+	Common::FixedTimestep timestep;
+	// Negative keeps the EGL default (1)
+	int swapInterval;
+	// Plugins reloaded at frame boundaries when rebuilt, NULL without -l
+	Common::PluginLoader* plugins;
+	// Skips frames without damage and repaints partial ones, with -d
+	Common::PartialPresenter presenter;
+};
+
+// Set by SIGUSR1 or the P key, the frame trace is written by the thread that pumps events
+volatile sig_atomic_t traceRequested = 0;
+
 /*!*********************************************************************************************************************
 \param[in]			functionLastCalled          Function which triggered the error
 \return		True if no EGL error was detected
@@ -138,7 +187,7 @@ bool createNativeWindow(Display* nativeDisplay, Window* nativeWindow)
 	windowAttributes.colormap = colorMap;
 
 	// Set events that will be handled by the app, add to these for other events.
-	windowAttributes.event_mask = StructureNotifyMask | ExposureMask | ButtonPressMask;
+	windowAttributes.event_mask = StructureNotifyMask | ExposureMask | ButtonPressMask | KeyPressMask;
 
 	// Create the window
 	*nativeWindow = XCreateWindow(nativeDisplay,              // The display used to create the window
@@ -334,22 +383,209 @@ void releaseNativeResources(Display* nativeDisplay, Window nativeWindow)
 	if (nativeDisplay){	XCloseDisplay(nativeDisplay);	}
 }
 
-bool renderScene(Common::IRenderer *renderer, EGLDisplay eglDisplay, EGLSurface eglSurface, Display* nativeDisplay)
+/*!*********************************************************************************************************************
+\param[in]			event                       The X event to translate
+\param[in,out]		width                       Last known window width, updated on resize
+\param[in,out]		height                      Last known window height, updated on resize
+\param[out]		message                     Message produced by the event
+\return		Whether the event produced a message for the renderer
+\brief	Translates window system events into host messages.
+***********************************************************************************************************************/
+bool translateX11Event(const XEvent& event, int& width, int& height, HostMessage& message)
 {
-	//renderer.DrawFrame();
-	//	Present the display data to the screen.
-	//	When rendering to a Window surface, OpenGL ES is double buffered. This means that OpenGL ES renders directly to one frame buffer,
-	//	known as the back buffer, whilst the display reads from another - the front buffer. eglSwapBuffers signals to the windowing system
-	//	that OpenGL ES 2.0 has finished rendering a scene, and that the display should now draw to the screen from the new data. At the same
-	//	time, the front buffer is made available for OpenGL ES 2.0 to start rendering to. In effect, this call swaps the front and back
-	//	buffers.
+	switch (event.type)
+	{
+	// Resize, ConfigureNotify is also sent when the window only moves
+	case ConfigureNotify:
+		if (event.xconfigure.width == width && event.xconfigure.height == height) { return false; }
+		width = event.xconfigure.width;
+		height = event.xconfigure.height;
+		message.type = HostMessage::Resize;
+		message.width = width;
+		message.height = height;
+		return true;
+	// Uncovered, the window content may be gone and frames without damage would not bring it back
+	case Expose:
+		if (event.xexpose.count > 0) { return false; }
+		message.type = HostMessage::Redraw;
+		return true;
+	// Keys 1 to 9 show or hide the matching layer, P writes the frame trace
+	case KeyPress:
+	{
+		KeySym key = XLookupKeysym(const_cast<XKeyEvent*>(&event.xkey), 0);
+		if (key == XK_p)
+		{
+			message.type = HostMessage::DumpTrace;
+			return true;
+		}
+		if (key < XK_1 || key > XK_9) { return false; }
+		message.type = HostMessage::ToggleLayer;
+		message.layer = (int)(key - XK_1);
+		return true;
+	}
+	// Exit on window close
+	case ClientMessage:
+	// Exit on mouse click
+	case ButtonPress:
+	case DestroyNotify:
+		message.type = HostMessage::Close;
+		return true;
+	default:
+		return false;
+	}
+}
+
+/*!*********************************************************************************************************************
+\param[in]			signal                      The signal received
+\brief	SIGUSR1 handler, asks for the frame trace to be written.
+***********************************************************************************************************************/
+void requestTrace(int)
+{
+	traceRequested = 1;
+}
+
+/*!*********************************************************************************************************************
+\param[in]			tracePath                   File the trace is written to, nothing is written when empty
+\brief	Writes the frames kept by the profiler as Chrome trace events.
+***********************************************************************************************************************/
+void writeTrace(const std::string& tracePath)
+{
+	if (tracePath.empty()) { return; }
+	if (Common::Context::Instance()->GetFrameProfiler()->WriteChromeTrace(tracePath))
+	{
+		std::cout<<"Frame trace written to "<<tracePath<<std::endl;
+	}
+	else
+	{
+		std::cerr<<"Unable to write "<<tracePath<<std::endl;
+	}
+}
+
+/*!*********************************************************************************************************************
+\param[in]			eglDisplay                  The EGLDisplay used by the application, its context current on the calling thread
+\param[in]			eglSurface                  The EGLSurface presented
+\param[in]			loop                        Frame loop to start
+\brief	Applies the swap interval, looks up the partial presentation extensions and starts the pacing and simulation clocks.
+***********************************************************************************************************************/
+void startFrameLoop(EGLDisplay eglDisplay, EGLSurface eglSurface, FrameLoop* loop)
+{
+	// The interval belongs to the surface bound to the current context
+	if (loop->swapInterval >= 0 && !eglSwapInterval(eglDisplay, loop->swapInterval))
+	{
+		testEGLError("eglSwapInterval");
+	}
+	loop->presenter.Initialize(eglDisplay, eglSurface);
+	loop->pacer.Reset();
+	loop->timestep.Reset();
+}
+
+/*!*********************************************************************************************************************
+\param[in]			plugins                     The plugins reloaded this frame
+\param[in]			first                       The first swap not printed yet
+\brief	Prints the plugins swapped since, the loader reports the reloads that failed on stderr.
+***********************************************************************************************************************/
+void printSwaps(const Common::PluginLoader* plugins, size_t first)
+{
+	const std::vector<Common::PluginLoader::Swap>& swaps = plugins->GetSwaps();
+	for (size_t i = first; i < swaps.size(); ++i)
+	{
+		const Common::PluginLoader::Swap& swap = swaps[i];
+		if (!swap.loaded) { continue; }
+		std::cout<<"renderer "<<swap.name<<" reloaded in "<<swap.load_milliseconds + swap.gl_milliseconds<<" ms ("
+		         <<swap.load_milliseconds<<" ms loading, "<<swap.gl_milliseconds<<" ms swapping "
+		         <<swap.layers<<" layers)"<<std::endl;
+	}
+}
+
+/*!*********************************************************************************************************************
+\param[in]			renderer                    The compositor to draw
+\param[in]			loop                        Pacing, simulation clock and presenter, initialized on the surface to present
+\return		Whether the frame was presented or skipped, false when the swap failed
+\brief	Swaps rebuilt plugins, waits for the frame deadline, runs the simulation steps due, draws and presents what changed.
+***********************************************************************************************************************/
+bool presentFrame(Common::Compositor* renderer, FrameLoop* loop)
+{
+	// Between two frames, on the thread that owns the context
+	if (loop->plugins != NULL)
+	{
+		size_t first = loop->plugins->GetSwaps().size();
+		loop->plugins->Update(renderer);
+		printSwaps(loop->plugins, first);
+	}
+
+	// The pacing sleep is not part of the profiled frame
+	loop->pacer.Wait();
+
+	Common::FrameProfiler* profiler = Common::Context::Instance()->GetFrameProfiler();
+	profiler->BeginFrame();
+	profiler->BeginMarker("Update");
+	unsigned int steps = loop->timestep.Advance();
+	for (unsigned int step = 0; step < steps; ++step)
+	{
+		renderer->Update(loop->timestep.GetStep());
+	}
+	profiler->EndMarker();
+
+	// Nothing changed: nothing is drawn nor swapped, the window keeps showing the last frame
+	if (!loop->presenter.BeginFrame(renderer))
+	{
+		renderer->SkipFrame();
+		profiler->EndFrame();
+		// No swap blocks until the next vertical blank
+		if (loop->pacer.GetTargetRate() <= 0.0)
+		{
+			std::this_thread::sleep_for(std::chrono::microseconds(1000000 / IdleFrameRate));
+		}
+		return true;
+	}
+	renderer->SetRepaintRegion(loop->presenter.GetRepaintRegion());
 	renderer->DrawFrame();
 
-	if (!eglSwapBuffers(eglDisplay, eglSurface))
+	profiler->BeginMarker("SwapBuffers");
+	bool swapped = loop->presenter.Present();
+	profiler->EndMarker();
+	profiler->EndFrame();
+	if (!swapped)
 	{
 		testEGLError("eglSwapBuffers");
 		return false;
 	}
+	return true;
+}
+
+/*!*********************************************************************************************************************
+\param[in]			loop                        The frame loop that has ended
+\brief	Prints how the frames were paced.
+***********************************************************************************************************************/
+void printPacingStats(const FrameLoop* loop)
+{
+	if (loop->pacer.GetTargetRate() > 0.0)
+	{
+		std::cout<<loop->pacer.GetFrameCount()<<" frames paced at "<<loop->pacer.GetTargetRate()<<" Hz, "
+		         <<loop->pacer.GetMissedCount()<<" missed deadlines, "<<loop->pacer.GetSleptMilliseconds()<<" ms asleep"<<std::endl;
+	}
+	if (loop->timestep.GetDroppedStepCount() > 0)
+	{
+		std::cout<<loop->timestep.GetDroppedStepCount()<<" simulation steps dropped after stalls"<<std::endl;
+	}
+	if (loop->presenter.IsEnabled())
+	{
+		const Common::PartialPresenter::Stats& stats = loop->presenter.GetStats();
+		std::cout<<stats.presented<<" frames presented ("<<stats.partial<<" partial), "<<stats.skipped<<" skipped without damage, "
+		         <<(stats.surface_pixels > 0.0 ? 100.0 * stats.repainted_pixels / stats.surface_pixels : 0.0)
+		         <<"% of the presented pixels repainted"<<std::endl;
+	}
+}
+
+bool renderScene(Common::Compositor *renderer, FrameLoop* loop, Display* nativeDisplay, int& width, int& height)
+{
+	//	Present the display data to the screen.
+	//	When rendering to a Window surface, OpenGL ES is double buffered. This means that OpenGL ES renders directly to one frame buffer,
+	//	known as the back buffer, whilst the display reads from another - the front buffer. eglSwapBuffers signals to the windowing system
+	//	that OpenGL ES 2.0 has finished rendering a scene, and that the display should now draw to the screen from the new data. At the same
+	//	time, the front buffer is made available for OpenGL ES 2.0 to start rendering to. In effect, this call swaps the front and back
+	//	buffers.
+	if (!presentFrame(renderer, loop)) { return false; }
 
 	// Check for messages from the windowing system.
 	int numberOfMessages = XPending(nativeDisplay);
@@ -358,37 +594,311 @@ bool renderScene(Common::IRenderer *renderer, EGLDisplay eglDisplay, EGLSurface
 		XEvent event;
 		XNextEvent(nativeDisplay, &event);
 
-		switch (event.type)
+		HostMessage message;
+		if (!translateX11Event(event, width, height, message)) { continue; }
+		if (message.type == HostMessage::Close) { return false; }
+		if (message.type == HostMessage::DumpTrace) { traceRequested = 1; }
+		else if (message.type == HostMessage::Redraw) { renderer->Invalidate(); }
+		else if (message.type == HostMessage::ToggleLayer) { renderer->SetLayerEnabled(message.layer, !renderer->IsLayerEnabled(message.layer)); }
+		else { renderer->SetViewport(message.width, message.height); }
+	}
+	return true;
+
+}
+
+/*!*********************************************************************************************************************
+\param[in]			eglDisplay                  The EGLDisplay used by the application
+\param[in]			eglSurface                  The EGLSurface to render to
+\param[in]			eglContext                  The EGLContext, released from the main thread beforehand
+\param[in]			renderer                    Layers to draw, GL resources are created and released on this thread
+\param[in]			loop                        Pacing and simulation clock, used by this thread only
+\param[in]			queue                       Messages from the event pump
+\param[out]		running                     Cleared when the render thread exits
+\brief	Render thread: owns the context and the renderer, applies host messages at frame boundaries.
+***********************************************************************************************************************/
+void renderThread(EGLDisplay eglDisplay, EGLSurface eglSurface, EGLContext eglContext, Common::Compositor* renderer, FrameLoop* loop, HostMessageQueue* queue, std::atomic<bool>* running)
+{
+	eglMakeCurrent(eglDisplay, eglSurface, eglSurface, eglContext);
+	if (!testEGLError("eglMakeCurrent"))
+	{
+		running->store(false);
+		return;
+	}
+
+	renderer->InitializeGl();
+	renderer->SetViewport(WindowWidth, WindowHeight);
+	startFrameLoop(eglDisplay, eglSurface, loop);
+
+	bool close = false;
+	while (!close)
+	{
+		// Drain the queue at the frame boundary, several resizes in one frame collapse to the last one.
+		bool resize = false;
+		int width = 0;
+		int height = 0;
+		HostMessage message;
+		while (queue->Pop(message))
 		{
-		// Exit on window close
-		case ClientMessage:
-		// Exit on mouse click
-		case ButtonPress:
-		case DestroyNotify:
-			return false;
-		default:
-			break;
+			if (message.type == HostMessage::Close) { close = true; }
+			else if (message.type == HostMessage::ToggleLayer) { renderer->SetLayerEnabled(message.layer, !renderer->IsLayerEnabled(message.layer)); }
+			else if (message.type == HostMessage::Redraw) { renderer->Invalidate(); }
+			else { resize = true; width = message.width; height = message.height; }
 		}
+		if (close) { break; }
+		if (resize) { renderer->SetViewport(width, height); }
+
+		if (!presentFrame(renderer, loop)) { break; }
 	}
-	return true;
 
+	renderer->ReleaseGl();
+	Common::Context::Instance()->GetFrameProfiler()->ReleaseGl();
+	eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	running->store(false);
+}
+
+/*!*********************************************************************************************************************
+\param[in]			nativeDisplay               The native display, opened after XInitThreads
+\param[in]			eglDisplay                  The EGLDisplay used by the application
+\param[in]			eglSurface                  The EGLSurface to render to
+\param[in]			eglContext                  The EGLContext, current on the calling thread
+\param[in]			renderer                    Layers to draw, handed over to the render thread until it exits
+\param[in]			loop                        Pacing and simulation clock, handed over to the render thread until it exits
+\param[in]			tracePath                   Where the frame trace is written on request
+\brief	Runs the renderer on a dedicated thread while this thread only pumps X events.
+***********************************************************************************************************************/
+void runThreaded(Display* nativeDisplay, EGLDisplay eglDisplay, EGLSurface eglSurface, EGLContext eglContext, Common::Compositor* renderer, FrameLoop* loop, const std::string& tracePath)
+{
+	// A context can only be current on one thread at a time.
+	eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+
+	HostMessageQueue queue;
+	std::atomic<bool> running(true);
+	std::thread thread(renderThread, eglDisplay, eglSurface, eglContext, renderer, loop, &queue, &running);
+
+	int width = WindowWidth;
+	int height = WindowHeight;
+	bool close = false;
+	while (!close && running.load())
+	{
+		// Wait for X events without spinning, with a timeout so that a render thread failure is noticed.
+		if (XPending(nativeDisplay) == 0)
+		{
+			struct pollfd descriptor;
+			descriptor.fd = ConnectionNumber(nativeDisplay);
+			descriptor.events = POLLIN;
+			poll(&descriptor, 1, 100);
+		}
+		while (!close && XPending(nativeDisplay) > 0)
+		{
+			XEvent event;
+			XNextEvent(nativeDisplay, &event);
+
+			HostMessage message;
+			if (!translateX11Event(event, width, height, message)) { continue; }
+			if (message.type == HostMessage::DumpTrace) { traceRequested = 1; continue; }
+			close = message.type == HostMessage::Close;
+			// The render thread drains the queue every frame, a full queue only lasts one frame.
+			while (!queue.Push(message) && running.load()) { std::this_thread::yield(); }
+		}
+		// The profiler ring is read without stopping the render thread
+		if (traceRequested)
+		{
+			traceRequested = 0;
+			writeTrace(tracePath);
+		}
+	}
+	thread.join();
+}
+
+/*!*********************************************************************************************************************
+\return		The directory program binaries are cached in, empty when none can be found
+\brief	Follows the XDG base directory convention: $XDG_CACHE_HOME, else $HOME/.cache.
+***********************************************************************************************************************/
+std::string defaultShaderCacheDirectory()
+{
+	const char* cacheHome = getenv("XDG_CACHE_HOME");
+	if (cacheHome != NULL && cacheHome[0] != '\0') { return std::string(cacheHome) + "/common-gles/shaders"; }
+	const char* home = getenv("HOME");
+	if (home != NULL && home[0] != '\0') { return std::string(home) + "/.cache/common-gles/shaders"; }
+	return std::string();
+}
+
+/*!*********************************************************************************************************************
+\param[in]			renderer                    The compositor that drew the frames
+\brief	Prints the mean CPU time of every layer's DrawFrame, and the render scale the dynamic resolution settled on.
+***********************************************************************************************************************/
+void printLayerStats(const Common::Compositor* renderer)
+{
+	std::vector<Common::Compositor::LayerStats> layers = renderer->GetLayerStats();
+	for (size_t i = 0; i < layers.size(); ++i)
+	{
+		double mean = layers[i].frames > 0 ? layers[i].total_milliseconds / layers[i].frames : 0.0;
+		std::cout<<"layer "<<i + 1<<" "<<layers[i].name<<": "<<layers[i].frames<<" frames, "<<mean<<" ms per frame"<<std::endl;
+		for (size_t j = 0; j < layers[i].counters.size(); ++j)
+		{
+			std::cout<<"  "<<layers[i].counters[j].first<<": "<<layers[i].counters[j].second<<std::endl;
+		}
+	}
+	const Common::DynamicResolution& resolution = renderer->GetPostProcessChain()->GetDynamicResolution();
+	if (resolution.IsEnabled())
+	{
+		std::cout<<"render scale "<<resolution.GetScale()<<" after "<<resolution.GetChangeCount()<<" changes, "
+		         <<resolution.GetSmoothedMilliseconds()<<" ms per frame"<<std::endl;
+	}
+}
+
+/*!*********************************************************************************************************************
+\brief	Prints the GL objects each owner still holds once the renderers are released, which are leaks, and what the
+		deferred deletions cost.
+***********************************************************************************************************************/
+void printResourceStats()
+{
+	const Common::GlResourceRegistry* registry = Common::Context::Instance()->GetGlResourceRegistry();
+	std::vector<Common::GlResourceRegistry::OwnerStats> owners = registry->GetOwnerStats();
+	for (size_t i = 0; i < owners.size(); ++i)
+	{
+		unsigned long live = 0;
+		for (int kind = 0; kind < Common::GlResourceRegistry::KindCount; ++kind)
+		{
+			live += owners[i].live[kind];
+		}
+		if (live > 0)
+		{
+			std::cout<<"leaked by "<<owners[i].owner<<": "<<live<<" GL objects, "<<owners[i].bytes<<" bytes"<<std::endl;
+		}
+	}
+	Common::GlResourceRegistry::Stats stats = registry->GetStats();
+	std::cout<<stats.deleted<<" GL objects deleted in "<<stats.batches<<" batches ("<<stats.fenced<<" fenced), "
+	         <<stats.max_delete_milliseconds<<" ms at most at the end of a frame"<<std::endl;
 }
 
-int main(int /*argc*/, char** /*argv*/)
+void usage(const char* program)
 {
+	std::cerr<<"usage: "<<program<<" [-t] [-r renderer[,renderer...]] [-l plugin.so[,plugin.so...]] [-a assets.pak] [-e effect[,effect...]] [-x scale] [-g milliseconds] [-c shader cache directory] [-p trace.json] [-f rate] [-s interval] [-u rate] [-d]"<<std::endl;
+	std::cerr<<"  -r  renderers drawn as layers, back to front: triangle (default), batch, instanced, text"<<std::endl;
+	std::cerr<<"      keys 1 to 9 show or hide a layer"<<std::endl;
+	std::cerr<<"  -l  renderer plugins (libtriangle-plugin.so is triangle), reloaded when rebuilt"<<std::endl;
+	std::cerr<<"  -a  asset archive (pack-archive) the renderers load their sources and geometry from"<<std::endl;
+	std::cerr<<"  -e  post processing effects applied in order: bloom, vignette, grayscale"<<std::endl;
+	std::cerr<<"  -x  render scale, the frame is drawn at a fraction of the window size and upscaled"<<std::endl;
+	std::cerr<<"  -g  dynamic resolution: the render scale (down to 0.5) keeps the GPU time of frames under this target"<<std::endl;
+	std::cerr<<"  -c  where program binaries are cached, \"\" disables the cache"<<std::endl;
+	std::cerr<<"  -t  render on a dedicated thread, the main thread only pumps X events"<<std::endl;
+	std::cerr<<"  -f  frames per second the host sleeps to, 0 (default) leaves the rate to the swap interval"<<std::endl;
+	std::cerr<<"  -s  swap interval: 0 presents immediately (no vsync), 1 waits for each vertical blank, default left to EGL"<<std::endl;
+	std::cerr<<"  -u  simulation steps per second, independent of the frame rate (default 60)"<<std::endl;
+	std::cerr<<"  -p  profile frames, the Chrome trace is written on exit, on SIGUSR1 and with the P key"<<std::endl;
+	std::cerr<<"  -d  draw only what changed: frames without damage are skipped, the others repainted over their damage"<<std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	bool threaded = false;
+	const char* rendererName = "triangle";
+	std::string shaderCacheDirectory = defaultShaderCacheDirectory();
+	std::string tracePath;
+	std::string archivePath;
+	std::string effects;
+	std::string pluginPaths;
+	Common::PluginLoader plugins;
+	float renderScale = 1.0f;
+	double resolutionTarget = 0.0;
+	FrameLoop loop;
+	loop.swapInterval = -1;
+	loop.plugins = NULL;
+	int option;
+	while ((option = getopt(argc, argv, "tr:l:a:e:x:g:c:p:f:s:u:d")) != -1)
+	{
+		switch (option)
+		{
+		case 't': threaded = true; break;
+		case 'r': rendererName = optarg; break;
+		case 'l': pluginPaths = optarg; break;
+		case 'a': archivePath = optarg; break;
+		case 'e': effects = optarg; break;
+		case 'x': renderScale = atof(optarg); break;
+		case 'g': resolutionTarget = atof(optarg); break;
+		case 'c': shaderCacheDirectory = optarg; break;
+		case 'p': tracePath = optarg; break;
+		case 'f': loop.pacer.SetTargetRate(atof(optarg)); break;
+		case 's': loop.swapInterval = atoi(optarg); break;
+		case 'd': loop.presenter.SetEnabled(true); break;
+		case 'u':
+			if (atof(optarg) <= 0.0)
+			{
+				usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			loop.timestep.SetStep(1.0 / atof(optarg));
+			break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
 
 	// X11 variables
 	Display* nativeDisplay = NULL;
 	Window nativeWindow = 0;
+	int width = WindowWidth;
+	int height = WindowHeight;
 
 	// EGL variables
 	EGLDisplay			eglDisplay = NULL;
 	EGLConfig			eglConfig = NULL;
 	EGLSurface			eglSurface = NULL;
 	EGLContext			eglContext = NULL;
-	Common::IRenderer *renderer = NULL;
+	Common::Compositor *renderer = NULL;
 
 	Bootstrap::Startup();
+	// Mapped before any renderer initializes, they read their assets in place
+	if (!archivePath.empty() && !Common::Context::Instance()->GetAssetArchive()->Open(archivePath))
+	{
+		return EXIT_FAILURE;
+	}
+	// Registered over the factories linked in, before the layers are made
+	if (!pluginPaths.empty())
+	{
+		if (!plugins.LoadPlugins(pluginPaths))
+		{
+			return EXIT_FAILURE;
+		}
+		loop.plugins = &plugins;
+	}
+	renderer = new Common::Compositor();
+	if (!renderer->AddLayers(rendererName) || renderScale <= 0.0f
+	    || (!effects.empty() && !renderer->GetPostProcessChain()->AddEffects(effects)))
+	{
+		delete renderer;
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+	if (resolutionTarget > 0.0)
+	{
+		renderer->GetPostProcessChain()->SetDynamicResolution(resolutionTarget);
+	}
+	else
+	{
+		renderer->GetPostProcessChain()->SetRenderScale(renderScale);
+	}
+	if (!shaderCacheDirectory.empty())
+	{
+		Common::Context::Instance()->GetShaderCache()->SetCacheDirectory(shaderCacheDirectory);
+	}
+
+	if (!tracePath.empty())
+	{
+		Common::Context::Instance()->GetFrameProfiler()->SetEnabled(true);
+		signal(SIGUSR1, requestTrace);
+	}
+
+	// EGL uses the display connection from the render thread (eglSwapBuffers), Xlib must be made thread safe
+	// before the display is opened.
+	if (threaded && !XInitThreads())
+	{
+		std::cerr<<"Error: Xlib has no thread support"<<std::endl;
+		goto cleanup;
+	}
 
 	// Get access to a native display
 	if (!createNativeDisplay(&nativeDisplay)){ goto cleanup;	}
@@ -414,16 +924,35 @@ int main(int /*argc*/, char** /*argv*/)
 		goto cleanup;
 	}
 
-	renderer = Common::Context::Instance()->GetRendererFactory()->Create();
+	if (threaded)
+	{
+		runThreaded(nativeDisplay, eglDisplay, eglSurface, eglContext, renderer, &loop, tracePath);
+		printLayerStats(renderer);
+		printResourceStats();
+		printPacingStats(&loop);
+		writeTrace(tracePath);
+		goto cleanup;
+	}
 
 	renderer->InitializeGl();
 	renderer->SetViewport(WindowWidth,WindowHeight);
+	startFrameLoop(eglDisplay, eglSurface, &loop);
 
-	while (renderScene(renderer, eglDisplay, eglSurface, nativeDisplay))
+	while (renderScene(renderer, &loop, nativeDisplay, width, height))
 	{
+		if (traceRequested)
+		{
+			traceRequested = 0;
+			writeTrace(tracePath);
+		}
 	}
 
 	renderer->ReleaseGl();
+	Common::Context::Instance()->GetFrameProfiler()->ReleaseGl();
+	printLayerStats(renderer);
+	printResourceStats();
+	printPacingStats(&loop);
+	writeTrace(tracePath);
 
 cleanup:
 	if (renderer != NULL)
@@ -7,6 +7,6 @@
 #include "Bootstrap.h"
 
 void Bootstrap::Startup() {
-    Common::Context::Instance()->Register(new Triangle::RendererFactory());
+    Common::Context::Instance()->Register("triangle", new Triangle::RendererFactory());
 }
 
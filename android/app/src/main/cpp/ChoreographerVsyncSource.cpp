@@ -0,0 +1,106 @@
+#include <dlfcn.h>
+#include <chrono>
+#include "ChoreographerVsyncSource.h"
+
+ChoreographerVsyncSource::ChoreographerVsyncSource() : _looper(NULL) {
+    _get_instance = NULL;
+    _post_frame_callback = NULL;
+    _post_frame_callback_64 = NULL;
+    _choreographer = NULL;
+    _listener = NULL;
+    _library = dlopen("libandroid.so", RTLD_NOW | RTLD_LOCAL);
+    if (_library != NULL) {
+        _get_instance = (GetInstanceFunction) dlsym(_library, "AChoreographer_getInstance");
+        _post_frame_callback = (PostFrameCallbackFunction) dlsym(_library, "AChoreographer_postFrameCallback");
+        // API 29, the frame time of the other one is truncated where long is 32 bit
+        _post_frame_callback_64 = (PostFrameCallback64Function) dlsym(_library, "AChoreographer_postFrameCallback64");
+    }
+    if (_post_frame_callback == NULL && _post_frame_callback_64 == NULL) {
+        _get_instance = NULL;
+    }
+}
+
+ChoreographerVsyncSource::~ChoreographerVsyncSource() {
+    if (_library != NULL) {
+        dlclose(_library);
+    }
+}
+
+bool ChoreographerVsyncSource::Attach() {
+    // The loop thread has no looper yet, the choreographer instance belongs to the thread's looper
+    ALooper *looper = ALooper_prepare(0);
+    ALooper_acquire(looper);
+    _looper.store(looper);
+    _listener = NULL;
+    _choreographer = _get_instance != NULL ? _get_instance() : NULL;
+    if (_choreographer == NULL) {
+        return _fallback.Attach();
+    }
+    return true;
+}
+
+void ChoreographerVsyncSource::Detach() {
+    // Callbacks still posted are never dispatched, the looper is not polled anymore
+    _listener = NULL;
+    _choreographer = NULL;
+    _fallback.Detach();
+    ALooper *looper = _looper.exchange(NULL);
+    if (looper != NULL) {
+        ALooper_release(looper);
+    }
+}
+
+void ChoreographerVsyncSource::RequestFrame(Common::IVsyncListener *listener) {
+    if (_choreographer == NULL) {
+        _fallback.RequestFrame(listener);
+        return;
+    }
+    _listener = listener;
+    if (_post_frame_callback_64 != NULL) {
+        _post_frame_callback_64(_choreographer, OnFrame64, this);
+    } else {
+        _post_frame_callback(_choreographer, OnFrame, this);
+    }
+}
+
+void ChoreographerVsyncSource::Wait(int timeout_milliseconds) {
+    if (_choreographer == NULL) {
+        _fallback.Wait(timeout_milliseconds);
+        return;
+    }
+    // Frame callbacks run from inside the poll
+    ALooper_pollOnce(timeout_milliseconds, NULL, NULL, NULL);
+}
+
+void ChoreographerVsyncSource::Wake() {
+    ALooper *looper = _looper.load();
+    if (looper != NULL) {
+        ALooper_wake(looper);
+    }
+    _fallback.Wake();
+}
+
+void ChoreographerVsyncSource::OnFrame(long frame_time_nanos, void *data) {
+    if (sizeof(long) < sizeof(int64_t)) {
+        // Wrapped around: the blank is taken to be now, the latency reads 0
+        frame_time_nanos = 0;
+    }
+    static_cast<ChoreographerVsyncSource *>(data)->Dispatch(frame_time_nanos);
+}
+
+void ChoreographerVsyncSource::OnFrame64(int64_t frame_time_nanos, void *data) {
+    static_cast<ChoreographerVsyncSource *>(data)->Dispatch(frame_time_nanos);
+}
+
+void ChoreographerVsyncSource::Dispatch(int64_t frame_time_nanos) {
+    // System.nanoTime, the CLOCK_MONOTONIC of steady_clock
+    if (frame_time_nanos == 0) {
+        frame_time_nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    Common::IVsyncListener *listener = _listener;
+    _listener = NULL;
+    if (listener != NULL) {
+        listener->OnVsync(frame_time_nanos);
+    }
+}
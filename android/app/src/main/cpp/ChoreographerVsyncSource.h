@@ -0,0 +1,51 @@
+#ifndef ANDROID_CHOREOGRAPHER_VSYNC_SOURCE_H
+#define ANDROID_CHOREOGRAPHER_VSYNC_SOURCE_H
+
+#include <android/looper.h>
+#include <atomic>
+#include <IVsyncSource.h>
+#include <TimerVsyncSource.h>
+
+struct AChoreographer;
+
+// Vertical blanks from AChoreographer frame callbacks, dispatched by the ALooper of the render loop thread.
+// AChoreographer is API 24 and the app starts at 21: it is looked up in libandroid.so, older systems fall back
+// to a 60 Hz timer.
+class ChoreographerVsyncSource : public Common::IVsyncSource {
+public:
+    ChoreographerVsyncSource();
+    virtual ~ChoreographerVsyncSource();
+    // False when the timer stands in
+    bool HasChoreographer() const { return _get_instance != NULL; }
+
+    virtual bool Attach();
+    virtual void Detach();
+    virtual void RequestFrame(Common::IVsyncListener *listener);
+    virtual void Wait(int timeout_milliseconds);
+    virtual void Wake();
+
+private:
+    typedef void (*FrameCallback)(long frame_time_nanos, void *data);
+    typedef void (*FrameCallback64)(int64_t frame_time_nanos, void *data);
+    typedef AChoreographer *(*GetInstanceFunction)();
+    typedef void (*PostFrameCallbackFunction)(AChoreographer *choreographer, FrameCallback callback, void *data);
+    typedef void (*PostFrameCallback64Function)(AChoreographer *choreographer, FrameCallback64 callback, void *data);
+
+    static void OnFrame(long frame_time_nanos, void *data);
+    static void OnFrame64(int64_t frame_time_nanos, void *data);
+    void Dispatch(int64_t frame_time_nanos);
+
+    void *_library;
+    GetInstanceFunction _get_instance;
+    PostFrameCallbackFunction _post_frame_callback;
+    PostFrameCallback64Function _post_frame_callback_64;
+    // Loop thread only
+    AChoreographer *_choreographer;
+    Common::IVsyncListener *_listener;
+    // Woken from any thread
+    std::atomic<ALooper *> _looper;
+    Common::TimerVsyncSource _fallback;
+};
+
+
+#endif //ANDROID_CHOREOGRAPHER_VSYNC_SOURCE_H
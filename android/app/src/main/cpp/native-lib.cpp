@@ -1,9 +1,25 @@
 #include <jni.h>
+#include <android/asset_manager_jni.h>
+#include <android/log.h>
+#include <android/native_window_jni.h>
+#include <EGL/egl.h>
+#include <unistd.h>
+#include <algorithm>
 #include <cstdint>
+#include <string>
+#include <vector>
 #include "Bootstrap.h"
+#include "ChoreographerVsyncSource.h"
+#include <AssetArchive.h>
 #include <Context.h>
 #include <IRendererFactory.h>
 #include <IRenderer.h>
+#include <Compositor.h>
+#include <ShaderCache.h>
+#include <FrameProfiler.h>
+#include <GlResourceRegistry.h>
+#include <RenderLoop.h>
+#include <benchmark/Statistics.h>
 
 #define JNI_METHOD(return_type, method_name) \
   JNIEXPORT return_type JNICALL              \
@@ -11,12 +27,57 @@
 
 namespace {
 
-    inline jlong jptr(Common::IRenderer *renderer) {
+    inline jlong jptr(Common::Compositor *renderer) {
         return reinterpret_cast<intptr_t>(renderer);
     }
 
-    inline Common::IRenderer *native(jlong ptr) {
-        return reinterpret_cast<Common::IRenderer *>(ptr);
+    inline Common::Compositor *native(jlong ptr) {
+        return reinterpret_cast<Common::Compositor *>(ptr);
+    }
+
+    // The render loop thread owns the context and draws at each Choreographer frame, no JNI call per frame
+    EGLDisplay display = EGL_NO_DISPLAY;
+    ChoreographerVsyncSource vsync;
+    Common::RenderLoop loop;
+    // Drawn on by the loop, released once the loop has let go of it
+    ANativeWindow *window = NULL;
+
+    void logFrameStats() {
+        Common::RenderLoop::Stats stats = loop.GetStats();
+        std::vector<Common::RenderLoop::FrameTiming> timings = loop.GetTimings();
+        std::vector<double> latencies;
+        std::vector<double> frames;
+        for (size_t i = 0; i < timings.size(); ++i) {
+            latencies.push_back(timings[i].latency_milliseconds);
+            frames.push_back(timings[i].frame_milliseconds);
+        }
+        std::sort(latencies.begin(), latencies.end());
+        std::sort(frames.begin(), frames.end());
+        __android_log_print(ANDROID_LOG_INFO, "native-lib",
+                            "%lu frames (%s), %lu presented, %lu vsyncs missed, period %.2f ms, "
+                            "vsync to frame p50 %.2f p95 %.2f ms, frame p50 %.2f p95 %.2f ms",
+                            stats.vsyncs, vsync.HasChoreographer() ? "Choreographer" : "timer",
+                            stats.presented, stats.missed, stats.period_milliseconds,
+                            Benchmark::Percentile(latencies, 50.0), Benchmark::Percentile(latencies, 95.0),
+                            Benchmark::Percentile(frames, 50.0), Benchmark::Percentile(frames, 95.0));
+    }
+
+    // Live GL objects per owner; after the loop stopped, any left are leaks
+    void logResources() {
+        Common::GlResourceRegistry *registry = Common::Context::Instance()->GetGlResourceRegistry();
+        std::vector<Common::GlResourceRegistry::OwnerStats> owners = registry->GetOwnerStats();
+        for (size_t i = 0; i < owners.size(); ++i) {
+            unsigned long live = 0;
+            for (int kind = 0; kind < Common::GlResourceRegistry::KindCount; ++kind) {
+                live += owners[i].live[kind];
+            }
+            __android_log_print(ANDROID_LOG_INFO, "native-lib", "%s: %lu live GL objects, %llu bytes",
+                                owners[i].owner.c_str(), live, (unsigned long long) owners[i].bytes);
+        }
+        Common::GlResourceRegistry::Stats stats = registry->GetStats();
+        __android_log_print(ANDROID_LOG_INFO, "native-lib",
+                            "%lu GL objects deleted in %lu batches (%lu fenced), %.2f ms at most in a frame",
+                            stats.deleted, stats.batches, stats.fenced, stats.max_delete_milliseconds);
     }
 }  // anonymous namespace
 
@@ -28,31 +89,104 @@ JNI_METHOD(void, nativeStartup)
     Bootstrap::Startup();
 }
 
+JNI_METHOD(void, nativeSetCacheDirectory)
+(JNIEnv *env, jobject, jstring path) {
+    const char *directory = env->GetStringUTFChars(path, NULL);
+    Common::Context::Instance()->GetShaderCache()->SetCacheDirectory(std::string(directory) + "/shaders");
+    env->ReleaseStringUTFChars(path, directory);
+}
+
+// The archive must be stored uncompressed in the APK (noCompress "pak") to be mapped from the APK file itself
+JNI_METHOD(jboolean, nativeOpenArchive)
+(JNIEnv *env, jobject, jobject asset_manager, jstring name) {
+    const char *path = env->GetStringUTFChars(name, NULL);
+    AAsset *asset = AAssetManager_open(AAssetManager_fromJava(env, asset_manager), path, AASSET_MODE_STREAMING);
+    bool opened = false;
+    if (asset != NULL) {
+        off_t start = 0;
+        off_t length = 0;
+        int fd = AAsset_openFileDescriptor(asset, &start, &length);
+        if (fd >= 0) {
+            opened = Common::Context::Instance()->GetAssetArchive()->Open(fd, start, (size_t) length);
+            close(fd);
+        }
+        AAsset_close(asset);
+    }
+    if (!opened) {
+        __android_log_print(ANDROID_LOG_INFO, "native-lib", "No asset archive %s, embedded assets are used", path);
+    }
+    env->ReleaseStringUTFChars(name, path);
+    return opened ? JNI_TRUE : JNI_FALSE;
+}
+
+JNI_METHOD(void, nativeSetProfiling)
+(JNIEnv *, jobject, jboolean enabled) {
+    Common::Context::Instance()->GetFrameProfiler()->SetEnabled(enabled == JNI_TRUE);
+}
+
+// Called from the UI thread while the GL thread keeps recording, the profiler ring needs no lock
+JNI_METHOD(jboolean, nativeDumpTrace)
+(JNIEnv *env, jobject, jstring path) {
+    const char *file = env->GetStringUTFChars(path, NULL);
+    bool written = Common::Context::Instance()->GetFrameProfiler()->WriteChromeTrace(std::string(file));
+    env->ReleaseStringUTFChars(path, file);
+    return written ? JNI_TRUE : JNI_FALSE;
+}
+
 JNI_METHOD(jlong, nativeCreateRenderer )
 ( JNIEnv *, jobject) {
 
-return jptr(Common::Context::Instance()->GetRendererFactory()->Create()) ;
+    // A single layer, the default renderer; the compositor clears the frame
+    Common::Compositor *compositor = new Common::Compositor();
+    compositor->AddLayer("default", Common::Context::Instance()->GetRendererFactory()->Create());
+    return jptr(compositor);
 }
 
 
-JNI_METHOD(void, nativeInitializeGl)
+// The caches are reset on the loop thread when it creates its context
+JNI_METHOD(jboolean, nativeStartLoop)
 (JNIEnv *, jobject , jlong renderer_handler) {
-    native(renderer_handler)->InitializeGl();
+    display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL)) {
+        __android_log_print(ANDROID_LOG_ERROR, "native-lib", "Failed to initialize the EGLDisplay");
+        return JNI_FALSE;
+    }
+    return loop.Start(display, &vsync, native(renderer_handler)) ? JNI_TRUE : JNI_FALSE;
 }
 
-JNI_METHOD(void, nativeSetViewport)
-(JNIEnv *, jclass , jlong renderer_handler, int width, int height) {
-    native(renderer_handler)->SetViewport(width, height);
+// surfaceChanged and surfaceDestroyed (null): returns once the loop draws on the new surface, the old one destroyed
+JNI_METHOD(void, nativeSetSurface)
+(JNIEnv *env, jobject , jobject surface) {
+    ANativeWindow *next = surface != NULL ? ANativeWindow_fromSurface(env, surface) : NULL;
+    loop.SetWindow((EGLNativeWindowType) next);
+    if (window != NULL) {
+        ANativeWindow_release(window);
+    }
+    window = next;
 }
 
-JNI_METHOD(void, nativeDrawFrame)
-(JNIEnv *, jobject , jlong renderer_handler) {
-    native(renderer_handler)->DrawFrame();
+JNI_METHOD(void, nativeSetPaused)
+(JNIEnv *, jobject , jboolean paused) {
+    loop.SetPaused(paused == JNI_TRUE);
+    if (paused == JNI_TRUE) {
+        logFrameStats();
+        logResources();
+    }
 }
 
 JNI_METHOD(void, nativeDestroyRenderer)
 (JNIEnv *, jclass , jlong renderer_handler) {
-    native(renderer_handler)->ReleaseGl();
+    // The loop releases the renderer's GL resources with its context
+    loop.Stop();
+    logResources();
+    if (window != NULL) {
+        ANativeWindow_release(window);
+        window = NULL;
+    }
+    if (display != EGL_NO_DISPLAY) {
+        eglTerminate(display);
+        display = EGL_NO_DISPLAY;
+    }
     delete native(renderer_handler);
 }
 
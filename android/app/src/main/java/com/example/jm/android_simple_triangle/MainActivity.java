@@ -1,15 +1,15 @@
 package com.example.jm.android_simple_triangle;
 
 import android.content.Context;
+import android.content.res.AssetManager;
 import android.support.v7.app.AppCompatActivity;
 import android.os.Bundle;
-import android.opengl.GLSurfaceView;
-
-import javax.microedition.khronos.egl.EGLConfig;
-import javax.microedition.khronos.opengles.GL10;
+import android.view.Surface;
+import android.view.SurfaceHolder;
+import android.view.SurfaceView;
 
 public class MainActivity extends AppCompatActivity {
-    private GLSurfaceView surfaceView;
+    private SurfaceView surfaceView;
     private long renderer_handler;
 
     // Used to load the 'native-lib' library on application startup.
@@ -26,42 +26,62 @@ public class MainActivity extends AppCompatActivity {
         //TextView tv = (TextView) findViewById(R.id.sample_text);
         //tv.setText(stringFromJNI());
         nativeStartup();
+        // Shader sources and geometry, read in place from the APK when the archive is packaged
+        nativeOpenArchive(getAssets(), "assets.pak");
+        nativeSetCacheDirectory(getCacheDir().getAbsolutePath());
+        // Debug builds keep the last frames, written as a Chrome trace when the activity pauses
+        nativeSetProfiling(BuildConfig.DEBUG);
 
         renderer_handler = nativeCreateRenderer(
                 getClass().getClassLoader(),
                 this.getApplicationContext());
 
-        surfaceView = new GLSurfaceView(this);
-        surfaceView.setEGLContextClientVersion(2);
-        surfaceView.setEGLConfigChooser(8, 8, 8, 0, 0, 0);
-        surfaceView.setPreserveEGLContextOnPause(true);
-        surfaceView.setRenderer(
-                new GLSurfaceView.Renderer() {
+        // A native thread owns the EGL context and draws at each Choreographer frame,
+        // the view only hands it the surface
+        nativeStartLoop(renderer_handler);
+
+        surfaceView = new SurfaceView(this);
+        surfaceView.getHolder().addCallback(
+                new SurfaceHolder.Callback() {
                     @Override
-                    public void onSurfaceCreated(GL10 gl, EGLConfig config) {
-                        nativeInitializeGl(renderer_handler);
+                    public void surfaceCreated(SurfaceHolder holder) {
+                        // The size comes with surfaceChanged, which always follows
                     }
 
                     @Override
-                    public void onSurfaceChanged(GL10 gl, int width, int height) {
-                        nativeSetViewport(renderer_handler, width, height);
+                    public void surfaceChanged(SurfaceHolder holder, int format, int width, int height) {
+                        nativeSetSurface(holder.getSurface());
                     }
 
                     @Override
-                    public void onDrawFrame(GL10 gl) {
-
-                        nativeDrawFrame(renderer_handler);
+                    public void surfaceDestroyed(SurfaceHolder holder) {
+                        // Returns once the EGL surface is destroyed
+                        nativeSetSurface(null);
                     }
                 });
         setContentView(surfaceView);
     }
 
+    @Override
+    protected void onResume() {
+        super.onResume();
+        nativeSetPaused(false);
+    }
+
+    @Override
+    protected void onPause() {
+        super.onPause();
+        // Logs the frame latency stats
+        nativeSetPaused(true);
+        if (BuildConfig.DEBUG) {
+            nativeDumpTrace(getCacheDir().getAbsolutePath() + "/frame-trace.json");
+        }
+    }
+
     @Override
     protected void onDestroy() {
         super.onDestroy();
-        // Destruction order is important; shutting down the GvrLayout will detach
-        // the GLSurfaceView and stop the GL thread, allowing safe shutdown of
-        // native resources from the UI thread.
+        // Stops the render loop thread, which releases the renderer on its context
         nativeDestroyRenderer(renderer_handler);
     }
 
@@ -71,13 +91,21 @@ public class MainActivity extends AppCompatActivity {
          */
     private native void nativeStartup();
 
+    private native void nativeSetCacheDirectory(String path);
+
+    private native boolean nativeOpenArchive(AssetManager assetManager, String name);
+
+    private native void nativeSetProfiling(boolean enabled);
+
+    private native boolean nativeDumpTrace(String path);
+
     private native long nativeCreateRenderer(ClassLoader appClassLoader, Context context);
 
-    private native void nativeInitializeGl(long renderer_handler);
+    private native boolean nativeStartLoop(long renderer_handler);
 
-    private native long nativeDrawFrame(long renderer_handler);
+    private native void nativeSetSurface(Surface surface);
 
-    private native void nativeSetViewport(long renderer_handler, int width, int height);
+    private native void nativeSetPaused(boolean paused);
 
     private native void nativeDestroyRenderer(long renderer_handler);
 }
@@ -0,0 +1,6 @@
+varying lowp vec3 linear_color;
+uniform lowp float fade;
+void main(void)
+{
+  gl_FragColor = vec4(linear_color.x,linear_color.y,linear_color.z,fade);
+}
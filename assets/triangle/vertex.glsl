@@ -0,0 +1,9 @@
+attribute highp vec4 vertex;
+attribute lowp vec3 color;
+varying lowp vec3 linear_color;
+uniform mediump mat4 pmv_matrix;
+void main()
+{
+  gl_Position = pmv_matrix * vertex;
+  linear_color = color;
+}
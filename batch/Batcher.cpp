@@ -0,0 +1,86 @@
+#include "Batcher.h"
+
+using namespace Batch;
+
+Batcher::Batcher()
+{
+}
+
+void Batcher::Begin()
+{
+  _submitted.clear();
+  _primitives.clear();
+  _draw_list.Begin();
+}
+
+void Batcher::Add(const Material &material, unsigned char layer, uint32_t vertex_count)
+{
+  Primitive primitive;
+  // No depth, primitives of a material keep their submission order
+  _draw_list.Add(Common::DrawList::MakeKey(layer, false, 0.0f, material.program, material.texture, 0),
+                 material.program, material.texture, 0);
+  primitive.first_vertex = (uint32_t)_submitted.size() - vertex_count;
+  primitive.vertex_count = vertex_count;
+  primitive.material = material;
+  _primitives.push_back(primitive);
+}
+
+void Batcher::AddTriangle(const Material &material, const Vertex &a, const Vertex &b, const Vertex &c, unsigned char layer)
+{
+  _submitted.push_back(a);
+  _submitted.push_back(b);
+  _submitted.push_back(c);
+  Add(material, layer, 3);
+}
+
+void Batcher::AddQuad(const Material &material, const Vertex &a, const Vertex &b, const Vertex &c, const Vertex &d, unsigned char layer)
+{
+  _submitted.push_back(a);
+  _submitted.push_back(b);
+  _submitted.push_back(c);
+  _submitted.push_back(d);
+  Add(material, layer, 4);
+}
+
+void Batcher::Build()
+{
+  _vertices.clear();
+  _indices.clear();
+  _ranges.clear();
+  _draw_list.Sort();
+
+  const Common::DrawList::Item *items = _draw_list.GetItems();
+  DrawRange *range = NULL;
+  for (size_t i = 0; i < _primitives.size(); ++i)
+  {
+    const Primitive &primitive = _primitives[items[i].index];
+    if (range == NULL
+        || range->material.program != primitive.material.program
+        || range->material.texture != primitive.material.texture
+        || _vertices.size() - range->base_vertex + primitive.vertex_count > MaxVerticesPerRange)
+    {
+      DrawRange next;
+      next.material = primitive.material;
+      next.base_vertex = (GLsizei)_vertices.size();
+      next.first_index = (GLsizei)_indices.size();
+      next.index_count = 0;
+      _ranges.push_back(next);
+      range = &_ranges.back();
+    }
+
+    GLushort base = (GLushort)(_vertices.size() - range->base_vertex);
+    _vertices.insert(_vertices.end(),
+                     _submitted.begin() + primitive.first_vertex,
+                     _submitted.begin() + primitive.first_vertex + primitive.vertex_count);
+    _indices.push_back(base);
+    _indices.push_back(base + 1);
+    _indices.push_back(base + 2);
+    if (primitive.vertex_count == 4)
+    {
+      _indices.push_back(base);
+      _indices.push_back(base + 2);
+      _indices.push_back(base + 3);
+    }
+    range->index_count = (GLsizei)(_indices.size() - range->first_index);
+  }
+}
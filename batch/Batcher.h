@@ -0,0 +1,75 @@
+#ifndef BATCH_BATCHER_H
+#define BATCH_BATCHER_H
+
+#include <GLES2/gl2.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include <DrawList.h>
+
+namespace Batch
+{
+  struct Vertex
+  {
+    GLfloat x, y;
+    GLfloat u, v;
+    GLubyte color[4];
+  };
+
+  struct Material
+  {
+    GLuint program;
+    GLuint texture;
+  };
+
+  // One glDrawElements call: indices are relative to base_vertex
+  struct DrawRange
+  {
+    Material material;
+    GLsizei base_vertex;
+    GLsizei first_index;
+    GLsizei index_count;
+  };
+
+  // Collects triangles and quads for a frame, then sorts them by layer,
+  // program and texture through a Common::DrawList and packs them into
+  // one vertex and one index array.
+  // A new draw range starts only when the material changes or when the
+  // 16 bit index space is exhausted. Storage is kept across frames.
+  class Batcher
+  {
+  public:
+    static const size_t MaxVerticesPerRange = 65536;
+
+    Batcher();
+    virtual ~Batcher(){}
+    void Begin();
+    void AddTriangle(const Material &material, const Vertex &a, const Vertex &b, const Vertex &c, unsigned char layer = 0);
+    // Corners in winding order
+    void AddQuad(const Material &material, const Vertex &a, const Vertex &b, const Vertex &c, const Vertex &d, unsigned char layer = 0);
+    void Build();
+
+    const std::vector<Vertex> &GetVertices() const { return _vertices; }
+    const std::vector<GLushort> &GetIndices() const { return _indices; }
+    const std::vector<DrawRange> &GetRanges() const { return _ranges; }
+    size_t GetPrimitiveCount() const { return _primitives.size(); }
+    const Common::DrawList::Stats &GetSortStats() const { return _draw_list.GetStats(); }
+  private:
+    struct Primitive
+    {
+      uint32_t first_vertex;
+      uint32_t vertex_count;
+      Material material;
+    };
+    void Add(const Material &material, unsigned char layer, uint32_t vertex_count);
+    std::vector<Vertex> _submitted;
+    std::vector<Primitive> _primitives;
+    // Indices into _primitives, the submission order breaks ties
+    Common::DrawList _draw_list;
+    std::vector<Vertex> _vertices;
+    std::vector<GLushort> _indices;
+    std::vector<DrawRange> _ranges;
+  };
+}
+
+#endif
@@ -0,0 +1,276 @@
+#include <math.h>
+#include <stddef.h>
+#include <random>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <Context.h>
+#include <GlStateCache.h>
+#include <ShaderCache.h>
+#include <FrameProfiler.h>
+#include "Renderer.h"
+
+using namespace Batch;
+
+namespace
+{
+  const char* const vertex_source = R"glsl(
+    attribute highp vec2 position;
+    attribute mediump vec2 texcoord;
+    attribute lowp vec4 color;
+    uniform mediump mat4 projection;
+    varying mediump vec2 linear_texcoord;
+    varying lowp vec4 linear_color;
+    void main()
+    {
+      gl_Position = projection * vec4(position, 0.0, 1.0);
+      linear_texcoord = texcoord;
+      linear_color = color;
+    }
+  )glsl";
+
+  const char* const colored_fragment_source = R"glsl(
+    varying mediump vec2 linear_texcoord;
+    varying lowp vec4 linear_color;
+    void main(void)
+    {
+      gl_FragColor = linear_color;
+    }
+  )glsl";
+
+  const char* const textured_fragment_source = R"glsl(
+    varying mediump vec2 linear_texcoord;
+    varying lowp vec4 linear_color;
+    uniform sampler2D sampler;
+    void main(void)
+    {
+      gl_FragColor = linear_color * texture2D(sampler, linear_texcoord);
+    }
+  )glsl";
+
+  const float Pi = 3.14159265f;
+
+  // About three frames of the default scene
+  const GLsizeiptr VertexStreamSize = 4 * 1024 * 1024;
+  const GLsizeiptr IndexStreamSize = 1024 * 1024;
+}
+
+Renderer::Renderer(int shape_count)
+  : _vertex_stream(GL_ARRAY_BUFFER, VertexStreamSize)
+  , _index_stream(GL_ELEMENT_ARRAY_BUFFER, IndexStreamSize)
+{
+  _state = Common::Context::Instance()->GetGlStateCache();
+  _shaders = Common::Context::Instance()->GetShaderCache();
+  _profiler = Common::Context::Instance()->GetFrameProfiler();
+  _ratio = 1.0f;
+  _time = 0.0;
+  _projection_dirty[0] = _projection_dirty[1] = true;
+
+  // Deterministic scene so that runs can be compared
+  std::mt19937 generator(1234);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  _shapes.resize(shape_count);
+  for (int i = 0; i < shape_count; ++i)
+  {
+    Shape &shape = _shapes[i];
+    shape.x = (unit(generator) * 2.0f - 1.0f) * 1.8f;
+    shape.y = unit(generator) * 2.0f - 1.0f;
+    shape.size = 0.005f + unit(generator) * 0.025f;
+    shape.speed = (unit(generator) * 2.0f - 1.0f) * 2.0f;
+    shape.color[0] = (GLubyte)(unit(generator) * 255.0f);
+    shape.color[1] = (GLubyte)(unit(generator) * 255.0f);
+    shape.color[2] = (GLubyte)(unit(generator) * 255.0f);
+    shape.color[3] = 200;
+    shape.quad = unit(generator) < 0.5f;
+    shape.material = (int)(unit(generator) * MaterialCount) % MaterialCount;
+  }
+}
+
+void Renderer::CreateTexture(Common::GlTexture &texture, bool checker)
+{
+  const int size = 16;
+  GLubyte pixels[size * size * 4];
+  for (int y = 0; y < size; ++y)
+  {
+    for (int x = 0; x < size; ++x)
+    {
+      bool on = checker ? (((x / 4) + (y / 4)) % 2 == 0) : ((y / 2) % 2 == 0);
+      GLubyte *pixel = &pixels[(y * size + x) * 4];
+      pixel[0] = pixel[1] = pixel[2] = on ? 255 : 96;
+      pixel[3] = 255;
+    }
+  }
+  texture.Create("batch");
+  glBindTexture(GL_TEXTURE_2D, texture.Get());
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+  texture.SetBytes(sizeof(pixels));
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+void Renderer::InitializeGl()
+{
+  _time = 0.0;
+
+  // Both programs link while the textures and streams are set up
+  _colored_program = _shaders->Request(vertex_source, colored_fragment_source);
+  _textured_program = _shaders->Request(vertex_source, textured_fragment_source);
+
+  CreateTexture(_textures[0], true);
+  CreateTexture(_textures[1], false);
+  _vertex_stream.InitializeGl("batch");
+  _index_stream.InitializeGl("batch");
+
+  GLuint programs[2] = { _colored_program, _textured_program };
+  for (int i = 0; i < 2; ++i)
+  {
+    _shaders->Resolve(programs[i]);
+    _position_location[i] = glGetAttribLocation(programs[i], "position");
+    _texcoord_location[i] = glGetAttribLocation(programs[i], "texcoord");
+    _color_location[i] = glGetAttribLocation(programs[i], "color");
+    _projection_location[i] = glGetUniformLocation(programs[i], "projection");
+    _projection_dirty[i] = true;
+  }
+  _sampler_location = glGetUniformLocation(_textured_program, "sampler");
+  _state->UseProgram(_textured_program);
+  glUniform1i(_sampler_location, 0);
+
+  _materials[0].program = _colored_program;
+  _materials[0].texture = 0;
+  _materials[1].program = _textured_program;
+  _materials[1].texture = _textures[0].Get();
+  _materials[2].program = _textured_program;
+  _materials[2].texture = _textures[1].Get();
+}
+
+void Renderer::SetViewport(int width, int height)
+{
+  glViewport(0, 0, width, height);
+  _ratio = (float) width / height;
+  _projection_dirty[0] = _projection_dirty[1] = true;
+}
+
+void Renderer::Submit(float time)
+{
+  _batcher.Begin();
+  Vertex vertices[4];
+  for (size_t i = 0; i < _shapes.size(); ++i)
+  {
+    const Shape &shape = _shapes[i];
+    int corners = shape.quad ? 4 : 3;
+    float angle = shape.speed * time + (shape.quad ? Pi / 4.0f : Pi / 2.0f);
+    for (int corner = 0; corner < corners; ++corner)
+    {
+      float a = angle + corner * 2.0f * Pi / corners;
+      Vertex &vertex = vertices[corner];
+      vertex.x = shape.x + cosf(a) * shape.size;
+      vertex.y = shape.y + sinf(a) * shape.size;
+      vertex.u = (corner == 1 || corner == 2) ? 1.0f : 0.0f;
+      vertex.v = corner >= 2 ? 1.0f : 0.0f;
+      vertex.color[0] = shape.color[0];
+      vertex.color[1] = shape.color[1];
+      vertex.color[2] = shape.color[2];
+      vertex.color[3] = shape.color[3];
+    }
+    const Material &material = _materials[shape.material];
+    if (shape.quad)
+    {
+      _batcher.AddQuad(material, vertices[0], vertices[1], vertices[2], vertices[3]);
+    }
+    else
+    {
+      _batcher.AddTriangle(material, vertices[0], vertices[1], vertices[2]);
+    }
+  }
+  _batcher.Build();
+}
+
+void Renderer::DrawFrame()
+{
+  {
+    Common::FrameProfiler::Scope scope(_profiler, "Submit");
+    Submit((float)_time);
+  }
+
+  _state->SetBlend(true);
+  _state->BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+  // Whole frame goes up in one upload per stream, into a region no frame
+  // in flight is reading from.
+  const std::vector<Vertex> &vertices = _batcher.GetVertices();
+  const std::vector<GLushort> &indices = _batcher.GetIndices();
+  _profiler->BeginMarker("Upload");
+  _vertex_stream.NextFrame();
+  _index_stream.NextFrame();
+  GLintptr vertex_offset = _vertex_stream.Upload(vertices.data(), vertices.size() * sizeof(Vertex), sizeof(GLfloat));
+  GLintptr index_offset = _index_stream.Upload(indices.data(), indices.size() * sizeof(GLushort), sizeof(GLushort));
+  _profiler->EndMarker();
+  Common::FrameProfiler::Scope scope(_profiler, "Draw");
+
+  GLuint bound_texture = 0;
+  glActiveTexture(GL_TEXTURE0);
+
+  const std::vector<DrawRange> &ranges = _batcher.GetRanges();
+  for (size_t i = 0; i < ranges.size(); ++i)
+  {
+    const DrawRange &range = ranges[i];
+    int slot = range.material.program == _colored_program ? 0 : 1;
+    _state->UseProgram(range.material.program);
+    // Uniforms live in the programs, the projection only changes with the viewport
+    if (_projection_dirty[slot])
+    {
+      glm::mat4 projection = glm::ortho(-_ratio, _ratio, -1.0f, 1.0f, -1.0f, 1.0f);
+      glUniformMatrix4fv(_projection_location[slot], 1, GL_FALSE, glm::value_ptr(projection));
+      _projection_dirty[slot] = false;
+    }
+    if (range.material.texture != 0 && range.material.texture != bound_texture)
+    {
+      glBindTexture(GL_TEXTURE_2D, range.material.texture);
+      bound_texture = range.material.texture;
+    }
+
+    unsigned int mask = 0;
+    const GLchar *base = (const GLchar *)0 + vertex_offset + range.base_vertex * sizeof(Vertex);
+    _state->VertexAttribPointer(_position_location[slot], 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), base + offsetof(Vertex, x));
+    mask |= Common::GlStateCache::AttribBit(_position_location[slot]);
+    _state->VertexAttribPointer(_color_location[slot], 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), base + offsetof(Vertex, color));
+    mask |= Common::GlStateCache::AttribBit(_color_location[slot]);
+    if (_texcoord_location[slot] >= 0)
+    {
+      _state->VertexAttribPointer(_texcoord_location[slot], 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), base + offsetof(Vertex, u));
+      mask |= Common::GlStateCache::AttribBit(_texcoord_location[slot]);
+    }
+    _state->SetEnabledVertexAttribArrays(mask);
+
+    glDrawElements(GL_TRIANGLES, range.index_count, GL_UNSIGNED_SHORT, (const GLvoid *)(index_offset + range.first_index * sizeof(GLushort)));
+  }
+}
+
+void Renderer::Update(double seconds)
+{
+  _time += seconds;
+}
+
+void Renderer::GetCounters(std::vector<std::pair<std::string, double> > &counters) const
+{
+  counters.push_back(std::make_pair("vertex_stream_bytes", (double)_vertex_stream.GetBytesUploaded()));
+  counters.push_back(std::make_pair("vertex_stream_wraps", (double)_vertex_stream.GetWrapCount()));
+  counters.push_back(std::make_pair("vertex_stream_orphans", (double)_vertex_stream.GetOrphanCount()));
+  counters.push_back(std::make_pair("vertex_stream_stalls", (double)_vertex_stream.GetStallCount()));
+  // Of the last frame drawn, the sort avoids the switches of the unsorted order
+  const Common::DrawList::Stats &sort = _batcher.GetSortStats();
+  counters.push_back(std::make_pair("state_changes", (double)sort.state_changes));
+  counters.push_back(std::make_pair("state_changes_avoided", (double)sort.unsorted_state_changes - (double)sort.state_changes));
+}
+
+void Renderer::ReleaseGl()
+{
+  _vertex_stream.ReleaseGl();
+  _index_stream.ReleaseGl();
+  _textures[0].Reset();
+  _textures[1].Reset();
+  _shaders->Release(_colored_program);
+  _shaders->Release(_textured_program);
+}
@@ -0,0 +1,74 @@
+#ifndef BATCH_RENDERER_H
+#define BATCH_RENDERER_H
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+#include <vector>
+#include <GlHandle.h>
+#include <IRenderer.h>
+#include <StreamingBuffer.h>
+#include "Batcher.h"
+
+namespace Common
+{
+  class GlStateCache;
+  class ShaderCache;
+  class FrameProfiler;
+}
+
+namespace Batch
+{
+  // Animated field of colored and textured triangles and quads, all
+  // submitted through a Batcher and drawn with one call per material.
+  class Renderer : public Common::IRenderer
+  {
+  public:
+    static const int DefaultShapeCount = 20000;
+
+    Renderer(int shape_count = DefaultShapeCount);
+    ~Renderer(){};
+    void InitializeGl();
+    void ReleaseGl();
+    void SetViewport(int width, int height);
+    void DrawFrame();
+    void Update(double seconds);
+    // Use of the vertex stream and state changes of the last sort
+    void GetCounters(std::vector<std::pair<std::string, double> > &counters) const;
+  private:
+    struct Shape
+    {
+      GLfloat x, y;
+      GLfloat size;
+      GLfloat speed;
+      GLubyte color[4];
+      bool quad;
+      int material;
+    };
+    static const int MaterialCount = 3;
+    void CreateTexture(Common::GlTexture &texture, bool checker);
+    void Submit(float time);
+
+    std::vector<Shape> _shapes;
+    Batcher _batcher;
+    Material _materials[MaterialCount];
+    GLuint _colored_program;
+    GLuint _textured_program;
+    Common::GlTexture _textures[2];
+    Common::StreamingBuffer _vertex_stream;
+    Common::StreamingBuffer _index_stream;
+    GLint _position_location[2];
+    GLint _texcoord_location[2];
+    GLint _color_location[2];
+    GLint _projection_location[2];
+    // Per program, cleared once the projection is uploaded to it
+    bool _projection_dirty[2];
+    GLint _sampler_location;
+    double _time;
+    GLfloat _ratio;
+    Common::GlStateCache *_state;
+    Common::ShaderCache *_shaders;
+    Common::FrameProfiler *_profiler;
+  };
+}
+
+#endif
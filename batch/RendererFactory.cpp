@@ -0,0 +1,9 @@
+#include "RendererFactory.h"
+#include "Renderer.h"
+
+using namespace Batch;
+
+Common::IRenderer *RendererFactory::Create()
+{
+  return new Renderer();
+}
@@ -0,0 +1,14 @@
+#ifndef BATCH_RENDERER_FACTORY_H
+#define BATCH_RENDERER_FACTORY_H
+
+#include <IRendererFactory.h>
+
+namespace Batch
+{
+  class RendererFactory : public Common::IRendererFactory
+  {
+  public:
+    virtual Common::IRenderer *Create();
+  };
+}
+#endif
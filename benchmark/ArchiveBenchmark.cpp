@@ -0,0 +1,223 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+
+#include <AssetArchive.h>
+#include <headless/HeadlessContext.h>
+
+#include "Statistics.h"
+
+// Startup cost of an asset set read as loose files (one open and read per
+// asset into a heap buffer, the usual ifstream loader) against the same set
+// mapped from one Common::AssetArchive, every asset going to glBufferData.
+// With -c the page cache is dropped for the files before each run
+// (posix_fadvise), which approximates a cold start without root.
+
+const int DefaultAssets        = 400;
+const int DefaultIterations    = 10;
+
+typedef std::chrono::steady_clock Clock;
+
+void usage(const char* program)
+{
+	std::cerr<<"usage: "<<program<<" [-n assets] [-i iterations] [-c] [-d directory]"<<std::endl;
+	std::cerr<<"  -c  drop the files from the page cache before each run"<<std::endl;
+	std::cerr<<"  -d  where the assets are written, a temporary directory by default"<<std::endl;
+}
+
+/*!*********************************************************************************************************************
+\param[in]			path                        File to evict
+\brief	Asks the kernel to drop the cached pages of a file, they are read from the disk again.
+***********************************************************************************************************************/
+void evict(const std::string& path)
+{
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) { return; }
+	fdatasync(fd);
+	posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	close(fd);
+}
+
+/*!*********************************************************************************************************************
+\param[in]			paths                       Loose asset files
+\param[in]			buffer                      Buffer object the assets are uploaded to
+\return		Bytes uploaded
+\brief	Loads every file through an ifstream into a vector, then uploads it.
+***********************************************************************************************************************/
+size_t loadLoose(const std::vector<std::string>& paths, GLuint buffer)
+{
+	size_t bytes = 0;
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	for (size_t i = 0; i < paths.size(); ++i)
+	{
+		std::ifstream file(paths[i].c_str(), std::ios::binary | std::ios::ate);
+		std::vector<char> data((size_t)file.tellg());
+		file.seekg(0);
+		file.read(data.data(), data.size());
+		glBufferData(GL_ARRAY_BUFFER, data.size(), data.data(), GL_STATIC_DRAW);
+		bytes += data.size();
+	}
+	return bytes;
+}
+
+/*!*********************************************************************************************************************
+\param[in]			archivePath                 Archive of the same assets
+\param[in]			names                       Entry names
+\param[in]			buffer                      Buffer object the assets are uploaded to
+\return		Bytes uploaded, 0 when the archive does not open
+\brief	Maps the archive and uploads every asset straight from the mapping.
+***********************************************************************************************************************/
+size_t loadArchive(const std::string& archivePath, const std::vector<std::string>& names, GLuint buffer)
+{
+	Common::AssetArchive archive;
+	if (!archive.Open(archivePath)) { return 0; }
+	size_t bytes = 0;
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	for (size_t i = 0; i < names.size(); ++i)
+	{
+		size_t size = 0;
+		const void* data = archive.Find(names[i].c_str(), &size);
+		if (data == NULL) { return 0; }
+		glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
+		bytes += size;
+	}
+	return bytes;
+}
+
+int main(int argc, char** argv)
+{
+	int assetCount = DefaultAssets;
+	int iterations = DefaultIterations;
+	bool cold = false;
+	std::string directory;
+
+	int option;
+	while ((option = getopt(argc, argv, "n:i:cd:")) != -1)
+	{
+		switch (option)
+		{
+		case 'n': assetCount = atoi(optarg); break;
+		case 'i': iterations = atoi(optarg); break;
+		case 'c': cold = true; break;
+		case 'd': directory = optarg; break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (assetCount <= 0 || iterations <= 0)
+	{
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	bool temporary = directory.empty();
+	if (temporary)
+	{
+		char pattern[] = "/tmp/archive-benchmark-XXXXXX";
+		if (mkdtemp(pattern) == NULL)
+		{
+			std::cerr<<"Unable to create a temporary directory"<<std::endl;
+			return EXIT_FAILURE;
+		}
+		directory = pattern;
+	}
+
+	// Half shader sized text (1 to 4 KB), half vertex buffers (4 to 64 KB)
+	std::mt19937 generator(1234);
+	std::vector<std::string> names;
+	std::vector<std::string> paths;
+	Common::AssetArchiveBuilder builder;
+	size_t totalBytes = 0;
+	for (int i = 0; i < assetCount; ++i)
+	{
+		bool shader = i % 2 == 0;
+		size_t size = shader ? 1024 + generator() % 3072 : 4096 + generator() % 61440;
+		std::vector<char> data(size);
+		for (size_t b = 0; b < size; ++b) { data[b] = shader ? (char)('a' + generator() % 26) : (char)generator(); }
+		char name[64];
+		snprintf(name, sizeof(name), shader ? "shader-%d.glsl" : "mesh-%d.f32", i);
+		std::string path = directory + "/" + name;
+		std::ofstream file(path.c_str(), std::ios::binary);
+		file.write(data.data(), data.size());
+		if (!file)
+		{
+			std::cerr<<"Unable to write "<<path<<std::endl;
+			return EXIT_FAILURE;
+		}
+		names.push_back(name);
+		paths.push_back(path);
+		builder.Add(name, data.data(), data.size());
+		totalBytes += size;
+	}
+	std::string archivePath = directory + "/assets.pak";
+	if (!builder.Write(archivePath))
+	{
+		std::cerr<<"Unable to write "<<archivePath<<std::endl;
+		return EXIT_FAILURE;
+	}
+
+	Headless::HeadlessContext context;
+	if (!context.Create(64, 64))
+	{
+		return EXIT_FAILURE;
+	}
+	GLuint buffer;
+	glGenBuffers(1, &buffer);
+
+	std::vector<double> looseTimes;
+	std::vector<double> archiveTimes;
+	bool complete = true;
+	for (int iteration = 0; iteration < iterations; ++iteration)
+	{
+		// Alternated so that both see the same machine state
+		if (cold) { for (size_t i = 0; i < paths.size(); ++i) { evict(paths[i]); } }
+		Clock::time_point start = Clock::now();
+		complete = loadLoose(paths, buffer) == totalBytes && complete;
+		glFinish();
+		looseTimes.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+
+		if (cold) { evict(archivePath); }
+		start = Clock::now();
+		complete = loadArchive(archivePath, names, buffer) == totalBytes && complete;
+		glFinish();
+		archiveTimes.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+	}
+	glDeleteBuffers(1, &buffer);
+	GLenum glError = glGetError();
+	context.Release();
+
+	struct stat archiveStatus;
+	stat(archivePath.c_str(), &archiveStatus);
+	if (temporary)
+	{
+		for (size_t i = 0; i < paths.size(); ++i) { unlink(paths[i].c_str()); }
+		unlink(archivePath.c_str());
+		rmdir(directory.c_str());
+	}
+
+	std::cout<<"{"<<std::endl;
+	std::cout<<"  \"assets\": "<<assetCount<<","<<std::endl;
+	std::cout<<"  \"asset_mb\": "<<totalBytes / 1048576.0<<","<<std::endl;
+	std::cout<<"  \"archive_mb\": "<<archiveStatus.st_size / 1048576.0<<","<<std::endl;
+	std::cout<<"  \"cold\": "<<(cold ? "true" : "false")<<","<<std::endl;
+	std::cout<<"  \"complete\": "<<(complete ? "true" : "false")<<","<<std::endl;
+	std::cout<<"  \"gl_error\": "<<glError<<","<<std::endl;
+	std::cout<<"  ";
+	Benchmark::WriteDistribution(std::cout, "loose_ms", looseTimes);
+	std::cout<<","<<std::endl<<"  ";
+	Benchmark::WriteDistribution(std::cout, "archive_ms", archiveTimes);
+	std::cout<<std::endl<<"}"<<std::endl;
+	return complete && glError == GL_NO_ERROR ? EXIT_SUCCESS : EXIT_FAILURE;
+}
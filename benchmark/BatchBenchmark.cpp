@@ -0,0 +1,130 @@
+#include <unistd.h>
+#include <stdlib.h>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <batch/Batcher.h>
+
+#include "Statistics.h"
+
+// CPU side of Batch::Batcher: submission, sort and packing of N primitives,
+// no GL context needed. Times are reported per 10k primitives.
+
+const int DefaultPrimitives = 10000;
+const int DefaultIterations = 200;
+const int DefaultMaterials  = 4;
+
+typedef std::chrono::steady_clock Clock;
+
+struct Primitive
+{
+	Batch::Vertex vertices[4];
+	bool quad;
+	int material;
+};
+
+void usage(const char* program)
+{
+	std::cerr<<"usage: "<<program<<" [-n primitives] [-i iterations] [-m materials]"<<std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	int primitiveCount = DefaultPrimitives;
+	int iterations = DefaultIterations;
+	int materialCount = DefaultMaterials;
+
+	int option;
+	while ((option = getopt(argc, argv, "n:i:m:")) != -1)
+	{
+		switch (option)
+		{
+		case 'n': primitiveCount = atoi(optarg); break;
+		case 'i': iterations = atoi(optarg); break;
+		case 'm': materialCount = atoi(optarg); break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (primitiveCount <= 0 || iterations <= 0 || materialCount <= 0)
+	{
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	// Materials are interleaved randomly, the worst case for submission order drawing
+	std::mt19937 generator(1234);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::vector<Batch::Material> materials(materialCount);
+	for (int i = 0; i < materialCount; ++i)
+	{
+		materials[i].program = 1 + i % 2;
+		materials[i].texture = 1 + i;
+	}
+	std::vector<Primitive> primitives(primitiveCount);
+	for (int i = 0; i < primitiveCount; ++i)
+	{
+		Primitive& primitive = primitives[i];
+		primitive.quad = unit(generator) < 0.5f;
+		primitive.material = (int)(unit(generator) * materialCount) % materialCount;
+		for (int corner = 0; corner < 4; ++corner)
+		{
+			Batch::Vertex& vertex = primitive.vertices[corner];
+			vertex.x = unit(generator);
+			vertex.y = unit(generator);
+			vertex.u = corner & 1 ? 1.0f : 0.0f;
+			vertex.v = corner & 2 ? 1.0f : 0.0f;
+			vertex.color[0] = vertex.color[1] = vertex.color[2] = vertex.color[3] = 255;
+		}
+	}
+
+	Batch::Batcher batcher;
+	std::vector<double> submitTimes;
+	std::vector<double> buildTimes;
+	double scale = 10000.0 / primitiveCount;
+	for (int iteration = 0; iteration < iterations; ++iteration)
+	{
+		Clock::time_point start = Clock::now();
+		batcher.Begin();
+		for (int i = 0; i < primitiveCount; ++i)
+		{
+			const Primitive& primitive = primitives[i];
+			const Batch::Material& material = materials[primitive.material];
+			if (primitive.quad)
+			{
+				batcher.AddQuad(material, primitive.vertices[0], primitive.vertices[1], primitive.vertices[2], primitive.vertices[3]);
+			}
+			else
+			{
+				batcher.AddTriangle(material, primitive.vertices[0], primitive.vertices[1], primitive.vertices[2]);
+			}
+		}
+		Clock::time_point submitted = Clock::now();
+		batcher.Build();
+		Clock::time_point built = Clock::now();
+
+		submitTimes.push_back(std::chrono::duration<double, std::micro>(submitted - start).count() * scale);
+		buildTimes.push_back(std::chrono::duration<double, std::micro>(built - submitted).count() * scale);
+	}
+
+	std::cout<<"{"<<std::endl;
+	std::cout<<"  \"primitives\": "<<primitiveCount<<","<<std::endl;
+	std::cout<<"  \"materials\": "<<materialCount<<","<<std::endl;
+	std::cout<<"  \"iterations\": "<<iterations<<","<<std::endl;
+	std::cout<<"  \"vertices\": "<<batcher.GetVertices().size()<<","<<std::endl;
+	std::cout<<"  \"indices\": "<<batcher.GetIndices().size()<<","<<std::endl;
+	std::cout<<"  \"draw_calls\": "<<batcher.GetRanges().size()<<","<<std::endl;
+	std::cout<<"  \"draw_calls_unbatched\": "<<primitiveCount<<","<<std::endl;
+	const Common::DrawList::Stats& sortStats = batcher.GetSortStats();
+	std::cout<<"  \"state_changes\": "<<sortStats.state_changes<<","<<std::endl;
+	std::cout<<"  \"state_changes_unsorted\": "<<sortStats.unsorted_state_changes<<","<<std::endl;
+	std::cout<<"  ";
+	Benchmark::WriteDistribution(std::cout, "submit_us_per_10k", submitTimes);
+	std::cout<<","<<std::endl<<"  ";
+	Benchmark::WriteDistribution(std::cout, "build_us_per_10k", buildTimes);
+	std::cout<<std::endl<<"}"<<std::endl;
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,345 @@
+#include <unistd.h>
+#include <stdlib.h>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+
+#include <CommandBuffer.h>
+#include <Context.h>
+#include <GlStateCache.h>
+#include <headless/HeadlessContext.h>
+
+#include "Statistics.h"
+
+// Common::CommandBuffer: recording N commands on one thread and split over
+// worker threads (one buffer each), replaying them on the GL thread, and
+// issuing the same commands directly through the GlStateCache. Draws are
+// degenerate triangles, the GL work is validation and state only, so
+// replay and direct submission differ by the decoding cost. A second
+// sequence only repeats state the cache already has: nothing reaches GL
+// and the replay time is the decode loop itself. Times are microseconds
+// per 10k commands.
+
+const int DefaultCommands     = 10000;
+const int DefaultIterations   = 200;
+const int DefaultThreads      = 4;
+// Commands recorded per object
+const int CommandsPerObject   = 5;
+// Objects drawn with the same program in a row
+const int ObjectsPerProgram   = 8;
+
+typedef std::chrono::steady_clock Clock;
+
+// What the scene traversal would produce, the same for every method
+struct Scene
+{
+	GLuint programs[2];
+	GLint colorLocations[2];
+	GLint positionLocations[2];
+	GLuint buffer;
+	int objects;
+};
+
+// Recording threads wait for a new generation, record their slice and count themselves done.
+// They sleep in between so that they do not steal time from the GL thread's measurements.
+struct Workers
+{
+	std::vector<std::thread> threads;
+	std::vector<Common::CommandBuffer*> buffers;
+	std::mutex mutex;
+	std::condition_variable start;
+	std::condition_variable finished;
+	int generation;
+	int done;
+	bool stop;
+};
+
+void usage(const char* program)
+{
+	std::cerr<<"usage: "<<program<<" [-n commands] [-i iterations] [-t threads]"<<std::endl;
+}
+
+/*!*********************************************************************************************************************
+\param[in]			scene                       Objects to draw
+\param[in]			first                       First object
+\param[in]			last                        One past the last object
+\param[out]		target                      CommandBuffer or GlStateCache wrapper receiving the commands
+\brief	Emits the commands of a range of objects, the same sequence whether recorded or issued.
+***********************************************************************************************************************/
+template <typename Target>
+void emitObjects(const Scene& scene, int first, int last, Target& target)
+{
+	for (int object = first; object < last; ++object)
+	{
+		int program = (object / ObjectsPerProgram) % 2;
+		float shade = (float)(object % 256) / 255.0f;
+		target.UseProgram(scene.programs[program]);
+		target.BindArrayBuffer(scene.buffer);
+		target.VertexAttribPointer(scene.positionLocations[program], 2, GL_FLOAT, GL_FALSE, 0, 0);
+		target.Uniform4f(scene.colorLocations[program], shade, 1.0f - shade, 0.5f, 1.0f);
+		target.DrawArrays(GL_TRIANGLES, 0, 3);
+	}
+}
+
+/*!*********************************************************************************************************************
+\param[in]			scene                       Objects to draw
+\param[in]			count                       Commands to emit
+\param[out]		target                      CommandBuffer or GlStateCache wrapper receiving the commands
+\brief	Emits state the cache already holds, every command is elided.
+***********************************************************************************************************************/
+template <typename Target>
+void emitRedundantState(const Scene& scene, int count, Target& target)
+{
+	for (int i = 0; i + 3 <= count; i += 3)
+	{
+		target.UseProgram(scene.programs[0]);
+		target.BindArrayBuffer(scene.buffer);
+		target.VertexAttribPointer(scene.positionLocations[0], 2, GL_FLOAT, GL_FALSE, 0, 0);
+	}
+}
+
+// Same calls as CommandBuffer, issued right away
+struct DirectTarget
+{
+	Common::GlStateCache* state;
+	void UseProgram(GLuint program) { state->UseProgram(program); }
+	void BindArrayBuffer(GLuint buffer) { state->BindArrayBuffer(buffer); }
+	void VertexAttribPointer(GLint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, GLintptr offset)
+	{
+		state->VertexAttribPointer(index, size, type, normalized, stride, (const GLvoid*)offset);
+	}
+	void Uniform4f(GLint location, GLfloat x, GLfloat y, GLfloat z, GLfloat w) { glUniform4f(location, x, y, z, w); }
+	void DrawArrays(GLenum mode, GLint first, GLsizei count) { glDrawArrays(mode, first, count); }
+};
+
+/*!*********************************************************************************************************************
+\param[in]			workers                     Shared state
+\param[in]			scene                       Objects to draw
+\param[in]			index                       Worker index, also its slice of the objects
+\brief	Worker loop: records its slice each time the generation changes.
+***********************************************************************************************************************/
+void recordWorker(Workers* workers, const Scene* scene, int index)
+{
+	int seen = 0;
+	int count = (int)workers->buffers.size();
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(workers->mutex);
+			while (!workers->stop && workers->generation == seen) { workers->start.wait(lock); }
+			if (workers->stop) { return; }
+			seen = workers->generation;
+		}
+		Common::CommandBuffer* buffer = workers->buffers[index];
+		buffer->Reset();
+		emitObjects(*scene, scene->objects * index / count, scene->objects * (index + 1) / count, *buffer);
+		std::lock_guard<std::mutex> lock(workers->mutex);
+		if (++workers->done == count) { workers->finished.notify_one(); }
+	}
+}
+
+GLuint createProgram(const char* fragmentSource)
+{
+	const char* vertexSource =
+		"attribute vec2 position;\n"
+		"void main() { gl_Position = vec4(position, 0.0, 1.0); }\n";
+	GLuint program = glCreateProgram();
+	const char* sources[2] = { vertexSource, fragmentSource };
+	GLenum types[2] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+	for (int i = 0; i < 2; ++i)
+	{
+		GLuint shader = glCreateShader(types[i]);
+		glShaderSource(shader, 1, &sources[i], NULL);
+		glCompileShader(shader);
+		glAttachShader(program, shader);
+		glDeleteShader(shader);
+	}
+	glLinkProgram(program);
+	return program;
+}
+
+int main(int argc, char** argv)
+{
+	int commandCount = DefaultCommands;
+	int iterations = DefaultIterations;
+	int threadCount = DefaultThreads;
+
+	int option;
+	while ((option = getopt(argc, argv, "n:i:t:")) != -1)
+	{
+		switch (option)
+		{
+		case 'n': commandCount = atoi(optarg); break;
+		case 'i': iterations = atoi(optarg); break;
+		case 't': threadCount = atoi(optarg); break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (commandCount < CommandsPerObject || iterations <= 0 || threadCount <= 0)
+	{
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	Headless::HeadlessContext context;
+	if (!context.Create(64, 64))
+	{
+		return EXIT_FAILURE;
+	}
+	Common::GlStateCache* state = Common::Context::Instance()->GetGlStateCache();
+	state->Reset();
+
+	Scene scene;
+	scene.programs[0] = createProgram("precision mediump float; uniform vec4 color; void main() { gl_FragColor = color; }\n");
+	scene.programs[1] = createProgram("precision mediump float; uniform vec4 color; void main() { gl_FragColor = color.bgra; }\n");
+	for (int i = 0; i < 2; ++i)
+	{
+		scene.colorLocations[i] = glGetUniformLocation(scene.programs[i], "color");
+		scene.positionLocations[i] = glGetAttribLocation(scene.programs[i], "position");
+	}
+	// Every vertex at the same place, nothing is rasterized
+	const GLfloat vertices[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+	glGenBuffers(1, &scene.buffer);
+	state->BindArrayBuffer(scene.buffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+	state->SetEnabledVertexAttribArrays(Common::GlStateCache::AttribBit(scene.positionLocations[0])
+	                                    | Common::GlStateCache::AttribBit(scene.positionLocations[1]));
+	scene.objects = commandCount / CommandsPerObject;
+	double per10k = 10000.0 / (scene.objects * CommandsPerObject);
+
+	Common::CommandBuffer single;
+	Workers workers;
+	workers.generation = 0;
+	workers.done = 0;
+	workers.stop = false;
+	for (int i = 0; i < threadCount; ++i)
+	{
+		workers.buffers.push_back(new Common::CommandBuffer());
+	}
+	for (int i = 0; i < threadCount; ++i)
+	{
+		workers.threads.push_back(std::thread(recordWorker, &workers, &scene, i));
+	}
+
+	std::vector<double> recordTimes;
+	std::vector<double> parallelRecordTimes;
+	std::vector<double> replayTimes;
+	std::vector<double> directTimes;
+	std::vector<double> decodeTimes;
+	std::vector<double> elidedDirectTimes;
+	unsigned long replayIssued = 0;
+	unsigned long directIssued = 0;
+	size_t capacity = 0;
+	DirectTarget direct;
+	direct.state = state;
+	Common::CommandBuffer redundant;
+	emitRedundantState(scene, scene.objects * CommandsPerObject, redundant);
+	double redundantPer10k = 10000.0 / redundant.GetCommandCount();
+	// The first iteration sizes the buffers, it is not measured
+	for (int iteration = 0; iteration <= iterations; ++iteration)
+	{
+		Clock::time_point start = Clock::now();
+		single.Reset();
+		emitObjects(scene, 0, scene.objects, single);
+		double record = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+		start = Clock::now();
+		{
+			std::unique_lock<std::mutex> lock(workers.mutex);
+			workers.done = 0;
+			++workers.generation;
+			workers.start.notify_all();
+			while (workers.done < threadCount) { workers.finished.wait(lock); }
+		}
+		double parallelRecord = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+		// Worker buffers in slice order, the same sequence as the single buffer. Both start from an unknown state.
+		state->Reset();
+		state->ResetCounters();
+		start = Clock::now();
+		for (int i = 0; i < threadCount; ++i)
+		{
+			workers.buffers[i]->Replay(state);
+		}
+		double replay = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+		replayIssued = state->GetIssuedCount();
+		glFinish();
+
+		state->Reset();
+		state->ResetCounters();
+		start = Clock::now();
+		emitObjects(scene, 0, scene.objects, direct);
+		double issued = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+		directIssued = state->GetIssuedCount();
+		glFinish();
+
+		// Primes the cache with the redundant state, then nothing reaches GL
+		emitRedundantState(scene, 3, direct);
+		start = Clock::now();
+		redundant.Replay(state);
+		double decode = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+		start = Clock::now();
+		emitRedundantState(scene, (int)redundant.GetCommandCount(), direct);
+		double elided = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+		if (iteration > 0)
+		{
+			decodeTimes.push_back(decode * redundantPer10k);
+			elidedDirectTimes.push_back(elided * redundantPer10k);
+			recordTimes.push_back(record * per10k);
+			parallelRecordTimes.push_back(parallelRecord * per10k);
+			replayTimes.push_back(replay * per10k);
+			directTimes.push_back(issued * per10k);
+		}
+	}
+	capacity = single.GetCapacity();
+	size_t bytes = single.GetSize();
+	size_t recorded = single.GetCommandCount();
+
+	{
+		std::lock_guard<std::mutex> lock(workers.mutex);
+		workers.stop = true;
+		workers.start.notify_all();
+	}
+	for (int i = 0; i < threadCount; ++i)
+	{
+		workers.threads[i].join();
+		delete workers.buffers[i];
+	}
+	glDeleteBuffers(1, &scene.buffer);
+	glDeleteProgram(scene.programs[0]);
+	glDeleteProgram(scene.programs[1]);
+	GLenum glError = glGetError();
+	context.Release();
+
+	std::cout<<"{"<<std::endl;
+	std::cout<<"  \"commands\": "<<recorded<<","<<std::endl;
+	std::cout<<"  \"threads\": "<<threadCount<<","<<std::endl;
+	std::cout<<"  \"bytes_per_command\": "<<(double)bytes / recorded<<","<<std::endl;
+	std::cout<<"  \"capacity_bytes\": "<<capacity<<","<<std::endl;
+	// The state cache filters both the same way, the counts match when replay preserves the order
+	std::cout<<"  \"state_calls\": {\"replay\": "<<replayIssued<<", \"direct\": "<<directIssued<<"},"<<std::endl;
+	std::cout<<"  \"gl_error\": "<<glError<<","<<std::endl;
+	std::cout<<"  ";
+	Benchmark::WriteDistribution(std::cout, "record_us_per_10k", recordTimes);
+	std::cout<<","<<std::endl<<"  ";
+	Benchmark::WriteDistribution(std::cout, "parallel_record_us_per_10k", parallelRecordTimes);
+	std::cout<<","<<std::endl<<"  ";
+	Benchmark::WriteDistribution(std::cout, "replay_us_per_10k", replayTimes);
+	std::cout<<","<<std::endl<<"  ";
+	Benchmark::WriteDistribution(std::cout, "direct_us_per_10k", directTimes);
+	std::cout<<","<<std::endl<<"  ";
+	Benchmark::WriteDistribution(std::cout, "elided_replay_us_per_10k", decodeTimes);
+	std::cout<<","<<std::endl<<"  ";
+	Benchmark::WriteDistribution(std::cout, "elided_direct_us_per_10k", elidedDirectTimes);
+	std::cout<<std::endl<<"}"<<std::endl;
+	return glError == GL_NO_ERROR && replayIssued == directIssued ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,247 @@
+#include <unistd.h>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <CullingSystem.h>
+#include <JobSystem.h>
+
+#include "Statistics.h"
+
+// Common::CullingSystem on a large 3D scene: boxes spread over a cube, a
+// fraction of them moving every frame, seen by a perspective camera
+// turning in the middle. Each frame culls with a brute force test of
+// every box, then with the octree on one thread (scalar and SIMD tests)
+// and with jobs. The visible counts must agree, the exit status is a
+// failure otherwise. No GL context needed.
+
+const int DefaultObjects    = 100000;
+const int DefaultFrames     = 100;
+const double DefaultMoving  = 0.1;
+const int DefaultThreads    = 4;
+const float WorldHalfSize   = 100.0f;
+// Vertical, 60 degrees
+const float FieldOfView     = 1.0472f;
+
+typedef std::chrono::steady_clock Clock;
+
+void usage(const char* program)
+{
+	std::cerr<<"usage: "<<program<<" [-n objects] [-f frames] [-m moving fraction] [-t threads] [-d octree depth]"<<std::endl;
+}
+
+struct Box
+{
+	float center[3];
+	float extent[3];
+	float velocity[3];
+};
+
+/*!*********************************************************************************************************************
+\param[in]			viewProjection              Column major
+\param[out]		planes                      a b c d of the left right bottom top near far planes
+\brief	The planes the culling system takes from the matrix, for the brute force reference.
+***********************************************************************************************************************/
+void extractPlanes(const float* viewProjection, float planes[6][4])
+{
+	for (int plane = 0; plane < 6; ++plane)
+	{
+		int row = plane / 2;
+		float sign = plane % 2 == 0 ? 1.0f : -1.0f;
+		for (int column = 0; column < 4; ++column)
+		{
+			planes[plane][column] = viewProjection[column * 4 + 3] + sign * viewProjection[column * 4 + row];
+		}
+		float length = sqrtf(planes[plane][0] * planes[plane][0] + planes[plane][1] * planes[plane][1]
+		                     + planes[plane][2] * planes[plane][2]);
+		for (int column = 0; column < 4; ++column)
+		{
+			planes[plane][column] /= length;
+		}
+	}
+}
+
+/*!*********************************************************************************************************************
+\param[in]			boxes                       Every box of the scene
+\param[in]			planes                      Frustum planes
+\return		Boxes inside or crossing the frustum
+\brief	Every box against every plane, what a renderer without a spatial index does.
+***********************************************************************************************************************/
+size_t bruteForce(const std::vector<Box>& boxes, const float planes[6][4])
+{
+	size_t visible = 0;
+	for (size_t i = 0; i < boxes.size(); ++i)
+	{
+		const Box& box = boxes[i];
+		bool inside = true;
+		for (int plane = 0; plane < 6 && inside; ++plane)
+		{
+			const float* p = planes[plane];
+			float distance = p[0] * box.center[0] + p[1] * box.center[1] + p[2] * box.center[2] + p[3];
+			float radius = fabsf(p[0]) * box.extent[0] + fabsf(p[1]) * box.extent[1] + fabsf(p[2]) * box.extent[2];
+			inside = distance + radius >= 0.0f;
+		}
+		visible += inside ? 1 : 0;
+	}
+	return visible;
+}
+
+/*!*********************************************************************************************************************
+\param[in]			start                       When the measure started
+\return		Milliseconds since start
+\brief	Elapsed time of one cull.
+***********************************************************************************************************************/
+double elapsed(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+	int count = DefaultObjects;
+	int frames = DefaultFrames;
+	double moving = DefaultMoving;
+	int threads = DefaultThreads;
+	int depth = Common::CullingSystem::DefaultMaxDepth;
+	int option;
+	while ((option = getopt(argc, argv, "n:f:m:t:d:")) != -1)
+	{
+		switch (option)
+		{
+		case 'n': count = atoi(optarg); break;
+		case 'f': frames = atoi(optarg); break;
+		case 'm': moving = atof(optarg); break;
+		case 't': threads = atoi(optarg); break;
+		case 'd': depth = atoi(optarg); break;
+		default: usage(argv[0]); return EXIT_FAILURE;
+		}
+	}
+	if (count <= 0 || frames <= 0 || moving < 0.0 || moving > 1.0 || threads <= 0 || depth < 0)
+	{
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	std::mt19937 generator(1234);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	const float worldCenter[3] = { 0.0f, 0.0f, 0.0f };
+	Common::CullingSystem culling(worldCenter, WorldHalfSize, depth);
+	std::vector<Box> boxes(count);
+	std::vector<Common::CullingSystem::Handle> handles(count);
+	Clock::time_point start = Clock::now();
+	for (int i = 0; i < count; ++i)
+	{
+		Box& box = boxes[i];
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			box.center[axis] = (unit(generator) * 2.0f - 1.0f) * WorldHalfSize;
+			box.extent[axis] = 0.2f + unit(generator) * 0.8f;
+			box.velocity[axis] = (unit(generator) * 2.0f - 1.0f) * 0.5f;
+		}
+		handles[i] = culling.Insert(box.center, box.extent);
+	}
+	double insertMilliseconds = elapsed(start);
+	int movingCount = (int)(count * moving);
+
+	// The caller helps in the parallel cull, threads - 1 workers
+	Common::JobSystem jobs(threads - 1);
+	std::vector<Common::CullingSystem::Handle> visible(count);
+	std::vector<double> moveTimes;
+	std::vector<double> bruteTimes;
+	std::vector<double> scalarTimes;
+	std::vector<double> simdTimes;
+	std::vector<double> jobTimes;
+	double visibleSum = 0.0;
+	double testedSum = 0.0;
+	double acceptedSum = 0.0;
+	double nodesSum = 0.0;
+	int mismatches = 0;
+	for (int frame = 0; frame < frames; ++frame)
+	{
+		// A different slice of the boxes moves every frame, bouncing off the world's walls
+		start = Clock::now();
+		for (int i = 0; i < movingCount; ++i)
+		{
+			Box& box = boxes[((size_t)frame * movingCount + i) % count];
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				box.center[axis] += box.velocity[axis];
+				if (fabsf(box.center[axis]) > WorldHalfSize)
+				{
+					box.velocity[axis] = -box.velocity[axis];
+					box.center[axis] += 2.0f * box.velocity[axis];
+				}
+			}
+			culling.Move(handles[((size_t)frame * movingCount + i) % count], box.center, box.extent);
+		}
+		moveTimes.push_back(elapsed(start));
+
+		float angle = frame * 0.05f;
+		glm::mat4 view = glm::rotate(glm::mat4(1.0f), angle, glm::vec3(0.0f, 1.0f, 0.0f));
+		glm::mat4 projection = glm::perspective(FieldOfView, 16.0f / 9.0f, 1.0f, 150.0f);
+		glm::mat4 viewProjection = projection * view;
+		culling.SetViewProjection(glm::value_ptr(viewProjection));
+
+		float planes[6][4];
+		extractPlanes(glm::value_ptr(viewProjection), planes);
+		start = Clock::now();
+		size_t expected = bruteForce(boxes, planes);
+		bruteTimes.push_back(elapsed(start));
+
+		size_t scalar = culling.Cull(visible.data(), NULL, Common::CullingSystem::Scalar);
+		scalarTimes.push_back(culling.GetStats().milliseconds);
+		size_t simd = culling.Cull(visible.data(), NULL, Common::CullingSystem::Simd);
+		simdTimes.push_back(culling.GetStats().milliseconds);
+		size_t parallel = culling.Cull(visible.data(), &jobs, Common::CullingSystem::Simd);
+		jobTimes.push_back(culling.GetStats().milliseconds);
+		if (scalar != expected || simd != expected || parallel != expected)
+		{
+			++mismatches;
+		}
+
+		const Common::CullingSystem::Stats& stats = culling.GetStats();
+		visibleSum += stats.visible;
+		testedSum += stats.objects_tested;
+		acceptedSum += stats.objects_accepted;
+		nodesSum += stats.nodes_visited;
+	}
+
+	std::cout<<"{"<<std::endl;
+	std::cout<<"  \"objects\": "<<count<<","<<std::endl;
+	std::cout<<"  \"moving_per_frame\": "<<movingCount<<","<<std::endl;
+	std::cout<<"  \"frames\": "<<frames<<","<<std::endl;
+	std::cout<<"  \"threads\": "<<threads<<","<<std::endl;
+	std::cout<<"  \"max_depth\": "<<depth<<","<<std::endl;
+	std::cout<<"  \"simd\": "<<(Common::CullingSystem::HasSimd() ? "true" : "false")<<","<<std::endl;
+	std::cout<<"  \"insert_ms\": "<<insertMilliseconds<<","<<std::endl;
+	std::cout<<"  \"visible_per_frame\": "<<visibleSum / frames<<","<<std::endl;
+	std::cout<<"  \"tested_per_frame\": "<<testedSum / frames<<","<<std::endl;
+	std::cout<<"  \"accepted_per_frame\": "<<acceptedSum / frames<<","<<std::endl;
+	std::cout<<"  \"nodes_visited_per_frame\": "<<nodesSum / frames<<","<<std::endl;
+	std::cout<<"  ";
+	Benchmark::WriteDistribution(std::cout, "move_ms", moveTimes);
+	std::cout<<","<<std::endl<<"  ";
+	Benchmark::WriteDistribution(std::cout, "brute_force_ms", bruteTimes);
+	std::cout<<","<<std::endl<<"  ";
+	Benchmark::WriteDistribution(std::cout, "octree_scalar_ms", scalarTimes);
+	std::cout<<","<<std::endl<<"  ";
+	Benchmark::WriteDistribution(std::cout, "octree_simd_ms", simdTimes);
+	std::cout<<","<<std::endl<<"  ";
+	Benchmark::WriteDistribution(std::cout, "octree_jobs_ms", jobTimes);
+	std::cout<<","<<std::endl;
+	std::cout<<"  \"speedup\": "<<Benchmark::Percentile(bruteTimes, 50.0) / Benchmark::Percentile(jobTimes, 50.0)<<","<<std::endl;
+	std::cout<<"  \"mismatched_frames\": "<<mismatches<<std::endl;
+	std::cout<<"}"<<std::endl;
+	if (mismatches != 0)
+	{
+		std::cerr<<mismatches<<" frames where the octree and the brute force disagree"<<std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
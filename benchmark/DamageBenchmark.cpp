@@ -0,0 +1,239 @@
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+
+#include <Context.h>
+#include <Compositor.h>
+#include <PartialPresenter.h>
+#include <text/Renderer.h>
+#include <headless/HeadlessContext.h>
+
+#include "Statistics.h"
+
+// What damage tracking saves on a mostly idle scene: the text HUD, whose
+// statistics change twice a second, drawn at 60 simulated frames per
+// second with every frame redrawn whole, then with frames without damage
+// skipped and the others repainted over their damage only. The power
+// proxies are the frames presented, the pixels repainted and the CPU and
+// driver time spent per second of simulation. The last frame of the
+// damage run is read back and compared with the same frame redrawn whole,
+// the benchmark fails when they differ.
+
+const int DefaultFrames        = 600;
+const int DefaultWarmupFrames  = 30;
+const int DefaultWidth         = 1024;
+const int DefaultHeight        = 768;
+const double SimulationStep    = 1.0 / 60.0;
+
+typedef std::chrono::steady_clock Clock;
+
+struct Run
+{
+	Common::PartialPresenter::Stats stats;
+	std::vector<double> cpuTimes;
+	std::vector<double> finishTimes;
+	double cpuMilliseconds;
+	double finishMilliseconds;
+};
+
+void usage(const char* program)
+{
+	std::cerr<<"usage: "<<program<<" [-n frames] [-u warmup frames] [-w width] [-h height]"<<std::endl;
+}
+
+/*!*********************************************************************************************************************
+\param[in]			width                       Surface width
+\param[in]			height                      Surface height
+\param[out]		pixels                      RGBA pixels of the bound framebuffer
+\brief	Reads the frame back.
+***********************************************************************************************************************/
+void readFrame(int width, int height, std::vector<GLubyte>& pixels)
+{
+	pixels.resize((size_t)width * height * 4);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+}
+
+/*!*********************************************************************************************************************
+\param[in]			damage                      Whether frames are presented through their damage or whole
+\param[in]			frames                      Frames measured
+\param[in]			warmupFrames                Frames drawn before
+\param[in]			width                       Surface width
+\param[in]			height                      Surface height
+\param[out]		run                         Presentation counts and times of the measured frames
+\return		For the damage run, whether the last frame matches the same frame redrawn whole
+\brief	Draws the HUD for warmup and measured frames on the current context.
+***********************************************************************************************************************/
+bool drawFrames(bool damage, int frames, int warmupFrames, int width, int height, Run& run)
+{
+	Common::Compositor compositor;
+	compositor.AddLayer("text", new Text::Renderer());
+	compositor.InitializeGl();
+	compositor.SetViewport(width, height);
+	Common::PartialPresenter presenter;
+	presenter.SetEnabled(damage);
+	presenter.InitializeOffscreen(width, height);
+
+	run.cpuMilliseconds = 0.0;
+	run.finishMilliseconds = 0.0;
+	for (int frame = 0; frame < warmupFrames + frames; ++frame)
+	{
+		if (frame == warmupFrames)
+		{
+			presenter.ResetStats();
+		}
+		compositor.Update(SimulationStep);
+		// Skipped frames cost the damage query only
+		Clock::time_point start = Clock::now();
+		bool drawn = presenter.BeginFrame(&compositor);
+		if (drawn)
+		{
+			compositor.SetRepaintRegion(presenter.GetRepaintRegion());
+			compositor.DrawFrame();
+		}
+		else
+		{
+			compositor.SkipFrame();
+		}
+		Clock::time_point submitted = Clock::now();
+		glFinish();
+		Clock::time_point finished = Clock::now();
+		if (drawn)
+		{
+			presenter.Present();
+		}
+		if (frame >= warmupFrames)
+		{
+			double cpu = std::chrono::duration<double, std::milli>(submitted - start).count();
+			double finish = std::chrono::duration<double, std::milli>(finished - submitted).count();
+			run.cpuTimes.push_back(cpu);
+			run.finishTimes.push_back(finish);
+			run.cpuMilliseconds += cpu;
+			run.finishMilliseconds += finish;
+		}
+	}
+	run.stats = presenter.GetStats();
+
+	bool identical = true;
+	if (damage)
+	{
+		std::vector<GLubyte> partial;
+		std::vector<GLubyte> whole;
+		readFrame(width, height, partial);
+		compositor.Invalidate();
+		presenter.BeginFrame(&compositor);
+		compositor.SetRepaintRegion(presenter.GetRepaintRegion());
+		compositor.DrawFrame();
+		readFrame(width, height, whole);
+		identical = partial == whole;
+	}
+	compositor.ReleaseGl();
+	return identical;
+}
+
+/*!*********************************************************************************************************************
+\param[in]			output                      Stream the JSON object is written to
+\param[in]			mode                        Name of the run
+\param[in]			run                         Its results, the time samples are sorted
+\param[in]			seconds                     Simulated time the measured frames cover
+\brief	Writes one run of the report.
+***********************************************************************************************************************/
+void writeRun(std::ostream& output, const char* mode, Run& run, double seconds)
+{
+	const Common::PartialPresenter::Stats& stats = run.stats;
+	output<<"    {\"mode\": \""<<mode<<"\""
+	      <<", \"frames_presented\": "<<stats.presented
+	      <<", \"frames_skipped\": "<<stats.skipped
+	      <<", \"frames_partial\": "<<stats.partial
+	      <<", \"presented_per_s\": "<<stats.presented / seconds
+	      <<", \"mpixels_repainted_per_s\": "<<stats.repainted_pixels / seconds / 1000000.0
+	      <<", \"mpixels_damaged_per_s\": "<<stats.damaged_pixels / seconds / 1000000.0
+	      <<", \"cpu_ms_per_s\": "<<run.cpuMilliseconds / seconds
+	      <<", \"finish_ms_per_s\": "<<run.finishMilliseconds / seconds<<", ";
+	Benchmark::WriteDistribution(output, "cpu_frame_ms", run.cpuTimes);
+	output<<", ";
+	Benchmark::WriteDistribution(output, "finish_ms", run.finishTimes);
+	output<<"}";
+}
+
+double ratio(double value, double reference)
+{
+	return reference > 0.0 ? value / reference : 0.0;
+}
+
+int main(int argc, char** argv)
+{
+	int frames = DefaultFrames;
+	int warmupFrames = DefaultWarmupFrames;
+	int width = DefaultWidth;
+	int height = DefaultHeight;
+
+	int option;
+	while ((option = getopt(argc, argv, "n:u:w:h:")) != -1)
+	{
+		switch (option)
+		{
+		case 'n': frames = atoi(optarg); break;
+		case 'u': warmupFrames = atoi(optarg); break;
+		case 'w': width = atoi(optarg); break;
+		case 'h': height = atoi(optarg); break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (frames <= 0 || warmupFrames < 0 || width <= 0 || height <= 0)
+	{
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	Headless::HeadlessContext context;
+	if (!context.Create(width, height))
+	{
+		return EXIT_FAILURE;
+	}
+	const char* glRenderer = (const char*)glGetString(GL_RENDERER);
+	std::string glRendererName = glRenderer ? glRenderer : "unknown";
+
+	Run full;
+	Run damage;
+	drawFrames(false, frames, warmupFrames, width, height, full);
+	bool identical = drawFrames(true, frames, warmupFrames, width, height, damage);
+	GLenum glError = glGetError();
+	context.Release();
+	Common::Context::Release();
+
+	double seconds = frames * SimulationStep;
+	std::cout<<"{"<<std::endl;
+	std::cout<<"  \"gl_renderer\": \""<<glRendererName<<"\","<<std::endl;
+	std::cout<<"  \"surface\": \""<<context.GetSurfaceName()<<"\","<<std::endl;
+	std::cout<<"  \"width\": "<<width<<","<<std::endl;
+	std::cout<<"  \"height\": "<<height<<","<<std::endl;
+	std::cout<<"  \"frames\": "<<frames<<","<<std::endl;
+	std::cout<<"  \"gl_error\": "<<glError<<","<<std::endl;
+	std::cout<<"  \"partial_matches_whole\": "<<(identical ? "true" : "false")<<","<<std::endl;
+	std::cout<<"  \"presented_ratio\": "<<ratio(damage.stats.presented, full.stats.presented)<<","<<std::endl;
+	std::cout<<"  \"repainted_ratio\": "<<ratio(damage.stats.repainted_pixels, full.stats.repainted_pixels)<<","<<std::endl;
+	std::cout<<"  \"cpu_ratio\": "<<ratio(damage.cpuMilliseconds, full.cpuMilliseconds)<<","<<std::endl;
+	std::cout<<"  \"finish_ratio\": "<<ratio(damage.finishMilliseconds, full.finishMilliseconds)<<","<<std::endl;
+	std::cout<<"  \"runs\": ["<<std::endl;
+	writeRun(std::cout, "full", full, seconds);
+	std::cout<<","<<std::endl;
+	writeRun(std::cout, "damage", damage, seconds);
+	std::cout<<std::endl<<"  ]"<<std::endl;
+	std::cout<<"}"<<std::endl;
+	if (!identical)
+	{
+		std::cerr<<"The frame repainted over its damage differs from the frame drawn whole"<<std::endl;
+	}
+	return glError == GL_NO_ERROR && identical ? EXIT_SUCCESS : EXIT_FAILURE;
+}
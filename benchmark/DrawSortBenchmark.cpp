@@ -0,0 +1,183 @@
+#include <unistd.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <DrawList.h>
+
+#include "Statistics.h"
+
+// Common::DrawList on a frame of many draws: a few layers, a quarter of
+// the draws translucent, their programs, textures and buffers drawn at
+// random and their depths changing every frame. The radix sort is timed
+// against std::sort and std::stable_sort of the same keys, and checked
+// against the latter. The exit status is a failure when the order is
+// wrong or when the median sort exceeds the budget. No GL context needed.
+
+const int DefaultItems      = 100000;
+const int DefaultIterations = 100;
+// Half a frame at 60 Hz
+const double DefaultBudget  = 8000.0;
+const int Layers            = 4;
+const int Programs          = 16;
+const int Textures          = 256;
+const int Buffers           = 64;
+
+typedef std::chrono::steady_clock Clock;
+
+void usage(const char* program)
+{
+	std::cerr<<"usage: "<<program<<" [-n items] [-i iterations] [-b budget in microseconds]"<<std::endl;
+}
+
+struct Draw
+{
+	unsigned int layer;
+	bool translucent;
+	uint32_t program;
+	uint32_t texture;
+	uint32_t buffer;
+};
+
+// What std::stable_sort and the radix sort agree on: the key, then the order added
+bool byKey(const Common::DrawList::Item& a, const Common::DrawList::Item& b)
+{
+	return a.key < b.key;
+}
+
+bool byKeyThenIndex(const Common::DrawList::Item& a, const Common::DrawList::Item& b)
+{
+	return a.key < b.key || (a.key == b.key && a.index < b.index);
+}
+
+/*!*********************************************************************************************************************
+\param[in]			start                       When the measure started
+\return		Microseconds since start
+\brief	Elapsed time of one sort.
+***********************************************************************************************************************/
+double elapsed(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+	int count = DefaultItems;
+	int iterations = DefaultIterations;
+	double budget = DefaultBudget;
+	int option;
+	while ((option = getopt(argc, argv, "n:i:b:")) != -1)
+	{
+		switch (option)
+		{
+		case 'n': count = atoi(optarg); break;
+		case 'i': iterations = atoi(optarg); break;
+		case 'b': budget = atof(optarg); break;
+		default: usage(argv[0]); return EXIT_FAILURE;
+		}
+	}
+	if (count <= 0 || iterations <= 0 || budget <= 0.0)
+	{
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	std::mt19937 generator(1234);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::vector<Draw> draws(count);
+	for (int i = 0; i < count; ++i)
+	{
+		draws[i].layer = generator() % Layers;
+		draws[i].translucent = unit(generator) < 0.25f;
+		draws[i].program = 1 + generator() % Programs;
+		draws[i].texture = 1 + generator() % Textures;
+		draws[i].buffer = 1 + generator() % Buffers;
+	}
+
+	Common::DrawList list;
+	std::vector<Common::DrawList::Item> copy;
+	copy.reserve(count);
+	std::vector<double> addTimes;
+	std::vector<double> radixTimes;
+	std::vector<double> sortTimes;
+	std::vector<double> stableSortTimes;
+	double passes = 0.0;
+	int misordered = 0;
+	for (int iteration = 0; iteration < iterations; ++iteration)
+	{
+		Clock::time_point start = Clock::now();
+		list.Begin();
+		for (int i = 0; i < count; ++i)
+		{
+			const Draw& draw = draws[i];
+			uint64_t key = Common::DrawList::MakeKey(draw.layer, draw.translucent, unit(generator),
+			                                         draw.program, draw.texture, draw.buffer);
+			list.Add(key, draw.program, draw.texture, draw.buffer);
+		}
+		addTimes.push_back(elapsed(start));
+
+		copy.assign(list.GetItems(), list.GetItems() + list.GetCount());
+		start = Clock::now();
+		list.Sort();
+		radixTimes.push_back(elapsed(start));
+		passes += list.GetStats().passes;
+
+		std::vector<Common::DrawList::Item> unstable(copy);
+		start = Clock::now();
+		std::sort(unstable.begin(), unstable.end(), byKeyThenIndex);
+		sortTimes.push_back(elapsed(start));
+
+		start = Clock::now();
+		std::stable_sort(copy.begin(), copy.end(), byKey);
+		stableSortTimes.push_back(elapsed(start));
+
+		const Common::DrawList::Item* items = list.GetItems();
+		for (int i = 0; i < count; ++i)
+		{
+			if (items[i].key != copy[i].key || items[i].index != copy[i].index)
+			{
+				++misordered;
+				break;
+			}
+		}
+	}
+	const Common::DrawList::Stats& stats = list.GetStats();
+	std::vector<double> sortedRadixTimes(radixTimes);
+	std::sort(sortedRadixTimes.begin(), sortedRadixTimes.end());
+	double median = Benchmark::Percentile(sortedRadixTimes, 50.0);
+
+	std::cout<<"{"<<std::endl;
+	std::cout<<"  \"items\": "<<count<<","<<std::endl;
+	std::cout<<"  \"iterations\": "<<iterations<<","<<std::endl;
+	std::cout<<"  \"budget_us\": "<<budget<<","<<std::endl;
+	std::cout<<"  \"passes\": "<<passes / iterations<<","<<std::endl;
+	std::cout<<"  \"state_changes_unsorted\": "<<stats.unsorted_state_changes<<","<<std::endl;
+	std::cout<<"  \"state_changes\": "<<stats.state_changes<<","<<std::endl;
+	std::cout<<"  \"state_changes_avoided\": "<<stats.unsorted_state_changes - stats.state_changes<<","<<std::endl;
+	std::cout<<"  ";
+	Benchmark::WriteDistribution(std::cout, "add_us", addTimes);
+	std::cout<<","<<std::endl<<"  ";
+	Benchmark::WriteDistribution(std::cout, "radix_sort_us", radixTimes);
+	std::cout<<","<<std::endl<<"  ";
+	Benchmark::WriteDistribution(std::cout, "std_sort_us", sortTimes);
+	std::cout<<","<<std::endl<<"  ";
+	Benchmark::WriteDistribution(std::cout, "std_stable_sort_us", stableSortTimes);
+	std::cout<<","<<std::endl;
+	std::cout<<"  \"within_budget\": "<<(median <= budget ? "true" : "false")<<","<<std::endl;
+	std::cout<<"  \"misordered_iterations\": "<<misordered<<std::endl;
+	std::cout<<"}"<<std::endl;
+	if (misordered != 0)
+	{
+		std::cerr<<misordered<<" iterations where the radix sort and std::stable_sort disagree"<<std::endl;
+		return EXIT_FAILURE;
+	}
+	if (median > budget)
+	{
+		std::cerr<<"median sort of "<<median<<" us over the budget of "<<budget<<" us"<<std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
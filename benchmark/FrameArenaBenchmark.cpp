@@ -0,0 +1,247 @@
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <new>
+#include <vector>
+
+#include <FrameArena.h>
+#include <JobSystem.h>
+
+#include "Statistics.h"
+
+// Common::FrameArena against the heap for the temporaries of a frame: a
+// vector of draw items, their matrices and sort keys built and sorted on
+// the calling thread, and per job lists of visible items built by a
+// parallel for on a Common::JobSystem. The global operator new is
+// replaced to count every allocation: once the arena has grown to the
+// frames' high water mark, a frame must not allocate at all, the exit
+// status is a failure if one does.
+
+const int DefaultItems      = 10000;
+const int DefaultFrames     = 200;
+const int DefaultWarmup     = 10;
+const int DefaultThreads    = 4;
+const size_t Grain          = 256;
+
+typedef std::chrono::steady_clock Clock;
+
+std::atomic<unsigned long> heapAllocations(0);
+
+void* operator new(size_t size)
+{
+	++heapAllocations;
+	void* memory = malloc(size > 0 ? size : 1);
+	if (memory == NULL) { throw std::bad_alloc(); }
+	return memory;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* memory) noexcept
+{
+	free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	free(memory);
+}
+
+void usage(const char* program)
+{
+	std::cerr<<"usage: "<<program<<" [-n items] [-f frames] [-w warmup frames] [-t threads]"<<std::endl;
+}
+
+struct DrawItem
+{
+	uint32_t program;
+	uint32_t texture;
+	float depth;
+	uint32_t index;
+	float color[4];
+};
+
+// std::vector on the heap
+struct HeapVectors
+{
+	template <typename T> struct Vector { typedef std::vector<T> Type; };
+	template <typename T> std::vector<T> Make() const { return std::vector<T>(); }
+	void BeginFrame() const {}
+};
+
+// The same vectors in the arena
+struct ArenaVectors
+{
+	Common::FrameArena* arena;
+	template <typename T> struct Vector { typedef Common::FrameVector<T> Type; };
+	template <typename T> Common::FrameVector<T> Make() const { return Common::FrameVector<T>(Common::FrameAllocator<T>(arena)); }
+	void BeginFrame() const { arena->BeginFrame(); }
+};
+
+struct Nothing
+{
+	void operator()(size_t, size_t) const {}
+};
+
+// A range of items culled in a job, the list of the visible ones is a temporary of the job
+template <typename Vectors>
+struct Cull
+{
+	const Vectors* vectors;
+	const DrawItem* items;
+	std::atomic<size_t>* visible;
+	void operator()(size_t begin, size_t end) const
+	{
+		typename Vectors::template Vector<uint32_t>::Type list = vectors->template Make<uint32_t>();
+		for (size_t i = begin; i < end; ++i)
+		{
+			if (items[i].depth < 0.5f) { list.push_back(items[i].index); }
+		}
+		*visible += list.size();
+	}
+};
+
+/*!*********************************************************************************************************************
+\param[in]			vectors                     Where the temporaries are allocated
+\param[in]			jobs                        Runs the culling jobs
+\param[in]			count                       Draw items in the frame
+\param[in]			frame                       Changes the content from frame to frame
+\return		Visible items, so that nothing is optimized away
+\brief	The CPU side of a frame, as a renderer building draw lists would do it: vectors grown without a reserve.
+***********************************************************************************************************************/
+template <typename Vectors>
+size_t buildFrame(const Vectors& vectors, Common::JobSystem* jobs, int count, int frame)
+{
+	vectors.BeginFrame();
+	typename Vectors::template Vector<DrawItem>::Type items = vectors.template Make<DrawItem>();
+	typename Vectors::template Vector<float>::Type matrices = vectors.template Make<float>();
+	typename Vectors::template Vector<uint64_t>::Type keys = vectors.template Make<uint64_t>();
+	for (int i = 0; i < count; ++i)
+	{
+		DrawItem item = { (uint32_t)(i % 7), (uint32_t)((i * 31 + frame) % 64), (float)((i * 7919 + frame) % 1000) / 1000.0f,
+		                  (uint32_t)i, { 1.0f, 1.0f, 1.0f, 1.0f } };
+		items.push_back(item);
+		for (int j = 0; j < 16; ++j)
+		{
+			matrices.push_back(j % 5 == 0 ? 1.0f : 0.0f);
+		}
+		keys.push_back(((uint64_t)item.program << 48) | ((uint64_t)item.texture << 32) | (uint64_t)(item.depth * 65535.0f) << 16 | (uint64_t)(i & 0xFFFF));
+	}
+	std::sort(keys.begin(), keys.end());
+
+	std::atomic<size_t> visible(0);
+	Cull<Vectors> cull = { &vectors, items.data(), &visible };
+	jobs->ParallelFor(items.size(), Grain, cull);
+	return visible + (size_t)(keys[0] & 1) + (size_t)matrices[0];
+}
+
+/*!*********************************************************************************************************************
+\param[in]			vectors                     Where the temporaries are allocated
+\param[in]			jobs                        Runs the culling jobs
+\param[in]			count                       Draw items per frame
+\param[in]			frames                      Frames measured
+\param[in]			warmup                      Frames run before, the arena grows during those
+\param[out]		warmupAllocations           Heap allocations during the warmup
+\param[out]		allocations                 Heap allocations during the measured frames
+\param[out]		times                       Microseconds per measured frame
+\return		Sum of the frames' results
+\brief	Runs frames and counts the heap allocations they make.
+***********************************************************************************************************************/
+template <typename Vectors>
+size_t runFrames(const Vectors& vectors, Common::JobSystem* jobs, int count, int frames, int warmup,
+                 unsigned long& warmupAllocations, unsigned long& allocations, std::vector<double>& times)
+{
+	times.reserve(frames);
+	size_t result = 0;
+	unsigned long before = heapAllocations;
+	for (int frame = 0; frame < warmup; ++frame)
+	{
+		result += buildFrame(vectors, jobs, count, frame);
+	}
+	warmupAllocations = heapAllocations - before;
+	allocations = 0;
+	for (int frame = 0; frame < frames; ++frame)
+	{
+		unsigned long start = heapAllocations;
+		Clock::time_point begin = Clock::now();
+		result += buildFrame(vectors, jobs, count, warmup + frame);
+		times.push_back(std::chrono::duration<double, std::micro>(Clock::now() - begin).count());
+		allocations += heapAllocations - start;
+	}
+	return result;
+}
+
+int main(int argc, char** argv)
+{
+	int count = DefaultItems;
+	int frames = DefaultFrames;
+	int warmup = DefaultWarmup;
+	int threads = DefaultThreads;
+	int option;
+	while ((option = getopt(argc, argv, "n:f:w:t:")) != -1)
+	{
+		switch (option)
+		{
+		case 'n': count = atoi(optarg); break;
+		case 'f': frames = atoi(optarg); break;
+		case 'w': warmup = atoi(optarg); break;
+		case 't': threads = atoi(optarg); break;
+		default: usage(argv[0]); return EXIT_FAILURE;
+		}
+	}
+	if (count <= 0 || frames <= 0 || warmup < 0 || threads <= 0)
+	{
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	// The caller helps in the parallel for, threads - 1 workers
+	Common::JobSystem jobs(threads - 1);
+	// Starts the workers, their stacks are not the frames' allocations
+	jobs.ParallelFor(threads * Grain, Grain, Nothing());
+
+	HeapVectors heap;
+	unsigned long heapWarmup = 0;
+	unsigned long heapFrames = 0;
+	std::vector<double> heapTimes;
+	size_t result = runFrames(heap, &jobs, count, frames, warmup, heapWarmup, heapFrames, heapTimes);
+
+	Common::FrameArena arena;
+	ArenaVectors inArena = { &arena };
+	unsigned long arenaWarmup = 0;
+	unsigned long arenaFrames = 0;
+	std::vector<double> arenaTimes;
+	result += runFrames(inArena, &jobs, count, frames, warmup, arenaWarmup, arenaFrames, arenaTimes);
+	Common::FrameArena::Stats stats = arena.GetStats();
+
+	std::cout<<"{"<<std::endl;
+	std::cout<<"  \"items\": "<<count<<","<<std::endl;
+	std::cout<<"  \"frames\": "<<frames<<","<<std::endl;
+	std::cout<<"  \"warmup_frames\": "<<warmup<<","<<std::endl;
+	std::cout<<"  \"threads\": "<<threads<<","<<std::endl;
+	std::cout<<"  \"heap\": {\"allocations_per_frame\": "<<(double)heapFrames / frames<<", ";
+	Benchmark::WriteDistribution(std::cout, "frame_us", heapTimes);
+	std::cout<<"},"<<std::endl;
+	std::cout<<"  \"arena\": {\"warmup_allocations\": "<<arenaWarmup
+	         <<", \"allocations_per_frame\": "<<(double)arenaFrames / frames<<", ";
+	Benchmark::WriteDistribution(std::cout, "frame_us", arenaTimes);
+	std::cout<<", \"capacity\": "<<stats.capacity<<", \"high_water\": "<<stats.high_water
+	         <<", \"last_frame_used\": "<<stats.last_frame_used<<", \"grows\": "<<stats.grows
+	         <<", \"overflows\": "<<stats.total_overflows<<"},"<<std::endl;
+	std::cout<<"  \"steady_state_allocation_free\": "<<(arenaFrames == 0 ? "true" : "false")<<","<<std::endl;
+	std::cout<<"  \"checksum\": "<<result<<std::endl;
+	std::cout<<"}"<<std::endl;
+	if (arenaFrames != 0)
+	{
+		std::cerr<<arenaFrames<<" heap allocations in "<<frames<<" frames after the warmup"<<std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,146 @@
+#include <unistd.h>
+#include <stdlib.h>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+
+#include <Context.h>
+#include <instanced/Renderer.h>
+#include <headless/HeadlessContext.h>
+
+#include "Statistics.h"
+
+// Draw calls and frame time of Instanced::Renderer at several instance
+// counts, for each path the driver supports, on a headless context.
+// CPU time covers DrawFrame (animation, culling, uploads, draw submission),
+// finish time the wait for the driver to execute it.
+
+const int DefaultFrames        = 30;
+const int DefaultWarmupFrames  = 3;
+const int DefaultWidth         = 1024;
+const int DefaultHeight        = 768;
+const double SimulationStep    = 1.0 / 60.0;
+
+typedef std::chrono::steady_clock Clock;
+
+void usage(const char* program)
+{
+	std::cerr<<"usage: "<<program<<" [-c count[,count...]] [-n frames] [-u warmup frames] [-s]"<<std::endl;
+	std::cerr<<"  -c  instance counts, default 1000,10000,100000"<<std::endl;
+	std::cerr<<"  -s  skip the one draw per instance baseline"<<std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<int> counts;
+	Benchmark::ParseCounts("1000,10000,100000", counts);
+	int frames = DefaultFrames;
+	int warmupFrames = DefaultWarmupFrames;
+	bool perInstance = true;
+
+	int option;
+	while ((option = getopt(argc, argv, "c:n:u:s")) != -1)
+	{
+		switch (option)
+		{
+		case 'c':
+			if (!Benchmark::ParseCounts(optarg, counts))
+			{
+				usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'n': frames = atoi(optarg); break;
+		case 'u': warmupFrames = atoi(optarg); break;
+		case 's': perInstance = false; break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (frames <= 0 || warmupFrames < 0)
+	{
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	Headless::HeadlessContext context;
+	if (!context.Create(DefaultWidth, DefaultHeight))
+	{
+		return EXIT_FAILURE;
+	}
+	const char* glRenderer = (const char*)glGetString(GL_RENDERER);
+	std::string glRendererName = glRenderer ? glRenderer : "unknown";
+
+	std::vector<Instanced::Renderer::Path> paths;
+	paths.push_back(Instanced::Renderer::InstancedArrays);
+	paths.push_back(Instanced::Renderer::PseudoInstancing);
+	if (perInstance) { paths.push_back(Instanced::Renderer::PerInstance); }
+
+	std::ostringstream results;
+	bool instancedArrays = false;
+	bool first = true;
+	GLenum glError = GL_NO_ERROR;
+	for (size_t c = 0; c < counts.size(); ++c)
+	{
+		for (size_t p = 0; p < paths.size(); ++p)
+		{
+			Instanced::Renderer renderer(counts[c], paths[p]);
+			renderer.InitializeGl();
+			renderer.SetViewport(DefaultWidth, DefaultHeight);
+			// Without instanced arrays the renderer falls back, that run would duplicate pseudo-instancing
+			if (renderer.GetPath() != paths[p])
+			{
+				renderer.ReleaseGl();
+				continue;
+			}
+			instancedArrays = instancedArrays || paths[p] == Instanced::Renderer::InstancedArrays;
+
+			std::vector<double> cpuTimes;
+			std::vector<double> finishTimes;
+			for (int frame = 0; frame < warmupFrames + frames; ++frame)
+			{
+				renderer.Update(SimulationStep);
+				Clock::time_point start = Clock::now();
+				renderer.DrawFrame();
+				Clock::time_point submitted = Clock::now();
+				glFinish();
+				Clock::time_point finished = Clock::now();
+				if (frame >= warmupFrames)
+				{
+					cpuTimes.push_back(std::chrono::duration<double, std::milli>(submitted - start).count());
+					finishTimes.push_back(std::chrono::duration<double, std::milli>(finished - submitted).count());
+				}
+			}
+			GLenum error = glGetError();
+			if (glError == GL_NO_ERROR) { glError = error; }
+
+			results<<(first ? "\n" : ",\n")<<"    {\"instances\": "<<counts[c]
+			       <<", \"path\": \""<<Instanced::Renderer::GetPathName(paths[p])<<"\""
+			       <<", \"draw_calls\": "<<renderer.GetDrawCallCount()
+			       <<", \"visible\": "<<renderer.GetCullStats().visible<<", ";
+			Benchmark::WriteDistribution(results, "cpu_frame_ms", cpuTimes);
+			results<<", ";
+			Benchmark::WriteDistribution(results, "finish_ms", finishTimes);
+			results<<"}";
+			first = false;
+			renderer.ReleaseGl();
+		}
+	}
+	context.Release();
+	Common::Context::Release();
+
+	std::cout<<"{"<<std::endl;
+	std::cout<<"  \"gl_renderer\": \""<<glRendererName<<"\","<<std::endl;
+	std::cout<<"  \"instanced_arrays\": "<<(instancedArrays ? "true" : "false")<<","<<std::endl;
+	std::cout<<"  \"frames\": "<<frames<<","<<std::endl;
+	std::cout<<"  \"gl_error\": "<<glError<<","<<std::endl;
+	std::cout<<"  \"results\": ["<<results.str()<<std::endl<<"  ]"<<std::endl;
+	std::cout<<"}"<<std::endl;
+	return glError == GL_NO_ERROR ? EXIT_SUCCESS : EXIT_FAILURE;
+}
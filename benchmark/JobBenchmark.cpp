@@ -0,0 +1,173 @@
+#include <unistd.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <JobSystem.h>
+#include <TransformSystem.h>
+
+#include "Statistics.h"
+
+// Common::JobSystem from one thread to all the cores: the transforms of
+// many nodes rebuilt by TransformSystem::Update split over jobs, against
+// the same update on one thread without jobs, then the cost of a job on
+// its own, many empty children of one parent and a binary tree of jobs
+// spawning their children. A count of threads is the calling thread plus
+// that many less one workers, the caller helps while it waits. No GL
+// context needed.
+
+const int DefaultIterations = 20;
+const int DefaultTransforms = 100000;
+const int DefaultJobs       = 100000;
+
+typedef std::chrono::steady_clock Clock;
+
+void usage(const char* program)
+{
+	std::cerr<<"usage: "<<program<<" [-t threads] [-c transforms] [-n jobs] [-i iterations]"<<std::endl;
+	std::cerr<<"  -t  most threads measured, all the cores by default"<<std::endl;
+}
+
+// A job that does nothing, the cost measured is the job system's
+struct Empty
+{
+	void operator()() const {}
+};
+
+// Two children per level, all counted on the root so that waiting on it waits for the tree
+struct Tree
+{
+	Common::JobSystem* jobs;
+	Common::JobSystem::Job* root;
+	int depth;
+	void operator()() const
+	{
+		if (depth == 0) { return; }
+		Tree child = { jobs, root, depth - 1 };
+		jobs->Run(jobs->Create(child, root));
+		jobs->Run(jobs->Create(child, root));
+	}
+};
+
+/*!*********************************************************************************************************************
+\param[in]			start                       When the measure started
+\param[in]			scale                       Seconds to the reported unit
+\return		Time since start in the reported unit
+\brief	Elapsed time of one iteration.
+***********************************************************************************************************************/
+double elapsed(Clock::time_point start, double scale)
+{
+	return std::chrono::duration<double>(Clock::now() - start).count() * scale;
+}
+
+int main(int argc, char** argv)
+{
+	int threads = std::max((int)std::thread::hardware_concurrency(), 1);
+	int transformCount = DefaultTransforms;
+	int jobCount = DefaultJobs;
+	int iterations = DefaultIterations;
+	int option;
+	while ((option = getopt(argc, argv, "t:c:n:i:")) != -1)
+	{
+		switch (option)
+		{
+		case 't': threads = atoi(optarg); break;
+		case 'c': transformCount = atoi(optarg); break;
+		case 'n': jobCount = atoi(optarg); break;
+		case 'i': iterations = atoi(optarg); break;
+		default: usage(argv[0]); return EXIT_FAILURE;
+		}
+	}
+	if (threads <= 0 || transformCount <= 0 || jobCount <= 0 || iterations <= 0)
+	{
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	std::mt19937 generator(1234);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	Common::TransformSystem transforms;
+	for (int i = 0; i < transformCount; ++i)
+	{
+		Common::TransformSystem::Handle handle = transforms.Create();
+		transforms.SetPosition(handle, unit(generator) * 10.0f - 5.0f, unit(generator) * 10.0f - 5.0f, -10.0f);
+		transforms.SetRotationZ(handle, unit(generator) * 6.28f);
+	}
+	const float viewProjection[16] = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
+	                                   0.0f, 0.0f, -1.0f, -1.0f, 0.0f, 0.0f, -0.2f, 0.0f };
+
+	// The first update faults the matrices' pages in, it is not measured
+	transforms.Update();
+
+	int depth = 1;
+	while ((2 << depth) - 1 < jobCount) { ++depth; }
+
+	std::cout<<"{"<<std::endl;
+	std::cout<<"  \"hardware_threads\": "<<std::thread::hardware_concurrency()<<","<<std::endl;
+	std::cout<<"  \"iterations\": "<<iterations<<","<<std::endl;
+	std::cout<<"  \"transforms\": "<<transformCount<<","<<std::endl;
+	std::cout<<"  \"jobs\": "<<jobCount<<","<<std::endl;
+	std::cout<<"  \"tree_jobs\": "<<((2 << depth) - 1)<<","<<std::endl;
+	std::cout<<"  \"results\": [";
+	for (int count = 1; count <= threads; ++count)
+	{
+		Common::JobSystem jobs(count - 1);
+		// Like the GL thread of the hosts, so that this thread uses its own deque
+		jobs.SetMainThread();
+		std::vector<double> serialTimes;
+		std::vector<double> transformTimes;
+		std::vector<double> spawnTimes;
+		std::vector<double> treeTimes;
+		for (int iteration = 0; iteration < iterations; ++iteration)
+		{
+			// One thread without the job system, measured alongside so that both see the same machine load
+			transforms.SetViewProjection(viewProjection);
+			Clock::time_point start = Clock::now();
+			transforms.Update();
+			serialTimes.push_back(elapsed(start, 1.0e6));
+
+			transforms.SetViewProjection(viewProjection);
+			start = Clock::now();
+			transforms.Update(&jobs);
+			transformTimes.push_back(elapsed(start, 1.0e6));
+
+			// Flat: every job a child of one parent, created and run by this thread
+			start = Clock::now();
+			Common::JobSystem::Job* parent = jobs.Create(Empty());
+			for (int i = 0; i < jobCount; ++i)
+			{
+				jobs.Run(jobs.Create(Empty(), parent));
+			}
+			jobs.Run(parent);
+			jobs.Wait(parent);
+			spawnTimes.push_back(elapsed(start, 1.0e9 / jobCount));
+
+			// Nested: jobs create the jobs, the tree spreads over the workers by stealing
+			start = Clock::now();
+			Common::JobSystem::Job* root = jobs.Create(Empty());
+			Tree tree = { &jobs, root, depth };
+			jobs.Run(jobs.Create(tree, root));
+			jobs.Run(root);
+			jobs.Wait(root);
+			treeTimes.push_back(elapsed(start, 1.0e9 / ((2 << depth) - 1)));
+		}
+		Common::JobSystem::Stats stats = jobs.GetStats();
+
+		std::cout<<(count > 1 ? ",\n" : "\n")<<"    {\"threads\": "<<count<<", ";
+		Benchmark::WriteDistribution(std::cout, "serial_transform_us", serialTimes);
+		std::cout<<", ";
+		Benchmark::WriteDistribution(std::cout, "transform_us", transformTimes);
+		std::cout<<", \"speedup\": "<<Benchmark::Percentile(serialTimes, 50.0) / Benchmark::Percentile(transformTimes, 50.0)<<", ";
+		Benchmark::WriteDistribution(std::cout, "spawn_ns_per_job", spawnTimes);
+		std::cout<<", ";
+		Benchmark::WriteDistribution(std::cout, "tree_ns_per_job", treeTimes);
+		std::cout<<", \"executed\": "<<stats.executed<<", \"stolen\": "<<stats.stolen
+		         <<", \"inlined\": "<<stats.inlined<<"}";
+	}
+	std::cout<<std::endl<<"  ]"<<std::endl<<"}"<<std::endl;
+	return EXIT_SUCCESS;
+}
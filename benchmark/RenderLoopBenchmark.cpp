@@ -0,0 +1,230 @@
+#include <unistd.h>
+#include <stdlib.h>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+
+#include <Context.h>
+#include <Compositor.h>
+#include <IRenderer.h>
+#include <RenderLoop.h>
+#include <TimerVsyncSource.h>
+#include <text/Renderer.h>
+#include <headless/HeadlessContext.h>
+
+#include "Statistics.h"
+
+// The render loop of the Android host, run off device: a timer stands in
+// for Choreographer and a pbuffer for the window. The text HUD is drawn
+// on a first surface, the loop is paused and resumed, the surface is lost
+// and another one of half the size takes its place, as when an activity
+// goes to the background and comes back. Each surface reports the blank
+// to frame latency, the frame time and the blanks missed; with -l a frame
+// in 30 stalls to show the misses. The benchmark fails when a surface
+// presents nothing, or when a frame runs while paused or without surface.
+
+const int DefaultFrames        = 240;
+const double DefaultRate       = 60.0;
+const int DefaultWidth         = 1024;
+const int DefaultHeight        = 768;
+const int StallInterval        = 30;
+// How long the loop is left paused, then without surface
+const int IdleMilliseconds     = 200;
+
+typedef std::chrono::steady_clock Clock;
+
+// Busy waits in one frame out of StallInterval, a frame slower than a refresh period
+class StallRenderer : public Common::IRenderer
+{
+public:
+	StallRenderer(double milliseconds) : _milliseconds(milliseconds), _frames(0) {}
+	virtual void InitializeGl() {}
+	virtual void ReleaseGl() {}
+	virtual void SetViewport(int width, int height) {}
+	virtual void GetDamage(Common::DamageRegion& damage) {}
+	virtual void DrawFrame()
+	{
+		if (++_frames % StallInterval != 0)
+		{
+			return;
+		}
+		Clock::time_point end = Clock::now() + std::chrono::microseconds((long)(_milliseconds * 1000.0));
+		while (Clock::now() < end)
+		{
+		}
+	}
+private:
+	double _milliseconds;
+	unsigned long _frames;
+};
+
+struct Surface
+{
+	int width;
+	int height;
+	Common::RenderLoop::Stats stats;
+	std::vector<Common::RenderLoop::FrameTiming> timings;
+};
+
+void usage(const char* program)
+{
+	std::cerr<<"usage: "<<program<<" [-n frames per surface] [-r refresh rate] [-l stall milliseconds] [-w width] [-h height]"<<std::endl;
+}
+
+/*!*********************************************************************************************************************
+\param[in]			loop                        Running loop, with a surface
+\param[in]			frames                      Blanks to wait for
+\param[in]			rate                        Refreshes per second of the vsync source
+\param[in,out]		surface                     Size drawn at, its stats and timings are filled in
+\brief	Lets the loop draw a number of frames on the current surface, with a timeout should it stop drawing.
+***********************************************************************************************************************/
+void drawSurface(Common::RenderLoop& loop, int frames, double rate, Surface& surface)
+{
+	loop.ResetStats();
+	loop.SetOffscreen(surface.width, surface.height);
+	Clock::time_point timeout = Clock::now() + std::chrono::milliseconds((long)(4000.0 * frames / rate) + 2000);
+	while (loop.GetStats().vsyncs < (unsigned long)frames && Clock::now() < timeout)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	surface.stats = loop.GetStats();
+	surface.timings = loop.GetTimings();
+}
+
+/*!*********************************************************************************************************************
+\param[in]			loop                        Running loop
+\return		Blanks the loop handled while it was left alone
+\brief	Waits IdleMilliseconds, counting the frames that ran.
+***********************************************************************************************************************/
+unsigned long idleVsyncs(Common::RenderLoop& loop)
+{
+	unsigned long before = loop.GetStats().vsyncs;
+	std::this_thread::sleep_for(std::chrono::milliseconds(IdleMilliseconds));
+	return loop.GetStats().vsyncs - before;
+}
+
+/*!*********************************************************************************************************************
+\param[in]			output                      Stream the JSON object is written to
+\param[in]			surface                     The surface drawn on
+\brief	Writes the stats of one surface and the distributions of its frame timings.
+***********************************************************************************************************************/
+void writeSurface(std::ostream& output, const Surface& surface)
+{
+	std::vector<double> intervals;
+	std::vector<double> latencies;
+	std::vector<double> frameTimes;
+	for (size_t i = 0; i < surface.timings.size(); ++i)
+	{
+		const Common::RenderLoop::FrameTiming& timing = surface.timings[i];
+		if (timing.interval_milliseconds > 0.0)
+		{
+			intervals.push_back(timing.interval_milliseconds);
+		}
+		latencies.push_back(timing.latency_milliseconds);
+		frameTimes.push_back(timing.frame_milliseconds);
+	}
+	const Common::RenderLoop::Stats& stats = surface.stats;
+	output<<"    {\"width\": "<<surface.width<<", \"height\": "<<surface.height
+	      <<", \"vsyncs\": "<<stats.vsyncs
+	      <<", \"presented\": "<<stats.presented
+	      <<", \"missed\": "<<stats.missed
+	      <<", \"period_ms\": "<<stats.period_milliseconds<<", ";
+	Benchmark::WriteDistribution(output, "interval_ms", intervals);
+	output<<", ";
+	Benchmark::WriteDistribution(output, "latency_ms", latencies);
+	output<<", ";
+	Benchmark::WriteDistribution(output, "frame_ms", frameTimes);
+	output<<"}";
+}
+
+int main(int argc, char** argv)
+{
+	int frames = DefaultFrames;
+	double rate = DefaultRate;
+	double stallMilliseconds = 0.0;
+	int width = DefaultWidth;
+	int height = DefaultHeight;
+
+	int option;
+	while ((option = getopt(argc, argv, "n:r:l:w:h:")) != -1)
+	{
+		switch (option)
+		{
+		case 'n': frames = atoi(optarg); break;
+		case 'r': rate = atof(optarg); break;
+		case 'l': stallMilliseconds = atof(optarg); break;
+		case 'w': width = atoi(optarg); break;
+		case 'h': height = atoi(optarg); break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (frames <= 0 || rate <= 0.0 || stallMilliseconds < 0.0 || width < 2 || height < 2)
+	{
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	EGLDisplay display = Headless::HeadlessContext::OpenDisplay();
+	if (display == EGL_NO_DISPLAY)
+	{
+		return EXIT_FAILURE;
+	}
+	Common::Compositor compositor;
+	compositor.AddLayer("text", new Text::Renderer());
+	if (stallMilliseconds > 0.0)
+	{
+		compositor.AddLayer("stall", new StallRenderer(stallMilliseconds));
+	}
+	Common::TimerVsyncSource vsync(rate);
+	Common::RenderLoop loop;
+	if (!loop.Start(display, &vsync, &compositor))
+	{
+		eglTerminate(display);
+		return EXIT_FAILURE;
+	}
+
+	Surface first;
+	first.width = width;
+	first.height = height;
+	drawSurface(loop, frames, rate, first);
+	loop.SetPaused(true);
+	unsigned long pausedVsyncs = idleVsyncs(loop);
+	loop.SetPaused(false);
+	loop.SetOffscreen(0, 0);
+	unsigned long lostVsyncs = idleVsyncs(loop);
+	Surface second;
+	second.width = width / 2;
+	second.height = height / 2;
+	drawSurface(loop, frames, rate, second);
+	Common::RenderLoop::Stats total = loop.GetStats();
+	loop.Stop();
+	eglTerminate(display);
+	Common::Context::Release();
+
+	bool valid = first.stats.presented > 0 && second.stats.presented > 0 && pausedVsyncs == 0 && lostVsyncs == 0
+		&& first.stats.surfaces == 1 && total.surfaces == 1;
+	std::cout<<"{"<<std::endl;
+	std::cout<<"  \"rate\": "<<rate<<","<<std::endl;
+	std::cout<<"  \"frames\": "<<frames<<","<<std::endl;
+	std::cout<<"  \"stall_ms\": "<<stallMilliseconds<<","<<std::endl;
+	std::cout<<"  \"vsyncs_while_paused\": "<<pausedVsyncs<<","<<std::endl;
+	std::cout<<"  \"vsyncs_without_surface\": "<<lostVsyncs<<","<<std::endl;
+	std::cout<<"  \"surfaces\": ["<<std::endl;
+	writeSurface(std::cout, first);
+	std::cout<<","<<std::endl;
+	writeSurface(std::cout, second);
+	std::cout<<std::endl<<"  ]"<<std::endl;
+	std::cout<<"}"<<std::endl;
+	if (!valid)
+	{
+		std::cerr<<"The loop did not follow the surface and pause changes"<<std::endl;
+	}
+	return valid ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,351 @@
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+
+#include <Context.h>
+#include <Compositor.h>
+#include <GlResourceRegistry.h>
+#include <GlStateCache.h>
+#include <PostProcessChain.h>
+#include <ShaderCache.h>
+#include <batch/Renderer.h>
+#include <instanced/Renderer.h>
+#include <text/Renderer.h>
+#include <triangle/Renderer.h>
+#include <headless/HeadlessContext.h>
+
+#include "Statistics.h"
+
+// GL object lifetimes over a long session. The churn run makes, draws and
+// releases a compositor with every renderer and a post processing pass
+// over and over, the way a host swapping renderers or losing its surface
+// does, and checks after every cycle that no owner has a live object left
+// and that nothing waits for deletion. The streaming run makes and
+// releases vertex buffers every frame, deleting them right after the draw
+// that reads them or handing them to the registry, which deletes them a
+// few frames later, all at once or within its per frame budget; the frame
+// times show what the deletions cost.
+
+const int DefaultCycles          = 20;
+const int DefaultCycleFrames     = 10;
+const int DefaultFrames          = 120;
+const int DefaultBuffers         = 16;
+const int DefaultBufferKilobytes = 64;
+const double DefaultDeleteBudget = 2.0;
+const int Width                  = 640;
+const int Height                 = 480;
+const double SimulationStep      = 1.0 / 60.0;
+
+typedef std::chrono::steady_clock Clock;
+
+const char* vertexSource =
+	"attribute vec2 position;\n"
+	"void main()\n"
+	"{\n"
+	"  gl_Position = vec4(position, 0.0, 1.0);\n"
+	"  gl_PointSize = 1.0;\n"
+	"}\n";
+
+const char* fragmentSource =
+	"precision mediump float;\n"
+	"void main()\n"
+	"{\n"
+	"  gl_FragColor = vec4(1.0);\n"
+	"}\n";
+
+struct Churn
+{
+	// Owners with live objects after a cycle, empty when nothing leaked
+	std::vector<std::string> leaks;
+	unsigned long pendingAfterRelease;
+	unsigned long created;
+	uint64_t peakBytes;
+	std::vector<Common::GlResourceRegistry::OwnerStats> owners;
+};
+
+struct Streaming
+{
+	std::vector<double> cpuTimes;
+	double cpuMilliseconds;
+	double finishMilliseconds;
+	Common::GlResourceRegistry::Stats stats;
+};
+
+void usage(const char* program)
+{
+	std::cerr<<"usage: "<<program<<" [-c cycles] [-f frames per cycle] [-n streaming frames] [-b buffers per frame] [-k buffer kilobytes] [-d delete budget ms]"<<std::endl;
+}
+
+/*!*********************************************************************************************************************
+\param[in]			cycles                      Compositors made and released
+\param[in]			cycleFrames                 Frames drawn by each
+\param[out]		churn                       Leaks, objects made and the largest memory estimate
+\brief	Makes, draws and releases a compositor with every renderer cycles times.
+***********************************************************************************************************************/
+void churnRenderers(int cycles, int cycleFrames, Churn& churn)
+{
+	Common::GlResourceRegistry* registry = Common::Context::Instance()->GetGlResourceRegistry();
+	registry->ResetStats();
+	churn.pendingAfterRelease = 0;
+	churn.created = 0;
+	churn.peakBytes = 0;
+	for (int cycle = 0; cycle < cycles; ++cycle)
+	{
+		Common::Compositor* compositor = new Common::Compositor();
+		compositor->AddLayer("triangle", new Triangle::Renderer());
+		compositor->AddLayer("batch", new Batch::Renderer());
+		compositor->AddLayer("instanced", new Instanced::Renderer());
+		compositor->AddLayer("text", new Text::Renderer());
+		compositor->GetPostProcessChain()->AddEffects("vignette");
+		compositor->InitializeGl();
+		compositor->SetViewport(Width, Height);
+		for (int frame = 0; frame < cycleFrames; ++frame)
+		{
+			compositor->Update(SimulationStep);
+			compositor->DrawFrame();
+			uint64_t bytes = registry->GetStats().bytes;
+			if (bytes > churn.peakBytes)
+			{
+				churn.peakBytes = bytes;
+			}
+		}
+		glFinish();
+		compositor->ReleaseGl();
+		delete compositor;
+
+		churn.pendingAfterRelease += registry->GetStats().pending;
+		std::vector<Common::GlResourceRegistry::OwnerStats> owners = registry->GetOwnerStats();
+		for (size_t i = 0; i < owners.size(); ++i)
+		{
+			unsigned long live = 0;
+			for (int kind = 0; kind < Common::GlResourceRegistry::KindCount; ++kind)
+			{
+				live += owners[i].live[kind];
+			}
+			if (live > 0 || owners[i].bytes > 0)
+			{
+				std::cerr<<"cycle "<<cycle<<": "<<owners[i].owner<<" has "<<live<<" live objects, "
+				         <<owners[i].bytes<<" bytes"<<std::endl;
+				churn.leaks.push_back(owners[i].owner);
+			}
+		}
+	}
+	churn.owners = registry->GetOwnerStats();
+	for (size_t i = 0; i < churn.owners.size(); ++i)
+	{
+		churn.created += churn.owners[i].created;
+	}
+}
+
+/*!*********************************************************************************************************************
+\param[in]			deferred                    Whether the buffers go to the registry or are deleted right away
+\param[in]			budget                      Milliseconds the registry deletes for per frame, 0 for no limit
+\param[in]			frames                      Frames drawn
+\param[in]			buffers                     Buffers made, drawn and released per frame
+\param[in]			bufferBytes                 Size of each
+\param[out]		run                         Frame times and, deferred, the registry counters
+\brief	Streams vertex data through short lived buffers.
+***********************************************************************************************************************/
+void streamBuffers(bool deferred, double budget, int frames, int buffers, int bufferBytes, Streaming& run)
+{
+	Common::Context* context = Common::Context::Instance();
+	Common::GlStateCache* state = context->GetGlStateCache();
+	Common::ShaderCache* shaders = context->GetShaderCache();
+	Common::GlResourceRegistry* registry = context->GetGlResourceRegistry();
+	registry->InitializeGl();
+	registry->SetDeleteBudget(budget);
+	registry->ResetStats();
+
+	GLuint program = shaders->Request(vertexSource, fragmentSource);
+	shaders->Resolve(program);
+	GLint position = glGetAttribLocation(program, "position");
+	state->UseProgram(program);
+	state->SetEnabledVertexAttribArrays(Common::GlStateCache::AttribBit(position));
+
+	// Points spread over the surface
+	GLsizei points = bufferBytes / (2 * sizeof(GLfloat));
+	std::vector<GLfloat> vertices(points * 2);
+	for (GLsizei i = 0; i < points; ++i)
+	{
+		vertices[i * 2] = (GLfloat)(i % 97) / 48.5f - 1.0f;
+		vertices[i * 2 + 1] = (GLfloat)(i % 89) / 44.5f - 1.0f;
+	}
+
+	run.cpuMilliseconds = 0.0;
+	for (int frame = 0; frame < frames; ++frame)
+	{
+		Clock::time_point start = Clock::now();
+		glClear(GL_COLOR_BUFFER_BIT);
+		for (int i = 0; i < buffers; ++i)
+		{
+			GLuint buffer;
+			if (deferred)
+			{
+				buffer = registry->Create(Common::GlResourceRegistry::Buffer, "streaming");
+				registry->SetBytes(Common::GlResourceRegistry::Buffer, buffer, bufferBytes);
+			}
+			else
+			{
+				glGenBuffers(1, &buffer);
+			}
+			state->BindArrayBuffer(buffer);
+			glBufferData(GL_ARRAY_BUFFER, bufferBytes, vertices.data(), GL_STREAM_DRAW);
+			state->VertexAttribPointer(position, 2, GL_FLOAT, GL_FALSE, 0, 0);
+			glDrawArrays(GL_POINTS, 0, points);
+			if (deferred)
+			{
+				registry->Release(Common::GlResourceRegistry::Buffer, buffer);
+			}
+			else
+			{
+				state->DeleteBuffers(1, &buffer);
+			}
+		}
+		if (deferred)
+		{
+			registry->EndFrame();
+		}
+		glFlush();
+		double cpu = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		run.cpuTimes.push_back(cpu);
+		run.cpuMilliseconds += cpu;
+	}
+	Clock::time_point submitted = Clock::now();
+	glFinish();
+	run.finishMilliseconds = std::chrono::duration<double, std::milli>(Clock::now() - submitted).count();
+	run.stats = registry->GetStats();
+	registry->Flush();
+	shaders->Release(program);
+	registry->Flush();
+}
+
+/*!*********************************************************************************************************************
+\param[in]			output                      Stream the JSON object is written to
+\param[in]			mode                        Name of the run
+\param[in]			run                         Its results, the time samples are sorted
+\param[in]			deferred                    Whether the registry counters apply
+\brief	Writes one streaming run of the report.
+***********************************************************************************************************************/
+void writeStreaming(std::ostream& output, const char* mode, Streaming& run, bool deferred)
+{
+	output<<"    {\"mode\": \""<<mode<<"\""
+	      <<", \"cpu_ms\": "<<run.cpuMilliseconds
+	      <<", \"finish_ms\": "<<run.finishMilliseconds;
+	if (deferred)
+	{
+		output<<", \"deleted\": "<<run.stats.deleted
+		      <<", \"pending_before_flush\": "<<run.stats.pending
+		      <<", \"batches\": "<<run.stats.batches
+		      <<", \"fenced_batches\": "<<run.stats.fenced
+		      <<", \"delete_ms\": "<<run.stats.delete_milliseconds
+		      <<", \"max_delete_ms\": "<<run.stats.max_delete_milliseconds
+		      <<", \"over_budget_frames\": "<<run.stats.over_budget;
+	}
+	output<<", ";
+	Benchmark::WriteDistribution(output, "cpu_frame_ms", run.cpuTimes);
+	output<<"}";
+}
+
+int main(int argc, char** argv)
+{
+	int cycles = DefaultCycles;
+	int cycleFrames = DefaultCycleFrames;
+	int frames = DefaultFrames;
+	int buffers = DefaultBuffers;
+	int bufferKilobytes = DefaultBufferKilobytes;
+	double deleteBudget = DefaultDeleteBudget;
+
+	int option;
+	while ((option = getopt(argc, argv, "c:f:n:b:k:d:")) != -1)
+	{
+		switch (option)
+		{
+		case 'c': cycles = atoi(optarg); break;
+		case 'f': cycleFrames = atoi(optarg); break;
+		case 'n': frames = atoi(optarg); break;
+		case 'b': buffers = atoi(optarg); break;
+		case 'k': bufferKilobytes = atoi(optarg); break;
+		case 'd': deleteBudget = atof(optarg); break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (cycles <= 0 || cycleFrames <= 0 || frames <= 0 || buffers <= 0 || bufferKilobytes <= 0 || deleteBudget <= 0.0)
+	{
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	Headless::HeadlessContext context;
+	if (!context.Create(Width, Height))
+	{
+		return EXIT_FAILURE;
+	}
+	const char* glRenderer = (const char*)glGetString(GL_RENDERER);
+	std::string glRendererName = glRenderer ? glRenderer : "unknown";
+
+	Churn churn;
+	churnRenderers(cycles, cycleFrames, churn);
+	Common::GlResourceRegistry* registry = Common::Context::Instance()->GetGlResourceRegistry();
+	bool fenced = registry->HasFenceSync();
+
+	Streaming immediate;
+	Streaming deferred;
+	Streaming budgeted;
+	streamBuffers(false, 0.0, frames, buffers, bufferKilobytes * 1024, immediate);
+	streamBuffers(true, 0.0, frames, buffers, bufferKilobytes * 1024, deferred);
+	streamBuffers(true, deleteBudget, frames, buffers, bufferKilobytes * 1024, budgeted);
+	Common::GlResourceRegistry::Stats end = registry->GetStats();
+	GLenum glError = glGetError();
+	context.Release();
+	Common::Context::Release();
+
+	std::cout<<"{"<<std::endl;
+	std::cout<<"  \"gl_renderer\": \""<<glRendererName<<"\","<<std::endl;
+	std::cout<<"  \"surface\": \""<<context.GetSurfaceName()<<"\","<<std::endl;
+	std::cout<<"  \"gl_error\": "<<glError<<","<<std::endl;
+	std::cout<<"  \"fence_sync\": "<<(fenced ? "true" : "false")<<","<<std::endl;
+	std::cout<<"  \"churn\": {\"cycles\": "<<cycles
+	         <<", \"frames_per_cycle\": "<<cycleFrames
+	         <<", \"created\": "<<churn.created
+	         <<", \"peak_bytes\": "<<churn.peakBytes
+	         <<", \"leaks\": "<<churn.leaks.size()
+	         <<", \"pending_after_release\": "<<churn.pendingAfterRelease
+	         <<", \"owners\": [";
+	for (size_t i = 0; i < churn.owners.size(); ++i)
+	{
+		const Common::GlResourceRegistry::OwnerStats& owner = churn.owners[i];
+		std::cout<<(i > 0 ? ", " : "")<<"{\"owner\": \""<<owner.owner<<"\""
+		         <<", \"created\": "<<owner.created
+		         <<", \"released\": "<<owner.released<<"}";
+	}
+	std::cout<<"]},"<<std::endl;
+	std::cout<<"  \"buffers_per_frame\": "<<buffers<<","<<std::endl;
+	std::cout<<"  \"buffer_bytes\": "<<bufferKilobytes * 1024<<","<<std::endl;
+	std::cout<<"  \"delete_budget_ms\": "<<deleteBudget<<","<<std::endl;
+	std::cout<<"  \"live_at_end\": "<<end.live<<","<<std::endl;
+	std::cout<<"  \"pending_at_end\": "<<end.pending<<","<<std::endl;
+	std::cout<<"  \"streaming\": ["<<std::endl;
+	writeStreaming(std::cout, "immediate", immediate, false);
+	std::cout<<","<<std::endl;
+	writeStreaming(std::cout, "deferred", deferred, true);
+	std::cout<<","<<std::endl;
+	writeStreaming(std::cout, "budgeted", budgeted, true);
+	std::cout<<std::endl<<"  ]"<<std::endl;
+	std::cout<<"}"<<std::endl;
+
+	bool clean = churn.leaks.empty() && churn.pendingAfterRelease == 0 && end.live == 0 && end.pending == 0;
+	if (!clean)
+	{
+		std::cerr<<"GL objects were left live or waiting for deletion"<<std::endl;
+	}
+	return glError == GL_NO_ERROR && clean ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,73 @@
+#ifndef BENCHMARK_STATISTICS_H
+#define BENCHMARK_STATISTICS_H
+
+#include <stdlib.h>
+#include <algorithm>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace Benchmark
+{
+  // Nearest-rank percentile of samples sorted ascending
+  inline double Percentile(const std::vector<double> &samples, double percentile)
+  {
+    if (samples.empty())
+    {
+      return 0.0;
+    }
+    size_t rank = (size_t)(percentile / 100.0 * samples.size() + 0.5);
+    if (rank < 1)
+    {
+      rank = 1;
+    }
+    if (rank > samples.size())
+    {
+      rank = samples.size();
+    }
+    return samples[rank - 1];
+  }
+
+  // Writes "name": {p50, p95, p99, mean, max} as a JSON object member.
+  // The samples are sorted in place.
+  inline void WriteDistribution(std::ostream &output, const char *name, std::vector<double> &samples)
+  {
+    std::sort(samples.begin(), samples.end());
+    double sum = 0.0;
+    for (size_t i = 0; i < samples.size(); ++i)
+    {
+      sum += samples[i];
+    }
+    output<<"\""<<name<<"\": {"
+          <<"\"p50\": "<<Percentile(samples, 50.0)
+          <<", \"p95\": "<<Percentile(samples, 95.0)
+          <<", \"p99\": "<<Percentile(samples, 99.0)
+          <<", \"mean\": "<<(samples.empty() ? 0.0 : sum / samples.size())
+          <<", \"max\": "<<(samples.empty() ? 0.0 : samples.back())
+          <<"}";
+  }
+
+  // Comma separated positive counts, as the -c options take them
+  inline bool ParseCounts(const std::string &list, std::vector<int> &counts)
+  {
+    counts.clear();
+    size_t begin = 0;
+    for (;;)
+    {
+      size_t comma = list.find(',', begin);
+      int count = atoi(list.substr(begin, comma == std::string::npos ? std::string::npos : comma - begin).c_str());
+      if (count <= 0)
+      {
+        return false;
+      }
+      counts.push_back(count);
+      if (comma == std::string::npos)
+      {
+        return true;
+      }
+      begin = comma + 1;
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,179 @@
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <text/GlyphAtlas.h>
+#include <text/TextBatch.h>
+
+#include "Statistics.h"
+
+// Text::TextBatch building the vertices of a screen of text, a frame at a
+// time, once with the same strings every frame and once with strings that
+// all change every frame, as counters and timers do. Unchanged strings
+// come from the run cache and cost the copy of their quads; changed ones
+// are shaped again and may rasterize glyphs. The exit status is a failure
+// when an unchanged string was shaped again after the first frame. Only
+// the CPU side is measured, no GL context needed.
+
+const int DefaultLines      = 100;
+const int DefaultColumns    = 64;
+const int DefaultFrames     = 300;
+const int Sizes[]           = { 12, 16, 24 };
+const GLubyte White[4]      = { 255, 255, 255, 255 };
+
+typedef std::chrono::steady_clock Clock;
+
+void usage(const char* program)
+{
+	std::cerr<<"usage: "<<program<<" [-l lines] [-c columns] [-f frames]"<<std::endl;
+}
+
+struct Result
+{
+	std::vector<double> frameTimes;
+	unsigned long glyphs;
+	unsigned long shaped;
+	// Shaped after the first frame
+	unsigned long reshaped;
+	double seconds;
+};
+
+/*!*********************************************************************************************************************
+\param[in]			line                        Line number
+\param[in]			frame                       Frame number, -1 for a string that never changes
+\param[in]			columns                     Length of the string
+\return		A line of printable characters
+\brief	The text of one line, the frame number makes it change every frame.
+***********************************************************************************************************************/
+std::string makeLine(int line, int frame, int columns)
+{
+	char prefix[64];
+	if (frame < 0)
+	{
+		snprintf(prefix, sizeof(prefix), "line %d: ", line);
+	}
+	else
+	{
+		snprintf(prefix, sizeof(prefix), "line %d frame %d t=%.3f: ", line, frame, frame / 60.0);
+	}
+	std::string text(prefix);
+	for (int i = 0; (int)text.size() < columns; ++i)
+	{
+		text += (char)('A' + (line * 7 + i) % 58);
+	}
+	text.resize(columns);
+	return text;
+}
+
+/*!*********************************************************************************************************************
+\param[in]			lines                       Strings drawn each frame
+\param[in]			columns                     Characters per string
+\param[in]			frames                      Frames to build
+\param[in]			changing                    Whether every string changes every frame
+\return		Timings and counts of the frames
+\brief	Builds the frames in one atlas and batch, the strings are made before the timer starts.
+***********************************************************************************************************************/
+Result run(int lines, int columns, int frames, bool changing)
+{
+	Text::GlyphAtlas atlas;
+	Text::TextBatch batch(&atlas);
+	std::vector<std::string> text(lines);
+	Result result;
+	result.glyphs = 0;
+	result.shaped = 0;
+	result.reshaped = 0;
+	result.seconds = 0.0;
+	for (int frame = 0; frame < frames; ++frame)
+	{
+		for (int line = 0; line < lines; ++line)
+		{
+			text[line] = makeLine(line, changing ? frame : -1, columns);
+		}
+		Clock::time_point start = Clock::now();
+		batch.Begin();
+		float y = 0.0f;
+		for (int line = 0; line < lines; ++line)
+		{
+			int size = Sizes[line % (sizeof(Sizes) / sizeof(Sizes[0]))];
+			batch.Add(text[line], 0.0f, y, size, White);
+			y += size * 1.25f;
+		}
+		batch.Build();
+		double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		result.seconds += seconds;
+		result.frameTimes.push_back(seconds * 1e6);
+
+		const Text::TextBatch::Stats& stats = batch.GetStats();
+		result.glyphs += stats.glyphs;
+		result.shaped += stats.shaped;
+		if (frame > 0)
+		{
+			result.reshaped += stats.shaped;
+		}
+	}
+	return result;
+}
+
+/*!*********************************************************************************************************************
+\param[in]			name                        JSON member name
+\param[in]			result                      Measured frames
+\param[in]			frames                      Frame count
+\param[in]			last                        Whether no member follows
+\brief	Writes one mode as a JSON object member.
+***********************************************************************************************************************/
+void writeResult(const char* name, Result& result, int frames, bool last)
+{
+	std::cout<<"  \""<<name<<"\": {"<<std::endl;
+	std::cout<<"    \"glyphs_per_frame\": "<<result.glyphs / frames<<","<<std::endl;
+	std::cout<<"    \"glyphs_per_second\": "<<(result.seconds > 0.0 ? result.glyphs / result.seconds : 0.0)<<","<<std::endl;
+	std::cout<<"    \"shaped_per_frame\": "<<(double)result.shaped / frames<<","<<std::endl;
+	std::cout<<"    ";
+	Benchmark::WriteDistribution(std::cout, "frame_us", result.frameTimes);
+	std::cout<<std::endl<<"  }"<<(last ? "" : ",")<<std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	int lines = DefaultLines;
+	int columns = DefaultColumns;
+	int frames = DefaultFrames;
+	int option;
+	while ((option = getopt(argc, argv, "l:c:f:")) != -1)
+	{
+		switch (option)
+		{
+		case 'l': lines = atoi(optarg); break;
+		case 'c': columns = atoi(optarg); break;
+		case 'f': frames = atoi(optarg); break;
+		default: usage(argv[0]); return EXIT_FAILURE;
+		}
+	}
+	if (lines <= 0 || columns <= 0 || frames <= 1)
+	{
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	Result unchanged = run(lines, columns, frames, false);
+	Result changing = run(lines, columns, frames, true);
+
+	std::cout<<"{"<<std::endl;
+	std::cout<<"  \"lines\": "<<lines<<","<<std::endl;
+	std::cout<<"  \"columns\": "<<columns<<","<<std::endl;
+	std::cout<<"  \"frames\": "<<frames<<","<<std::endl;
+	writeResult("unchanged", unchanged, frames, false);
+	writeResult("changing", changing, frames, false);
+	std::cout<<"  \"speedup\": "<<(unchanged.seconds > 0.0 ? changing.seconds / unchanged.seconds : 0.0)<<std::endl;
+	std::cout<<"}"<<std::endl;
+	if (unchanged.reshaped != 0)
+	{
+		std::cerr<<unchanged.reshaped<<" unchanged strings shaped again after the first frame"<<std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
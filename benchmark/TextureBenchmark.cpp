@@ -0,0 +1,452 @@
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+
+#include <Context.h>
+#include <Compositor.h>
+#include <TextureDecoders.h>
+#include <TextureManager.h>
+#include <headless/HeadlessContext.h>
+
+#include "Statistics.h"
+
+// Common::TextureManager streaming a generated asset set (PNG, ETC1 PKM and
+// mipmapped RGBA KTX files, some duplicated under other names) while a
+// compositor draws frames on a headless context. Frame times show whether
+// the uploads stay within budget; the synchronous time is the same set
+// decoded and uploaded on the GL thread in one go, the spike the manager
+// avoids.
+
+const int DefaultTextures      = 16;
+const int DefaultSize          = 512;
+const int DefaultWidth         = 1024;
+const int DefaultHeight        = 768;
+const int MaxFrames            = 100000;
+const double SimulationStep    = 1.0 / 60.0;
+
+typedef std::chrono::steady_clock Clock;
+
+void usage(const char* program)
+{
+	std::cerr<<"usage: "<<program<<" [-n textures] [-s size] [-b budget ms] [-w workers] [-d directory]"<<std::endl;
+	std::cerr<<"  -n  textures per format, default 16"<<std::endl;
+	std::cerr<<"  -d  where the assets are written, a temporary directory by default"<<std::endl;
+}
+
+/*!*********************************************************************************************************************
+\param[in]			path                        File to write
+\param[in]			data                        Its content
+\return		Whether the file was written
+\brief	Writes a whole file.
+***********************************************************************************************************************/
+bool writeFile(const std::string& path, const std::vector<uint8_t>& data)
+{
+	FILE* file = fopen(path.c_str(), "wb");
+	if (file == NULL) { return false; }
+	bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+	return fclose(file) == 0 && written;
+}
+
+/*!*********************************************************************************************************************
+\param[in]			seed                        Distinguishes the images
+\param[in]			size                        Width and height
+\param[out]		pixels                      RGBA8 pixels
+\brief	A gradient with some noise, compresses about as well as real art.
+***********************************************************************************************************************/
+void generatePixels(int seed, int size, std::vector<uint8_t>& pixels)
+{
+	std::mt19937 generator(seed);
+	pixels.resize((size_t)size * size * 4);
+	for (int y = 0; y < size; ++y)
+	{
+		for (int x = 0; x < size; ++x)
+		{
+			uint8_t* pixel = &pixels[((size_t)y * size + x) * 4];
+			pixel[0] = (uint8_t)(x * 255 / size + seed);
+			pixel[1] = (uint8_t)(y * 255 / size);
+			pixel[2] = (uint8_t)(((x ^ y) & 0xF0) + (generator() & 0x0F));
+			pixel[3] = 255;
+		}
+	}
+}
+
+void appendBigEndian32(std::vector<uint8_t>& data, uint32_t value)
+{
+	data.push_back((uint8_t)(value >> 24));
+	data.push_back((uint8_t)(value >> 16));
+	data.push_back((uint8_t)(value >> 8));
+	data.push_back((uint8_t)value);
+}
+
+void appendChunk(std::vector<uint8_t>& png, const char* type, const std::vector<uint8_t>& data)
+{
+	appendBigEndian32(png, (uint32_t)data.size());
+	size_t start = png.size();
+	png.insert(png.end(), type, type + 4);
+	png.insert(png.end(), data.begin(), data.end());
+	appendBigEndian32(png, (uint32_t)crc32(0, &png[start], (uInt)(png.size() - start)));
+}
+
+/*!*********************************************************************************************************************
+\param[in]			pixels                      RGBA8 pixels
+\param[in]			size                        Width and height
+\param[out]		png                         The encoded file
+\brief	Encodes a PNG, rows cycle through the five filter types so that the decoder meets all of them.
+***********************************************************************************************************************/
+void encodePng(const std::vector<uint8_t>& pixels, int size, std::vector<uint8_t>& png)
+{
+	size_t stride = (size_t)size * 4;
+	std::vector<uint8_t> rows;
+	rows.reserve((stride + 1) * size);
+	for (int y = 0; y < size; ++y)
+	{
+		int filter = y % 5;
+		const uint8_t* row = &pixels[y * stride];
+		const uint8_t* up = y > 0 ? row - stride : NULL;
+		rows.push_back((uint8_t)filter);
+		for (size_t i = 0; i < stride; ++i)
+		{
+			int left = i >= 4 ? row[i - 4] : 0;
+			int above = up ? up[i] : 0;
+			int upLeft = up && i >= 4 ? up[i - 4] : 0;
+			int predictor = 0;
+			switch (filter)
+			{
+			case 1: predictor = left; break;
+			case 2: predictor = above; break;
+			case 3: predictor = (left + above) >> 1; break;
+			case 4:
+				{
+					int p = left + above - upLeft;
+					int pa = abs(p - left);
+					int pb = abs(p - above);
+					int pc = abs(p - upLeft);
+					predictor = pa <= pb && pa <= pc ? left : (pb <= pc ? above : upLeft);
+				}
+				break;
+			}
+			rows.push_back((uint8_t)(row[i] - predictor));
+		}
+	}
+
+	std::vector<uint8_t> header;
+	appendBigEndian32(header, size);
+	appendBigEndian32(header, size);
+	header.push_back(8);
+	header.push_back(6);
+	header.push_back(0);
+	header.push_back(0);
+	header.push_back(0);
+	uLongf compressedSize = compressBound(rows.size());
+	std::vector<uint8_t> compressed(compressedSize);
+	compress2(compressed.data(), &compressedSize, rows.data(), rows.size(), 6);
+	compressed.resize(compressedSize);
+
+	const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	png.assign(signature, signature + 8);
+	appendChunk(png, "IHDR", header);
+	appendChunk(png, "IDAT", compressed);
+	appendChunk(png, "IEND", std::vector<uint8_t>());
+}
+
+/*!*********************************************************************************************************************
+\param[in]			seed                        Distinguishes the images
+\param[in]			size                        Width and height, a multiple of 4
+\param[out]		pkm                         The encoded file
+\brief	An ETC1 PKM of random blocks in individual mode.
+***********************************************************************************************************************/
+void encodePkm(int seed, int size, std::vector<uint8_t>& pkm)
+{
+	const uint8_t header[16] = { 'P', 'K', 'M', ' ', '1', '0', 0, 0,
+		(uint8_t)(size >> 8), (uint8_t)size, (uint8_t)(size >> 8), (uint8_t)size,
+		(uint8_t)(size >> 8), (uint8_t)size, (uint8_t)(size >> 8), (uint8_t)size };
+	pkm.assign(header, header + 16);
+	std::mt19937 generator(seed);
+	size_t blocks = (size_t)(size / 4) * (size / 4);
+	for (size_t i = 0; i < blocks * 8; ++i)
+	{
+		// Byte 3 carries the differential bit, cleared so that the block means the same in ETC1 and ETC2
+		pkm.push_back((uint8_t)(i % 8 == 3 ? generator() & ~2u : generator()));
+	}
+}
+
+/*!*********************************************************************************************************************
+\param[in]			pixels                      RGBA8 pixels
+\param[in]			size                        Width and height
+\param[out]		ktx                         The encoded file
+\brief	An uncompressed RGBA KTX with its whole mip chain.
+***********************************************************************************************************************/
+void encodeKtx(const std::vector<uint8_t>& pixels, int size, std::vector<uint8_t>& ktx)
+{
+	Common::TextureImage image;
+	image.format = GL_RGBA;
+	image.type = GL_UNSIGNED_BYTE;
+	image.levels.resize(1);
+	image.levels[0].width = size;
+	image.levels[0].height = size;
+	image.levels[0].data = pixels;
+	Common::GenerateMipmaps(image);
+
+	const uint8_t identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+	uint32_t header[13] = { 0x04030201, GL_UNSIGNED_BYTE, 1, GL_RGBA, 0x8058 /* GL_RGBA8 */, GL_RGBA,
+		(uint32_t)size, (uint32_t)size, 0, 0, 1, (uint32_t)image.levels.size(), 0 };
+	ktx.assign(identifier, identifier + 12);
+	ktx.insert(ktx.end(), (const uint8_t*)header, (const uint8_t*)header + sizeof(header));
+	for (size_t i = 0; i < image.levels.size(); ++i)
+	{
+		uint32_t imageSize = (uint32_t)image.levels[i].data.size();
+		ktx.insert(ktx.end(), (const uint8_t*)&imageSize, (const uint8_t*)&imageSize + 4);
+		ktx.insert(ktx.end(), image.levels[i].data.begin(), image.levels[i].data.end());
+		ktx.resize((ktx.size() + 3) & ~(size_t)3, 0);
+	}
+}
+
+/*!*********************************************************************************************************************
+\param[in]			paths                       Asset files
+\param[out]		textures                    Created textures, to be deleted by the caller
+\return		Milliseconds spent on the calling thread
+\brief	Reads, decodes and uploads every file on the GL thread, the way a renderer without the texture manager would.
+***********************************************************************************************************************/
+double loadSynchronously(const std::vector<std::string>& paths, std::vector<GLuint>& textures)
+{
+	Common::KtxDecoder ktx;
+	Common::PkmDecoder pkm;
+	Common::PngDecoder png;
+	const Common::ITextureDecoder* decoders[3] = { &ktx, &pkm, &png };
+	const char* version = (const char*)glGetString(GL_VERSION);
+	bool es3 = version != NULL && strncmp(version, "OpenGL ES ", 10) == 0 && version[10] >= '3';
+	const char* extensions = (const char*)glGetString(GL_EXTENSIONS);
+	bool etc1 = extensions != NULL && strstr(extensions, "GL_OES_compressed_ETC1_RGB8_texture") != NULL;
+
+	Clock::time_point start = Clock::now();
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (size_t i = 0; i < paths.size(); ++i)
+	{
+		std::vector<uint8_t> data;
+		FILE* file = fopen(paths[i].c_str(), "rb");
+		if (file == NULL) { continue; }
+		fseek(file, 0, SEEK_END);
+		data.resize(ftell(file));
+		fseek(file, 0, SEEK_SET);
+		size_t read = fread(data.data(), 1, data.size(), file);
+		fclose(file);
+		if (read != data.size()) { continue; }
+
+		Common::TextureImage image;
+		for (int d = 0; d < 3; ++d)
+		{
+			if (decoders[d]->CanDecode(data.data(), data.size()))
+			{
+				decoders[d]->Decode(data.data(), data.size(), image);
+				break;
+			}
+		}
+		if (image.levels.empty()) { continue; }
+		if (image.compressed && image.internal_format == GL_ETC1_RGB8_OES && !etc1)
+		{
+			image.internal_format = GL_COMPRESSED_RGB8_ETC2;
+			if (!es3)
+			{
+				Common::TextureImage rgb;
+				Common::DecodeEtc1(image, rgb);
+				image = rgb;
+			}
+		}
+		Common::GenerateMipmaps(image);
+
+		GLuint texture;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		for (size_t level = 0; level < image.levels.size(); ++level)
+		{
+			const Common::TextureImage::Level& mip = image.levels[level];
+			if (image.compressed)
+			{
+				glCompressedTexImage2D(GL_TEXTURE_2D, level, image.internal_format, mip.width, mip.height, 0, mip.data.size(), mip.data.data());
+			}
+			else
+			{
+				glTexImage2D(GL_TEXTURE_2D, level, image.internal_format, mip.width, mip.height, 0, image.format, image.type, mip.data.data());
+			}
+		}
+		textures.push_back(texture);
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glFinish();
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+	int textureCount = DefaultTextures;
+	int size = DefaultSize;
+	double budgetMilliseconds = 2.0;
+	int workers = 0;
+	std::string directory;
+
+	int option;
+	while ((option = getopt(argc, argv, "n:s:b:w:d:")) != -1)
+	{
+		switch (option)
+		{
+		case 'n': textureCount = atoi(optarg); break;
+		case 's': size = atoi(optarg); break;
+		case 'b': budgetMilliseconds = atof(optarg); break;
+		case 'w': workers = atoi(optarg); break;
+		case 'd': directory = optarg; break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (textureCount <= 0 || size < 4 || size % 4 != 0 || budgetMilliseconds <= 0.0 || workers < 0)
+	{
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	bool temporary = directory.empty();
+	if (temporary)
+	{
+		char pattern[] = "/tmp/texture-benchmark-XXXXXX";
+		if (mkdtemp(pattern) == NULL)
+		{
+			std::cerr<<"Unable to create a temporary directory"<<std::endl;
+			return EXIT_FAILURE;
+		}
+		directory = pattern;
+	}
+
+	// Every format, plus one copy of a quarter of the files under another name for the content deduplication
+	std::vector<std::string> paths;
+	std::vector<std::string> files;
+	bool pngRoundTrip = true;
+	for (int i = 0; i < textureCount; ++i)
+	{
+		std::vector<uint8_t> pixels;
+		generatePixels(i, size, pixels);
+		std::vector<uint8_t> encoded[3];
+		encodePng(pixels, size, encoded[0]);
+		encodePkm(i, size, encoded[1]);
+		encodeKtx(pixels, size, encoded[2]);
+		const char* extensions[3] = { "png", "pkm", "ktx" };
+
+		Common::TextureImage decoded;
+		Common::PngDecoder png;
+		pngRoundTrip = pngRoundTrip && png.Decode(encoded[0].data(), encoded[0].size(), decoded) && decoded.levels[0].data == pixels;
+
+		for (int f = 0; f < 3; ++f)
+		{
+			char name[64];
+			snprintf(name, sizeof(name), "/%s-%d.%s", extensions[f], i, extensions[f]);
+			paths.push_back(directory + name);
+			files.push_back(directory + name);
+			if (!writeFile(files.back(), encoded[f]))
+			{
+				std::cerr<<"Unable to write "<<files.back()<<std::endl;
+				return EXIT_FAILURE;
+			}
+			if (i % 4 == 0)
+			{
+				snprintf(name, sizeof(name), "/copy-%s-%d.%s", extensions[f], i, extensions[f]);
+				files.push_back(directory + name);
+				paths.push_back(directory + name);
+				writeFile(files.back(), encoded[f]);
+			}
+		}
+	}
+
+	Headless::HeadlessContext context;
+	if (!context.Create(DefaultWidth, DefaultHeight))
+	{
+		return EXIT_FAILURE;
+	}
+	const char* glRenderer = (const char*)glGetString(GL_RENDERER);
+	std::string glRendererName = glRenderer ? glRenderer : "unknown";
+
+	Common::TextureManager* textures = Common::Context::Instance()->GetTextureManager();
+	if (workers > 0) { textures->SetWorkerCount(workers); }
+	textures->SetUploadBudget(budgetMilliseconds, 4 * 1024 * 1024);
+
+	// A compositor without layers: the clear and the texture uploads are the whole frame
+	Common::Compositor compositor;
+	compositor.InitializeGl();
+	compositor.SetViewport(DefaultWidth, DefaultHeight);
+	for (int frame = 0; frame < 3; ++frame) { compositor.DrawFrame(); }
+	glFinish();
+
+	Clock::time_point start = Clock::now();
+	std::vector<Common::TextureManager::Handle> handles;
+	for (size_t i = 0; i < paths.size(); ++i)
+	{
+		handles.push_back(textures->Load(paths[i]));
+	}
+	double loadCallMilliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+	std::vector<double> frameTimes;
+	for (int frame = 0; frame < MaxFrames && textures->GetStats().pending > 0; ++frame)
+	{
+		Clock::time_point frameStart = Clock::now();
+		compositor.Update(SimulationStep);
+		compositor.DrawFrame();
+		glFinish();
+		frameTimes.push_back(std::chrono::duration<double, std::milli>(Clock::now() - frameStart).count());
+	}
+	double streamMilliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	Common::TextureManager::Stats stats = textures->GetStats();
+	size_t ready = 0;
+	for (size_t i = 0; i < handles.size(); ++i)
+	{
+		ready += textures->IsReady(handles[i]) ? 1 : 0;
+		textures->Release(handles[i]);
+	}
+
+	std::vector<GLuint> synchronousTextures;
+	double synchronousMilliseconds = loadSynchronously(paths, synchronousTextures);
+	glDeleteTextures(synchronousTextures.size(), synchronousTextures.data());
+
+	GLenum glError = glGetError();
+	compositor.ReleaseGl();
+	context.Release();
+	Common::Context::Release();
+	if (temporary)
+	{
+		for (size_t i = 0; i < files.size(); ++i) { unlink(files[i].c_str()); }
+		rmdir(directory.c_str());
+	}
+
+	double decodeSeconds = stats.decode_milliseconds / 1000.0;
+	std::cout<<"{"<<std::endl;
+	std::cout<<"  \"gl_renderer\": \""<<glRendererName<<"\","<<std::endl;
+	std::cout<<"  \"loads\": "<<handles.size()<<","<<std::endl;
+	std::cout<<"  \"ready\": "<<ready<<","<<std::endl;
+	std::cout<<"  \"deduplicated\": "<<stats.deduplicated<<","<<std::endl;
+	std::cout<<"  \"failed\": "<<stats.failed<<","<<std::endl;
+	std::cout<<"  \"png_round_trip\": "<<(pngRoundTrip ? "true" : "false")<<","<<std::endl;
+	std::cout<<"  \"load_calls_ms\": "<<loadCallMilliseconds<<","<<std::endl;
+	std::cout<<"  \"stream_ms\": "<<streamMilliseconds<<","<<std::endl;
+	std::cout<<"  \"synchronous_ms\": "<<synchronousMilliseconds<<","<<std::endl;
+	std::cout<<"  \"source_mb\": "<<stats.source_bytes / 1048576.0<<","<<std::endl;
+	std::cout<<"  \"decoded_mb\": "<<stats.decoded_bytes / 1048576.0<<","<<std::endl;
+	std::cout<<"  \"decode_mb_per_s\": "<<(decodeSeconds > 0.0 ? stats.decoded_bytes / 1048576.0 / decodeSeconds : 0.0)<<","<<std::endl;
+	std::cout<<"  \"upload_frames\": "<<stats.upload_frames<<","<<std::endl;
+	std::cout<<"  \"upload_bytes_per_frame\": "<<(stats.upload_frames > 0 ? stats.uploaded_bytes / stats.upload_frames : 0)<<","<<std::endl;
+	std::cout<<"  \"max_frame_upload_bytes\": "<<stats.max_frame_upload_bytes<<","<<std::endl;
+	std::cout<<"  \"max_frame_upload_ms\": "<<stats.max_frame_upload_milliseconds<<","<<std::endl;
+	std::cout<<"  \"gl_error\": "<<glError<<","<<std::endl;
+	std::cout<<"  ";
+	Benchmark::WriteDistribution(std::cout, "frame_ms", frameTimes);
+	std::cout<<std::endl<<"}"<<std::endl;
+	return glError == GL_NO_ERROR && stats.failed == 0 && ready == handles.size() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,166 @@
+#include <unistd.h>
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <TransformSystem.h>
+
+#include "Statistics.h"
+
+// Common::TransformSystem at 1k to 1M nodes: every matrix rebuilt with the
+// scalar and the SIMD kernel, 10% of the nodes changed per frame, and the
+// per object glm::mat4 composition it replaces. Times are nanoseconds per
+// transform, no GL context needed.
+
+const int DefaultIterations = 20;
+
+typedef std::chrono::steady_clock Clock;
+
+void usage(const char* program)
+{
+	std::cerr<<"usage: "<<program<<" [-c count[,count...]] [-i iterations]"<<std::endl;
+	std::cerr<<"  -c  transform counts, default 1000,10000,100000,1000000"<<std::endl;
+}
+
+struct Node
+{
+	float x, y, z;
+	float angle;
+	float scale;
+};
+
+int main(int argc, char** argv)
+{
+	std::vector<int> counts;
+	Benchmark::ParseCounts("1000,10000,100000,1000000", counts);
+	int iterations = DefaultIterations;
+
+	int option;
+	while ((option = getopt(argc, argv, "c:i:")) != -1)
+	{
+		switch (option)
+		{
+		case 'c':
+			if (!Benchmark::ParseCounts(optarg, counts))
+			{
+				usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'i': iterations = atoi(optarg); break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (iterations <= 0)
+	{
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	glm::mat4 projection = glm::perspective(0.8f, 4.0f / 3.0f, 0.1f, 100.0f);
+	glm::mat4 view = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -10.0f));
+	glm::mat4 viewProjection = projection * view;
+
+	std::cout<<"{"<<std::endl;
+	std::cout<<"  \"simd\": "<<(Common::TransformSystem::HasSimd() ? "true" : "false")<<","<<std::endl;
+	std::cout<<"  \"iterations\": "<<iterations<<","<<std::endl;
+	std::cout<<"  \"results\": [";
+	for (size_t c = 0; c < counts.size(); ++c)
+	{
+		int count = counts[c];
+		std::mt19937 generator(1234);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		std::vector<Node> nodes(count);
+		Common::TransformSystem transforms;
+		for (int i = 0; i < count; ++i)
+		{
+			Node& node = nodes[i];
+			node.x = unit(generator) * 10.0f - 5.0f;
+			node.y = unit(generator) * 10.0f - 5.0f;
+			node.z = unit(generator) * 10.0f - 5.0f;
+			node.angle = unit(generator) * 6.28f;
+			node.scale = 0.1f + unit(generator);
+			Common::TransformSystem::Handle handle = transforms.Create();
+			transforms.SetPosition(handle, node.x, node.y, node.z);
+			transforms.SetRotationZ(handle, node.angle);
+			transforms.SetScale(handle, node.scale, node.scale, node.scale);
+		}
+		transforms.SetViewProjection(glm::value_ptr(viewProjection));
+		double scale = 1.0e9 / count;
+
+		// Both kernels must agree, the SIMD one only reorders the work
+		transforms.Update(Common::TransformSystem::Scalar);
+		std::vector<float> reference(transforms.GetClipMatrices(), transforms.GetClipMatrices() + count * 16);
+		transforms.SetViewProjection(glm::value_ptr(viewProjection));
+		transforms.Update(Common::TransformSystem::Simd);
+		double difference = 0.0;
+		for (int i = 0; i < count * 16; ++i)
+		{
+			difference = std::max(difference, (double)fabsf(reference[i] - transforms.GetClipMatrices()[i]));
+		}
+
+		std::vector<double> scalarTimes;
+		std::vector<double> simdTimes;
+		std::vector<double> partialTimes;
+		std::vector<double> glmTimes;
+		std::vector<float> glmMatrices(count * 16);
+		for (int iteration = 0; iteration < iterations; ++iteration)
+		{
+			// A new view projection dirties every node
+			transforms.SetViewProjection(glm::value_ptr(viewProjection));
+			Clock::time_point start = Clock::now();
+			transforms.Update(Common::TransformSystem::Scalar);
+			scalarTimes.push_back(std::chrono::duration<double>(Clock::now() - start).count() * scale);
+
+			transforms.SetViewProjection(glm::value_ptr(viewProjection));
+			start = Clock::now();
+			transforms.Update(Common::TransformSystem::Simd);
+			simdTimes.push_back(std::chrono::duration<double>(Clock::now() - start).count() * scale);
+
+			// One node in ten moves, the others keep their matrices
+			for (int i = iteration % 10; i < count; i += 10)
+			{
+				transforms.SetRotationZ(i, nodes[i].angle + iteration * 0.01f);
+			}
+			start = Clock::now();
+			transforms.Update(Common::TransformSystem::Simd);
+			partialTimes.push_back(std::chrono::duration<double>(Clock::now() - start).count() * scale);
+
+			start = Clock::now();
+			for (int i = 0; i < count; ++i)
+			{
+				const Node& node = nodes[i];
+				glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(node.x, node.y, node.z));
+				model = glm::rotate(model, node.angle, glm::vec3(0.0f, 0.0f, 1.0f));
+				model = glm::scale(model, glm::vec3(node.scale));
+				glm::mat4 clip = projection * view * model;
+				const float* values = glm::value_ptr(clip);
+				std::copy(values, values + 16, &glmMatrices[i * 16]);
+			}
+			glmTimes.push_back(std::chrono::duration<double>(Clock::now() - start).count() * scale);
+		}
+
+		std::cout<<(c > 0 ? ",\n" : "\n")<<"    {\"transforms\": "<<count<<", \"max_difference\": "<<difference<<", ";
+		Benchmark::WriteDistribution(std::cout, "scalar_ns", scalarTimes);
+		std::cout<<", ";
+		Benchmark::WriteDistribution(std::cout, "simd_ns", simdTimes);
+		std::cout<<", ";
+		Benchmark::WriteDistribution(std::cout, "simd_10_percent_dirty_ns", partialTimes);
+		std::cout<<", ";
+		Benchmark::WriteDistribution(std::cout, "glm_ns", glmTimes);
+		std::cout<<"}";
+	}
+	std::cout<<std::endl<<"  ]"<<std::endl<<"}"<<std::endl;
+	return EXIT_SUCCESS;
+}
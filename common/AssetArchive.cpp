@@ -0,0 +1,264 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <iostream>
+#include "AssetArchive.h"
+
+using namespace Common;
+
+namespace
+{
+  const uint32_t ArchiveMagic = 0x4b415047; // "GPAK"
+  const uint32_t ArchiveVersion = 1;
+
+  size_t alignUp(size_t value, size_t alignment)
+  {
+    return (value + alignment - 1) & ~(alignment - 1);
+  }
+}
+
+AssetArchive::AssetArchive()
+{
+  _mapping = NULL;
+  _mapping_size = 0;
+  _data = NULL;
+  _size = 0;
+}
+
+AssetArchive::~AssetArchive()
+{
+  Close();
+}
+
+bool AssetArchive::Open(const std::string &path)
+{
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    std::cerr<<"Unable to open "<<path<<std::endl;
+    return false;
+  }
+  struct stat status;
+  bool opened = fstat(fd, &status) == 0 && Open(fd, 0, (size_t)status.st_size);
+  close(fd);
+  if (!opened)
+  {
+    std::cerr<<path<<" is not an asset archive"<<std::endl;
+  }
+  return opened;
+}
+
+bool AssetArchive::Open(int fd, off_t offset, size_t length)
+{
+  Close();
+  if (length < sizeof(Header))
+  {
+    return false;
+  }
+  // mmap wants a page aligned offset, assets inside an APK rarely start on one
+  off_t page = (off_t)sysconf(_SC_PAGESIZE);
+  off_t start = offset & ~(page - 1);
+  size_t lead = (size_t)(offset - start);
+  void *mapping = mmap(NULL, length + lead, PROT_READ, MAP_PRIVATE, fd, start);
+  if (mapping == MAP_FAILED)
+  {
+    return false;
+  }
+  // The table of contents and the first blobs are read right away
+  madvise(mapping, length + lead, MADV_WILLNEED);
+  _mapping = mapping;
+  _mapping_size = length + lead;
+  _data = (const uint8_t *)mapping + lead;
+  _size = length;
+  if (!Validate())
+  {
+    Close();
+    return false;
+  }
+  return true;
+}
+
+void AssetArchive::Close()
+{
+  if (_mapping != NULL)
+  {
+    munmap(_mapping, _mapping_size);
+  }
+  _mapping = NULL;
+  _mapping_size = 0;
+  _data = NULL;
+  _size = 0;
+}
+
+bool AssetArchive::Validate() const
+{
+  Header header;
+  memcpy(&header, _data, sizeof(header));
+  if (header.magic != ArchiveMagic || header.version != ArchiveVersion
+      || header.entry_count > (_size - sizeof(Header)) / sizeof(TocEntry))
+  {
+    return false;
+  }
+  // Every name and blob lies inside the file and ends with its 0 byte,
+  // Find then needs no checks and text blobs are safe as C strings
+  const TocEntry *toc = GetToc();
+  for (uint32_t i = 0; i < header.entry_count; ++i)
+  {
+    const TocEntry &entry = toc[i];
+    if (entry.name_offset >= _size || entry.name_length >= _size - entry.name_offset
+        || _data[entry.name_offset + entry.name_length] != 0
+        || entry.offset > _size || entry.size >= _size - entry.offset
+        || _data[entry.offset + entry.size] != 0)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+const AssetArchive::TocEntry *AssetArchive::GetToc() const
+{
+  return (const TocEntry *)(_data + sizeof(Header));
+}
+
+size_t AssetArchive::GetEntryCount() const
+{
+  return _data != NULL ? ((const Header *)_data)->entry_count : 0;
+}
+
+const char *AssetArchive::GetEntryName(size_t index) const
+{
+  return index < GetEntryCount() ? (const char *)_data + GetToc()[index].name_offset : NULL;
+}
+
+const void *AssetArchive::Find(const char *name, size_t *size) const
+{
+  // Binary search, the table is sorted by name
+  const TocEntry *toc = GetToc();
+  size_t low = 0;
+  size_t high = GetEntryCount();
+  while (low < high)
+  {
+    size_t middle = (low + high) / 2;
+    int order = strcmp(name, (const char *)_data + toc[middle].name_offset);
+    if (order == 0)
+    {
+      if (size != NULL)
+      {
+        *size = (size_t)toc[middle].size;
+      }
+      return _data + toc[middle].offset;
+    }
+    if (order < 0)
+    {
+      high = middle;
+    }
+    else
+    {
+      low = middle + 1;
+    }
+  }
+  return NULL;
+}
+
+AssetArchiveBuilder::AssetArchiveBuilder(size_t alignment)
+{
+  _alignment = alignment > 0 && (alignment & (alignment - 1)) == 0 ? alignment : 16;
+}
+
+void AssetArchiveBuilder::Add(const std::string &name, const void *data, size_t size)
+{
+  _entries[name].assign((const uint8_t *)data, (const uint8_t *)data + size);
+}
+
+bool AssetArchiveBuilder::AddFile(const std::string &name, const std::string &path)
+{
+  FILE *file = fopen(path.c_str(), "rb");
+  if (file == NULL)
+  {
+    return false;
+  }
+  std::vector<uint8_t> data;
+  uint8_t buffer[65536];
+  size_t read;
+  while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+  {
+    data.insert(data.end(), buffer, buffer + read);
+  }
+  bool complete = !ferror(file);
+  fclose(file);
+  if (complete)
+  {
+    _entries[name].swap(data);
+  }
+  return complete;
+}
+
+bool AssetArchiveBuilder::Write(const std::string &path) const
+{
+  typedef std::map<std::string, std::vector<uint8_t> >::const_iterator Iterator;
+  AssetArchive::Header header;
+  header.magic = ArchiveMagic;
+  header.version = ArchiveVersion;
+  header.entry_count = (uint32_t)_entries.size();
+  header.alignment = (uint32_t)_alignment;
+
+  std::vector<AssetArchive::TocEntry> toc;
+  std::string names;
+  size_t names_offset = sizeof(header) + _entries.size() * sizeof(AssetArchive::TocEntry);
+  for (Iterator it = _entries.begin(); it != _entries.end(); ++it)
+  {
+    AssetArchive::TocEntry entry;
+    entry.name_offset = (uint32_t)(names_offset + names.size());
+    entry.name_length = (uint32_t)it->first.size();
+    names += it->first;
+    names += '\0';
+    toc.push_back(entry);
+  }
+  size_t offset = names_offset + names.size();
+  size_t index = 0;
+  for (Iterator it = _entries.begin(); it != _entries.end(); ++it, ++index)
+  {
+    offset = alignUp(offset, _alignment);
+    toc[index].offset = offset;
+    toc[index].size = it->second.size();
+    // The terminating 0 makes text blobs C strings
+    offset += it->second.size() + 1;
+  }
+
+  std::string temporary = path + ".tmp";
+  FILE *file = fopen(temporary.c_str(), "wb");
+  if (file == NULL)
+  {
+    return false;
+  }
+  bool written = fwrite(&header, sizeof(header), 1, file) == 1
+                 && (toc.empty() || fwrite(toc.data(), sizeof(AssetArchive::TocEntry), toc.size(), file) == toc.size())
+                 && fwrite(names.data(), 1, names.size(), file) == names.size();
+  size_t position = names_offset + names.size();
+  const char padding[256] = { 0 };
+  index = 0;
+  for (Iterator it = _entries.begin(); written && it != _entries.end(); ++it, ++index)
+  {
+    while (written && position < toc[index].offset)
+    {
+      size_t count = std::min<size_t>(sizeof(padding), toc[index].offset - position);
+      written = fwrite(padding, 1, count, file) == count;
+      position += count;
+    }
+    written = written && (it->second.empty() || fwrite(it->second.data(), 1, it->second.size(), file) == it->second.size())
+              && fwrite(padding, 1, 1, file) == 1;
+    position += it->second.size() + 1;
+  }
+  written = fclose(file) == 0 && written;
+  if (!written || rename(temporary.c_str(), path.c_str()) != 0)
+  {
+    unlink(temporary.c_str());
+    return false;
+  }
+  return true;
+}
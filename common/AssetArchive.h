@@ -0,0 +1,80 @@
+#ifndef ASSET_ARCHIVE_H
+#define ASSET_ARCHIVE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace Common
+{
+  // Read only pack of named blobs, mapped in memory as a whole. The file
+  // starts with a header and a table of contents sorted by name, blobs
+  // follow at aligned offsets, each one followed by a 0 byte so that text
+  // assets (GLSL sources) are C strings in place. Find() returns pointers
+  // into the mapping: they go to glBufferData or the shader cache as they
+  // are and stay valid until Close. Little endian hosts only.
+  class AssetArchive
+  {
+  public:
+    AssetArchive();
+    // Unmaps the archive
+    virtual ~AssetArchive();
+    bool Open(const std::string &path);
+    // Maps length bytes at offset of an open file, such as the descriptor
+    // of an uncompressed APK asset (AAsset_openFileDescriptor). The
+    // descriptor can be closed once this returns.
+    bool Open(int fd, off_t offset, size_t length);
+    void Close();
+    bool IsOpen() const { return _data != NULL; }
+
+    // NULL when the archive has no such blob
+    const void *Find(const char *name, size_t *size = NULL) const;
+    size_t GetEntryCount() const;
+    const char *GetEntryName(size_t index) const;
+  private:
+    struct Header
+    {
+      uint32_t magic;
+      uint32_t version;
+      uint32_t entry_count;
+      uint32_t alignment;
+    };
+    struct TocEntry
+    {
+      uint32_t name_offset;
+      uint32_t name_length;
+      uint64_t offset;
+      uint64_t size;
+    };
+    bool Validate() const;
+    const TocEntry *GetToc() const;
+    void *_mapping;
+    size_t _mapping_size;
+    const uint8_t *_data;
+    size_t _size;
+
+    friend class AssetArchiveBuilder;
+  };
+
+  // Writes an archive for AssetArchive, entries ordered by name
+  class AssetArchiveBuilder
+  {
+  public:
+    // Blob alignment, a power of two
+    AssetArchiveBuilder(size_t alignment = 16);
+    virtual ~AssetArchiveBuilder(){}
+    // Replaces an entry of the same name
+    void Add(const std::string &name, const void *data, size_t size);
+    bool AddFile(const std::string &name, const std::string &path);
+    size_t GetEntryCount() const { return _entries.size(); }
+    bool Write(const std::string &path) const;
+  private:
+    size_t _alignment;
+    std::map<std::string, std::vector<uint8_t> > _entries;
+  };
+}
+
+#endif
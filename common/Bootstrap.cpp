@@ -0,0 +1,14 @@
+#include "Bootstrap.h"
+#include <common/Context.h>
+#include <triangle/RendererFactory.h>
+#include <batch/RendererFactory.h>
+#include <instanced/RendererFactory.h>
+#include <text/RendererFactory.h>
+
+void Bootstrap::Startup()
+{
+  Common::Context::Instance()->Register("triangle", new Triangle::RendererFactory());
+  Common::Context::Instance()->Register("batch", new Batch::RendererFactory());
+  Common::Context::Instance()->Register("instanced", new Instanced::RendererFactory());
+  Common::Context::Instance()->Register("text", new Text::RendererFactory());
+}
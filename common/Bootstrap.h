@@ -0,0 +1,16 @@
+#ifndef BOOTSTRAP_H
+#define BOOTSTRAP_H
+
+// Shared by the X11 and headless hosts. Built as bootstrap-lib rather
+// than into common-lib, it links every renderer library
+class Bootstrap
+{
+private:
+  Bootstrap(){};
+public:
+  virtual ~Bootstrap(){}
+  // Registers every renderer factory by name, "triangle" is the default
+  static void Startup();
+};
+
+#endif
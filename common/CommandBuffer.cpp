@@ -0,0 +1,366 @@
+#include <assert.h>
+#include <string.h>
+#include "CommandBuffer.h"
+#include "GlStateCache.h"
+
+using namespace Common;
+
+namespace
+{
+  // Header: opcode in the low byte, length of the command in words above it
+  const uint32_t OpcodeMask = 0xff;
+  const unsigned int LengthShift = 8;
+  // The length has 24 bits
+  const size_t MaxCommandWords = (1u << (32 - LengthShift)) - 1;
+  // Payload of one glBufferSubData record, larger uploads are split
+  const size_t MaxBufferSubDataBytes = (MaxCommandWords - 4) * sizeof(uint32_t);
+
+  inline uint32_t fromFloat(GLfloat value)
+  {
+    uint32_t word;
+    memcpy(&word, &value, sizeof(word));
+    return word;
+  }
+
+  inline GLfloat toFloat(uint32_t word)
+  {
+    GLfloat value;
+    memcpy(&value, &word, sizeof(value));
+    return value;
+  }
+
+  inline size_t wordsFor(size_t bytes)
+  {
+    return (bytes + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+  }
+}
+
+CommandBuffer::CommandBuffer(size_t chunk_size)
+{
+  _chunk_words = wordsFor(chunk_size > 0 ? chunk_size : DefaultChunkSize);
+  _current = 0;
+  _commands = 0;
+}
+
+CommandBuffer::~CommandBuffer()
+{
+  for (size_t i = 0; i < _chunks.size(); ++i)
+  {
+    delete[] _chunks[i].words;
+  }
+}
+
+void CommandBuffer::Reset()
+{
+  for (size_t i = 0; i < _chunks.size(); ++i)
+  {
+    _chunks[i].used = 0;
+  }
+  _current = 0;
+  _commands = 0;
+}
+
+size_t CommandBuffer::GetSize() const
+{
+  size_t words = 0;
+  for (size_t i = 0; i < _chunks.size(); ++i)
+  {
+    words += _chunks[i].used;
+  }
+  return words * sizeof(uint32_t);
+}
+
+size_t CommandBuffer::GetCapacity() const
+{
+  size_t words = 0;
+  for (size_t i = 0; i < _chunks.size(); ++i)
+  {
+    words += _chunks[i].capacity;
+  }
+  return words * sizeof(uint32_t);
+}
+
+uint32_t *CommandBuffer::Allocate(Opcode opcode, size_t payload_words)
+{
+  size_t words = payload_words + 1;
+  assert(words <= MaxCommandWords);
+  if (_chunks.empty() || _chunks[_current].used + words > _chunks[_current].capacity)
+  {
+    // A command never spans two chunks, the rest of this one stays unused
+    if (!_chunks.empty() && _chunks[_current].used > 0)
+    {
+      ++_current;
+    }
+    if (_current == _chunks.size())
+    {
+      Chunk chunk;
+      chunk.capacity = words > _chunk_words ? words : _chunk_words;
+      chunk.words = new uint32_t[chunk.capacity];
+      chunk.used = 0;
+      _chunks.push_back(chunk);
+    }
+    else if (_chunks[_current].capacity < words)
+    {
+      // Only for a command larger than the chunk size
+      delete[] _chunks[_current].words;
+      _chunks[_current].capacity = words;
+      _chunks[_current].words = new uint32_t[words];
+    }
+  }
+  Chunk &chunk = _chunks[_current];
+  uint32_t *command = chunk.words + chunk.used;
+  chunk.used += words;
+  ++_commands;
+  command[0] = (uint32_t)opcode | (uint32_t)(words << LengthShift);
+  return command + 1;
+}
+
+void CommandBuffer::UseProgram(GLuint program)
+{
+  uint32_t *payload = Allocate(OpUseProgram, 1);
+  payload[0] = program;
+}
+
+void CommandBuffer::BindArrayBuffer(GLuint buffer)
+{
+  uint32_t *payload = Allocate(OpBindArrayBuffer, 1);
+  payload[0] = buffer;
+}
+
+void CommandBuffer::BindElementArrayBuffer(GLuint buffer)
+{
+  uint32_t *payload = Allocate(OpBindElementArrayBuffer, 1);
+  payload[0] = buffer;
+}
+
+void CommandBuffer::BindTexture(GLuint unit, GLuint texture)
+{
+  uint32_t *payload = Allocate(OpBindTexture, 2);
+  payload[0] = unit;
+  payload[1] = texture;
+}
+
+void CommandBuffer::SetEnabledVertexAttribArrays(unsigned int mask)
+{
+  uint32_t *payload = Allocate(OpSetEnabledVertexAttribArrays, 1);
+  payload[0] = mask;
+}
+
+void CommandBuffer::VertexAttribPointer(GLint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, GLintptr offset)
+{
+  uint32_t *payload = Allocate(OpVertexAttribPointer, 6);
+  payload[0] = (uint32_t)index;
+  payload[1] = (uint32_t)size;
+  payload[2] = type;
+  payload[3] = normalized;
+  payload[4] = (uint32_t)stride;
+  payload[5] = (uint32_t)offset;
+}
+
+void CommandBuffer::SetBlend(bool enabled)
+{
+  uint32_t *payload = Allocate(OpSetBlend, 1);
+  payload[0] = enabled ? 1 : 0;
+}
+
+void CommandBuffer::BlendFunc(GLenum source, GLenum destination)
+{
+  uint32_t *payload = Allocate(OpBlendFunc, 2);
+  payload[0] = source;
+  payload[1] = destination;
+}
+
+void CommandBuffer::Viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+  uint32_t *payload = Allocate(OpViewport, 4);
+  payload[0] = (uint32_t)x;
+  payload[1] = (uint32_t)y;
+  payload[2] = (uint32_t)width;
+  payload[3] = (uint32_t)height;
+}
+
+void CommandBuffer::ClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha)
+{
+  uint32_t *payload = Allocate(OpClearColor, 4);
+  payload[0] = fromFloat(red);
+  payload[1] = fromFloat(green);
+  payload[2] = fromFloat(blue);
+  payload[3] = fromFloat(alpha);
+}
+
+void CommandBuffer::Clear(GLbitfield mask)
+{
+  uint32_t *payload = Allocate(OpClear, 1);
+  payload[0] = mask;
+}
+
+void CommandBuffer::Uniform1i(GLint location, GLint value)
+{
+  uint32_t *payload = Allocate(OpUniform1i, 2);
+  payload[0] = (uint32_t)location;
+  payload[1] = (uint32_t)value;
+}
+
+void CommandBuffer::Uniform1f(GLint location, GLfloat x)
+{
+  uint32_t *payload = Allocate(OpUniform1f, 2);
+  payload[0] = (uint32_t)location;
+  payload[1] = fromFloat(x);
+}
+
+void CommandBuffer::Uniform2f(GLint location, GLfloat x, GLfloat y)
+{
+  uint32_t *payload = Allocate(OpUniform2f, 3);
+  payload[0] = (uint32_t)location;
+  payload[1] = fromFloat(x);
+  payload[2] = fromFloat(y);
+}
+
+void CommandBuffer::Uniform4f(GLint location, GLfloat x, GLfloat y, GLfloat z, GLfloat w)
+{
+  uint32_t *payload = Allocate(OpUniform4f, 5);
+  payload[0] = (uint32_t)location;
+  payload[1] = fromFloat(x);
+  payload[2] = fromFloat(y);
+  payload[3] = fromFloat(z);
+  payload[4] = fromFloat(w);
+}
+
+void CommandBuffer::Uniform4fv(GLint location, GLsizei count, const GLfloat *values)
+{
+  uint32_t *payload = Allocate(OpUniform4fv, 2 + 4 * count);
+  payload[0] = (uint32_t)location;
+  payload[1] = (uint32_t)count;
+  memcpy(payload + 2, values, 4 * count * sizeof(GLfloat));
+}
+
+void CommandBuffer::UniformMatrix4fv(GLint location, GLsizei count, const GLfloat *values)
+{
+  uint32_t *payload = Allocate(OpUniformMatrix4fv, 2 + 16 * count);
+  payload[0] = (uint32_t)location;
+  payload[1] = (uint32_t)count;
+  memcpy(payload + 2, values, 16 * count * sizeof(GLfloat));
+}
+
+void CommandBuffer::BufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const GLvoid *data)
+{
+  const uint8_t *bytes = static_cast<const uint8_t *>(data);
+  do
+  {
+    size_t part = (size_t)size < MaxBufferSubDataBytes ? (size_t)size : MaxBufferSubDataBytes;
+    uint32_t *payload = Allocate(OpBufferSubData, 3 + wordsFor(part));
+    payload[0] = target;
+    payload[1] = (uint32_t)offset;
+    payload[2] = (uint32_t)part;
+    memcpy(payload + 3, bytes, part);
+    offset += part;
+    bytes += part;
+    size -= part;
+  }
+  while (size > 0);
+}
+
+void CommandBuffer::DrawArrays(GLenum mode, GLint first, GLsizei count)
+{
+  uint32_t *payload = Allocate(OpDrawArrays, 3);
+  payload[0] = mode;
+  payload[1] = (uint32_t)first;
+  payload[2] = (uint32_t)count;
+}
+
+void CommandBuffer::DrawElements(GLenum mode, GLsizei count, GLenum type, GLintptr offset)
+{
+  uint32_t *payload = Allocate(OpDrawElements, 4);
+  payload[0] = mode;
+  payload[1] = (uint32_t)count;
+  payload[2] = type;
+  payload[3] = (uint32_t)offset;
+}
+
+void CommandBuffer::Replay(GlStateCache *state) const
+{
+  // The texture unit is not in the state cache, it is tracked for the replay and put back to 0
+  GLuint active_unit = 0;
+  for (size_t c = 0; c < _chunks.size() && (c <= _current); ++c)
+  {
+    const uint32_t *command = _chunks[c].words;
+    const uint32_t *end = command + _chunks[c].used;
+    while (command < end)
+    {
+      const uint32_t *p = command + 1;
+      switch ((Opcode)(command[0] & OpcodeMask))
+      {
+      case OpUseProgram:
+        state->UseProgram(p[0]);
+        break;
+      case OpBindArrayBuffer:
+        state->BindArrayBuffer(p[0]);
+        break;
+      case OpBindElementArrayBuffer:
+        state->BindElementArrayBuffer(p[0]);
+        break;
+      case OpBindTexture:
+        if (p[0] != active_unit)
+        {
+          active_unit = p[0];
+          glActiveTexture(GL_TEXTURE0 + active_unit);
+        }
+        glBindTexture(GL_TEXTURE_2D, p[1]);
+        break;
+      case OpSetEnabledVertexAttribArrays:
+        state->SetEnabledVertexAttribArrays(p[0]);
+        break;
+      case OpVertexAttribPointer:
+        state->VertexAttribPointer((GLint)p[0], (GLint)p[1], p[2], (GLboolean)p[3], (GLsizei)p[4], (const GLvoid *)(uintptr_t)p[5]);
+        break;
+      case OpSetBlend:
+        state->SetBlend(p[0] != 0);
+        break;
+      case OpBlendFunc:
+        state->BlendFunc(p[0], p[1]);
+        break;
+      case OpViewport:
+        glViewport((GLint)p[0], (GLint)p[1], (GLsizei)p[2], (GLsizei)p[3]);
+        break;
+      case OpClearColor:
+        state->ClearColor(toFloat(p[0]), toFloat(p[1]), toFloat(p[2]), toFloat(p[3]));
+        break;
+      case OpClear:
+        glClear(p[0]);
+        break;
+      case OpUniform1i:
+        glUniform1i((GLint)p[0], (GLint)p[1]);
+        break;
+      case OpUniform1f:
+        glUniform1f((GLint)p[0], toFloat(p[1]));
+        break;
+      case OpUniform2f:
+        glUniform2f((GLint)p[0], toFloat(p[1]), toFloat(p[2]));
+        break;
+      case OpUniform4f:
+        glUniform4f((GLint)p[0], toFloat(p[1]), toFloat(p[2]), toFloat(p[3]), toFloat(p[4]));
+        break;
+      case OpUniform4fv:
+        glUniform4fv((GLint)p[0], (GLsizei)p[1], (const GLfloat *)(p + 2));
+        break;
+      case OpUniformMatrix4fv:
+        glUniformMatrix4fv((GLint)p[0], (GLsizei)p[1], GL_FALSE, (const GLfloat *)(p + 2));
+        break;
+      case OpBufferSubData:
+        glBufferSubData(p[0], (GLintptr)p[1], (GLsizeiptr)p[2], p + 3);
+        break;
+      case OpDrawArrays:
+        glDrawArrays(p[0], (GLint)p[1], (GLsizei)p[2]);
+        break;
+      case OpDrawElements:
+        glDrawElements(p[0], (GLsizei)p[1], p[2], (const GLvoid *)(uintptr_t)p[3]);
+        break;
+      }
+      command += command[0] >> LengthShift;
+    }
+  }
+  if (active_unit != 0)
+  {
+    glActiveTexture(GL_TEXTURE0);
+  }
+}
@@ -0,0 +1,108 @@
+#ifndef COMMAND_BUFFER_H
+#define COMMAND_BUFFER_H
+
+#include <GLES2/gl2.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace Common
+{
+  class GlStateCache;
+
+  // GL commands recorded as a byte stream, so that a frame can be built on
+  // any thread and submitted later on the one that owns the context. Each
+  // command is a 32 bit header (opcode and length) followed by its
+  // arguments; uniform values and buffer data are copied inline, so the
+  // caller's memory may go away once recorded. A command is at most 64 MB,
+  // larger BufferSubData uploads are recorded as several. Attribute
+  // pointers and element indices are offsets into buffer objects, client
+  // memory cannot be recorded. The stream lives in chunks that Reset()
+  // keeps, recording a frame of the same size allocates nothing.
+  //
+  // A buffer is recorded by one thread at a time; buffers recorded in
+  // parallel are replayed one after the other in the order wanted. Replay
+  // is a switch over the opcodes, state changes go through the
+  // GlStateCache like any renderer's.
+  class CommandBuffer
+  {
+  public:
+    static const size_t DefaultChunkSize = 64 * 1024;
+
+    explicit CommandBuffer(size_t chunk_size = DefaultChunkSize);
+    virtual ~CommandBuffer();
+    // Forgets the commands, the memory is kept for the next recording
+    void Reset();
+
+    void UseProgram(GLuint program);
+    void BindArrayBuffer(GLuint buffer);
+    void BindElementArrayBuffer(GLuint buffer);
+    // GL_TEXTURE_2D on texture unit GL_TEXTURE0 + unit
+    void BindTexture(GLuint unit, GLuint texture);
+    void SetEnabledVertexAttribArrays(unsigned int mask);
+    void VertexAttribPointer(GLint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, GLintptr offset);
+    void SetBlend(bool enabled);
+    void BlendFunc(GLenum source, GLenum destination);
+    void Viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+    void ClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha);
+    void Clear(GLbitfield mask);
+    void Uniform1i(GLint location, GLint value);
+    void Uniform1f(GLint location, GLfloat x);
+    void Uniform2f(GLint location, GLfloat x, GLfloat y);
+    void Uniform4f(GLint location, GLfloat x, GLfloat y, GLfloat z, GLfloat w);
+    void Uniform4fv(GLint location, GLsizei count, const GLfloat *values);
+    void UniformMatrix4fv(GLint location, GLsizei count, const GLfloat *values);
+    void BufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const GLvoid *data);
+    void DrawArrays(GLenum mode, GLint first, GLsizei count);
+    void DrawElements(GLenum mode, GLsizei count, GLenum type, GLintptr offset);
+
+    // GL thread only, the buffer is left as recorded and may be replayed again
+    void Replay(GlStateCache *state) const;
+
+    size_t GetCommandCount() const { return _commands; }
+    // Bytes recorded, headers included
+    size_t GetSize() const;
+    size_t GetCapacity() const;
+  private:
+    enum Opcode
+    {
+      OpUseProgram,
+      OpBindArrayBuffer,
+      OpBindElementArrayBuffer,
+      OpBindTexture,
+      OpSetEnabledVertexAttribArrays,
+      OpVertexAttribPointer,
+      OpSetBlend,
+      OpBlendFunc,
+      OpViewport,
+      OpClearColor,
+      OpClear,
+      OpUniform1i,
+      OpUniform1f,
+      OpUniform2f,
+      OpUniform4f,
+      OpUniform4fv,
+      OpUniformMatrix4fv,
+      OpBufferSubData,
+      OpDrawArrays,
+      OpDrawElements
+    };
+    // Words of 32 bits, every argument is one and payloads are padded to one
+    struct Chunk
+    {
+      uint32_t *words;
+      size_t capacity;
+      size_t used;
+    };
+    CommandBuffer(const CommandBuffer &);
+    CommandBuffer &operator=(const CommandBuffer &);
+    // Room for the header and payload_words, the header is written
+    uint32_t *Allocate(Opcode opcode, size_t payload_words);
+    std::vector<Chunk> _chunks;
+    size_t _current;
+    size_t _chunk_words;
+    size_t _commands;
+  };
+}
+
+#endif
@@ -0,0 +1,307 @@
+#include <chrono>
+#include <iostream>
+#include "Compositor.h"
+#include "Context.h"
+#include "FrameProfiler.h"
+#include "GlResourceRegistry.h"
+#include "GlStateCache.h"
+#include "IRendererFactory.h"
+#include "JobSystem.h"
+#include "PostProcessChain.h"
+#include "RenderTargetPool.h"
+#include "TextureManager.h"
+
+using namespace Common;
+
+namespace
+{
+  typedef std::chrono::steady_clock Clock;
+}
+
+Compositor::Compositor()
+{
+  _initialized = false;
+  _width = 0;
+  _height = 0;
+  _render_width = 0;
+  _render_height = 0;
+  _clear_color[0] = 0.2f;
+  _clear_color[1] = 0.2f;
+  _clear_color[2] = 0.2f;
+  _clear_color[3] = 1.0f;
+  _invalidated = true;
+  _state = Context::Instance()->GetGlStateCache();
+  _profiler = Context::Instance()->GetFrameProfiler();
+  _textures = Context::Instance()->GetTextureManager();
+  _targets = Context::Instance()->GetRenderTargetPool();
+  _jobs = Context::Instance()->GetJobSystem();
+  _resources = Context::Instance()->GetGlResourceRegistry();
+  _post_process = new PostProcessChain();
+}
+
+Compositor::~Compositor()
+{
+  for (size_t i = 0; i < _layers.size(); ++i)
+  {
+    delete _layers[i].renderer;
+  }
+  delete _post_process;
+}
+
+void Compositor::AddLayer(const std::string &name, IRenderer *renderer)
+{
+  Layer layer;
+  layer.renderer = renderer;
+  layer.viewport_dirty = _render_width > 0 && _render_height > 0;
+  layer.stats.name = name;
+  layer.stats.enabled = true;
+  layer.stats.frames = 0;
+  layer.stats.last_milliseconds = 0.0;
+  layer.stats.total_milliseconds = 0.0;
+  if (_initialized)
+  {
+    renderer->InitializeGl();
+  }
+  _layers.push_back(layer);
+  _invalidated = true;
+}
+
+bool Compositor::AddLayers(const std::string &names)
+{
+  // Every name is checked before any renderer is created
+  std::vector<std::string> split;
+  size_t begin = 0;
+  for (;;)
+  {
+    size_t comma = names.find(',', begin);
+    std::string name = names.substr(begin, comma == std::string::npos ? std::string::npos : comma - begin);
+    if (Context::Instance()->GetRendererFactory(name) == NULL)
+    {
+      std::cerr<<"Unknown renderer "<<name<<std::endl;
+      return false;
+    }
+    split.push_back(name);
+    if (comma == std::string::npos)
+    {
+      break;
+    }
+    begin = comma + 1;
+  }
+  for (size_t i = 0; i < split.size(); ++i)
+  {
+    AddLayer(split[i], Context::Instance()->GetRendererFactory(split[i])->Create());
+  }
+  return true;
+}
+
+size_t Compositor::ReplaceLayers(const std::string &name, IRendererFactory *factory)
+{
+  size_t replaced = 0;
+  for (size_t i = 0; i < _layers.size(); ++i)
+  {
+    Layer &layer = _layers[i];
+    if (layer.stats.name != name)
+    {
+      continue;
+    }
+    // The old renderer's code may go away with its library, nothing of it is kept
+    if (_initialized)
+    {
+      layer.renderer->ReleaseGl();
+    }
+    delete layer.renderer;
+    layer.renderer = factory->Create();
+    if (_initialized)
+    {
+      layer.renderer->InitializeGl();
+    }
+    layer.viewport_dirty = _render_width > 0 && _render_height > 0;
+    ++replaced;
+  }
+  _invalidated = _invalidated || replaced > 0;
+  return replaced;
+}
+
+void Compositor::SetLayerEnabled(size_t layer, bool enabled)
+{
+  if (layer < _layers.size() && _layers[layer].stats.enabled != enabled)
+  {
+    _layers[layer].stats.enabled = enabled;
+    _invalidated = true;
+  }
+}
+
+bool Compositor::IsLayerEnabled(size_t layer) const
+{
+  return layer < _layers.size() && _layers[layer].stats.enabled;
+}
+
+void Compositor::SetClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha)
+{
+  _clear_color[0] = red;
+  _clear_color[1] = green;
+  _clear_color[2] = blue;
+  _clear_color[3] = alpha;
+  _invalidated = true;
+}
+
+std::vector<Compositor::LayerStats> Compositor::GetLayerStats() const
+{
+  std::vector<LayerStats> stats;
+  for (size_t i = 0; i < _layers.size(); ++i)
+  {
+    stats.push_back(_layers[i].stats);
+    _layers[i].renderer->GetCounters(stats.back().counters);
+  }
+  return stats;
+}
+
+void Compositor::ResetLayerStats()
+{
+  for (size_t i = 0; i < _layers.size(); ++i)
+  {
+    _layers[i].stats.frames = 0;
+    _layers[i].stats.last_milliseconds = 0.0;
+    _layers[i].stats.total_milliseconds = 0.0;
+  }
+}
+
+void Compositor::InitializeGl()
+{
+  // The GL thread, a new one on Android when the surface is created again
+  _jobs->SetMainThread();
+  // The context may be a new one too, forget what the cache knows
+  _state->Reset();
+  _resources->InitializeGl();
+  _textures->InitializeGl();
+  _post_process->InitializeGl();
+  for (size_t i = 0; i < _layers.size(); ++i)
+  {
+    _layers[i].renderer->InitializeGl();
+  }
+  _initialized = true;
+  _invalidated = true;
+}
+
+void Compositor::ReleaseGl()
+{
+  for (size_t i = 0; i < _layers.size(); ++i)
+  {
+    _layers[i].renderer->ReleaseGl();
+  }
+  _post_process->ReleaseGl();
+  _targets->ReleaseGl();
+  _textures->ReleaseGl();
+  // What the layers released last is deleted with the context still current
+  _resources->Flush();
+  _initialized = false;
+}
+
+void Compositor::SetViewport(int width, int height)
+{
+  _width = width;
+  _height = height;
+  _post_process->SetViewport(width, height);
+  _invalidated = true;
+}
+
+void Compositor::Update(double seconds)
+{
+  for (size_t i = 0; i < _layers.size(); ++i)
+  {
+    if (_layers[i].stats.enabled)
+    {
+      _layers[i].renderer->Update(seconds);
+    }
+  }
+}
+
+void Compositor::GetDamage(DamageRegion &damage)
+{
+  if (_invalidated || _post_process->IsActive())
+  {
+    damage.AddFull();
+    return;
+  }
+  for (size_t i = 0; i < _layers.size(); ++i)
+  {
+    if (_layers[i].stats.enabled)
+    {
+      _layers[i].renderer->GetDamage(damage);
+    }
+  }
+}
+
+void Compositor::DrawFrame()
+{
+  Context::Instance()->BeginFrame();
+  // Redirected to the scene target when there is post processing, the
+  // render size follows the dynamic resolution
+  int width = _width;
+  int height = _height;
+  _post_process->BeginScene(width, height);
+  if (width != _render_width || height != _render_height)
+  {
+    _render_width = width;
+    _render_height = height;
+    for (size_t i = 0; i < _layers.size(); ++i)
+    {
+      _layers[i].viewport_dirty = true;
+    }
+  }
+
+  // What is outside the region is still on the surface from earlier frames
+  bool partial = !_invalidated && !_repaint.IsEmpty() && !_repaint.IsFull() && !_post_process->IsActive()
+                 && _repaint.GetWidth() == _width && _repaint.GetHeight() == _height;
+  if (partial)
+  {
+    DamageRegion::Rectangle bounds = _repaint.GetBounds();
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(bounds.x, bounds.y, bounds.width, bounds.height);
+  }
+  _repaint.Reset(0, 0);
+  _invalidated = false;
+  {
+    FrameProfiler::Scope scope(_profiler, "Clear");
+    _state->ClearColor(_clear_color[0], _clear_color[1], _clear_color[2], _clear_color[3]);
+    glClear(GL_COLOR_BUFFER_BIT);
+  }
+
+  for (size_t i = 0; i < _layers.size(); ++i)
+  {
+    Layer &layer = _layers[i];
+    if (!layer.stats.enabled)
+    {
+      continue;
+    }
+    FrameProfiler::Scope scope(_profiler, layer.stats.name.c_str());
+    Clock::time_point start = Clock::now();
+    // Layers share the viewport, each one sets it again for its own projection
+    if (layer.viewport_dirty)
+    {
+      layer.renderer->SetViewport(_render_width, _render_height);
+      layer.viewport_dirty = false;
+    }
+    layer.renderer->DrawFrame();
+    double milliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    layer.stats.last_milliseconds = milliseconds;
+    layer.stats.total_milliseconds += milliseconds;
+    ++layer.stats.frames;
+  }
+  if (partial)
+  {
+    glDisable(GL_SCISSOR_TEST);
+  }
+
+  {
+    FrameProfiler::Scope scope(_profiler, "PostProcess");
+    _post_process->EndScene();
+  }
+  Context::Instance()->EndFrame();
+}
+
+void Compositor::SkipFrame()
+{
+  Context::Instance()->BeginFrame();
+  Context::Instance()->EndFrame();
+}
@@ -0,0 +1,109 @@
+#ifndef COMPOSITOR_H
+#define COMPOSITOR_H
+
+#include <GLES2/gl2.h>
+#include <string>
+#include <vector>
+#include "IRenderer.h"
+
+namespace Common
+{
+  class GlStateCache;
+  class FrameProfiler;
+  class TextureManager;
+  class PostProcessChain;
+  class RenderTargetPool;
+  class JobSystem;
+  class GlResourceRegistry;
+  class IRendererFactory;
+
+  // Draws several renderers into one surface, in the order their layers
+  // were added. The compositor clears the frame once, layers only draw
+  // over it. A disabled layer keeps its GL resources but is neither drawn
+  // nor timed; a viewport change it missed is applied when it comes back.
+  // Each drawn layer is a FrameProfiler marker named after the layer, and
+  // each frame a frame of the Context. Layers draw through the
+  // PostProcessChain, at its render resolution. The frame's damage is the
+  // union of the enabled layers'; a host that presents partial frames sets
+  // the region to repaint before DrawFrame.
+  class Compositor : public IRenderer
+  {
+  public:
+    struct LayerStats
+    {
+      std::string name;
+      bool enabled;
+      unsigned long frames;
+      // CPU time spent in the layer's DrawFrame
+      double last_milliseconds;
+      double total_milliseconds;
+      // From the layer's GetCounters
+      std::vector<std::pair<std::string, double> > counters;
+    };
+
+    Compositor();
+    // Deletes the layer renderers
+    virtual ~Compositor();
+    // Takes ownership, initialized right away when the compositor already is
+    void AddLayer(const std::string &name, IRenderer *renderer);
+    // One layer per comma separated name of a registered renderer factory,
+    // false (and no layer added) when a name is unknown
+    bool AddLayers(const std::string &names);
+    size_t GetLayerCount() const { return _layers.size(); }
+    // Between frames: the layers with this name are released, deleted and
+    // made again by the factory, keeping their place and whether they are
+    // enabled. Returns how many were replaced
+    size_t ReplaceLayers(const std::string &name, IRendererFactory *factory);
+    void SetLayerEnabled(size_t layer, bool enabled);
+    bool IsLayerEnabled(size_t layer) const;
+    void SetClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha);
+    // Passes and render scale, empty and at full resolution by default
+    PostProcessChain *GetPostProcessChain() const { return _post_process; }
+    // The next frame is drawn whole, when the window was exposed for instance
+    void Invalidate() { _invalidated = true; }
+    // For the next DrawFrame only, which otherwise repaints the whole frame
+    void SetRepaintRegion(const DamageRegion &region) { _repaint = region; }
+
+    std::vector<LayerStats> GetLayerStats() const;
+    void ResetLayerStats();
+
+    // The calling thread becomes the JobSystem's main thread
+    void InitializeGl();
+    void ReleaseGl();
+    void SetViewport(int width, int height);
+    void DrawFrame();
+    // In place of DrawFrame when there is nothing to draw: the Context's
+    // frame still begins and ends, jobs run and released objects go
+    void SkipFrame();
+    // Disabled layers are not updated either, their simulation pauses
+    void Update(double seconds);
+    void GetDamage(DamageRegion &damage);
+  private:
+    struct Layer
+    {
+      IRenderer *renderer;
+      bool viewport_dirty;
+      LayerStats stats;
+    };
+    std::vector<Layer> _layers;
+    bool _initialized;
+    int _width;
+    int _height;
+    // Size the layers draw at, the output size without scaling
+    int _render_width;
+    int _render_height;
+    GLfloat _clear_color[4];
+    // Everything is damaged by the next frame
+    bool _invalidated;
+    DamageRegion _repaint;
+    GlStateCache *_state;
+    FrameProfiler *_profiler;
+    TextureManager *_textures;
+    RenderTargetPool *_targets;
+    JobSystem *_jobs;
+    GlResourceRegistry *_resources;
+    PostProcessChain *_post_process;
+  };
+}
+
+#endif
@@ -1,6 +1,15 @@
+#include <stddef.h>
 #include "Context.h"
 #include "IRendererFactory.h"
-#define NULL 0L
+#include "GlStateCache.h"
+#include "ShaderCache.h"
+#include "FrameProfiler.h"
+#include "TextureManager.h"
+#include "AssetArchive.h"
+#include "RenderTargetPool.h"
+#include "JobSystem.h"
+#include "FrameArena.h"
+#include "GlResourceRegistry.h"
 
 using namespace Common;
 
@@ -26,28 +35,133 @@ void Context::Release()
 
 Context::Context()
 {
-  _renderer_factory = NULL;
+  _job_system = new JobSystem();
+  _gl_state_cache = new GlStateCache();
+  _gl_resource_registry = new GlResourceRegistry(_gl_state_cache);
+  _shader_cache = new ShaderCache();
+  _frame_profiler = new FrameProfiler();
+  _texture_manager = new TextureManager(_job_system);
+  _asset_archive = new AssetArchive();
+  _render_target_pool = new RenderTargetPool();
+  _frame_arena = new FrameArena();
 }
 
 Context::~Context()
 {
-  if (_renderer_factory != NULL)
+  for (size_t i = 0; i < _renderer_factories.size(); ++i)
   {
-    delete _renderer_factory;
+    delete _renderer_factories[i].second;
   }
+  delete _frame_arena;
+  delete _render_target_pool;
+  delete _asset_archive;
+  delete _texture_manager;
+  delete _frame_profiler;
+  delete _shader_cache;
+  delete _gl_resource_registry;
+  delete _gl_state_cache;
+  // Last, subsystems wait for their jobs when deleted
+  delete _job_system;
 }
 
-void Context::Register(IRendererFactory *factory)
+void Context::Register(const std::string &name, IRendererFactory *factory)
 {
-  if (_renderer_factory)
+  for (size_t i = 0; i < _renderer_factories.size(); ++i)
   {
-    delete _renderer_factory;
+    if (_renderer_factories[i].first == name)
+    {
+      delete _renderer_factories[i].second;
+      _renderer_factories[i].second = factory;
+      return;
+    }
   }
-  _renderer_factory = factory;
+  _renderer_factories.push_back(std::make_pair(name, factory));
 }
 
+IRendererFactory *Context::GetRendererFactory(const std::string &name)
+{
+  for (size_t i = 0; i < _renderer_factories.size(); ++i)
+  {
+    if (_renderer_factories[i].first == name)
+    {
+      return _renderer_factories[i].second;
+    }
+  }
+  return NULL;
+}
 
 IRendererFactory *Context::GetRendererFactory()
 {
-  return _renderer_factory;
+  return _renderer_factories.empty() ? NULL : _renderer_factories[0].second;
+}
+
+std::vector<std::string> Context::GetRendererNames() const
+{
+  std::vector<std::string> names;
+  for (size_t i = 0; i < _renderer_factories.size(); ++i)
+  {
+    names.push_back(_renderer_factories[i].first);
+  }
+  return names;
+}
+
+GlStateCache *Context::GetGlStateCache()
+{
+  return _gl_state_cache;
+}
+
+ShaderCache *Context::GetShaderCache()
+{
+  return _shader_cache;
+}
+
+FrameProfiler *Context::GetFrameProfiler()
+{
+  return _frame_profiler;
+}
+
+TextureManager *Context::GetTextureManager()
+{
+  return _texture_manager;
+}
+
+AssetArchive *Context::GetAssetArchive()
+{
+  return _asset_archive;
+}
+
+RenderTargetPool *Context::GetRenderTargetPool()
+{
+  return _render_target_pool;
+}
+
+JobSystem *Context::GetJobSystem()
+{
+  return _job_system;
+}
+
+FrameArena *Context::GetFrameArena()
+{
+  return _frame_arena;
+}
+
+GlResourceRegistry *Context::GetGlResourceRegistry()
+{
+  return _gl_resource_registry;
+}
+
+void Context::BeginFrame()
+{
+  // What the frame before last allocated is gone
+  _frame_arena->BeginFrame();
+  _job_system->RunMainJobs();
+  // Within the texture manager's budget, large loads are spread over frames
+  FrameProfiler::Scope scope(_frame_profiler, "Textures");
+  _texture_manager->Upload();
+}
+
+void Context::EndFrame()
+{
+  _render_target_pool->EndFrame();
+  _gl_resource_registry->EndFrame();
 }
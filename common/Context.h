@@ -1,21 +1,68 @@
 #ifndef CONTEXT_H
 #define CONTEXT_H
 
+#include <string>
+#include <utility>
+#include <vector>
+
 namespace Common
 {
   class IRendererFactory;
+  class GlStateCache;
+  class ShaderCache;
+  class FrameProfiler;
+  class TextureManager;
+  class AssetArchive;
+  class RenderTargetPool;
+  class JobSystem;
+  class FrameArena;
+  class GlResourceRegistry;
   class Context
   {
   private:
     static Context *_instance;
-    IRendererFactory *_renderer_factory;
+    // In registration order, the first one is the default renderer
+    std::vector< std::pair<std::string, IRendererFactory *> > _renderer_factories;
+    GlStateCache *_gl_state_cache;
+    ShaderCache *_shader_cache;
+    FrameProfiler *_frame_profiler;
+    TextureManager *_texture_manager;
+    AssetArchive *_asset_archive;
+    RenderTargetPool *_render_target_pool;
+    JobSystem *_job_system;
+    FrameArena *_frame_arena;
+    GlResourceRegistry *_gl_resource_registry;
     Context();
   public:
     virtual ~Context();
     static Context *Instance();
     static void Release();
-    void Register(IRendererFactory *factory);
+    // Takes ownership, replaces a factory registered under the same name
+    void Register(const std::string &name, IRendererFactory *factory);
+    // NULL when no factory has this name
+    IRendererFactory *GetRendererFactory(const std::string &name);
+    // The first registered factory, NULL when none is
     IRendererFactory *GetRendererFactory();
+    std::vector<std::string> GetRendererNames() const;
+    GlStateCache *GetGlStateCache();
+    ShaderCache *GetShaderCache();
+    FrameProfiler *GetFrameProfiler();
+    TextureManager *GetTextureManager();
+    // Closed until the host opens it, renderers then fall back to embedded assets
+    AssetArchive *GetAssetArchive();
+    RenderTargetPool *GetRenderTargetPool();
+    // Shared by every renderer, the host sets its GL thread as the main thread
+    JobSystem *GetJobSystem();
+    // Per frame temporaries, the compositor starts a frame of it with each of its own
+    FrameArena *GetFrameArena();
+    // GL objects of the renderers and subsystems, deleted once the GPU is done with them
+    GlResourceRegistry *GetGlResourceRegistry();
+
+    // GL thread, around each frame: the frame arena turns over, the jobs
+    // pinned to the main thread run and the decoded textures upload
+    void BeginFrame();
+    // Render targets unused this frame and GL objects the GPU is done with go
+    void EndFrame();
   };
 }
 #endif
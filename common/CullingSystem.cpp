@@ -0,0 +1,549 @@
+#include <math.h>
+#include <string.h>
+#include <chrono>
+#include "CullingSystem.h"
+#include "JobSystem.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define CULLING_SSE
+#define CULLING_SIMD
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define CULLING_NEON
+#define CULLING_SIMD
+#endif
+
+using namespace Common;
+
+namespace
+{
+  // Subtrees at this depth are the jobs of a parallel cull, up to 512 of them
+  const unsigned int SplitDepth = 3;
+  // Objects a node holds before it is split
+  const size_t NodeCapacity = 32;
+
+  float maxOf(float a, float b) { return a > b ? a : b; }
+
+#if defined(CULLING_SSE)
+  typedef __m128 Lanes;
+  inline Lanes load(const float *p) { return _mm_loadu_ps(p); }
+  inline Lanes splat(float value) { return _mm_set1_ps(value); }
+  inline Lanes add(Lanes a, Lanes b) { return _mm_add_ps(a, b); }
+  inline Lanes mul(Lanes a, Lanes b) { return _mm_mul_ps(a, b); }
+  // Bit i set when lane i is not negative
+  inline int notNegative(Lanes a) { return _mm_movemask_ps(_mm_cmpge_ps(a, _mm_setzero_ps())); }
+#elif defined(CULLING_NEON)
+  typedef float32x4_t Lanes;
+  inline Lanes load(const float *p) { return vld1q_f32(p); }
+  inline Lanes splat(float value) { return vdupq_n_f32(value); }
+  inline Lanes add(Lanes a, Lanes b) { return vaddq_f32(a, b); }
+  inline Lanes mul(Lanes a, Lanes b) { return vmulq_f32(a, b); }
+  inline int notNegative(Lanes a)
+  {
+    uint32x4_t mask = vcgeq_f32(a, vdupq_n_f32(0.0f));
+    return (int)((vgetq_lane_u32(mask, 0) & 1) | (vgetq_lane_u32(mask, 1) & 2)
+                 | (vgetq_lane_u32(mask, 2) & 4) | (vgetq_lane_u32(mask, 3) & 8));
+  }
+#endif
+}
+
+void CullingSystem::Output::Add(Handle handle)
+{
+  buffer[buffered++] = handle;
+  if (buffered == BufferSize)
+  {
+    Flush();
+  }
+}
+
+void CullingSystem::Output::Flush()
+{
+  if (buffered == 0)
+  {
+    return;
+  }
+  size_t offset = count->fetch_add(buffered);
+  memcpy(visible + offset, buffer, buffered * sizeof(Handle));
+  buffered = 0;
+}
+
+void CullingSystem::SubtreeJob::operator()(size_t begin, size_t end) const
+{
+  Output output;
+  output.visible = visible;
+  output.count = count;
+  output.buffered = 0;
+  output.nodes_visited = 0;
+  output.objects_tested = 0;
+  output.objects_accepted = 0;
+  for (size_t i = begin; i < end; ++i)
+  {
+    system->Traverse(system->_split[i], system->_split_inside[i] != 0, kernel, 0, output);
+  }
+  output.Flush();
+  *nodes_visited += output.nodes_visited;
+  *objects_tested += output.objects_tested;
+  *objects_accepted += output.objects_accepted;
+}
+
+CullingSystem::CullingSystem(const float *center, float half_size, unsigned int max_depth)
+{
+  memcpy(_center, center, sizeof(_center));
+  _half_size = half_size;
+  _max_depth = max_depth;
+  memset(&_stats, 0, sizeof(_stats));
+  // Everything visible until a view projection is given
+  memset(_planes, 0, sizeof(_planes));
+  for (int plane = 0; plane < 6; ++plane)
+  {
+    _planes[plane][3] = 1.0f;
+  }
+  Clear();
+}
+
+bool CullingSystem::HasSimd()
+{
+#ifdef CULLING_SIMD
+  return true;
+#else
+  return false;
+#endif
+}
+
+void CullingSystem::Clear()
+{
+  _nodes.clear();
+  _objects.clear();
+  _free.clear();
+  _count = 0;
+  Node root;
+  memcpy(root.center, _center, sizeof(root.center));
+  root.half_size = _half_size;
+  root.depth = 0;
+  root.parent = -1;
+  for (int child = 0; child < 8; ++child)
+  {
+    root.children[child] = -1;
+  }
+  root.split = false;
+  root.subtree_count = 0;
+  _nodes.push_back(root);
+}
+
+int CullingSystem::CreateNode(int parent, unsigned int child)
+{
+  Node node;
+  const Node &above = _nodes[parent];
+  node.half_size = above.half_size * 0.5f;
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    node.center[axis] = above.center[axis] + ((child >> axis) & 1 ? node.half_size : -node.half_size);
+  }
+  node.depth = above.depth + 1;
+  node.parent = parent;
+  for (int i = 0; i < 8; ++i)
+  {
+    node.children[i] = -1;
+  }
+  node.split = false;
+  node.subtree_count = 0;
+  // above is not used past this point, the push may move it
+  int index = (int)_nodes.size();
+  _nodes.push_back(node);
+  _nodes[parent].children[child] = index;
+  return index;
+}
+
+int CullingSystem::Locate(const float *center, const float *extent)
+{
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    if (fabsf(center[axis] - _center[axis]) > _half_size)
+    {
+      return 0;
+    }
+  }
+  // Deepest cell at least as large as the object, its loose bounds hold it
+  float radius = maxOf(extent[0], maxOf(extent[1], extent[2]));
+  unsigned int depth = 0;
+  float half_size = _half_size;
+  while (depth < _max_depth && radius <= half_size * 0.5f)
+  {
+    half_size *= 0.5f;
+    ++depth;
+  }
+  int node = 0;
+  for (unsigned int level = 0; level < depth && _nodes[node].split; ++level)
+  {
+    unsigned int child = 0;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      if (center[axis] >= _nodes[node].center[axis])
+      {
+        child |= 1u << axis;
+      }
+    }
+    int next = _nodes[node].children[child];
+    node = next >= 0 ? next : CreateNode(node, child);
+  }
+  return node;
+}
+
+void CullingSystem::Append(int index, Handle handle, const float *center, const float *extent)
+{
+  Node &node = _nodes[index];
+  _objects[handle].node = index;
+  _objects[handle].slot = (uint32_t)node.handles.size();
+  node.center_x.push_back(center[0]);
+  node.center_y.push_back(center[1]);
+  node.center_z.push_back(center[2]);
+  node.extent_x.push_back(extent[0]);
+  node.extent_y.push_back(extent[1]);
+  node.extent_z.push_back(extent[2]);
+  node.handles.push_back(handle);
+  for (int up = index; up >= 0; up = _nodes[up].parent)
+  {
+    ++_nodes[up].subtree_count;
+  }
+  if (!_nodes[index].split && _nodes[index].depth < _max_depth && _nodes[index].handles.size() > NodeCapacity)
+  {
+    Split(index);
+  }
+}
+
+void CullingSystem::Split(int index)
+{
+  _nodes[index].split = true;
+  size_t slot = 0;
+  while (slot < _nodes[index].handles.size())
+  {
+    const Node &node = _nodes[index];
+    Handle handle = node.handles[slot];
+    float center[3] = { node.center_x[slot], node.center_y[slot], node.center_z[slot] };
+    float extent[3] = { node.extent_x[slot], node.extent_y[slot], node.extent_z[slot] };
+    int target = Locate(center, extent);
+    if (target == index)
+    {
+      ++slot;
+      continue;
+    }
+    // The last object takes the slot, it is looked at next
+    Detach(handle);
+    Append(target, handle, center, extent);
+  }
+}
+
+void CullingSystem::Detach(Handle handle)
+{
+  int index = _objects[handle].node;
+  uint32_t slot = _objects[handle].slot;
+  Node &node = _nodes[index];
+  // The last object of the node takes the slot
+  size_t last = node.handles.size() - 1;
+  node.center_x[slot] = node.center_x[last];
+  node.center_y[slot] = node.center_y[last];
+  node.center_z[slot] = node.center_z[last];
+  node.extent_x[slot] = node.extent_x[last];
+  node.extent_y[slot] = node.extent_y[last];
+  node.extent_z[slot] = node.extent_z[last];
+  node.handles[slot] = node.handles[last];
+  _objects[node.handles[slot]].slot = slot;
+  node.center_x.pop_back();
+  node.center_y.pop_back();
+  node.center_z.pop_back();
+  node.extent_x.pop_back();
+  node.extent_y.pop_back();
+  node.extent_z.pop_back();
+  node.handles.pop_back();
+  for (int up = index; up >= 0; up = _nodes[up].parent)
+  {
+    --_nodes[up].subtree_count;
+  }
+  _objects[handle].node = -1;
+}
+
+CullingSystem::Handle CullingSystem::Insert(const float *center, const float *extent)
+{
+  Handle handle;
+  if (!_free.empty())
+  {
+    handle = _free.back();
+    _free.pop_back();
+  }
+  else
+  {
+    handle = (Handle)_objects.size();
+    Object object = { -1, 0 };
+    _objects.push_back(object);
+  }
+  Append(Locate(center, extent), handle, center, extent);
+  ++_count;
+  return handle;
+}
+
+bool CullingSystem::Keeps(const Node &node, const float *center, const float *extent) const
+{
+  if (node.depth == 0)
+  {
+    return false;
+  }
+  float radius = maxOf(extent[0], maxOf(extent[1], extent[2]));
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    if (fabsf(center[axis] - node.center[axis]) > node.half_size)
+    {
+      return false;
+    }
+  }
+  // Fits the node's loose bounds and could not go further down
+  return radius <= node.half_size
+         && (!node.split || node.depth == _max_depth || radius > node.half_size * 0.5f);
+}
+
+void CullingSystem::Move(Handle handle, const float *center, const float *extent)
+{
+  if (handle >= _objects.size() || _objects[handle].node < 0)
+  {
+    return;
+  }
+  int index = _objects[handle].node;
+  if (!Keeps(_nodes[index], center, extent))
+  {
+    index = Locate(center, extent);
+    if (index != _objects[handle].node)
+    {
+      Detach(handle);
+      Append(index, handle, center, extent);
+      return;
+    }
+  }
+  // Still in its cell, only the box changes
+  Node &node = _nodes[index];
+  uint32_t slot = _objects[handle].slot;
+  node.center_x[slot] = center[0];
+  node.center_y[slot] = center[1];
+  node.center_z[slot] = center[2];
+  node.extent_x[slot] = extent[0];
+  node.extent_y[slot] = extent[1];
+  node.extent_z[slot] = extent[2];
+}
+
+void CullingSystem::Remove(Handle handle)
+{
+  if (handle >= _objects.size() || _objects[handle].node < 0)
+  {
+    return;
+  }
+  Detach(handle);
+  _free.push_back(handle);
+  --_count;
+}
+
+void CullingSystem::SetViewProjection(const float *matrix)
+{
+  // Gribb and Hartmann: row 3 plus or minus rows 0, 1 and 2, left right bottom top near far
+  for (int plane = 0; plane < 6; ++plane)
+  {
+    int row = plane / 2;
+    float sign = plane % 2 == 0 ? 1.0f : -1.0f;
+    float length = 0.0f;
+    for (int column = 0; column < 4; ++column)
+    {
+      _planes[plane][column] = matrix[column * 4 + 3] + sign * matrix[column * 4 + row];
+    }
+    length = sqrtf(_planes[plane][0] * _planes[plane][0] + _planes[plane][1] * _planes[plane][1]
+                   + _planes[plane][2] * _planes[plane][2]);
+    if (length > 0.0f)
+    {
+      for (int column = 0; column < 4; ++column)
+      {
+        _planes[plane][column] /= length;
+      }
+    }
+  }
+}
+
+CullingSystem::Overlap CullingSystem::TestNode(const Node &node) const
+{
+  // Loose bounds, twice the cell
+  float extent = node.half_size * 2.0f;
+  Overlap overlap = Inside;
+  for (int plane = 0; plane < 6; ++plane)
+  {
+    const float *p = _planes[plane];
+    float distance = p[0] * node.center[0] + p[1] * node.center[1] + p[2] * node.center[2] + p[3];
+    float radius = (fabsf(p[0]) + fabsf(p[1]) + fabsf(p[2])) * extent;
+    if (distance + radius < 0.0f)
+    {
+      return Outside;
+    }
+    if (distance - radius < 0.0f)
+    {
+      overlap = Intersecting;
+    }
+  }
+  return overlap;
+}
+
+void CullingSystem::TestObjectsScalar(const Node &node, size_t begin, Output &output) const
+{
+  size_t count = node.handles.size();
+  for (size_t i = begin; i < count; ++i)
+  {
+    bool visible = true;
+    for (int plane = 0; plane < 6 && visible; ++plane)
+    {
+      const float *p = _planes[plane];
+      float distance = p[0] * node.center_x[i] + p[1] * node.center_y[i] + p[2] * node.center_z[i] + p[3];
+      float radius = fabsf(p[0]) * node.extent_x[i] + fabsf(p[1]) * node.extent_y[i] + fabsf(p[2]) * node.extent_z[i];
+      visible = distance + radius >= 0.0f;
+    }
+    if (visible)
+    {
+      output.Add(node.handles[i]);
+    }
+  }
+  output.objects_tested += count - begin;
+}
+
+#ifdef CULLING_SIMD
+void CullingSystem::TestObjectsSimd(const Node &node, Output &output) const
+{
+  Lanes a[6], b[6], c[6], d[6], abs_a[6], abs_b[6], abs_c[6];
+  for (int plane = 0; plane < 6; ++plane)
+  {
+    const float *p = _planes[plane];
+    a[plane] = splat(p[0]);
+    b[plane] = splat(p[1]);
+    c[plane] = splat(p[2]);
+    d[plane] = splat(p[3]);
+    abs_a[plane] = splat(fabsf(p[0]));
+    abs_b[plane] = splat(fabsf(p[1]));
+    abs_c[plane] = splat(fabsf(p[2]));
+  }
+  // Whole groups of four, the rest goes through the scalar test
+  size_t groups = node.handles.size() & ~(size_t)3;
+  for (size_t i = 0; i < groups; i += 4)
+  {
+    Lanes x = load(&node.center_x[i]);
+    Lanes y = load(&node.center_y[i]);
+    Lanes z = load(&node.center_z[i]);
+    Lanes ex = load(&node.extent_x[i]);
+    Lanes ey = load(&node.extent_y[i]);
+    Lanes ez = load(&node.extent_z[i]);
+    int mask = 0xF;
+    for (int plane = 0; plane < 6 && mask != 0; ++plane)
+    {
+      Lanes distance = add(add(mul(a[plane], x), mul(b[plane], y)), add(mul(c[plane], z), d[plane]));
+      Lanes radius = add(add(mul(abs_a[plane], ex), mul(abs_b[plane], ey)), mul(abs_c[plane], ez));
+      mask &= notNegative(add(distance, radius));
+    }
+    for (int lane = 0; mask != 0; ++lane, mask >>= 1)
+    {
+      if (mask & 1)
+      {
+        output.Add(node.handles[i + lane]);
+      }
+    }
+  }
+  output.objects_tested += groups;
+  TestObjectsScalar(node, groups, output);
+}
+#else
+void CullingSystem::TestObjectsSimd(const Node &node, Output &output) const
+{
+  TestObjectsScalar(node, 0, output);
+}
+#endif
+
+void CullingSystem::Traverse(int index, bool inside, Kernel kernel, unsigned int split_depth, Output &output)
+{
+  const Node &node = _nodes[index];
+  if (node.subtree_count == 0)
+  {
+    return;
+  }
+  // The root holds what is outside the world, it is never rejected as a whole
+  if (!inside && index != 0)
+  {
+    Overlap overlap = TestNode(node);
+    if (overlap == Outside)
+    {
+      return;
+    }
+    inside = overlap == Inside;
+  }
+  if (split_depth != 0 && node.depth == split_depth)
+  {
+    _split.push_back(index);
+    _split_inside.push_back(inside ? 1 : 0);
+    return;
+  }
+  ++output.nodes_visited;
+  size_t count = node.handles.size();
+  if (inside && count > 0)
+  {
+    // Straight to the output, past the buffer
+    output.Flush();
+    size_t offset = output.count->fetch_add(count);
+    memcpy(output.visible + offset, node.handles.data(), count * sizeof(Handle));
+    output.objects_accepted += count;
+  }
+  else if (count > 0)
+  {
+    if (kernel == Simd)
+    {
+      TestObjectsSimd(node, output);
+    }
+    else
+    {
+      TestObjectsScalar(node, 0, output);
+    }
+  }
+  for (int child = 0; child < 8; ++child)
+  {
+    if (node.children[child] >= 0)
+    {
+      Traverse(node.children[child], inside, kernel, split_depth, output);
+    }
+  }
+}
+
+size_t CullingSystem::Cull(Handle *visible, JobSystem *jobs, Kernel kernel)
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::atomic<size_t> count(0);
+  Output output;
+  output.visible = visible;
+  output.count = &count;
+  output.buffered = 0;
+  output.nodes_visited = 0;
+  output.objects_tested = 0;
+  output.objects_accepted = 0;
+  std::atomic<size_t> nodes_visited(0);
+  std::atomic<size_t> objects_tested(0);
+  std::atomic<size_t> objects_accepted(0);
+  if (jobs == NULL || _max_depth < SplitDepth)
+  {
+    Traverse(0, false, kernel, 0, output);
+  }
+  else
+  {
+    // The first levels here, the subtrees below them as jobs
+    _split.clear();
+    _split_inside.clear();
+    Traverse(0, false, kernel, SplitDepth, output);
+    SubtreeJob job = { this, visible, &count, kernel, &nodes_visited, &objects_tested, &objects_accepted };
+    jobs->ParallelFor(_split.size(), 1, job);
+  }
+  output.Flush();
+
+  _stats.objects = _count;
+  _stats.nodes_visited = output.nodes_visited + nodes_visited;
+  _stats.objects_tested = output.objects_tested + objects_tested;
+  _stats.objects_accepted = output.objects_accepted + objects_accepted;
+  _stats.visible = count;
+  _stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  return count;
+}
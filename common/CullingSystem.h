@@ -0,0 +1,155 @@
+#ifndef CULLING_SYSTEM_H
+#define CULLING_SYSTEM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+
+namespace Common
+{
+  class JobSystem;
+
+  // Bounding boxes in a loose octree, culled against the frustum of a view
+  // projection. An object lives in the deepest node whose cell is at least
+  // as large as the object, wherever its center falls: a node's loose
+  // bounds are twice its cell and hold any such object. A node only gets
+  // children once it holds more than a few tens of objects, sparse regions
+  // stay shallow and nodes hold enough boxes to test. Insert, Move and
+  // Remove are incremental, an object moving within its cell only
+  // rewrites its box. Cull() rejects the nodes outside the frustum,
+  // accepts the subtrees of the nodes inside it without testing their
+  // objects, and tests the rest four boxes at a time against the six
+  // planes, with SSE on x86, NEON on ARM and plain C++ elsewhere. For 2D
+  // scenes, give a zero z extent.
+  class CullingSystem
+  {
+  public:
+    enum Kernel { Scalar, Simd };
+    typedef uint32_t Handle;
+    static const Handle InvalidHandle = 0xFFFFFFFF;
+    static const unsigned int DefaultMaxDepth = 8;
+
+    struct Stats
+    {
+      size_t objects;
+      size_t nodes_visited;
+      // Boxes tested against the planes, and accepted with their node
+      size_t objects_tested;
+      size_t objects_accepted;
+      size_t visible;
+      double milliseconds;
+    };
+
+    // The world is the cube around center, objects outside it are kept in
+    // the root and tested every time
+    CullingSystem(const float *center, float half_size, unsigned int max_depth = DefaultMaxDepth);
+    virtual ~CullingSystem(){}
+    // center and extent are x y z, extent is half the box's size
+    Handle Insert(const float *center, const float *extent);
+    // A removed or unknown handle is ignored, as by Remove
+    void Move(Handle handle, const float *center, const float *extent);
+    // The handle is given again by a later Insert
+    void Remove(Handle handle);
+    void Clear();
+    size_t GetCount() const { return _count; }
+
+    // Column major, the planes are taken from it
+    void SetViewProjection(const float *matrix);
+    // Writes the handles of the visible objects to visible, in no given
+    // order, and returns how many. visible has room for GetCount()
+    // handles. With jobs, the subtrees below the first levels are culled in
+    // parallel and the call returns when all are done.
+    size_t Cull(Handle *visible, JobSystem *jobs = NULL, Kernel kernel = Simd);
+    const Stats &GetStats() const { return _stats; }
+
+    // Whether Simd runs a vector kernel rather than falling back to Scalar
+    static bool HasSimd();
+  private:
+    struct Node
+    {
+      float center[3];
+      // Of the cell, the loose bounds are twice as large
+      float half_size;
+      unsigned int depth;
+      int parent;
+      int children[8];
+      // Objects that fit a child go down to it
+      bool split;
+      // Objects in the node and below, empty subtrees are skipped
+      size_t subtree_count;
+      // Structure of arrays, four boxes per SIMD register
+      std::vector<float> center_x;
+      std::vector<float> center_y;
+      std::vector<float> center_z;
+      std::vector<float> extent_x;
+      std::vector<float> extent_y;
+      std::vector<float> extent_z;
+      std::vector<Handle> handles;
+    };
+    struct Object
+    {
+      // -1 once removed
+      int node;
+      uint32_t slot;
+    };
+    enum Overlap { Outside, Intersecting, Inside };
+    // Visible handles of a traversal, buffered then copied out at a reserved offset
+    struct Output
+    {
+      static const size_t BufferSize = 256;
+      Handle *visible;
+      std::atomic<size_t> *count;
+      Handle buffer[BufferSize];
+      size_t buffered;
+      size_t nodes_visited;
+      size_t objects_tested;
+      size_t objects_accepted;
+      void Add(Handle handle);
+      void Flush();
+    };
+    struct SubtreeJob
+    {
+      CullingSystem *system;
+      Handle *visible;
+      std::atomic<size_t> *count;
+      Kernel kernel;
+      std::atomic<size_t> *nodes_visited;
+      std::atomic<size_t> *objects_tested;
+      std::atomic<size_t> *objects_accepted;
+      void operator()(size_t begin, size_t end) const;
+    };
+    CullingSystem(const CullingSystem &);
+    CullingSystem &operator=(const CullingSystem &);
+    // Node an object of that box belongs in, created on the way if needed
+    int Locate(const float *center, const float *extent);
+    // Whether the box still belongs in the node, checked before a Locate
+    bool Keeps(const Node &node, const float *center, const float *extent) const;
+    int CreateNode(int parent, unsigned int child);
+    void Append(int node, Handle handle, const float *center, const float *extent);
+    void Detach(Handle handle);
+    // Gives the node children and moves down the objects that fit them
+    void Split(int node);
+    Overlap TestNode(const Node &node) const;
+    // Subtrees at split_depth are queued to _split rather than traversed, split_depth 0 goes all the way
+    void Traverse(int node, bool inside, Kernel kernel, unsigned int split_depth, Output &output);
+    void TestObjectsScalar(const Node &node, size_t begin, Output &output) const;
+    void TestObjectsSimd(const Node &node, Output &output) const;
+
+    float _center[3];
+    float _half_size;
+    unsigned int _max_depth;
+    std::vector<Node> _nodes;
+    std::vector<Object> _objects;
+    std::vector<Handle> _free;
+    size_t _count;
+    // a b c d of the six planes, inside when a x + b y + c z + d >= 0
+    float _planes[6][4];
+    // Subtree roots of a parallel cull and whether they are inside
+    std::vector<int> _split;
+    std::vector<uint8_t> _split_inside;
+    Stats _stats;
+  };
+}
+
+#endif
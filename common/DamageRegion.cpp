@@ -0,0 +1,110 @@
+#include <algorithm>
+#include "DamageRegion.h"
+
+using namespace Common;
+
+namespace
+{
+  bool overlaps(const DamageRegion::Rectangle &a, const DamageRegion::Rectangle &b)
+  {
+    return a.x < b.x + b.width && b.x < a.x + a.width && a.y < b.y + b.height && b.y < a.y + a.height;
+  }
+
+  DamageRegion::Rectangle merge(const DamageRegion::Rectangle &a, const DamageRegion::Rectangle &b)
+  {
+    DamageRegion::Rectangle bounds;
+    bounds.x = std::min(a.x, b.x);
+    bounds.y = std::min(a.y, b.y);
+    bounds.width = std::max(a.x + a.width, b.x + b.width) - bounds.x;
+    bounds.height = std::max(a.y + a.height, b.y + b.height) - bounds.y;
+    return bounds;
+  }
+}
+
+DamageRegion::DamageRegion()
+{
+  _width = 0;
+  _height = 0;
+}
+
+void DamageRegion::Reset(int width, int height)
+{
+  _width = width;
+  _height = height;
+  _rectangles.clear();
+}
+
+void DamageRegion::Add(int x, int y, int width, int height)
+{
+  Rectangle added;
+  added.x = std::max(x, 0);
+  added.y = std::max(y, 0);
+  added.width = std::min(x + width, _width) - added.x;
+  added.height = std::min(y + height, _height) - added.y;
+  if (added.width <= 0 || added.height <= 0)
+  {
+    return;
+  }
+  // A merged rectangle may now overlap others, until it does not
+  size_t i = 0;
+  while (i < _rectangles.size())
+  {
+    if (overlaps(_rectangles[i], added))
+    {
+      added = merge(_rectangles[i], added);
+      _rectangles[i] = _rectangles.back();
+      _rectangles.pop_back();
+      i = 0;
+    }
+    else
+    {
+      ++i;
+    }
+  }
+  _rectangles.push_back(added);
+  if (_rectangles.size() > MaxRectangles)
+  {
+    Rectangle bounds = GetBounds();
+    _rectangles.assign(1, bounds);
+  }
+}
+
+void DamageRegion::Add(const DamageRegion &region)
+{
+  for (size_t i = 0; i < region._rectangles.size(); ++i)
+  {
+    const Rectangle &rectangle = region._rectangles[i];
+    Add(rectangle.x, rectangle.y, rectangle.width, rectangle.height);
+  }
+}
+
+void DamageRegion::AddFull()
+{
+  _rectangles.clear();
+  Add(0, 0, _width, _height);
+}
+
+bool DamageRegion::IsFull() const
+{
+  return _rectangles.size() == 1 && _rectangles[0].width == _width && _rectangles[0].height == _height;
+}
+
+DamageRegion::Rectangle DamageRegion::GetBounds() const
+{
+  Rectangle bounds = { 0, 0, 0, 0 };
+  for (size_t i = 0; i < _rectangles.size(); ++i)
+  {
+    bounds = i == 0 ? _rectangles[0] : merge(bounds, _rectangles[i]);
+  }
+  return bounds;
+}
+
+long DamageRegion::GetArea() const
+{
+  long area = 0;
+  for (size_t i = 0; i < _rectangles.size(); ++i)
+  {
+    area += (long)_rectangles[i].width * _rectangles[i].height;
+  }
+  return area;
+}
@@ -0,0 +1,52 @@
+#ifndef DAMAGE_REGION_H
+#define DAMAGE_REGION_H
+
+#include <stddef.h>
+#include <vector>
+
+namespace Common
+{
+  // The part of a surface a frame changes, as a few rectangles in window
+  // coordinates: pixels, origin at the bottom left, like glScissor and the
+  // EGL damage extensions. Rectangles are clipped to the surface and kept
+  // disjoint, one that overlaps another is merged with it into their
+  // bounds; past MaxRectangles the whole region becomes its bounds. The
+  // region only ever grows until it is reset.
+  class DamageRegion
+  {
+  public:
+    static const size_t MaxRectangles = 16;
+
+    struct Rectangle
+    {
+      int x;
+      int y;
+      int width;
+      int height;
+    };
+
+    DamageRegion();
+    // Empty, over a surface of this size
+    void Reset(int width, int height);
+    void Add(int x, int y, int width, int height);
+    void Add(const DamageRegion &region);
+    // The whole surface
+    void AddFull();
+
+    bool IsEmpty() const { return _rectangles.empty(); }
+    bool IsFull() const;
+    int GetWidth() const { return _width; }
+    int GetHeight() const { return _height; }
+    const std::vector<Rectangle> &GetRectangles() const { return _rectangles; }
+    // Smallest rectangle holding the region, 0 by 0 when empty
+    Rectangle GetBounds() const;
+    // Pixels covered
+    long GetArea() const;
+  private:
+    int _width;
+    int _height;
+    std::vector<Rectangle> _rectangles;
+  };
+}
+
+#endif
@@ -0,0 +1,145 @@
+#include <string.h>
+#include <chrono>
+#include "DrawList.h"
+
+using namespace Common;
+
+namespace
+{
+  // 11 bit digits, six passes cover the key
+  const int DigitBits = 11;
+  const int Digits = (64 + DigitBits - 1) / DigitBits;
+  const uint32_t DigitValues = 1u << DigitBits;
+  const uint64_t DigitMask = DigitValues - 1;
+
+  // Field widths of the key, see the header
+  const uint64_t LayerMask   = 0xFF;
+  const uint64_t ProgramMask = 0xFFF;
+  const uint64_t TextureMask = 0x3FFF;
+  const uint64_t BufferMask  = 0x7FF;
+  const uint64_t DepthMask   = 0x3FFFF;
+
+  uint64_t quantize(float depth)
+  {
+    if (!(depth > 0.0f))
+    {
+      return 0;
+    }
+    if (depth >= 1.0f)
+    {
+      return DepthMask;
+    }
+    return (uint64_t)(depth * (float)DepthMask + 0.5f);
+  }
+}
+
+DrawList::DrawList()
+{
+  _unsorted_state_changes = 0;
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+uint64_t DrawList::MakeKey(unsigned int layer, bool translucent, float depth,
+                           uint32_t program, uint32_t texture, uint32_t buffer)
+{
+  uint64_t state = ((program & ProgramMask) << 25) | ((texture & TextureMask) << 11) | (buffer & BufferMask);
+  uint64_t key = (layer & LayerMask) << 56;
+  if (translucent)
+  {
+    // Far ones first so that blending sees what is behind, the state only breaks ties
+    return key | (1ull << 55) | ((DepthMask - quantize(depth)) << 37) | state;
+  }
+  return key | (state << 18) | quantize(depth);
+}
+
+void DrawList::Begin()
+{
+  _items.clear();
+  _states.clear();
+  _unsorted_state_changes = 0;
+}
+
+size_t DrawList::CountChanges(const State &a, const State &b)
+{
+  return (a.program != b.program ? 1 : 0) + (a.texture != b.texture ? 1 : 0) + (a.buffer != b.buffer ? 1 : 0);
+}
+
+uint32_t DrawList::Add(uint64_t key, uint32_t program, uint32_t texture, uint32_t buffer)
+{
+  Item item;
+  item.key = key;
+  item.index = (uint32_t)_items.size();
+  _items.push_back(item);
+  State state = { program, texture, buffer };
+  if (!_states.empty())
+  {
+    _unsorted_state_changes += CountChanges(_states.back(), state);
+  }
+  _states.push_back(state);
+  return item.index;
+}
+
+void DrawList::Sort()
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  size_t count = _items.size();
+  _scratch.resize(count);
+  unsigned int passes = 0;
+  if (count > 1)
+  {
+    // Every digit's histogram in one read of the keys
+    uint32_t histograms[Digits][DigitValues];
+    memset(histograms, 0, sizeof(histograms));
+    for (size_t i = 0; i < count; ++i)
+    {
+      uint64_t key = _items[i].key;
+      for (int digit = 0; digit < Digits; ++digit)
+      {
+        ++histograms[digit][(key >> (digit * DigitBits)) & DigitMask];
+      }
+    }
+
+    Item *from = _items.data();
+    Item *to = _scratch.data();
+    for (int digit = 0; digit < Digits; ++digit)
+    {
+      uint32_t *histogram = histograms[digit];
+      int shift = digit * DigitBits;
+      // Shared by every key, the pass would not move anything
+      if (histogram[(from[0].key >> shift) & DigitMask] == count)
+      {
+        continue;
+      }
+      // Histogram turned into the offset of each value's run
+      uint32_t offset = 0;
+      for (uint32_t value = 0; value < DigitValues; ++value)
+      {
+        uint32_t size = histogram[value];
+        histogram[value] = offset;
+        offset += size;
+      }
+      for (size_t i = 0; i < count; ++i)
+      {
+        to[histogram[(from[i].key >> shift) & DigitMask]++] = from[i];
+      }
+      Item *swap = from;
+      from = to;
+      to = swap;
+      ++passes;
+    }
+    if (from != _items.data())
+    {
+      _items.swap(_scratch);
+    }
+  }
+  _stats.sort_microseconds = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+  _stats.items = count;
+  _stats.passes = passes;
+  _stats.unsorted_state_changes = _unsorted_state_changes;
+  _stats.state_changes = 0;
+  for (size_t i = 1; i < count; ++i)
+  {
+    _stats.state_changes += CountChanges(_states[_items[i - 1].index], _states[_items[i].index]);
+  }
+}
@@ -0,0 +1,74 @@
+#ifndef DRAW_LIST_H
+#define DRAW_LIST_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace Common
+{
+  // The draws of a frame, ordered by a 64 bit key before they are
+  // submitted so that draws sharing a program, texture or buffer follow
+  // each other. From the most significant bit:
+  //   opaque       layer:8 | 0:1 | program:12 | texture:14 | buffer:11 | depth:18, front to back
+  //   translucent  layer:8 | 1:1 | depth:18, back to front | program:12 | texture:14 | buffer:11
+  // Layers draw in increasing order, opaque draws before translucent ones.
+  // Names wider than their field are folded, such draws may not group but
+  // still draw in a valid order. Sort() is a least significant digit radix
+  // sort, 11 bits per pass, and skips the digits every key shares; it is
+  // stable, equal keys keep the order they were added in. Storage is kept
+  // across frames.
+  class DrawList
+  {
+  public:
+    struct Item
+    {
+      uint64_t key;
+      // Order the draw was added in, the caller's draw
+      uint32_t index;
+    };
+
+    struct Stats
+    {
+      size_t items;
+      // Program, texture and buffer switches, each counts one, in the
+      // order the draws were added and once sorted
+      size_t unsorted_state_changes;
+      size_t state_changes;
+      unsigned int passes;
+      double sort_microseconds;
+    };
+
+    DrawList();
+    virtual ~DrawList(){}
+    static uint64_t MakeKey(unsigned int layer, bool translucent, float depth,
+                            uint32_t program, uint32_t texture, uint32_t buffer);
+
+    void Begin();
+    // The state is what the draw binds, for the state change counts.
+    // Returns the draw's index
+    uint32_t Add(uint64_t key, uint32_t program, uint32_t texture, uint32_t buffer);
+    void Sort();
+
+    const Item *GetItems() const { return _items.data(); }
+    size_t GetCount() const { return _items.size(); }
+    const Stats &GetStats() const { return _stats; }
+  private:
+    struct State
+    {
+      uint32_t program;
+      uint32_t texture;
+      uint32_t buffer;
+    };
+    static size_t CountChanges(const State &a, const State &b);
+
+    std::vector<Item> _items;
+    // Second buffer of the radix sort
+    std::vector<Item> _scratch;
+    std::vector<State> _states;
+    size_t _unsorted_state_changes;
+    Stats _stats;
+  };
+}
+
+#endif
@@ -0,0 +1,82 @@
+#include <math.h>
+#include "DynamicResolution.h"
+
+using namespace Common;
+
+namespace
+{
+  // Frames measured at a new scale before it may change again
+  const unsigned int SettlingFrames = 8;
+  // Weight of the last frame in the smoothed time
+  const double Smoothing = 0.2;
+  // Grows only well under the target, shrinks as soon as it is over
+  const double Headroom = 0.8;
+  const float GrowStep = 0.05f;
+  // Scales are kept on a grid so that small variations keep the same size
+  const float Quantum = 1.0f / 32.0f;
+}
+
+DynamicResolution::DynamicResolution()
+{
+  _target = 0.0;
+  _minimum = 0.5f;
+  _maximum = 1.0f;
+  Reset();
+}
+
+void DynamicResolution::SetTarget(double milliseconds)
+{
+  _target = milliseconds > 0.0 ? milliseconds : 0.0;
+  Reset();
+}
+
+void DynamicResolution::SetRange(float minimum, float maximum)
+{
+  _maximum = maximum > 0.0f ? maximum : 1.0f;
+  _minimum = minimum > 0.0f && minimum < _maximum ? minimum : _maximum;
+  Reset();
+}
+
+void DynamicResolution::Reset()
+{
+  _scale = _maximum;
+  _smoothed = 0.0;
+  _settling_frames = SettlingFrames;
+  _changes = 0;
+}
+
+float DynamicResolution::Update(double milliseconds)
+{
+  if (!IsEnabled())
+  {
+    return _scale;
+  }
+  _smoothed = _smoothed > 0.0 ? _smoothed + (milliseconds - _smoothed) * Smoothing : milliseconds;
+  if (_settling_frames > 0)
+  {
+    --_settling_frames;
+    return _scale;
+  }
+
+  float scale = _scale;
+  if (_smoothed > _target)
+  {
+    // Frame time follows the pixel count, the square of the scale
+    scale = _scale * (float)sqrt(_target / _smoothed);
+    scale = floorf(scale / Quantum) * Quantum;
+  }
+  else if (_smoothed < _target * Headroom)
+  {
+    scale = ceilf((_scale + GrowStep) / Quantum) * Quantum;
+  }
+  scale = scale < _minimum ? _minimum : (scale > _maximum ? _maximum : scale);
+  if (scale != _scale)
+  {
+    _scale = scale;
+    // The smoothed time belongs to the old scale, start over
+    _smoothed = 0.0;
+    _settling_frames = SettlingFrames;
+    ++_changes;
+  }
+  return _scale;
+}
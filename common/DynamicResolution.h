@@ -0,0 +1,41 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+namespace Common
+{
+  // Picks the render scale (fraction of the output width and height) that
+  // keeps the measured frame time under a target. The time is smoothed,
+  // and the scale only moves after a few frames at the new one have been
+  // measured: a frame over budget shrinks the pixel count in proportion,
+  // one well under grows it a step at a time, so it neither oscillates
+  // nor reacts to a single slow frame.
+  class DynamicResolution
+  {
+  public:
+    DynamicResolution();
+    // 0 disables scaling, the scale then stays at the maximum
+    void SetTarget(double milliseconds);
+    double GetTarget() const { return _target; }
+    void SetRange(float minimum, float maximum);
+    float GetMinimum() const { return _minimum; }
+    float GetMaximum() const { return _maximum; }
+    bool IsEnabled() const { return _target > 0.0; }
+    // Back to the maximum scale
+    void Reset();
+    // Feeds the time of a frame drawn at the current scale, returns the scale of the next one
+    float Update(double milliseconds);
+    float GetScale() const { return _scale; }
+    double GetSmoothedMilliseconds() const { return _smoothed; }
+    unsigned long GetChangeCount() const { return _changes; }
+  private:
+    double _target;
+    float _minimum;
+    float _maximum;
+    float _scale;
+    double _smoothed;
+    unsigned int _settling_frames;
+    unsigned long _changes;
+  };
+}
+
+#endif
@@ -0,0 +1,49 @@
+#include <string.h>
+#include <EGL/egl.h>
+#include "Extensions.h"
+
+bool Common::HasExtension(const char *extensions, const char *name)
+{
+  if (extensions == NULL)
+  {
+    return false;
+  }
+  size_t length = strlen(name);
+  const char *cursor = extensions;
+  while ((cursor = strstr(cursor, name)) != NULL)
+  {
+    if ((cursor == extensions || cursor[-1] == ' ') && (cursor[length] == ' ' || cursor[length] == '\0'))
+    {
+      return true;
+    }
+    cursor += length;
+  }
+  return false;
+}
+
+bool Common::HasGlExtension(const char *name)
+{
+  return HasExtension((const char *)glGetString(GL_EXTENSIONS), name);
+}
+
+bool Common::TimerQueries::IsLoaded() const
+{
+  return genQueries != NULL && deleteQueries != NULL && queryCounter != NULL && getQueryiv != NULL
+      && getQueryObjectuiv != NULL && getQueryObjectui64v != NULL;
+}
+
+Common::TimerQueries Common::LoadTimerQueries()
+{
+  TimerQueries queries = { NULL, NULL, NULL, NULL, NULL, NULL };
+  if (!HasGlExtension("GL_EXT_disjoint_timer_query"))
+  {
+    return queries;
+  }
+  queries.genQueries = (PFNGLGENQUERIESEXTPROC)eglGetProcAddress("glGenQueriesEXT");
+  queries.deleteQueries = (PFNGLDELETEQUERIESEXTPROC)eglGetProcAddress("glDeleteQueriesEXT");
+  queries.queryCounter = (PFNGLQUERYCOUNTEREXTPROC)eglGetProcAddress("glQueryCounterEXT");
+  queries.getQueryiv = (PFNGLGETQUERYIVEXTPROC)eglGetProcAddress("glGetQueryivEXT");
+  queries.getQueryObjectuiv = (PFNGLGETQUERYOBJECTUIVEXTPROC)eglGetProcAddress("glGetQueryObjectuivEXT");
+  queries.getQueryObjectui64v = (PFNGLGETQUERYOBJECTUI64VEXTPROC)eglGetProcAddress("glGetQueryObjectui64vEXT");
+  return queries;
+}
@@ -0,0 +1,30 @@
+#ifndef EXTENSIONS_H
+#define EXTENSIONS_H
+
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+namespace Common
+{
+  // GL_EXT_disjoint_timer_query entry points
+  struct TimerQueries
+  {
+    PFNGLGENQUERIESEXTPROC genQueries;
+    PFNGLDELETEQUERIESEXTPROC deleteQueries;
+    PFNGLQUERYCOUNTEREXTPROC queryCounter;
+    PFNGLGETQUERYIVEXTPROC getQueryiv;
+    PFNGLGETQUERYOBJECTUIVEXTPROC getQueryObjectuiv;
+    PFNGLGETQUERYOBJECTUI64VEXTPROC getQueryObjectui64v;
+    // All of them were found
+    bool IsLoaded() const;
+  };
+
+  // Whether name appears as a whole word in a space separated extension list
+  bool HasExtension(const char *extensions, const char *name);
+  // Whether the GL context current on the calling thread exposes name
+  bool HasGlExtension(const char *name);
+  // From the GL context current on the calling thread, all NULL when it lacks the extension
+  TimerQueries LoadTimerQueries();
+}
+
+#endif
@@ -0,0 +1,50 @@
+#include <math.h>
+#include "FixedTimestep.h"
+
+using namespace Common;
+
+FixedTimestep::FixedTimestep(double step, unsigned int max_steps)
+{
+  _step = step > 0.0 ? step : 1.0 / 60.0;
+  _max_steps = max_steps > 0 ? max_steps : 1;
+  _dropped_steps = 0;
+  Reset();
+}
+
+void FixedTimestep::SetStep(double step)
+{
+  if (step > 0.0)
+  {
+    _step = step;
+  }
+  Reset();
+}
+
+void FixedTimestep::Reset()
+{
+  _accumulator = 0.0;
+  _started = false;
+}
+
+unsigned int FixedTimestep::Advance()
+{
+  Clock::time_point now = Clock::now();
+  if (!_started)
+  {
+    // The first frame simulates one step, nothing has elapsed yet
+    _started = true;
+    _last = now;
+    return 1;
+  }
+  _accumulator += std::chrono::duration<double>(now - _last).count();
+  _last = now;
+  double steps = floor(_accumulator / _step);
+  if (steps > _max_steps)
+  {
+    _dropped_steps += (unsigned long)(steps - _max_steps);
+    _accumulator = 0.0;
+    return _max_steps;
+  }
+  _accumulator -= steps * _step;
+  return (unsigned int)steps;
+}
@@ -0,0 +1,37 @@
+#ifndef FIXED_TIMESTEP_H
+#define FIXED_TIMESTEP_H
+
+#include <chrono>
+
+namespace Common
+{
+  // Decouples the simulation rate from the frame rate: elapsed wall clock
+  // time is accumulated and consumed in steps of a fixed length, so the
+  // simulation behaves the same at 20 or 144 frames per second.
+  class FixedTimestep
+  {
+  public:
+    FixedTimestep(double step = 1.0 / 60.0, unsigned int max_steps = 8);
+    void SetStep(double step);
+    double GetStep() const { return _step; }
+    // Forgets the accumulated time, the next Advance starts from now
+    void Reset();
+    // Number of steps to simulate for the time elapsed since the last call.
+    // Beyond max_steps the time is dropped, a long stall (a debugger, a
+    // lost context) must not turn into a burst of catch-up steps.
+    unsigned int Advance();
+    // Fraction of a step left in the accumulator, to interpolate rendering
+    double GetAlpha() const { return _accumulator / _step; }
+    unsigned long GetDroppedStepCount() const { return _dropped_steps; }
+  private:
+    typedef std::chrono::steady_clock Clock;
+    double _step;
+    unsigned int _max_steps;
+    double _accumulator;
+    bool _started;
+    Clock::time_point _last;
+    unsigned long _dropped_steps;
+  };
+}
+
+#endif
@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <new>
+#include "FrameArena.h"
+
+using namespace Common;
+
+namespace
+{
+  std::atomic<uint64_t> nextArenaId(1);
+
+  // The calling thread's chunk, for one arena and one frame at a time
+  struct LocalChunk
+  {
+    uint64_t arena;
+    uint64_t frame;
+    uintptr_t cursor;
+    uintptr_t end;
+  };
+
+  thread_local LocalChunk localChunk = { 0, 0, 0, 0 };
+
+  inline uintptr_t alignUp(uintptr_t address, size_t alignment)
+  {
+    return (address + alignment - 1) & ~(uintptr_t)(alignment - 1);
+  }
+}
+
+FrameArena::FrameArena(size_t capacity, unsigned int buffers)
+{
+  _id = nextArenaId++;
+  for (unsigned int i = 0; i < std::max(buffers, 1u); ++i)
+  {
+    Buffer *buffer = new Buffer();
+    buffer->capacity = capacity > 0 ? capacity : DefaultCapacity;
+    buffer->base = new uint8_t[buffer->capacity];
+    buffer->offset = 0;
+    buffer->overflow_bytes = 0;
+    _buffers.push_back(buffer);
+  }
+  _current = _buffers[0];
+  _frame = 0;
+  _high_water = 0;
+  _last_frame_used = 0;
+  _overflows = 0;
+  _total_overflows = 0;
+  _grows = 0;
+}
+
+FrameArena::~FrameArena()
+{
+  for (size_t i = 0; i < _buffers.size(); ++i)
+  {
+    for (size_t j = 0; j < _buffers[i]->overflow.size(); ++j)
+    {
+      ::operator delete(_buffers[i]->overflow[j]);
+    }
+    delete[] _buffers[i]->base;
+    delete _buffers[i];
+  }
+}
+
+void FrameArena::BeginFrame()
+{
+  size_t used = _current->offset + _current->overflow_bytes;
+  _last_frame_used = used;
+  _high_water = std::max(_high_water, used);
+  ++_frame;
+  _current = _buffers[_frame % _buffers.size()];
+  Reset(*_current);
+}
+
+void FrameArena::Reset(Buffer &buffer)
+{
+  for (size_t i = 0; i < buffer.overflow.size(); ++i)
+  {
+    ::operator delete(buffer.overflow[i]);
+  }
+  buffer.overflow.clear();
+  buffer.overflow_bytes = 0;
+  buffer.offset = 0;
+  _overflows = 0;
+  if (buffer.capacity < _high_water)
+  {
+    // An eighth more, sub arena chunks make the next frames vary a little
+    delete[] buffer.base;
+    buffer.capacity = _high_water + _high_water / 8;
+    buffer.base = new uint8_t[buffer.capacity];
+    ++_grows;
+  }
+}
+
+void *FrameArena::Allocate(size_t size, size_t alignment)
+{
+  Buffer &buffer = *_current;
+  uintptr_t base = (uintptr_t)buffer.base;
+  size_t offset = buffer.offset.load(std::memory_order_relaxed);
+  for (;;)
+  {
+    uintptr_t start = alignUp(base + offset, alignment);
+    size_t end = start + size - base;
+    if (end > buffer.capacity)
+    {
+      return Overflow(buffer, size, alignment);
+    }
+    if (buffer.offset.compare_exchange_weak(offset, end, std::memory_order_relaxed))
+    {
+      return (void *)start;
+    }
+  }
+}
+
+void *FrameArena::Overflow(Buffer &buffer, size_t size, size_t alignment)
+{
+  // Only until the buffer's next reset, it grows then
+  void *block = ::operator new(size + alignment);
+  std::lock_guard<std::mutex> lock(_overflow_mutex);
+  buffer.overflow.push_back(block);
+  buffer.overflow_bytes += size + alignment;
+  ++_overflows;
+  ++_total_overflows;
+  return (void *)alignUp((uintptr_t)block, alignment);
+}
+
+void *FrameArena::AllocateLocal(size_t size, size_t alignment)
+{
+  // Large blocks would waste most of a chunk
+  if (size > LocalChunkSize / 4 || alignment > LocalChunkSize / 4)
+  {
+    return Allocate(size, alignment);
+  }
+  LocalChunk &chunk = localChunk;
+  if (chunk.arena == _id && chunk.frame == _frame)
+  {
+    uintptr_t start = alignUp(chunk.cursor, alignment);
+    if (start + size <= chunk.end)
+    {
+      chunk.cursor = start + size;
+      return (void *)start;
+    }
+  }
+  uintptr_t memory = (uintptr_t)Allocate(LocalChunkSize, 64);
+  uintptr_t start = alignUp(memory, alignment);
+  chunk.arena = _id;
+  chunk.frame = _frame;
+  chunk.cursor = start + size;
+  chunk.end = memory + LocalChunkSize;
+  return (void *)start;
+}
+
+FrameArena::Stats FrameArena::GetStats() const
+{
+  std::lock_guard<std::mutex> lock(_overflow_mutex);
+  Stats stats;
+  stats.frame = _frame;
+  stats.capacity = _current->capacity;
+  stats.used = _current->offset + _current->overflow_bytes;
+  stats.high_water = std::max(_high_water, stats.used);
+  stats.last_frame_used = _last_frame_used;
+  stats.overflows = _overflows;
+  stats.total_overflows = _total_overflows;
+  stats.grows = _grows;
+  return stats;
+}
@@ -0,0 +1,123 @@
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace Common
+{
+  // Memory for the temporaries of a frame: draw items, matrices, sort
+  // keys. Allocating bumps an offset in the frame's buffer, freeing does
+  // nothing, BeginFrame() takes the next buffer and forgets what it held.
+  // With several buffers, what a frame allocated stays valid while the
+  // next ones are built, for a consumer running a frame behind.
+  //
+  // Any thread may allocate. Allocate() takes its bytes from the shared
+  // buffer with an atomic; AllocateLocal() bumps in a chunk of the buffer
+  // owned by the calling thread, without touching shared state most of the
+  // time, and is what FrameAllocator uses. A buffer that runs out hands
+  // out heap blocks until its next reset, where it grows to the high water
+  // mark of the frame: steady frames allocate nothing from the heap.
+  class FrameArena
+  {
+  public:
+    static const size_t DefaultCapacity = 256 * 1024;
+    static const unsigned int DefaultBuffers = 2;
+    // Taken from the buffer by a thread's sub arena at a time
+    static const size_t LocalChunkSize = 16 * 1024;
+
+    struct Stats
+    {
+      uint64_t frame;
+      size_t capacity;
+      // Current frame, heap blocks included
+      size_t used;
+      // Highest of the frames so far, and of the last finished frame
+      size_t high_water;
+      size_t last_frame_used;
+      // Heap blocks of the current frame and since the arena was created
+      unsigned long overflows;
+      unsigned long total_overflows;
+      // Buffers grown to the high water mark
+      unsigned long grows;
+    };
+
+    explicit FrameArena(size_t capacity = DefaultCapacity, unsigned int buffers = DefaultBuffers);
+    virtual ~FrameArena();
+    // The thread that owns the frame, while no other allocates
+    void BeginFrame();
+    // Alignment is a power of two. Never NULL, valid until BeginFrame is
+    // called as many times as there are buffers
+    void *Allocate(size_t size, size_t alignment = sizeof(void *) * 2);
+    void *AllocateLocal(size_t size, size_t alignment = sizeof(void *) * 2);
+    template <typename T>
+    T *AllocateArray(size_t count)
+    {
+      return static_cast<T *>(AllocateLocal(count * sizeof(T), alignof(T)));
+    }
+
+    uint64_t GetFrame() const { return _frame; }
+    Stats GetStats() const;
+  private:
+    struct Buffer
+    {
+      uint8_t *base;
+      size_t capacity;
+      std::atomic<size_t> offset;
+      // Heap blocks once the buffer is full and their bytes
+      std::vector<void *> overflow;
+      size_t overflow_bytes;
+    };
+    FrameArena(const FrameArena &);
+    FrameArena &operator=(const FrameArena &);
+    void *Overflow(Buffer &buffer, size_t size, size_t alignment);
+    void Reset(Buffer &buffer);
+
+    // Unique over the process, a thread's sub arena is matched on it rather than on the address
+    uint64_t _id;
+    std::vector<Buffer *> _buffers;
+    Buffer *_current;
+    uint64_t _frame;
+    mutable std::mutex _overflow_mutex;
+    size_t _high_water;
+    size_t _last_frame_used;
+    unsigned long _overflows;
+    unsigned long _total_overflows;
+    unsigned long _grows;
+  };
+
+  // STL allocator taking from the calling thread's sub arena, deallocate
+  // does nothing. A vector that grows leaves its old storage behind until
+  // the frame is over: reserve what is known.
+  template <typename T>
+  class FrameAllocator
+  {
+  public:
+    typedef T value_type;
+    template <typename U> struct rebind { typedef FrameAllocator<U> other; };
+
+    explicit FrameAllocator(FrameArena *arena) : _arena(arena) {}
+    template <typename U>
+    FrameAllocator(const FrameAllocator<U> &other) : _arena(other.GetArena()) {}
+
+    T *allocate(size_t count) { return _arena->AllocateArray<T>(count); }
+    void deallocate(T *, size_t) {}
+    FrameArena *GetArena() const { return _arena; }
+  private:
+    FrameArena *_arena;
+  };
+
+  template <typename T, typename U>
+  bool operator==(const FrameAllocator<T> &a, const FrameAllocator<U> &b) { return a.GetArena() == b.GetArena(); }
+  template <typename T, typename U>
+  bool operator!=(const FrameAllocator<T> &a, const FrameAllocator<U> &b) { return a.GetArena() != b.GetArena(); }
+
+  // A vector of the frame, FrameVector<DrawItem> items(FrameAllocator<DrawItem>(arena))
+  template <typename T>
+  using FrameVector = std::vector<T, FrameAllocator<T> >;
+}
+
+#endif
@@ -0,0 +1,58 @@
+#include <thread>
+#include "FramePacer.h"
+
+using namespace Common;
+
+FramePacer::FramePacer()
+{
+  _rate = 0.0;
+  _period = Clock::duration::zero();
+  _started = false;
+  _frames = 0;
+  _missed = 0;
+  _slept_milliseconds = 0.0;
+}
+
+void FramePacer::SetTargetRate(double rate)
+{
+  _rate = rate > 0.0 ? rate : 0.0;
+  _period = _rate > 0.0
+    ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / _rate))
+    : Clock::duration::zero();
+  Reset();
+}
+
+void FramePacer::Reset()
+{
+  _started = false;
+}
+
+void FramePacer::Wait()
+{
+  ++_frames;
+  if (_period == Clock::duration::zero())
+  {
+    return;
+  }
+  Clock::time_point now = Clock::now();
+  if (!_started)
+  {
+    _started = true;
+    _deadline = now + _period;
+    return;
+  }
+  if (now > _deadline)
+  {
+    ++_missed;
+    if (now - _deadline > _period)
+    {
+      _deadline = now;
+    }
+  }
+  else
+  {
+    std::this_thread::sleep_until(_deadline);
+    _slept_milliseconds += std::chrono::duration<double, std::milli>(Clock::now() - now).count();
+  }
+  _deadline += _period;
+}
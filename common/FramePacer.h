@@ -0,0 +1,41 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <chrono>
+
+namespace Common
+{
+  // Caps the frame rate by sleeping until the start of the next frame.
+  // Deadlines are whole periods from the first frame rather than a period
+  // after the last wakeup, so sleep overshoot does not accumulate into a
+  // lower rate. A frame that starts after its deadline is a missed
+  // deadline; more than a period late, the schedule restarts from now
+  // instead of rushing the following frames to catch up.
+  class FramePacer
+  {
+  public:
+    FramePacer();
+    // Frames per second, 0 disables pacing
+    void SetTargetRate(double rate);
+    double GetTargetRate() const { return _rate; }
+    // Restarts the schedule, after a pause for instance
+    void Reset();
+    // Called once per frame, before rendering it
+    void Wait();
+
+    unsigned long GetFrameCount() const { return _frames; }
+    unsigned long GetMissedCount() const { return _missed; }
+    double GetSleptMilliseconds() const { return _slept_milliseconds; }
+  private:
+    typedef std::chrono::steady_clock Clock;
+    double _rate;
+    Clock::duration _period;
+    Clock::time_point _deadline;
+    bool _started;
+    unsigned long _frames;
+    unsigned long _missed;
+    double _slept_milliseconds;
+  };
+}
+
+#endif
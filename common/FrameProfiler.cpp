@@ -0,0 +1,393 @@
+#include <string.h>
+#include <fstream>
+#include "FrameProfiler.h"
+#include "Extensions.h"
+
+using namespace Common;
+
+namespace
+{
+  TimerQueries timerQueries = { NULL, NULL, NULL, NULL, NULL, NULL };
+
+  const unsigned int Untracked = FrameProfiler::MaxMarkers;
+
+  void writeEvent(std::ostream &output, bool &first, const char *name, int thread, double begin, double end, uint64_t frame)
+  {
+    output<<(first ? "\n" : ",\n")<<"{\"name\": \"";
+    for (const char *c = name; *c != '\0'; ++c)
+    {
+      if (*c == '"' || *c == '\\')
+      {
+        output<<'\\';
+      }
+      output<<*c;
+    }
+    output<<"\", \"ph\": \"X\", \"pid\": 1, \"tid\": "<<thread
+          <<", \"ts\": "<<begin<<", \"dur\": "<<(end > begin ? end - begin : 0.0)
+          <<", \"args\": {\"frame\": "<<frame<<"}}";
+    first = false;
+  }
+}
+
+FrameProfiler::FrameProfiler(unsigned int capacity)
+  : _enabled(false)
+  , _published(0)
+{
+  _active = false;
+  _gl_initialized = false;
+  _gpu_timing = Untimed;
+  _disjoint_checked = false;
+  _disjoint_query = false;
+  _disjoint_count = 0;
+  for (unsigned int i = 0; i < FramesInFlight; ++i)
+  {
+    _pending[i].waiting = false;
+  }
+  _frame_index = 0;
+  _depth = 0;
+  _overflow = 0;
+  _dropped_markers = 0;
+  _capacity = capacity > 0 ? capacity : 1;
+  _slots = new Slot[_capacity];
+  for (unsigned int i = 0; i < _capacity; ++i)
+  {
+    _slots[i].sequence.store(0);
+  }
+  _origin = std::chrono::steady_clock::now();
+}
+
+FrameProfiler::~FrameProfiler()
+{
+  delete[] _slots;
+}
+
+double FrameProfiler::Now() const
+{
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - _origin).count();
+}
+
+void FrameProfiler::InitializeGl()
+{
+  _gl_initialized = true;
+  _gpu_timing = Finish;
+  timerQueries = LoadTimerQueries();
+  if (!timerQueries.IsLoaded())
+  {
+    return;
+  }
+  // Nested markers need timestamps, some implementations only have elapsed time queries
+  GLint bits = 0;
+  timerQueries.getQueryiv(GL_TIMESTAMP_EXT, GL_QUERY_COUNTER_BITS_EXT, &bits);
+  if (bits <= 0)
+  {
+    return;
+  }
+  for (unsigned int i = 0; i < FramesInFlight; ++i)
+  {
+    timerQueries.genQueries(MaxMarkers * 2, _pending[i].queries);
+  }
+  _gpu_timing = TimerQuery;
+}
+
+void FrameProfiler::Reset()
+{
+  for (unsigned int i = 0; i < FramesInFlight; ++i)
+  {
+    _pending[i].waiting = false;
+  }
+  _gl_initialized = false;
+  _gpu_timing = Untimed;
+  _disjoint_checked = false;
+  _active = false;
+  _depth = 0;
+  _overflow = 0;
+}
+
+void FrameProfiler::ReleaseGl()
+{
+  if (!_gl_initialized)
+  {
+    return;
+  }
+  // Frames resolved here have seen no BeginFrame since they ended
+  PollDisjoint();
+  // Oldest first, so that the ring stays in frame order
+  for (unsigned int i = 1; i <= FramesInFlight; ++i)
+  {
+    Pending &pending = _pending[(_frame_index + i) % FramesInFlight];
+    if (pending.waiting)
+    {
+      // The context is going, waiting for the GPU is fine now
+      Resolve(pending, true);
+    }
+  }
+  if (_gpu_timing == TimerQuery)
+  {
+    for (unsigned int i = 0; i < FramesInFlight; ++i)
+    {
+      timerQueries.deleteQueries(MaxMarkers * 2, _pending[i].queries);
+    }
+  }
+  Reset();
+}
+
+void FrameProfiler::PollDisjoint()
+{
+  if (!_disjoint_checked)
+  {
+    _disjoint_query = HasGlExtension("GL_EXT_disjoint_timer_query");
+    _disjoint_checked = true;
+  }
+  if (!_disjoint_query)
+  {
+    return;
+  }
+  // A disjoint operation (power state change...) since the last read
+  GLint disjoint = GL_FALSE;
+  glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+  if (disjoint != GL_FALSE)
+  {
+    ++_disjoint_count;
+  }
+}
+
+void FrameProfiler::BeginFrame()
+{
+  // The post process chain's timestamps depend on it, profiling or not
+  PollDisjoint();
+  _active = _enabled.load(std::memory_order_relaxed);
+  if (!_active)
+  {
+    return;
+  }
+  if (!_gl_initialized)
+  {
+    InitializeGl();
+  }
+  ++_frame_index;
+  Pending &pending = _pending[_frame_index % FramesInFlight];
+  if (pending.waiting)
+  {
+    // Submitted FramesInFlight frames ago, published without GPU times when
+    // a driver queuing more frames has not run it yet
+    Resolve(pending, false);
+  }
+  pending.frame.index = _frame_index;
+  pending.disjoint_count = _disjoint_count;
+  pending.frame.gpu_valid = _gpu_timing != Untimed;
+  pending.frame.marker_count = 0;
+  _depth = 0;
+  _overflow = 0;
+  BeginMarker("Frame");
+}
+
+void FrameProfiler::EndFrame()
+{
+  if (!_active)
+  {
+    return;
+  }
+  // Markers left open are closed with the frame
+  _overflow = 0;
+  while (_depth > 0)
+  {
+    EndMarker();
+  }
+  Pending &pending = _pending[_frame_index % FramesInFlight];
+  if (_gpu_timing == TimerQuery)
+  {
+    pending.waiting = true;
+  }
+  else
+  {
+    Publish(pending.frame);
+  }
+  _active = false;
+}
+
+void FrameProfiler::BeginMarker(const char *name)
+{
+  if (!_active)
+  {
+    return;
+  }
+  if (_depth >= MaxMarkers)
+  {
+    // Past the stack, counted so that their EndMarker calls close nothing
+    ++_dropped_markers;
+    ++_overflow;
+    return;
+  }
+  Frame &frame = _pending[_frame_index % FramesInFlight].frame;
+  if (frame.marker_count >= MaxMarkers)
+  {
+    ++_dropped_markers;
+    _stack[_depth++] = Untracked;
+    return;
+  }
+  unsigned int index = frame.marker_count++;
+  Marker &marker = frame.markers[index];
+  strncpy(marker.name, name, MaxNameLength - 1);
+  marker.name[MaxNameLength - 1] = '\0';
+  marker.depth = _depth;
+  if (_gpu_timing == Finish)
+  {
+    // Work submitted before the marker is not charged to it
+    glFinish();
+  }
+  marker.cpu_begin = Now();
+  marker.gpu_begin = marker.cpu_begin;
+  if (_gpu_timing == TimerQuery)
+  {
+    timerQueries.queryCounter(_pending[_frame_index % FramesInFlight].queries[index * 2], GL_TIMESTAMP_EXT);
+  }
+  _stack[_depth++] = index;
+}
+
+void FrameProfiler::EndMarker()
+{
+  if (!_active || _depth == 0)
+  {
+    return;
+  }
+  if (_overflow > 0)
+  {
+    --_overflow;
+    return;
+  }
+  unsigned int index = _stack[--_depth];
+  if (index == Untracked)
+  {
+    return;
+  }
+  Pending &pending = _pending[_frame_index % FramesInFlight];
+  Marker &marker = pending.frame.markers[index];
+  marker.cpu_end = Now();
+  if (_gpu_timing == TimerQuery)
+  {
+    timerQueries.queryCounter(pending.queries[index * 2 + 1], GL_TIMESTAMP_EXT);
+  }
+  else if (_gpu_timing == Finish)
+  {
+    glFinish();
+  }
+  marker.gpu_end = Now();
+}
+
+void FrameProfiler::Resolve(Pending &pending, bool wait)
+{
+  pending.waiting = false;
+  Frame &frame = pending.frame;
+  // Timestamps of a frame that saw a disjoint operation are meaningless
+  frame.gpu_valid = pending.disjoint_count == _disjoint_count && frame.marker_count > 0;
+  if (frame.gpu_valid && !wait)
+  {
+    // The end of the "Frame" marker is the last timestamp of the frame,
+    // timestamps complete in order
+    GLuint available = 0;
+    timerQueries.getQueryObjectuiv(pending.queries[1], GL_QUERY_RESULT_AVAILABLE_EXT, &available);
+    frame.gpu_valid = available != 0;
+  }
+  if (frame.gpu_valid)
+  {
+    GLuint64 origin = 0;
+    for (unsigned int i = 0; i < frame.marker_count; ++i)
+    {
+      GLuint64 begin = 0;
+      GLuint64 end = 0;
+      timerQueries.getQueryObjectui64v(pending.queries[i * 2], GL_QUERY_RESULT_EXT, &begin);
+      timerQueries.getQueryObjectui64v(pending.queries[i * 2 + 1], GL_QUERY_RESULT_EXT, &end);
+      if (i == 0)
+      {
+        origin = begin;
+      }
+      // Nanoseconds on the GPU clock, aligned on the CPU start of the frame
+      Marker &marker = frame.markers[i];
+      marker.gpu_begin = frame.markers[0].cpu_begin + (double)(int64_t)(begin - origin) / 1000.0;
+      marker.gpu_end = frame.markers[0].cpu_begin + (double)(int64_t)(end - origin) / 1000.0;
+    }
+  }
+  Publish(frame);
+}
+
+void FrameProfiler::Publish(const Frame &frame)
+{
+  uint64_t published = _published.load(std::memory_order_relaxed);
+  Slot &slot = _slots[published % _capacity];
+  uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+  slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  memcpy(&slot.frame, &frame, sizeof(Frame));
+  slot.sequence.store(sequence + 2, std::memory_order_release);
+  _published.store(published + 1, std::memory_order_release);
+}
+
+std::vector<FrameProfiler::Frame> FrameProfiler::GetFrames() const
+{
+  std::vector<Frame> frames;
+  uint64_t published = _published.load(std::memory_order_acquire);
+  uint64_t first = published > _capacity ? published - _capacity : 0;
+  frames.reserve((size_t)(published - first));
+  Frame copy;
+  for (uint64_t i = first; i < published; ++i)
+  {
+    const Slot &slot = _slots[i % _capacity];
+    // Seqlock read: retry while the writer is in the slot, a slot reused by
+    // a newer frame meanwhile only means the oldest frames are skipped
+    for (;;)
+    {
+      uint32_t before = slot.sequence.load(std::memory_order_acquire);
+      if (before & 1)
+      {
+        continue;
+      }
+      memcpy(&copy, &slot.frame, sizeof(Frame));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.sequence.load(std::memory_order_relaxed) == before)
+      {
+        break;
+      }
+    }
+    if (copy.index > (frames.empty() ? 0 : frames.back().index))
+    {
+      frames.push_back(copy);
+    }
+  }
+  return frames;
+}
+
+void FrameProfiler::WriteChromeTrace(std::ostream &output) const
+{
+  std::vector<Frame> frames = GetFrames();
+  bool first = true;
+  output<<"{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+  output<<"\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1, \"args\": {\"name\": \"CPU\"}}";
+  output<<",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 2, \"args\": {\"name\": \""
+        <<(GetGpuTiming() == Finish ? "GPU (glFinish)" : "GPU")<<"\"}}";
+  first = false;
+  for (size_t i = 0; i < frames.size(); ++i)
+  {
+    const Frame &frame = frames[i];
+    for (unsigned int m = 0; m < frame.marker_count; ++m)
+    {
+      const Marker &marker = frame.markers[m];
+      writeEvent(output, first, marker.name, 1, marker.cpu_begin, marker.cpu_end, frame.index);
+      if (frame.gpu_valid)
+      {
+        writeEvent(output, first, marker.name, 2, marker.gpu_begin, marker.gpu_end, frame.index);
+      }
+    }
+  }
+  output<<"\n]}"<<std::endl;
+}
+
+bool FrameProfiler::WriteChromeTrace(const std::string &path) const
+{
+  std::ofstream file(path.c_str());
+  if (!file)
+  {
+    return false;
+  }
+  WriteChromeTrace(file);
+  return file.good();
+}
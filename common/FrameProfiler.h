@@ -0,0 +1,137 @@
+#ifndef FRAME_PROFILER_H
+#define FRAME_PROFILER_H
+
+#include <GLES2/gl2.h>
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace Common
+{
+  // CPU and GPU time of nested markers placed in a frame. GPU time comes
+  // from GL_EXT_disjoint_timer_query timestamps, read back FramesInFlight
+  // frames later so that the readback never waits for the GPU (a frame
+  // the GPU has not run by then is published without GPU times); without
+  // the extension every marker is bracketed by glFinish, which serialises
+  // the pipeline but still tells where the time goes. Finished frames are
+  // published to a ring of the last N frames that any thread can copy
+  // without taking a lock, for instance to dump it as a Chrome trace
+  // (chrome://tracing or ui.perfetto.dev) while the render thread runs.
+  class FrameProfiler
+  {
+  public:
+    static const unsigned int MaxMarkers = 32;
+    static const unsigned int MaxNameLength = 32;
+    static const unsigned int FramesInFlight = 3;
+    enum GpuTiming { Untimed, TimerQuery, Finish };
+
+    struct Marker
+    {
+      char name[MaxNameLength];
+      unsigned int depth;
+      // Microseconds since the profiler was created, GPU times are moved
+      // onto the CPU clock by aligning the frame's first marker
+      double cpu_begin;
+      double cpu_end;
+      double gpu_begin;
+      double gpu_end;
+    };
+
+    struct Frame
+    {
+      uint64_t index;
+      // False when the driver reported a disjoint operation or timing is off
+      bool gpu_valid;
+      unsigned int marker_count;
+      Marker markers[MaxMarkers];
+    };
+
+    // Places a marker for the lifetime of the scope
+    class Scope
+    {
+    public:
+      Scope(FrameProfiler *profiler, const char *name) : _profiler(profiler) { _profiler->BeginMarker(name); }
+      ~Scope() { _profiler->EndMarker(); }
+    private:
+      FrameProfiler *_profiler;
+    };
+
+    explicit FrameProfiler(unsigned int capacity = 120);
+    virtual ~FrameProfiler();
+    // Takes effect at the next BeginFrame, a disabled profiler costs a branch per marker
+    void SetEnabled(bool enabled) { _enabled.store(enabled); }
+    bool IsEnabled() const { return _enabled.load(); }
+    // Forgets the queries without deleting them, for a lost context
+    void Reset();
+    // Waits for the frames still in flight, publishes them and deletes the queries
+    void ReleaseGl();
+
+    // BeginFrame also opens a "Frame" marker that EndFrame closes
+    void BeginFrame();
+    void EndFrame();
+    void BeginMarker(const char *name);
+    void EndMarker();
+
+    // GL thread. Frames whose BeginFrame found GL_GPU_DISJOINT_EXT set.
+    // Reading the flag clears it, so the profiler alone reads it, once in
+    // every BeginFrame, enabled or not. GPU timestamps taken while this
+    // count changed are meaningless
+    uint64_t GetDisjointCount() const { return _disjoint_count; }
+
+    // Any thread
+    GpuTiming GetGpuTiming() const { return _gpu_timing.load(); }
+    unsigned long GetDroppedMarkerCount() const { return _dropped_markers.load(); }
+    // Copies the published frames, oldest first, from any thread
+    std::vector<Frame> GetFrames() const;
+    void WriteChromeTrace(std::ostream &output) const;
+    bool WriteChromeTrace(const std::string &path) const;
+  private:
+    struct Pending
+    {
+      Frame frame;
+      GLuint queries[MaxMarkers * 2];
+      bool waiting;
+      // GetDisjointCount() when the frame began
+      uint64_t disjoint_count;
+    };
+    struct Slot
+    {
+      // Odd while the frame is being written
+      std::atomic<uint32_t> sequence;
+      Frame frame;
+    };
+    void InitializeGl();
+    // Reads GL_GPU_DISJOINT_EXT when the context has it
+    void PollDisjoint();
+    double Now() const;
+    // Without wait, a frame whose queries are not available yet loses its GPU times
+    void Resolve(Pending &pending, bool wait);
+    void Publish(const Frame &frame);
+    std::atomic<bool> _enabled;
+    bool _active;
+    bool _gl_initialized;
+    // Set on the GL thread, read by the threads that dump the trace
+    std::atomic<GpuTiming> _gpu_timing;
+    // Whether the current context has GL_EXT_disjoint_timer_query, looked up once
+    bool _disjoint_checked;
+    bool _disjoint_query;
+    uint64_t _disjoint_count;
+    Pending _pending[FramesInFlight];
+    uint64_t _frame_index;
+    unsigned int _stack[MaxMarkers];
+    unsigned int _depth;
+    // Markers opened beyond MaxMarkers levels, not on the stack
+    unsigned int _overflow;
+    // Counted on the GL thread, read from any thread
+    std::atomic<unsigned long> _dropped_markers;
+    Slot *_slots;
+    unsigned int _capacity;
+    std::atomic<uint64_t> _published;
+    std::chrono::steady_clock::time_point _origin;
+  };
+}
+
+#endif
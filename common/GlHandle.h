@@ -0,0 +1,70 @@
+#ifndef GL_HANDLE_H
+#define GL_HANDLE_H
+
+#include <GLES2/gl2.h>
+#include <stdint.h>
+#include "Context.h"
+#include "GlResourceRegistry.h"
+
+namespace Common
+{
+  // Owns one GL object registered with the context's GlResourceRegistry.
+  // Reset, or the destructor, hands it to the registry, which deletes it
+  // once the GPU is done with it; a handle is 0 until Create. Handles are
+  // not copyable. One left set when the context is released is counted
+  // as a leak, renderers reset theirs in ReleaseGl. A name from before a
+  // registry Reset (a lost context) is dropped, the new context may have
+  // handed it out again.
+  template <GlResourceRegistry::Kind K>
+  class GlHandle
+  {
+  public:
+    GlHandle() : _name(0), _registry(NULL), _generation(0) {}
+    ~GlHandle() { Reset(); }
+
+    // Releases the previous object, shader_type for shaders
+    GLuint Create(const char *owner, GLenum shader_type = 0)
+    {
+      Reset();
+      _registry = Context::Instance()->GetGlResourceRegistry();
+      _generation = _registry->GetGeneration();
+      _name = _registry->Create(K, owner, shader_type);
+      return _name;
+    }
+    // Memory estimate reported to the registry
+    void SetBytes(uint64_t bytes)
+    {
+      if (_name != 0 && _generation == _registry->GetGeneration())
+      {
+        _registry->SetBytes(K, _name, bytes);
+      }
+    }
+    void Reset()
+    {
+      if (_name != 0)
+      {
+        if (_generation == _registry->GetGeneration())
+        {
+          _registry->Release(K, _name);
+        }
+        _name = 0;
+      }
+    }
+    GLuint Get() const { return _name; }
+  private:
+    GlHandle(const GlHandle &);
+    GlHandle &operator=(const GlHandle &);
+    GLuint _name;
+    GlResourceRegistry *_registry;
+    unsigned long _generation;
+  };
+
+  typedef GlHandle<GlResourceRegistry::Buffer> GlBuffer;
+  typedef GlHandle<GlResourceRegistry::Program> GlProgram;
+  typedef GlHandle<GlResourceRegistry::Shader> GlShader;
+  typedef GlHandle<GlResourceRegistry::Texture> GlTexture;
+  typedef GlHandle<GlResourceRegistry::Framebuffer> GlFramebuffer;
+  typedef GlHandle<GlResourceRegistry::Renderbuffer> GlRenderbuffer;
+}
+
+#endif
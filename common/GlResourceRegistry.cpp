@@ -0,0 +1,342 @@
+#include <chrono>
+#include "Extensions.h"
+#include "GlResourceRegistry.h"
+#include "GlStateCache.h"
+
+using namespace Common;
+
+namespace
+{
+  typedef std::chrono::steady_clock Clock;
+
+  void resetOwner(GlResourceRegistry::OwnerStats &owner)
+  {
+    for (int kind = 0; kind < GlResourceRegistry::KindCount; ++kind)
+    {
+      owner.live[kind] = 0;
+    }
+    owner.bytes = 0;
+  }
+}
+
+GlResourceRegistry::GlResourceRegistry(GlStateCache *state)
+{
+  _state = state;
+  _display = EGL_NO_DISPLAY;
+  _fence_sync = false;
+  _create_sync = NULL;
+  _destroy_sync = NULL;
+  _client_wait_sync = NULL;
+  _frame = 0;
+  _generation = 0;
+  _budget_milliseconds = 2.0;
+  _stats.live = 0;
+  _stats.bytes = 0;
+  _stats.pending = 0;
+  ResetStats();
+}
+
+GlResourceRegistry::~GlResourceRegistry()
+{
+  DestroyFences();
+}
+
+void GlResourceRegistry::InitializeGl()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  _display = eglGetCurrentDisplay();
+  // The fence goes into the GL command stream only with GL_OES_EGL_sync
+  _fence_sync = _display != EGL_NO_DISPLAY
+    && HasExtension(eglQueryString(_display, EGL_EXTENSIONS), "EGL_KHR_fence_sync")
+    && HasGlExtension("GL_OES_EGL_sync");
+  if (_fence_sync)
+  {
+    _create_sync = (PFNEGLCREATESYNCKHRPROC)eglGetProcAddress("eglCreateSyncKHR");
+    _destroy_sync = (PFNEGLDESTROYSYNCKHRPROC)eglGetProcAddress("eglDestroySyncKHR");
+    _client_wait_sync = (PFNEGLCLIENTWAITSYNCKHRPROC)eglGetProcAddress("eglClientWaitSyncKHR");
+    _fence_sync = _create_sync != NULL && _destroy_sync != NULL && _client_wait_sync != NULL;
+  }
+}
+
+void GlResourceRegistry::Reset()
+{
+  DestroyFences();
+  std::lock_guard<std::mutex> lock(_mutex);
+  for (int kind = 0; kind < KindCount; ++kind)
+  {
+    _objects[kind].clear();
+  }
+  for (size_t i = 0; i < _owners.size(); ++i)
+  {
+    resetOwner(_owners[i]);
+  }
+  _released.clear();
+  _batches.clear();
+  _deletable.clear();
+  ++_generation;
+  _stats.live = 0;
+  _stats.bytes = 0;
+  _stats.pending = 0;
+}
+
+void GlResourceRegistry::DestroyFences()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  for (size_t i = 0; i < _batches.size(); ++i)
+  {
+    if (_batches[i].fence != EGL_NO_SYNC_KHR)
+    {
+      _destroy_sync(_display, _batches[i].fence);
+      _batches[i].fence = EGL_NO_SYNC_KHR;
+    }
+  }
+}
+
+void GlResourceRegistry::Flush()
+{
+  std::vector<Pending> objects;
+  DestroyFences();
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (size_t i = 0; i < _batches.size(); ++i)
+    {
+      objects.insert(objects.end(), _batches[i].objects.begin(), _batches[i].objects.end());
+    }
+    objects.insert(objects.end(), _released.begin(), _released.end());
+    objects.insert(objects.end(), _deletable.begin(), _deletable.end());
+    _batches.clear();
+    _released.clear();
+    _deletable.clear();
+  }
+  Delete(objects);
+}
+
+size_t GlResourceRegistry::FindOwner(const char *owner)
+{
+  for (size_t i = 0; i < _owners.size(); ++i)
+  {
+    if (_owners[i].owner == owner)
+    {
+      return i;
+    }
+  }
+  OwnerStats stats;
+  stats.owner = owner;
+  resetOwner(stats);
+  stats.created = 0;
+  stats.released = 0;
+  _owners.push_back(stats);
+  return _owners.size() - 1;
+}
+
+GLuint GlResourceRegistry::Create(Kind kind, const char *owner, GLenum shader_type)
+{
+  GLuint name = 0;
+  switch (kind)
+  {
+  case Buffer: glGenBuffers(1, &name); break;
+  case Program: name = glCreateProgram(); break;
+  case Shader: name = glCreateShader(shader_type); break;
+  case Texture: glGenTextures(1, &name); break;
+  case Framebuffer: glGenFramebuffers(1, &name); break;
+  case Renderbuffer: glGenRenderbuffers(1, &name); break;
+  default: break;
+  }
+  if (name == 0)
+  {
+    return 0;
+  }
+  std::lock_guard<std::mutex> lock(_mutex);
+  Object &object = _objects[kind][name];
+  object.owner = FindOwner(owner);
+  object.bytes = 0;
+  ++_owners[object.owner].live[kind];
+  ++_owners[object.owner].created;
+  ++_stats.live;
+  return name;
+}
+
+void GlResourceRegistry::SetBytes(Kind kind, GLuint name, uint64_t bytes)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  std::map<GLuint, Object>::iterator found = _objects[kind].find(name);
+  if (found == _objects[kind].end())
+  {
+    return;
+  }
+  OwnerStats &owner = _owners[found->second.owner];
+  owner.bytes = owner.bytes - found->second.bytes + bytes;
+  _stats.bytes = _stats.bytes - found->second.bytes + bytes;
+  found->second.bytes = bytes;
+}
+
+void GlResourceRegistry::Release(Kind kind, GLuint name)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  std::map<GLuint, Object>::iterator found = _objects[kind].find(name);
+  if (found == _objects[kind].end())
+  {
+    return;
+  }
+  // Not live anymore; GL does not hand the name out again before it is deleted
+  OwnerStats &owner = _owners[found->second.owner];
+  --owner.live[kind];
+  owner.bytes -= found->second.bytes;
+  ++owner.released;
+  --_stats.live;
+  _stats.bytes -= found->second.bytes;
+  ++_stats.pending;
+  _objects[kind].erase(found);
+  Pending pending;
+  pending.kind = kind;
+  pending.name = name;
+  _released.push_back(pending);
+}
+
+bool GlResourceRegistry::IsDone(const Batch &batch) const
+{
+  if (batch.fence != EGL_NO_SYNC_KHR)
+  {
+    // Polled, never waited for
+    return _client_wait_sync(_display, batch.fence, 0, 0) == EGL_CONDITION_SATISFIED_KHR;
+  }
+  return _frame - batch.frame >= FramesInFlight;
+}
+
+void GlResourceRegistry::EndFrame()
+{
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    // Batches complete in order, the first one not done holds back the others
+    while (!_batches.empty() && IsDone(_batches.front()))
+    {
+      Batch &batch = _batches.front();
+      if (batch.fence != EGL_NO_SYNC_KHR)
+      {
+        _destroy_sync(_display, batch.fence);
+      }
+      _deletable.insert(_deletable.end(), batch.objects.begin(), batch.objects.end());
+      _batches.pop_front();
+    }
+    if (!_released.empty())
+    {
+      Batch batch;
+      batch.objects.swap(_released);
+      batch.frame = _frame;
+      batch.fence = _fence_sync ? _create_sync(_display, EGL_SYNC_FENCE_KHR, NULL) : EGL_NO_SYNC_KHR;
+      ++_stats.batches;
+      if (batch.fence != EGL_NO_SYNC_KHR)
+      {
+        ++_stats.fenced;
+      }
+      _batches.push_back(batch);
+    }
+    ++_frame;
+  }
+  // The frame is submitted first, or a driver that finds an object in the
+  // commands not sent yet runs them before deleting. That is the frame's
+  // own cost, the swap would pay it, it is not counted as deleting
+  if (!_deletable.empty())
+  {
+    glFlush();
+  }
+  Clock::time_point start = Clock::now();
+  // Oldest first, what the budget leaves waits for the next frame
+  size_t deleted = 0;
+  while (true)
+  {
+    Pending object;
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if (_deletable.empty())
+      {
+        break;
+      }
+      if (deleted > 0 && _budget_milliseconds > 0.0
+          && std::chrono::duration<double, std::milli>(Clock::now() - start).count() >= _budget_milliseconds)
+      {
+        ++_stats.over_budget;
+        break;
+      }
+      object = _deletable.front();
+      _deletable.pop_front();
+    }
+    Delete(object);
+    ++deleted;
+  }
+  if (deleted == 0)
+  {
+    return;
+  }
+  double milliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  std::lock_guard<std::mutex> lock(_mutex);
+  _stats.pending -= deleted;
+  _stats.deleted += deleted;
+  _stats.delete_milliseconds += milliseconds;
+  if (milliseconds > _stats.max_delete_milliseconds)
+  {
+    _stats.max_delete_milliseconds = milliseconds;
+  }
+}
+
+void GlResourceRegistry::Delete(const Pending &object)
+{
+  GLuint name = object.name;
+  switch (object.kind)
+  {
+  // Through the state cache, which forgets the bindings of the name
+  case Buffer: _state->DeleteBuffers(1, &name); break;
+  case Program: _state->DeleteProgram(name); break;
+  case Shader: glDeleteShader(name); break;
+  case Texture: glDeleteTextures(1, &name); break;
+  case Framebuffer: glDeleteFramebuffers(1, &name); break;
+  case Renderbuffer: glDeleteRenderbuffers(1, &name); break;
+  default: break;
+  }
+}
+
+void GlResourceRegistry::Delete(const std::vector<Pending> &objects)
+{
+  for (size_t i = 0; i < objects.size(); ++i)
+  {
+    Delete(objects[i]);
+  }
+  std::lock_guard<std::mutex> lock(_mutex);
+  _stats.pending -= objects.size();
+  _stats.deleted += objects.size();
+}
+
+unsigned long GlResourceRegistry::GetGeneration() const
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _generation;
+}
+
+GlResourceRegistry::Stats GlResourceRegistry::GetStats() const
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _stats;
+}
+
+std::vector<GlResourceRegistry::OwnerStats> GlResourceRegistry::GetOwnerStats() const
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _owners;
+}
+
+void GlResourceRegistry::ResetStats()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  // Live objects and pending deletions are state, not counters
+  _stats.deleted = 0;
+  _stats.batches = 0;
+  _stats.fenced = 0;
+  _stats.delete_milliseconds = 0.0;
+  _stats.max_delete_milliseconds = 0.0;
+  _stats.over_budget = 0;
+  for (size_t i = 0; i < _owners.size(); ++i)
+  {
+    _owners[i].created = 0;
+    _owners[i].released = 0;
+  }
+}
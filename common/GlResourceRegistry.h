@@ -0,0 +1,134 @@
+#ifndef GL_RESOURCE_REGISTRY_H
+#define GL_RESOURCE_REGISTRY_H
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES2/gl2.h>
+#include <stdint.h>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Common
+{
+  class GlStateCache;
+
+  // Every GL object the renderers and subsystems create, counted per owner
+  // (the renderer or subsystem name) with an estimate of its memory, so a
+  // long session can show it does not leak. Released objects are not
+  // deleted at once: the frame may still be drawing with them. They are
+  // batched per frame and a batch is deleted at the end of a later frame,
+  // once the EGL_KHR_fence_sync fence inserted after it has signaled, or
+  // FramesInFlight frames later without fences; the fence is polled, a
+  // frame never waits for it. The frame is flushed before deleting, and
+  // each frame deletes within a time budget, leaving the rest for the
+  // next. Objects are usually held by GlHandle.
+  class GlResourceRegistry
+  {
+  public:
+    enum Kind { Buffer, Program, Shader, Texture, Framebuffer, Renderbuffer, KindCount };
+    // Frames a released object is kept for without fences
+    static const unsigned int FramesInFlight = 3;
+
+    struct OwnerStats
+    {
+      std::string owner;
+      unsigned long live[KindCount];
+      uint64_t bytes;
+      unsigned long created;
+      unsigned long released;
+    };
+
+    struct Stats
+    {
+      unsigned long live;
+      uint64_t bytes;
+      // Released, waiting for the GPU to be done with them
+      unsigned long pending;
+      unsigned long deleted;
+      // Frames that released objects, and how many of them got a fence
+      unsigned long batches;
+      unsigned long fenced;
+      // Time spent deleting at the end of frames
+      double delete_milliseconds;
+      double max_delete_milliseconds;
+      // Frames that left objects the GPU was done with for the next one
+      unsigned long over_budget;
+    };
+
+    explicit GlResourceRegistry(GlStateCache *state);
+    // Objects are left to the context
+    virtual ~GlResourceRegistry();
+    // Looks up the fence functions for the current display and context
+    void InitializeGl();
+    // Forgets every object and pending deletion without deleting them, for a lost context
+    void Reset();
+    // Deletes everything released, the context is about to go or idle
+    void Flush();
+    // Per EndFrame call, at least one object is deleted; 0 for no limit
+    void SetDeleteBudget(double milliseconds) { _budget_milliseconds = milliseconds; }
+
+    // The GL thread. Creates an object accounted to owner, shader_type for shaders
+    GLuint Create(Kind kind, const char *owner, GLenum shader_type = 0);
+    // Memory estimate of an object, replaces the previous one
+    void SetBytes(Kind kind, GLuint name, uint64_t bytes);
+    // Any thread. The object is deleted once the frames submitted so far
+    // are done; names the registry does not know (from a lost context) are ignored
+    void Release(Kind kind, GLuint name);
+    // Once per frame, after it is submitted: deletes the batches the GPU is
+    // done with and closes the one of this frame
+    void EndFrame();
+
+    bool HasFenceSync() const { return _fence_sync; }
+    // Goes up with every Reset, names from an older generation are stale
+    unsigned long GetGeneration() const;
+    Stats GetStats() const;
+    std::vector<OwnerStats> GetOwnerStats() const;
+    void ResetStats();
+  private:
+    struct Object
+    {
+      size_t owner;
+      uint64_t bytes;
+    };
+    struct Pending
+    {
+      Kind kind;
+      GLuint name;
+    };
+    struct Batch
+    {
+      std::vector<Pending> objects;
+      EGLSyncKHR fence;
+      unsigned long frame;
+    };
+    size_t FindOwner(const char *owner);
+    bool IsDone(const Batch &batch) const;
+    void Delete(const Pending &object);
+    void Delete(const std::vector<Pending> &objects);
+    void DestroyFences();
+
+    GlStateCache *_state;
+    EGLDisplay _display;
+    bool _fence_sync;
+    PFNEGLCREATESYNCKHRPROC _create_sync;
+    PFNEGLDESTROYSYNCKHRPROC _destroy_sync;
+    PFNEGLCLIENTWAITSYNCKHRPROC _client_wait_sync;
+    // Release comes from any thread, the rest from the GL thread
+    mutable std::mutex _mutex;
+    std::map<GLuint, Object> _objects[KindCount];
+    std::vector<OwnerStats> _owners;
+    std::vector<Pending> _released;
+    std::deque<Batch> _batches;
+    // From batches the GPU is done with, left over by the budget
+    std::deque<Pending> _deletable;
+    double _budget_milliseconds;
+    unsigned long _frame;
+    unsigned long _generation;
+    Stats _stats;
+  };
+}
+
+#endif
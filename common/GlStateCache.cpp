@@ -0,0 +1,283 @@
+#include "GlStateCache.h"
+
+using namespace Common;
+
+GlStateCache::GlStateCache()
+{
+  Reset();
+  ResetCounters();
+}
+
+void GlStateCache::Reset()
+{
+  _program_known = false;
+  _program = 0;
+  _array_buffer_known = false;
+  _array_buffer = 0;
+  _element_array_buffer_known = false;
+  _element_array_buffer = 0;
+  _enabled_attribs_known = 0;
+  _enabled_attribs = 0;
+  // Queried on first use, the cache is reset before a context exists too
+  _attrib_count = 0;
+  for (GLuint i = 0; i < MaxVertexAttribs; ++i)
+  {
+    _attrib_pointers[i].known = false;
+  }
+  _blend_known = false;
+  _blend = false;
+  _blend_func_known = false;
+  _blend_source = GL_ONE;
+  _blend_destination = GL_ZERO;
+  _clear_color_known = false;
+  for (int i = 0; i < 4; ++i)
+  {
+    _clear_color[i] = 0.0f;
+  }
+}
+
+void GlStateCache::ResetCounters()
+{
+  _issued = 0;
+  _elided = 0;
+}
+
+bool GlStateCache::Elide(bool unchanged)
+{
+  if (unchanged)
+  {
+    ++_elided;
+  }
+  else
+  {
+    ++_issued;
+  }
+  return unchanged;
+}
+
+GLuint GlStateCache::GetAttribCount()
+{
+  if (_attrib_count == 0)
+  {
+    GLint count = 0;
+    glGetIntegerv(GL_MAX_VERTEX_ATTRIBS, &count);
+    _attrib_count = count > 0 && (GLuint)count < MaxVertexAttribs ? (GLuint)count : MaxVertexAttribs;
+  }
+  return _attrib_count;
+}
+
+void GlStateCache::UseProgram(GLuint program)
+{
+  if (Elide(_program_known && _program == program))
+  {
+    return;
+  }
+  glUseProgram(program);
+  _program_known = true;
+  _program = program;
+}
+
+void GlStateCache::BindArrayBuffer(GLuint buffer)
+{
+  if (Elide(_array_buffer_known && _array_buffer == buffer))
+  {
+    return;
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, buffer);
+  _array_buffer_known = true;
+  _array_buffer = buffer;
+}
+
+void GlStateCache::BindElementArrayBuffer(GLuint buffer)
+{
+  if (Elide(_element_array_buffer_known && _element_array_buffer == buffer))
+  {
+    return;
+  }
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+  _element_array_buffer_known = true;
+  _element_array_buffer = buffer;
+}
+
+void GlStateCache::EnableVertexAttribArray(GLuint index)
+{
+  if (index >= MaxVertexAttribs)
+  {
+    ++_issued;
+    glEnableVertexAttribArray(index);
+    return;
+  }
+  unsigned int bit = 1u << index;
+  if (Elide((_enabled_attribs_known & bit) && (_enabled_attribs & bit)))
+  {
+    return;
+  }
+  glEnableVertexAttribArray(index);
+  _enabled_attribs_known |= bit;
+  _enabled_attribs |= bit;
+}
+
+void GlStateCache::DisableVertexAttribArray(GLuint index)
+{
+  if (index >= MaxVertexAttribs)
+  {
+    ++_issued;
+    glDisableVertexAttribArray(index);
+    return;
+  }
+  unsigned int bit = 1u << index;
+  if (Elide((_enabled_attribs_known & bit) && !(_enabled_attribs & bit)))
+  {
+    return;
+  }
+  glDisableVertexAttribArray(index);
+  _enabled_attribs_known |= bit;
+  _enabled_attribs &= ~bit;
+}
+
+void GlStateCache::SetEnabledVertexAttribArrays(unsigned int mask)
+{
+  // Unknown attributes past the context's count would be an invalid value
+  GLuint count = GetAttribCount();
+  for (GLuint i = 0; i < count; ++i)
+  {
+    unsigned int bit = 1u << i;
+    if (mask & bit)
+    {
+      EnableVertexAttribArray(i);
+    }
+    else if (!(_enabled_attribs_known & bit) || (_enabled_attribs & bit))
+    {
+      // Attributes already known to be disabled are skipped without being counted
+      DisableVertexAttribArray(i);
+    }
+  }
+}
+
+void GlStateCache::VertexAttribPointer(GLint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const GLvoid *pointer)
+{
+  if (index < 0)
+  {
+    return;
+  }
+  // The pointer captures the current array buffer binding, it can only be
+  // compared when that binding is known.
+  if ((GLuint)index >= MaxVertexAttribs || !_array_buffer_known)
+  {
+    ++_issued;
+    glVertexAttribPointer(index, size, type, normalized, stride, pointer);
+    if ((GLuint)index < MaxVertexAttribs)
+    {
+      _attrib_pointers[index].known = false;
+    }
+    return;
+  }
+  AttribPointer &current = _attrib_pointers[index];
+  if (Elide(current.known
+            && current.buffer == _array_buffer
+            && current.size == size
+            && current.type == type
+            && current.normalized == normalized
+            && current.stride == stride
+            && current.pointer == pointer))
+  {
+    return;
+  }
+  glVertexAttribPointer(index, size, type, normalized, stride, pointer);
+  current.known = true;
+  current.buffer = _array_buffer;
+  current.size = size;
+  current.type = type;
+  current.normalized = normalized;
+  current.stride = stride;
+  current.pointer = pointer;
+}
+
+void GlStateCache::SetBlend(bool enabled)
+{
+  if (Elide(_blend_known && _blend == enabled))
+  {
+    return;
+  }
+  if (enabled)
+  {
+    glEnable(GL_BLEND);
+  }
+  else
+  {
+    glDisable(GL_BLEND);
+  }
+  _blend_known = true;
+  _blend = enabled;
+}
+
+void GlStateCache::BlendFunc(GLenum source, GLenum destination)
+{
+  if (Elide(_blend_func_known && _blend_source == source && _blend_destination == destination))
+  {
+    return;
+  }
+  glBlendFunc(source, destination);
+  _blend_func_known = true;
+  _blend_source = source;
+  _blend_destination = destination;
+}
+
+void GlStateCache::ClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha)
+{
+  if (Elide(_clear_color_known
+            && _clear_color[0] == red
+            && _clear_color[1] == green
+            && _clear_color[2] == blue
+            && _clear_color[3] == alpha))
+  {
+    return;
+  }
+  glClearColor(red, green, blue, alpha);
+  _clear_color_known = true;
+  _clear_color[0] = red;
+  _clear_color[1] = green;
+  _clear_color[2] = blue;
+  _clear_color[3] = alpha;
+}
+
+void GlStateCache::DeleteBuffers(GLsizei count, const GLuint *buffers)
+{
+  // GL resets every binding of a deleted buffer to zero
+  for (GLsizei i = 0; i < count; ++i)
+  {
+    if (buffers[i] == 0)
+    {
+      continue;
+    }
+    if (_array_buffer_known && _array_buffer == buffers[i])
+    {
+      _array_buffer = 0;
+    }
+    if (_element_array_buffer_known && _element_array_buffer == buffers[i])
+    {
+      _element_array_buffer = 0;
+    }
+    for (GLuint j = 0; j < MaxVertexAttribs; ++j)
+    {
+      if (_attrib_pointers[j].known && _attrib_pointers[j].buffer == buffers[i])
+      {
+        _attrib_pointers[j].known = false;
+      }
+    }
+  }
+  ++_issued;
+  glDeleteBuffers(count, buffers);
+}
+
+void GlStateCache::DeleteProgram(GLuint program)
+{
+  // A program in use stays bound until another one is used, the name may be
+  // recycled though: forget it.
+  if (_program_known && _program == program)
+  {
+    _program_known = false;
+  }
+  ++_issued;
+  glDeleteProgram(program);
+}
@@ -0,0 +1,85 @@
+#ifndef GL_STATE_CACHE_H
+#define GL_STATE_CACHE_H
+
+#include <GLES2/gl2.h>
+
+namespace Common
+{
+  // Shadow copy of the GL state renderers touch every frame. Calls that would
+  // not change the current value are skipped, the others are forwarded to GL.
+  // State changed behind the cache's back (or a new context) requires Reset().
+  class GlStateCache
+  {
+  public:
+    // Tracked attributes, at most GL_MAX_VERTEX_ATTRIBS of them are touched
+    static const GLuint MaxVertexAttribs = 16;
+
+    // Bit of an attribute location for the masks below, 0 for a location
+    // glGetAttribLocation did not find (-1) or one beyond the tracked ones
+    static unsigned int AttribBit(GLint location)
+    {
+      return location >= 0 && (GLuint)location < MaxVertexAttribs ? 1u << location : 0u;
+    }
+
+    GlStateCache();
+    virtual ~GlStateCache(){}
+    void Reset();
+
+    void UseProgram(GLuint program);
+    void BindArrayBuffer(GLuint buffer);
+    void BindElementArrayBuffer(GLuint buffer);
+    void EnableVertexAttribArray(GLuint index);
+    void DisableVertexAttribArray(GLuint index);
+    // Enables the attributes in mask (bit i for attribute i) and disables the others
+    void SetEnabledVertexAttribArrays(unsigned int mask);
+    // A location glGetAttribLocation did not find (-1) is ignored
+    void VertexAttribPointer(GLint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const GLvoid *pointer);
+    void SetBlend(bool enabled);
+    void BlendFunc(GLenum source, GLenum destination);
+    void ClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha);
+
+    // Deletion goes through the cache so that stale bindings are forgotten
+    void DeleteBuffers(GLsizei count, const GLuint *buffers);
+    void DeleteProgram(GLuint program);
+
+    unsigned long GetIssuedCount() const { return _issued; }
+    unsigned long GetElidedCount() const { return _elided; }
+    void ResetCounters();
+  private:
+    struct AttribPointer
+    {
+      bool known;
+      GLuint buffer;
+      GLint size;
+      GLenum type;
+      GLboolean normalized;
+      GLsizei stride;
+      const GLvoid *pointer;
+    };
+    bool Elide(bool unchanged);
+    // GL_MAX_VERTEX_ATTRIBS up to MaxVertexAttribs, queried once per context
+    GLuint GetAttribCount();
+    bool _program_known;
+    GLuint _program;
+    bool _array_buffer_known;
+    GLuint _array_buffer;
+    bool _element_array_buffer_known;
+    GLuint _element_array_buffer;
+    unsigned int _enabled_attribs_known;
+    unsigned int _enabled_attribs;
+    // 0 until queried, ES 2 only guarantees 8
+    GLuint _attrib_count;
+    AttribPointer _attrib_pointers[MaxVertexAttribs];
+    bool _blend_known;
+    bool _blend;
+    bool _blend_func_known;
+    GLenum _blend_source;
+    GLenum _blend_destination;
+    bool _clear_color_known;
+    GLfloat _clear_color[4];
+    unsigned long _issued;
+    unsigned long _elided;
+  };
+}
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace Common
+{
+  // 64 bit FNV-1a, start from FnvOffset and chain calls to hash several buffers.
+  // Keys hashed with it are compared across runs (the shader cache files), the
+  // constants must not change.
+  const uint64_t FnvOffset = 14695981039346656037ull;
+
+  inline uint64_t Fnv1a(uint64_t hash, const void *data, size_t length)
+  {
+    const uint8_t *bytes = (const uint8_t *)data;
+    for (size_t i = 0; i < length; ++i)
+    {
+      hash ^= bytes[i];
+      hash *= 1099511628211ull;
+    }
+    return hash;
+  }
+}
+
+#endif
@@ -1,6 +1,11 @@
 #ifndef IRENDERER_H
 #define IRENDERER_H
 
+#include <string>
+#include <utility>
+#include <vector>
+#include "DamageRegion.h"
+
 namespace Common
 {
   class IRenderer
@@ -11,6 +16,15 @@ namespace Common
     virtual void ReleaseGl()=0;
     virtual void SetViewport(int width, int height)=0;
     virtual void DrawFrame()=0;
+    // Advances the simulation by a fixed step, called by the host zero or more times per frame
+    virtual void Update(double seconds){}
+    // Adds what the next DrawFrame changes since the last one, in viewport pixels. Called
+    // at most once per frame, after Update; a frame without damage may not be drawn at all.
+    // Renderers that do not track it change everything
+    virtual void GetDamage(DamageRegion &damage) { damage.AddFull(); }
+    // Appends named counters for the host to report (bytes streamed, cache
+    // misses...), still valid after ReleaseGl. Renderers print nothing themselves
+    virtual void GetCounters(std::vector<std::pair<std::string, double> > &counters) const {}
   };
 }
 
@@ -0,0 +1,43 @@
+#ifndef ITEXTURE_DECODER_H
+#define ITEXTURE_DECODER_H
+
+#include <GLES2/gl2.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace Common
+{
+  // A decoded image and its mip chain, level 0 first. Uncompressed images
+  // are uploaded with glTexImage2D(format, type), compressed ones with
+  // glCompressedTexImage2D(internal_format).
+  struct TextureImage
+  {
+    struct Level
+    {
+      int width;
+      int height;
+      std::vector<uint8_t> data;
+    };
+    GLenum internal_format;
+    GLenum format;
+    GLenum type;
+    bool compressed;
+    std::vector<Level> levels;
+    TextureImage() : internal_format(0), format(0), type(0), compressed(false) {}
+  };
+
+  // Turns file contents into a TextureImage. Decoders run on the texture
+  // manager worker threads, they must not call GL and must not share
+  // mutable state between calls.
+  class ITextureDecoder
+  {
+  public:
+    virtual ~ITextureDecoder(){}
+    // Cheap check of the magic number, the first decoder accepting wins
+    virtual bool CanDecode(const uint8_t *data, size_t size) const = 0;
+    virtual bool Decode(const uint8_t *data, size_t size, TextureImage &image) const = 0;
+  };
+}
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef IVSYNC_SOURCE_H
+#define IVSYNC_SOURCE_H
+
+#include <stdint.h>
+
+namespace Common
+{
+  class IVsyncListener
+  {
+  public:
+    virtual ~IVsyncListener(){}
+    // Vertical blank the frame is for, in steady_clock (CLOCK_MONOTONIC) nanoseconds
+    virtual void OnVsync(int64_t vsync_nanoseconds)=0;
+  };
+
+  // Tells a render loop when the display refreshes, AChoreographer on
+  // Android. Frames are asked for one at a time, the way Choreographer
+  // frame callbacks are posted, and the callback runs on the loop thread
+  // from inside Wait. Attach, RequestFrame and Wait are only called from
+  // the loop thread, Wake from any.
+  class IVsyncSource
+  {
+  public:
+    virtual ~IVsyncSource(){}
+    // On the loop thread, before anything else
+    virtual bool Attach()=0;
+    virtual void Detach()=0;
+    // One OnVsync at the next vertical blank; a request cannot be taken back
+    virtual void RequestFrame(IVsyncListener *listener)=0;
+    // Returns after a frame callback ran, after Wake, or after the timeout (negative waits forever)
+    virtual void Wait(int timeout_milliseconds)=0;
+    virtual void Wake()=0;
+  };
+}
+
+#endif
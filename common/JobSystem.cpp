@@ -0,0 +1,390 @@
+#include "JobSystem.h"
+
+using namespace Common;
+
+namespace
+{
+  // Which system's thread this is, a thread belongs to one at most
+  struct ThreadSlot
+  {
+    const JobSystem *system;
+    int index;
+  };
+
+  thread_local ThreadSlot threadSlot = { NULL, -1 };
+
+  // Tries before an idle worker sleeps, a job pushed meanwhile is taken without a wake up
+  const int IdleSpins = 64;
+
+  // Ring slots looked at before helping, a long running parent must not cost a scan of the whole ring
+  const unsigned int ScanSlots = 16;
+}
+
+unsigned int JobSystem::GetDefaultWorkerCount()
+{
+  unsigned int cores = std::thread::hardware_concurrency();
+  return cores > 1 ? cores - 1 : 1;
+}
+
+JobSystem::JobSystem(unsigned int worker_count)
+{
+  _worker_count = 0;
+  _started = false;
+  _main_stealing = true;
+  _queued = 0;
+  _sleeping = 0;
+  _stopping = false;
+  _shared.queue.head = 0;
+  _shared.queue.tail = 0;
+  _shared.ring = new Job[MaxJobs];
+  _shared.next = 0;
+  for (unsigned int i = 0; i < MaxJobs; ++i)
+  {
+    _shared.ring[i].unfinished = 0;
+  }
+  _main_jobs.head = 0;
+  _main_jobs.tail = 0;
+  SetWorkerCount(worker_count);
+  ResetStats();
+}
+
+JobSystem::~JobSystem()
+{
+  {
+    std::lock_guard<std::mutex> lock(_sleep_mutex);
+    _stopping = true;
+  }
+  _wake.notify_all();
+  for (size_t i = 0; i < _workers.size(); ++i)
+  {
+    _workers[i].join();
+  }
+  for (size_t i = 0; i < _threads.size(); ++i)
+  {
+    delete[] _threads[i]->ring;
+    delete _threads[i];
+  }
+  delete[] _shared.ring;
+}
+
+void JobSystem::SetWorkerCount(unsigned int count)
+{
+  if (_started)
+  {
+    return;
+  }
+  _worker_count = count;
+  // The main thread's deque is there whether or not one is set
+  while (_threads.size() < count + 1)
+  {
+    Thread *thread = new Thread();
+    thread->queue.head = 0;
+    thread->queue.tail = 0;
+    thread->ring = new Job[MaxJobs];
+    thread->next = 0;
+    for (unsigned int i = 0; i < MaxJobs; ++i)
+    {
+      thread->ring[i].unfinished = 0;
+    }
+    _threads.push_back(thread);
+  }
+  while (_threads.size() > count + 1)
+  {
+    delete[] _threads.back()->ring;
+    delete _threads.back();
+    _threads.pop_back();
+  }
+}
+
+void JobSystem::SetMainThread()
+{
+  _main_thread = std::this_thread::get_id();
+  threadSlot.system = this;
+  threadSlot.index = 0;
+}
+
+bool JobSystem::IsMainThread() const
+{
+  return _main_thread.load() == std::this_thread::get_id();
+}
+
+int JobSystem::GetThreadIndex() const
+{
+  if (threadSlot.system != this)
+  {
+    return -1;
+  }
+  // A main thread replaced since by SetMainThread no longer owns deque 0
+  if (threadSlot.index == 0 && !IsMainThread())
+  {
+    return -1;
+  }
+  return threadSlot.index;
+}
+
+JobSystem::Job *JobSystem::Allocate(Job *parent)
+{
+  int index = GetThreadIndex();
+  Thread &thread = index >= 0 ? *_threads[index] : _shared;
+  Job *job = NULL;
+  while (job == NULL)
+  {
+    {
+      std::unique_lock<std::mutex> lock(_shared_mutex, std::defer_lock);
+      if (index < 0)
+      {
+        lock.lock();
+      }
+      // Slots whose job has not finished are skipped, the ring is not a strict FIFO
+      for (unsigned int i = 0; i < ScanSlots && job == NULL; ++i)
+      {
+        Job *slot = &thread.ring[thread.next++ % MaxJobs];
+        if (IsFinished(slot))
+        {
+          job = slot;
+          job->unfinished.store(1, std::memory_order_relaxed);
+        }
+      }
+    }
+    if (job == NULL)
+    {
+      // The slots looked at are busy, some work frees one
+      Job *other = Next(index);
+      if (other != NULL)
+      {
+        Execute(other);
+      }
+      else
+      {
+        std::this_thread::yield();
+      }
+    }
+  }
+  job->parent = parent;
+  if (parent != NULL)
+  {
+    parent->unfinished.fetch_add(1, std::memory_order_relaxed);
+  }
+  return job;
+}
+
+void JobSystem::StartWorkers()
+{
+  if (_started.load(std::memory_order_acquire))
+  {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(_start_mutex);
+  if (!_started.load(std::memory_order_relaxed))
+  {
+    for (unsigned int i = 1; i <= _worker_count; ++i)
+    {
+      _workers.push_back(std::thread(&JobSystem::Work, this, (int)i));
+    }
+    _started.store(true, std::memory_order_release);
+  }
+}
+
+void JobSystem::Run(Job *job)
+{
+  StartWorkers();
+  int index = GetThreadIndex();
+  Queue &queue = index >= 0 ? _threads[index]->queue : _shared.queue;
+  if (Push(queue, job))
+  {
+    Wake();
+  }
+  else
+  {
+    ++_inlined;
+    Execute(job);
+  }
+}
+
+void JobSystem::RunOnMainThread(Job *job)
+{
+  StartWorkers();
+  while (!Push(_main_jobs, job))
+  {
+    if (IsMainThread())
+    {
+      ++_inlined;
+      Execute(job);
+      return;
+    }
+    std::this_thread::yield();
+  }
+}
+
+void JobSystem::RunMainJobs()
+{
+  for (Job *job = PopFront(_main_jobs); job != NULL; job = PopFront(_main_jobs))
+  {
+    Execute(job);
+  }
+}
+
+void JobSystem::Wait(Job *job)
+{
+  int index = GetThreadIndex();
+  while (!IsFinished(job))
+  {
+    Job *next = Next(index);
+    if (next != NULL)
+    {
+      Execute(next);
+    }
+    else
+    {
+      std::this_thread::yield();
+    }
+  }
+}
+
+void JobSystem::Work(int index)
+{
+  threadSlot.system = this;
+  threadSlot.index = index;
+  while (!_stopping)
+  {
+    Job *job = Next(index);
+    for (int i = 0; job == NULL && i < IdleSpins && !_stopping; ++i)
+    {
+      std::this_thread::yield();
+      job = Next(index);
+    }
+    if (job != NULL)
+    {
+      Execute(job);
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(_sleep_mutex);
+    ++_sleeping;
+    while (!_stopping && _queued == 0)
+    {
+      _wake.wait(lock);
+    }
+    --_sleeping;
+  }
+}
+
+JobSystem::Job *JobSystem::Next(int index)
+{
+  Job *job = NULL;
+  if (index == 0)
+  {
+    job = PopFront(_main_jobs);
+    // Without workers nobody else runs the jobs it waits for
+    if (job != NULL || (!_main_stealing && _worker_count > 0))
+    {
+      return job;
+    }
+  }
+  if (index >= 0)
+  {
+    job = PopBack(_threads[index]->queue);
+  }
+  if (job == NULL)
+  {
+    // The shared queue is the own deque of threads the system does not know
+    job = index >= 0 ? PopFront(_shared.queue) : PopBack(_shared.queue);
+  }
+  size_t count = _threads.size();
+  for (size_t i = 1; job == NULL && i <= count; ++i)
+  {
+    size_t victim = (index + i) % count;
+    if ((int)victim != index)
+    {
+      job = PopFront(_threads[victim]->queue);
+      if (job != NULL)
+      {
+        ++_stolen;
+      }
+    }
+  }
+  return job;
+}
+
+void JobSystem::Execute(Job *job)
+{
+  job->function(job);
+  ++_executed;
+  Finish(job);
+}
+
+void JobSystem::Finish(Job *job)
+{
+  // The slot may be reused as soon as the count drops to 0
+  Job *parent = job->parent;
+  if (job->unfinished.fetch_sub(1, std::memory_order_acq_rel) == 1 && parent != NULL)
+  {
+    Finish(parent);
+  }
+}
+
+bool JobSystem::Push(Queue &queue, Job *job)
+{
+  std::lock_guard<std::mutex> lock(queue.mutex);
+  if (queue.tail - queue.head == MaxJobs)
+  {
+    return false;
+  }
+  queue.jobs[queue.tail++ % MaxJobs] = job;
+  // Main jobs are not for the workers, they do not wake them
+  if (&queue != &_main_jobs)
+  {
+    ++_queued;
+  }
+  return true;
+}
+
+JobSystem::Job *JobSystem::PopBack(Queue &queue)
+{
+  std::lock_guard<std::mutex> lock(queue.mutex);
+  if (queue.tail == queue.head)
+  {
+    return NULL;
+  }
+  --_queued;
+  return queue.jobs[--queue.tail % MaxJobs];
+}
+
+JobSystem::Job *JobSystem::PopFront(Queue &queue)
+{
+  std::lock_guard<std::mutex> lock(queue.mutex);
+  if (queue.tail == queue.head)
+  {
+    return NULL;
+  }
+  if (&queue != &_main_jobs)
+  {
+    --_queued;
+  }
+  return queue.jobs[queue.head++ % MaxJobs];
+}
+
+void JobSystem::Wake()
+{
+  // A worker counts itself sleeping before it checks _queued, one of the two sees the other
+  if (_sleeping > 0)
+  {
+    std::lock_guard<std::mutex> lock(_sleep_mutex);
+    _wake.notify_one();
+  }
+}
+
+JobSystem::Stats JobSystem::GetStats() const
+{
+  Stats stats;
+  stats.executed = _executed;
+  stats.stolen = _stolen;
+  stats.inlined = _inlined;
+  return stats;
+}
+
+void JobSystem::ResetStats()
+{
+  _executed = 0;
+  _stolen = 0;
+  _inlined = 0;
+}
@@ -0,0 +1,197 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <stddef.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+namespace Common
+{
+  // Worker threads shared by every subsystem. Each thread has a deque of
+  // jobs: it pushes and pops its own at the back, idle threads steal from
+  // the front of the others'. A job may be the child of another, which
+  // only counts as finished once its children are; Wait() runs jobs while
+  // the one waited for is not finished, so nested waits never deadlock.
+  //
+  // Jobs are closures of at most JobDataSize bytes, stored in a ring of
+  // MaxJobs per thread: creating one allocates nothing. A job pointer is
+  // valid until its creating thread has created MaxJobs more, wait on it
+  // (or drop it) before then.
+  //
+  // The thread that owns the GL context calls SetMainThread(). Jobs run
+  // with RunOnMainThread() only ever execute there, in RunMainJobs() or
+  // while it waits; SetMainThreadStealing(false) keeps it from picking up
+  // anybody else's work, so a long job never delays a frame, unless there
+  // are no workers to do it. Calling SetMainThread() from another thread
+  // hands the role over, once the previous one has stopped using the
+  // system; that one is then a thread the system does not know.
+  class JobSystem
+  {
+  public:
+    static const size_t JobDataSize = 64;
+    static const unsigned int MaxJobs = 4096;
+
+    struct Job
+    {
+      void (*function)(Job *job);
+      Job *parent;
+      // Itself and its unfinished children
+      std::atomic<int> unfinished;
+      union
+      {
+        double alignment;
+        void *pointer;
+        unsigned char data[JobDataSize];
+      };
+    };
+
+    struct Stats
+    {
+      unsigned long executed;
+      // Taken from another thread's deque
+      unsigned long stolen;
+      // Run where created because the deque was full
+      unsigned long inlined;
+    };
+
+    // Cores less the GL thread, at least one
+    static unsigned int GetDefaultWorkerCount();
+
+    explicit JobSystem(unsigned int worker_count = GetDefaultWorkerCount());
+    // Jobs not started yet are dropped
+    virtual ~JobSystem();
+    // Only before the first job, workers start with it. 0 runs every job
+    // on the threads that wait
+    void SetWorkerCount(unsigned int count);
+    unsigned int GetWorkerCount() const { return _worker_count; }
+    void SetMainThread();
+    bool IsMainThread() const;
+    void SetMainThreadStealing(bool stealing) { _main_stealing = stealing; }
+
+    // Not queued until Run, a parent must not have finished yet
+    template <typename Function>
+    Job *Create(const Function &function, Job *parent = NULL)
+    {
+      static_assert(sizeof(Function) <= JobDataSize, "Job closures are limited to JobDataSize bytes");
+      Job *job = Allocate(parent);
+      new (job->data) Function(function);
+      job->function = &Invoke<Function>;
+      return job;
+    }
+    void Run(Job *job);
+    void RunOnMainThread(Job *job);
+    // Main thread, once per frame
+    void RunMainJobs();
+    void Wait(Job *job);
+    bool IsFinished(const Job *job) const { return job->unfinished.load(std::memory_order_acquire) == 0; }
+
+    // function(begin, end) over [0, count) in ranges of at most grain,
+    // split in halves so that thieves take large ranges. Returns when all
+    // are done
+    template <typename Function>
+    void ParallelFor(size_t count, size_t grain, const Function &function)
+    {
+      if (count == 0)
+      {
+        return;
+      }
+      Job *root = Create(Nothing());
+      Run(Create(Range<Function>(this, root, &function, 0, count, grain > 0 ? grain : 1), root));
+      Run(root);
+      Wait(root);
+    }
+
+    Stats GetStats() const;
+    void ResetStats();
+  private:
+    struct Queue
+    {
+      std::mutex mutex;
+      Job *jobs[MaxJobs];
+      size_t head;
+      size_t tail;
+    };
+    struct Thread
+    {
+      Queue queue;
+      Job *ring;
+      size_t next;
+    };
+    struct Nothing
+    {
+      void operator()() const {}
+    };
+    template <typename Function>
+    struct Range
+    {
+      Range(JobSystem *system, Job *root, const Function *function, size_t begin, size_t end, size_t grain)
+        : system(system), root(root), function(function), begin(begin), end(end), grain(grain) {}
+      void operator()() const
+      {
+        size_t last = end;
+        while (last - begin > grain)
+        {
+          size_t middle = begin + (last - begin) / 2;
+          system->Run(system->Create(Range(system, root, function, middle, last, grain), root));
+          last = middle;
+        }
+        (*function)(begin, last);
+      }
+      JobSystem *system;
+      Job *root;
+      const Function *function;
+      size_t begin;
+      size_t end;
+      size_t grain;
+    };
+    template <typename Function>
+    static void Invoke(Job *job)
+    {
+      Function *function = reinterpret_cast<Function *>(job->data);
+      (*function)();
+      function->~Function();
+    }
+    JobSystem(const JobSystem &);
+    JobSystem &operator=(const JobSystem &);
+    // Index in _threads of the calling thread, -1 for a thread the system does not know
+    int GetThreadIndex() const;
+    Job *Allocate(Job *parent);
+    void StartWorkers();
+    void Work(int index);
+    // Own deque, main jobs, shared queue, then the others' deques
+    Job *Next(int index);
+    void Execute(Job *job);
+    void Finish(Job *job);
+    bool Push(Queue &queue, Job *job);
+    Job *PopBack(Queue &queue);
+    Job *PopFront(Queue &queue);
+    void Wake();
+
+    unsigned int _worker_count;
+    std::atomic<bool> _started;
+    std::mutex _start_mutex;
+    // 0 is the main thread, 1 to _worker_count the workers
+    std::vector<Thread *> _threads;
+    std::vector<std::thread> _workers;
+    // Jobs from threads the system does not know and their ring
+    Thread _shared;
+    std::mutex _shared_mutex;
+    Queue _main_jobs;
+    std::atomic<std::thread::id> _main_thread;
+    bool _main_stealing;
+    std::atomic<int> _queued;
+    std::atomic<int> _sleeping;
+    std::atomic<bool> _stopping;
+    std::mutex _sleep_mutex;
+    std::condition_variable _wake;
+    std::atomic<unsigned long> _executed;
+    std::atomic<unsigned long> _stolen;
+    std::atomic<unsigned long> _inlined;
+  };
+}
+
+#endif
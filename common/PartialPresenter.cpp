@@ -0,0 +1,202 @@
+#include <string.h>
+#include "Extensions.h"
+#include "IRenderer.h"
+#include "PartialPresenter.h"
+
+using namespace Common;
+
+PartialPresenter::PartialPresenter()
+{
+  _display = EGL_NO_DISPLAY;
+  _surface = EGL_NO_SURFACE;
+  _enabled = false;
+  _offscreen = false;
+  _buffer_age = false;
+  _preserved = false;
+  _width = 0;
+  _height = 0;
+  _swap_with_damage = NULL;
+  _set_damage_region = NULL;
+  ResetStats();
+}
+
+void PartialPresenter::Initialize(EGLDisplay display, EGLSurface surface)
+{
+  _display = display;
+  _surface = surface;
+  _offscreen = false;
+  _history.clear();
+  const char *extensions = eglQueryString(display, EGL_EXTENSIONS);
+  bool partial_update = HasExtension(extensions, "EGL_KHR_partial_update");
+  _buffer_age = partial_update || HasExtension(extensions, "EGL_EXT_buffer_age");
+  _set_damage_region = partial_update
+    ? (PFNEGLSETDAMAGEREGIONKHRPROC)eglGetProcAddress("eglSetDamageRegionKHR") : NULL;
+  _swap_with_damage = NULL;
+  if (HasExtension(extensions, "EGL_KHR_swap_buffers_with_damage"))
+  {
+    _swap_with_damage = (PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC)eglGetProcAddress("eglSwapBuffersWithDamageKHR");
+  }
+  if (_swap_with_damage == NULL && HasExtension(extensions, "EGL_EXT_swap_buffers_with_damage"))
+  {
+    _swap_with_damage = (PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC)eglGetProcAddress("eglSwapBuffersWithDamageEXT");
+  }
+  // Preserving costs a copy per swap on some drivers, only asked for when frames can be partial
+  _preserved = false;
+  if (_enabled && !_buffer_age)
+  {
+    _preserved = eglSurfaceAttrib(display, surface, EGL_SWAP_BEHAVIOR, EGL_BUFFER_PRESERVED) == EGL_TRUE;
+    if (!_preserved)
+    {
+      // The config has no EGL_SWAP_BEHAVIOR_PRESERVED_BIT
+      eglGetError();
+    }
+  }
+  QuerySize(_width, _height);
+}
+
+void PartialPresenter::InitializeOffscreen(int width, int height)
+{
+  _display = EGL_NO_DISPLAY;
+  _surface = EGL_NO_SURFACE;
+  _offscreen = true;
+  _buffer_age = false;
+  _preserved = false;
+  _swap_with_damage = NULL;
+  _set_damage_region = NULL;
+  _width = width;
+  _height = height;
+  _history.clear();
+}
+
+void PartialPresenter::SetEnabled(bool enabled)
+{
+  _enabled = enabled;
+  _history.clear();
+}
+
+void PartialPresenter::QuerySize(int &width, int &height) const
+{
+  if (_offscreen)
+  {
+    width = _width;
+    height = _height;
+    return;
+  }
+  EGLint value = 0;
+  eglQuerySurface(_display, _surface, EGL_WIDTH, &value);
+  width = value;
+  value = 0;
+  eglQuerySurface(_display, _surface, EGL_HEIGHT, &value);
+  height = value;
+}
+
+bool PartialPresenter::BeginFrame(IRenderer *renderer)
+{
+  int width;
+  int height;
+  QuerySize(width, height);
+  if (width != _width || height != _height)
+  {
+    // Buffers of another size hold nothing worth keeping
+    _width = width;
+    _height = height;
+    _history.clear();
+  }
+  _damage.Reset(width, height);
+  _repaint.Reset(width, height);
+  if (!_enabled)
+  {
+    _damage.AddFull();
+    _repaint.AddFull();
+    return true;
+  }
+  renderer->GetDamage(_damage);
+  if (_damage.IsEmpty())
+  {
+    ++_stats.skipped;
+    return false;
+  }
+
+  // 1 is the buffer presented last, 0 one never drawn
+  EGLint age = 0;
+  if (_offscreen || _preserved)
+  {
+    age = 1;
+  }
+  else if (_buffer_age && !eglQuerySurface(_display, _surface, EGL_BUFFER_AGE_EXT, &age))
+  {
+    age = 0;
+  }
+  if (age <= 0 || age > MaxBufferAge || (size_t)(age - 1) > _history.size())
+  {
+    _repaint.AddFull();
+  }
+  else
+  {
+    _repaint.Add(_damage);
+    for (EGLint i = 0; i < age - 1; ++i)
+    {
+      _repaint.Add(_history[i]);
+    }
+  }
+  // Renderers draw over the bounds, not the separate rectangles
+  if (_set_damage_region != NULL && !_repaint.IsFull())
+  {
+    DamageRegion::Rectangle bounds = _repaint.GetBounds();
+    EGLint rectangle[4] = { bounds.x, bounds.y, bounds.width, bounds.height };
+    _set_damage_region(_display, _surface, rectangle, 1);
+  }
+  return true;
+}
+
+bool PartialPresenter::Present()
+{
+  bool swapped = true;
+  if (!_offscreen)
+  {
+    const std::vector<DamageRegion::Rectangle> &rectangles = _damage.GetRectangles();
+    if (_enabled && _swap_with_damage != NULL && !_damage.IsFull())
+    {
+      EGLint damage[DamageRegion::MaxRectangles * 4];
+      for (size_t i = 0; i < rectangles.size(); ++i)
+      {
+        damage[i * 4] = rectangles[i].x;
+        damage[i * 4 + 1] = rectangles[i].y;
+        damage[i * 4 + 2] = rectangles[i].width;
+        damage[i * 4 + 3] = rectangles[i].height;
+      }
+      swapped = _swap_with_damage(_display, _surface, damage, (EGLint)rectangles.size()) == EGL_TRUE;
+    }
+    else
+    {
+      swapped = eglSwapBuffers(_display, _surface) == EGL_TRUE;
+    }
+  }
+
+  DamageRegion::Rectangle bounds = _repaint.GetBounds();
+  ++_stats.presented;
+  if (!_repaint.IsFull())
+  {
+    ++_stats.partial;
+  }
+  _stats.repainted_pixels += (double)bounds.width * bounds.height;
+  _stats.damaged_pixels += (double)_damage.GetArea();
+  _stats.surface_pixels += (double)_width * _height;
+
+  _history.push_front(_damage);
+  if (_history.size() > (size_t)MaxBufferAge)
+  {
+    _history.pop_back();
+  }
+  return swapped;
+}
+
+void PartialPresenter::Invalidate()
+{
+  _history.clear();
+}
+
+void PartialPresenter::ResetStats()
+{
+  memset(&_stats, 0, sizeof(_stats));
+}
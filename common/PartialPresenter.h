@@ -0,0 +1,92 @@
+#ifndef PARTIAL_PRESENTER_H
+#define PARTIAL_PRESENTER_H
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <deque>
+#include "DamageRegion.h"
+
+namespace Common
+{
+  class IRenderer;
+
+  // Presents only what changed. Each frame starts by asking the renderer
+  // for its damage: a frame without any is neither drawn nor swapped, the
+  // surface keeps showing the last one. Otherwise the region to repaint is
+  // the damage plus what the buffer about to be drawn has missed, from the
+  // damage of the frames presented since it was last shown: its age, from
+  // EGL_EXT_buffer_age or EGL_KHR_partial_update. Without them the back
+  // buffer is asked to be preserved (EGL_SWAP_BEHAVIOR), so that it is
+  // always one frame old, else every drawn frame is repainted whole. The
+  // repaint region is announced with eglSetDamageRegionKHR and the damage
+  // is handed to eglSwapBuffersWithDamage (KHR or EXT), plain swaps
+  // otherwise. Offscreen surfaces (pbuffer, FBO) keep their content and
+  // are not swapped. Disabled, every frame is drawn whole and swapped.
+  class PartialPresenter
+  {
+  public:
+    // Buffer ages beyond this one repaint everything
+    static const int MaxBufferAge = 4;
+
+    struct Stats
+    {
+      // Drawn and presented
+      unsigned long presented;
+      // Without damage, neither drawn nor presented
+      unsigned long skipped;
+      // Presented without repainting the whole surface
+      unsigned long partial;
+      // Pixels drawn over (repaint bounds) and changed (damage)
+      double repainted_pixels;
+      double damaged_pixels;
+      // Pixels of the surface, per frame presented
+      double surface_pixels;
+    };
+
+    PartialPresenter();
+    // Window surface, with the context current
+    void Initialize(EGLDisplay display, EGLSurface surface);
+    // Surface whose content stays from frame to frame and that is not swapped
+    void InitializeOffscreen(int width, int height);
+    void SetEnabled(bool enabled);
+    bool IsEnabled() const { return _enabled; }
+    // Whether the surface supports anything better than whole frames
+    bool HasBufferAge() const { return _buffer_age || _preserved || _offscreen; }
+    bool HasSwapWithDamage() const { return _swap_with_damage != NULL; }
+    bool HasPartialUpdate() const { return _set_damage_region != NULL; }
+
+    // False when the frame has no damage and is to be skipped, the caller
+    // still ends it (Compositor::SkipFrame). Otherwise the frame is to be
+    // drawn over GetRepaintRegion(), then presented
+    bool BeginFrame(IRenderer *renderer);
+    const DamageRegion &GetRepaintRegion() const { return _repaint; }
+    const DamageRegion &GetDamage() const { return _damage; }
+    // False when the swap failed
+    bool Present();
+    // Forgets the frames presented, the next one is repainted whole
+    void Invalidate();
+
+    const Stats &GetStats() const { return _stats; }
+    void ResetStats();
+  private:
+    void QuerySize(int &width, int &height) const;
+
+    EGLDisplay _display;
+    EGLSurface _surface;
+    bool _enabled;
+    bool _offscreen;
+    bool _buffer_age;
+    bool _preserved;
+    int _width;
+    int _height;
+    PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC _swap_with_damage;
+    PFNEGLSETDAMAGEREGIONKHRPROC _set_damage_region;
+    DamageRegion _damage;
+    DamageRegion _repaint;
+    // Damage of the frames presented, most recent first
+    std::deque<DamageRegion> _history;
+    Stats _stats;
+  };
+}
+
+#endif
@@ -0,0 +1,262 @@
+#include <dlfcn.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include "Compositor.h"
+#include "Context.h"
+#include "PluginLoader.h"
+#include "RendererPlugin.h"
+
+using namespace Common;
+
+namespace
+{
+  typedef std::chrono::steady_clock Clock;
+
+  double milliseconds(Clock::time_point from, Clock::time_point to)
+  {
+    return std::chrono::duration<double, std::milli>(to - from).count();
+  }
+
+  // Builds write the file in place or replace it by a rename
+  const uint32_t WatchedEvents = IN_CLOSE_WRITE | IN_MOVED_TO;
+}
+
+PluginLoader::PluginLoader()
+{
+  _inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (_inotify < 0)
+  {
+    std::cerr<<"inotify_init1 failed: "<<strerror(errno)<<", plugins will not reload"<<std::endl;
+  }
+  _copies = 0;
+}
+
+PluginLoader::~PluginLoader()
+{
+  if (_inotify >= 0)
+  {
+    close(_inotify);
+  }
+}
+
+std::string PluginLoader::GetPluginName(const std::string &path)
+{
+  size_t slash = path.rfind('/');
+  std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+  size_t dot = name.find('.');
+  if (dot != std::string::npos)
+  {
+    name.erase(dot);
+  }
+  if (name.compare(0, 3, "lib") == 0)
+  {
+    name.erase(0, 3);
+  }
+  const std::string suffix = "-plugin";
+  if (name.size() > suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0)
+  {
+    name.erase(name.size() - suffix.size());
+  }
+  return name;
+}
+
+void *PluginLoader::Open(const std::string &path, IRendererFactory *&factory)
+{
+  const char *temporary = getenv("TMPDIR");
+  char copy[PATH_MAX];
+  snprintf(copy, sizeof(copy), "%s/%s.%d.%lu", temporary != NULL && temporary[0] != '\0' ? temporary : "/tmp",
+           GetPluginName(path).c_str(), (int)getpid(), _copies++);
+  {
+    std::ifstream input(path.c_str(), std::ios::binary);
+    std::ofstream output(copy, std::ios::binary);
+    // An empty file is one the build has just truncated
+    if (!input || !output || input.peek() == EOF || !(output<<input.rdbuf()))
+    {
+      std::cerr<<"Unable to copy "<<path<<" to "<<copy<<(input.eof() ? ", it is empty" : "")<<std::endl;
+      unlink(copy);
+      return NULL;
+    }
+  }
+  // Mapped once open, the copy is not needed any more
+  void *library = dlopen(copy, RTLD_NOW | RTLD_LOCAL);
+  unlink(copy);
+  if (library == NULL)
+  {
+    std::cerr<<"Unable to load "<<path<<": "<<dlerror()<<std::endl;
+    return NULL;
+  }
+  RendererPluginEntryPoint entry = (RendererPluginEntryPoint)dlsym(library, COMMON_RENDERER_PLUGIN_ENTRY_POINT);
+  if (entry == NULL)
+  {
+    std::cerr<<path<<" has no "<<COMMON_RENDERER_PLUGIN_ENTRY_POINT<<std::endl;
+    dlclose(library);
+    return NULL;
+  }
+  factory = entry();
+  return library;
+}
+
+bool PluginLoader::Load(const std::string &path)
+{
+  IRendererFactory *factory = NULL;
+  void *library = Open(path, factory);
+  if (library == NULL)
+  {
+    return false;
+  }
+  Plugin plugin;
+  plugin.name = GetPluginName(path);
+  plugin.path = path;
+  size_t slash = path.rfind('/');
+  plugin.directory = slash == std::string::npos ? "." : path.substr(0, slash + 1);
+  plugin.file = slash == std::string::npos ? path : path.substr(slash + 1);
+  plugin.library = library;
+  plugin.changed = false;
+  Context::Instance()->Register(plugin.name, factory);
+  _plugins.push_back(plugin);
+
+  // The directory is watched, the file itself may be replaced
+  bool watched = false;
+  for (size_t i = 0; i < _watches.size(); ++i)
+  {
+    watched = watched || _watches[i].second == plugin.directory;
+  }
+  if (_inotify >= 0 && !watched)
+  {
+    int watch = inotify_add_watch(_inotify, plugin.directory.c_str(), WatchedEvents);
+    if (watch < 0)
+    {
+      std::cerr<<"Unable to watch "<<plugin.directory<<": "<<strerror(errno)<<std::endl;
+    }
+    else
+    {
+      _watches.push_back(std::make_pair(watch, plugin.directory));
+    }
+  }
+  return true;
+}
+
+bool PluginLoader::LoadPlugins(const std::string &paths)
+{
+  size_t begin = 0;
+  for (;;)
+  {
+    size_t comma = paths.find(',', begin);
+    if (!Load(paths.substr(begin, comma == std::string::npos ? std::string::npos : comma - begin)))
+    {
+      return false;
+    }
+    if (comma == std::string::npos)
+    {
+      return true;
+    }
+    begin = comma + 1;
+  }
+}
+
+void PluginLoader::ReadEvents()
+{
+  if (_inotify < 0)
+  {
+    return;
+  }
+  // Aligned for the events, names follow each one
+  char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  for (;;)
+  {
+    ssize_t size = read(_inotify, buffer, sizeof(buffer));
+    if (size <= 0)
+    {
+      // EAGAIN once every event is read
+      return;
+    }
+    for (ssize_t offset = 0; offset < size;)
+    {
+      const struct inotify_event *event = (const struct inotify_event *)(buffer + offset);
+      offset += sizeof(struct inotify_event) + event->len;
+      if (event->len == 0)
+      {
+        continue;
+      }
+      for (size_t i = 0; i < _watches.size(); ++i)
+      {
+        if (_watches[i].first != event->wd)
+        {
+          continue;
+        }
+        for (size_t j = 0; j < _plugins.size(); ++j)
+        {
+          if (_plugins[j].directory == _watches[i].second && _plugins[j].file == event->name)
+          {
+            _plugins[j].changed = true;
+          }
+        }
+      }
+    }
+  }
+}
+
+bool PluginLoader::Reload(Plugin &plugin, Compositor *compositor)
+{
+  Clock::time_point start = Clock::now();
+  IRendererFactory *factory = NULL;
+  void *library = Open(plugin.path, factory);
+  Clock::time_point loaded = Clock::now();
+  Swap swap;
+  swap.name = plugin.name;
+  swap.loaded = library != NULL;
+  swap.load_milliseconds = milliseconds(start, loaded);
+  swap.gl_milliseconds = 0.0;
+  swap.layers = 0;
+  if (library == NULL)
+  {
+    std::cerr<<"renderer "<<plugin.name<<" kept running"<<std::endl;
+    _swaps.push_back(swap);
+    return false;
+  }
+
+  // The old renderers and factory go before their code does
+  swap.layers = compositor->ReplaceLayers(plugin.name, factory);
+  Context::Instance()->Register(plugin.name, factory);
+  swap.gl_milliseconds = milliseconds(loaded, Clock::now());
+  dlclose(plugin.library);
+  plugin.library = library;
+  _swaps.push_back(swap);
+  return true;
+}
+
+size_t PluginLoader::Update(Compositor *compositor)
+{
+  ReadEvents();
+  size_t swapped = 0;
+  for (size_t i = 0; i < _plugins.size(); ++i)
+  {
+    if (_plugins[i].changed)
+    {
+      _plugins[i].changed = false;
+      swapped += Reload(_plugins[i], compositor) ? 1 : 0;
+    }
+  }
+  return swapped;
+}
+
+size_t PluginLoader::ReloadAll(Compositor *compositor)
+{
+  // Pending changes are part of this reload
+  ReadEvents();
+  size_t swapped = 0;
+  for (size_t i = 0; i < _plugins.size(); ++i)
+  {
+    _plugins[i].changed = false;
+    swapped += Reload(_plugins[i], compositor) ? 1 : 0;
+  }
+  return swapped;
+}
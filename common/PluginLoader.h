@@ -0,0 +1,83 @@
+#ifndef PLUGIN_LOADER_H
+#define PLUGIN_LOADER_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Common
+{
+  class Compositor;
+  class IRendererFactory;
+
+  // Renderer modules built as shared objects (see RendererPlugin.h),
+  // loaded with dlopen and watched with inotify. A plugin's factory is
+  // registered in the Context under the plugin's name, replacing one the
+  // host links in, so that layers created by name come from the plugin.
+  // When the file is written again Update() loads the new version at the
+  // next frame boundary and swaps the compositor's layers of that name on
+  // the same context: ReleaseGl on the old renderer, InitializeGl on the
+  // new one. A version that fails to load leaves the running one in place.
+  // Each version is loaded from a private copy of the file, unlinked once
+  // open, so that the build can rewrite the file and the dynamic linker
+  // does not hand back the version already loaded. Replaced versions are
+  // closed; the last one stays loaded until the process exits, the
+  // Context keeps its factory until then. Linux only (inotify).
+  class PluginLoader
+  {
+  public:
+    struct Swap
+    {
+      std::string name;
+      bool loaded;
+      // Copy, dlopen and entry point
+      double load_milliseconds;
+      // Old renderers released, new ones created and initialized
+      double gl_milliseconds;
+      size_t layers;
+    };
+
+    PluginLoader();
+    virtual ~PluginLoader();
+    // libtriangle-plugin.so is triangle
+    static std::string GetPluginName(const std::string &path);
+    // Registers the plugin's factory under its name and watches the file,
+    // before the layers are created. False when it cannot be loaded
+    bool Load(const std::string &path);
+    // Comma separated paths, false at the first one that cannot be loaded
+    bool LoadPlugins(const std::string &paths);
+    size_t GetPluginCount() const { return _plugins.size(); }
+
+    // Frame boundary, on the GL thread with the context current: reloads
+    // the plugins whose file was written since and swaps their layers.
+    // Returns the number of plugins swapped
+    size_t Update(Compositor *compositor);
+    // Reloads every plugin whether its file changed or not
+    size_t ReloadAll(Compositor *compositor);
+    // Every reload, successful or not, in order
+    const std::vector<Swap> &GetSwaps() const { return _swaps; }
+  private:
+    struct Plugin
+    {
+      std::string name;
+      std::string path;
+      std::string directory;
+      std::string file;
+      void *library;
+      bool changed;
+    };
+    // Opens a private copy of the file, NULL (and an error printed) on failure
+    void *Open(const std::string &path, IRendererFactory *&factory);
+    bool Reload(Plugin &plugin, Compositor *compositor);
+    void ReadEvents();
+
+    std::vector<Plugin> _plugins;
+    std::vector<Swap> _swaps;
+    int _inotify;
+    // Watch descriptor of each watched directory
+    std::vector< std::pair<int, std::string> > _watches;
+    unsigned long _copies;
+  };
+}
+
+#endif
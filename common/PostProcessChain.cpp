@@ -0,0 +1,494 @@
+#include <math.h>
+#include <iostream>
+#include "PostProcessChain.h"
+#include "Context.h"
+#include "Extensions.h"
+#include "FrameProfiler.h"
+#include "GlStateCache.h"
+#include "ShaderCache.h"
+
+using namespace Common;
+
+namespace
+{
+  TimerQueries timerQueries = { NULL, NULL, NULL, NULL, NULL, NULL };
+
+  typedef std::chrono::steady_clock Clock;
+
+  const char *const VertexSource = R"glsl(
+    attribute vec2 position;
+    varying vec2 v_uv;
+    void main()
+    {
+      v_uv = position * 0.5 + 0.5;
+      gl_Position = vec4(position, 0.0, 1.0);
+    }
+  )glsl";
+
+  // Targets are larger than what was drawn in them, lookups are scaled to
+  // the drawn corner and clamped half a texel inside it
+  const char *const FragmentPrelude = R"glsl(
+    precision mediump float;
+    varying vec2 v_uv;
+    uniform sampler2D u_source;
+    uniform sampler2D u_scene;
+    uniform vec4 u_source_rect;
+    uniform vec4 u_scene_rect;
+    uniform vec2 u_texel;
+    vec4 Source(vec2 uv) { return texture2D(u_source, min(uv * u_source_rect.xy, u_source_rect.zw)); }
+    vec4 Scene(vec2 uv) { return texture2D(u_scene, min(uv * u_scene_rect.xy, u_scene_rect.zw)); }
+  )glsl";
+
+  const char *const CopySource = R"glsl(
+    void main() { gl_FragColor = Source(v_uv); }
+  )glsl";
+
+  const char *const BrightSource = R"glsl(
+    void main()
+    {
+      vec3 color = Source(v_uv).rgb;
+      float luminance = dot(color, vec3(0.2126, 0.7152, 0.0722));
+      gl_FragColor = vec4(color * smoothstep(0.5, 0.9, luminance), 1.0);
+    }
+  )glsl";
+
+  // 9 tap gaussian in 5 bilinear lookups
+  const char *const BlurHorizontalSource = R"glsl(
+    void main()
+    {
+      vec2 near = vec2(1.3846153846 * u_texel.x, 0.0);
+      vec2 far = vec2(3.2307692308 * u_texel.x, 0.0);
+      gl_FragColor = Source(v_uv) * 0.2270270270
+                   + (Source(v_uv - near) + Source(v_uv + near)) * 0.3162162162
+                   + (Source(v_uv - far) + Source(v_uv + far)) * 0.0702702703;
+    }
+  )glsl";
+
+  const char *const BlurVerticalSource = R"glsl(
+    void main()
+    {
+      vec2 near = vec2(0.0, 1.3846153846 * u_texel.y);
+      vec2 far = vec2(0.0, 3.2307692308 * u_texel.y);
+      gl_FragColor = Source(v_uv) * 0.2270270270
+                   + (Source(v_uv - near) + Source(v_uv + near)) * 0.3162162162
+                   + (Source(v_uv - far) + Source(v_uv + far)) * 0.0702702703;
+    }
+  )glsl";
+
+  const char *const BloomCompositeSource = R"glsl(
+    void main() { gl_FragColor = vec4(Scene(v_uv).rgb + Source(v_uv).rgb * 0.8, 1.0); }
+  )glsl";
+
+  const char *const VignetteSource = R"glsl(
+    void main()
+    {
+      vec2 offset = v_uv - 0.5;
+      gl_FragColor = vec4(Source(v_uv).rgb * (1.0 - dot(offset, offset) * 1.2), 1.0);
+    }
+  )glsl";
+
+  const char *const GrayscaleSource = R"glsl(
+    void main()
+    {
+      float luminance = dot(Source(v_uv).rgb, vec3(0.2126, 0.7152, 0.0722));
+      gl_FragColor = vec4(vec3(luminance), 1.0);
+    }
+  )glsl";
+
+  // A triangle covering the viewport, no diagonal seam
+  const GLfloat FullScreenTriangle[] = { -1.0f, -1.0f, 3.0f, -1.0f, -1.0f, 3.0f };
+
+  int scaled(int size, float scale)
+  {
+    int value = (int)ceilf(size * scale);
+    return value > 0 ? value : 1;
+  }
+}
+
+PostProcessChain::PostProcessChain()
+{
+  _copy.name = "copy";
+  _copy.source = CopySource;
+  _copy.scale = 1.0f;
+  _copy.program = 0;
+  _initialized = false;
+  _depth = false;
+  _width = 0;
+  _height = 0;
+  _render_width = 0;
+  _render_height = 0;
+  _resolution.SetRange(1.0f, 1.0f);
+  _output_framebuffer = 0;
+  _scene = NULL;
+  _gpu_timed = false;
+  for (unsigned int i = 0; i < FramesInFlight; ++i)
+  {
+    _timers[i].waiting = false;
+  }
+  _timer_index = 0;
+  _timing = false;
+  _state = Context::Instance()->GetGlStateCache();
+  _shaders = Context::Instance()->GetShaderCache();
+  _profiler = Context::Instance()->GetFrameProfiler();
+  _targets = Context::Instance()->GetRenderTargetPool();
+}
+
+PostProcessChain::~PostProcessChain()
+{
+}
+
+void PostProcessChain::AddPass(const std::string &name, const char *fragment_source, float scale)
+{
+  Pass pass;
+  pass.name = name;
+  pass.source = fragment_source;
+  pass.scale = scale > 0.0f ? scale : 1.0f;
+  pass.program = 0;
+  if (_initialized)
+  {
+    Compile(pass);
+  }
+  _passes.push_back(pass);
+}
+
+bool PostProcessChain::AddEffects(const std::string &names)
+{
+  // Every name is checked before any pass is added
+  std::vector<std::string> split;
+  size_t begin = 0;
+  for (;;)
+  {
+    size_t comma = names.find(',', begin);
+    std::string name = names.substr(begin, comma == std::string::npos ? std::string::npos : comma - begin);
+    if (name != "bloom" && name != "vignette" && name != "grayscale")
+    {
+      std::cerr<<"Unknown effect "<<name<<std::endl;
+      return false;
+    }
+    split.push_back(name);
+    if (comma == std::string::npos)
+    {
+      break;
+    }
+    begin = comma + 1;
+  }
+  for (size_t i = 0; i < split.size(); ++i)
+  {
+    if (split[i] == "bloom")
+    {
+      AddPass("bloom bright", BrightSource, 0.5f);
+      AddPass("bloom blur horizontal", BlurHorizontalSource, 0.5f);
+      AddPass("bloom blur vertical", BlurVerticalSource, 0.5f);
+      AddPass("bloom composite", BloomCompositeSource);
+    }
+    else if (split[i] == "vignette")
+    {
+      AddPass("vignette", VignetteSource);
+    }
+    else
+    {
+      AddPass("grayscale", GrayscaleSource);
+    }
+  }
+  return true;
+}
+
+void PostProcessChain::ClearPasses()
+{
+  for (size_t i = 0; i < _passes.size(); ++i)
+  {
+    if (_passes[i].program != 0)
+    {
+      _shaders->Release(_passes[i].program);
+    }
+  }
+  _passes.clear();
+}
+
+void PostProcessChain::SetRenderScale(float scale)
+{
+  _resolution.SetTarget(0.0);
+  _resolution.SetRange(scale, scale);
+}
+
+void PostProcessChain::SetDynamicResolution(double target_milliseconds, float minimum)
+{
+  _resolution.SetRange(minimum, 1.0f);
+  _resolution.SetTarget(target_milliseconds);
+}
+
+void PostProcessChain::Compile(Pass &pass)
+{
+  std::string fragment = std::string(FragmentPrelude) + pass.source;
+  pass.program = _shaders->Request(VertexSource, fragment.c_str());
+  if (!_shaders->Resolve(pass.program))
+  {
+    std::cerr<<"Post process pass "<<pass.name<<" does not link"<<std::endl;
+  }
+  pass.position_location = glGetAttribLocation(pass.program, "position");
+  pass.source_rect_location = glGetUniformLocation(pass.program, "u_source_rect");
+  pass.scene_rect_location = glGetUniformLocation(pass.program, "u_scene_rect");
+  pass.texel_location = glGetUniformLocation(pass.program, "u_texel");
+  _state->UseProgram(pass.program);
+  glUniform1i(glGetUniformLocation(pass.program, "u_source"), 0);
+  glUniform1i(glGetUniformLocation(pass.program, "u_scene"), 1);
+}
+
+void PostProcessChain::InitializeTimers()
+{
+  _gpu_timed = false;
+  timerQueries = LoadTimerQueries();
+  if (!timerQueries.IsLoaded())
+  {
+    return;
+  }
+  // Timestamps rather than an elapsed time query, the frame profiler may have one running
+  GLint bits = 0;
+  timerQueries.getQueryiv(GL_TIMESTAMP_EXT, GL_QUERY_COUNTER_BITS_EXT, &bits);
+  if (bits <= 0)
+  {
+    return;
+  }
+  for (unsigned int i = 0; i < FramesInFlight; ++i)
+  {
+    timerQueries.genQueries(2, _timers[i].queries);
+    _timers[i].waiting = false;
+  }
+  _timer_index = 0;
+  _gpu_timed = true;
+}
+
+void PostProcessChain::InitializeGl()
+{
+  // The context may be a new one, the old names are forgotten rather than deleted
+  _scene = NULL;
+  _vertex_buffer.Create("post");
+  _state->BindArrayBuffer(_vertex_buffer.Get());
+  glBufferData(GL_ARRAY_BUFFER, sizeof(FullScreenTriangle), FullScreenTriangle, GL_STATIC_DRAW);
+  _vertex_buffer.SetBytes(sizeof(FullScreenTriangle));
+  // Only a scaled scene without passes is copied, compiled the first time one is
+  _copy.program = 0;
+  for (size_t i = 0; i < _passes.size(); ++i)
+  {
+    Compile(_passes[i]);
+  }
+  InitializeTimers();
+  _timing = false;
+  _last_scene = Clock::time_point();
+  _resolution.Reset();
+  _initialized = true;
+}
+
+void PostProcessChain::ReleaseGl()
+{
+  if (!_initialized)
+  {
+    return;
+  }
+  if (_scene != NULL)
+  {
+    _targets->Release(_scene);
+    _scene = NULL;
+  }
+  _vertex_buffer.Reset();
+  if (_copy.program != 0)
+  {
+    _shaders->Release(_copy.program);
+    _copy.program = 0;
+  }
+  for (size_t i = 0; i < _passes.size(); ++i)
+  {
+    _shaders->Release(_passes[i].program);
+    _passes[i].program = 0;
+  }
+  if (_gpu_timed)
+  {
+    for (unsigned int i = 0; i < FramesInFlight; ++i)
+    {
+      timerQueries.deleteQueries(2, _timers[i].queries);
+    }
+    _gpu_timed = false;
+  }
+  _initialized = false;
+}
+
+void PostProcessChain::SetViewport(int width, int height)
+{
+  _width = width;
+  _height = height;
+}
+
+void PostProcessChain::BeginTimer()
+{
+  // The oldest frame in flight is read back when its result is there, never waited for
+  Timer &timer = _timers[_timer_index];
+  if (timer.waiting)
+  {
+    GLuint available = 0;
+    timerQueries.getQueryObjectuiv(timer.queries[1], GL_QUERY_RESULT_AVAILABLE_EXT, &available);
+    if (!available)
+    {
+      _timing = false;
+      return;
+    }
+    GLuint64 begin = 0;
+    GLuint64 end = 0;
+    timerQueries.getQueryObjectui64v(timer.queries[0], GL_QUERY_RESULT_EXT, &begin);
+    timerQueries.getQueryObjectui64v(timer.queries[1], GL_QUERY_RESULT_EXT, &end);
+    timer.waiting = false;
+    if (timer.disjoint_count == _profiler->GetDisjointCount() && end > begin)
+    {
+      _resolution.Update((end - begin) / 1000000.0);
+    }
+  }
+  timerQueries.queryCounter(timer.queries[0], GL_TIMESTAMP_EXT);
+  timer.disjoint_count = _profiler->GetDisjointCount();
+  _timing = true;
+}
+
+void PostProcessChain::EndTimer()
+{
+  if (!_timing)
+  {
+    return;
+  }
+  Timer &timer = _timers[_timer_index];
+  timerQueries.queryCounter(timer.queries[1], GL_TIMESTAMP_EXT);
+  timer.waiting = true;
+  _timer_index = (_timer_index + 1) % FramesInFlight;
+  _timing = false;
+}
+
+void PostProcessChain::BeginScene(int &width, int &height)
+{
+  width = _width;
+  height = _height;
+  if (!_initialized || _width <= 0 || _height <= 0)
+  {
+    return;
+  }
+  if (_resolution.IsEnabled())
+  {
+    if (_gpu_timed)
+    {
+      BeginTimer();
+    }
+    else
+    {
+      // Frame period: a frame bound by the GPU shows up as a longer wait in the swap
+      Clock::time_point now = Clock::now();
+      if (_last_scene != Clock::time_point())
+      {
+        _resolution.Update(std::chrono::duration<double, std::milli>(now - _last_scene).count());
+      }
+      _last_scene = now;
+    }
+  }
+
+  float scale = _resolution.GetScale();
+  _render_width = scaled(_width, scale);
+  _render_height = scaled(_height, scale);
+  if (_passes.empty() && _render_width == _width && _render_height == _height)
+  {
+    return;
+  }
+  if (_passes.empty() && _copy.program == 0)
+  {
+    Compile(_copy);
+  }
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &_output_framebuffer);
+  float maximum = _resolution.GetMaximum();
+  _scene = _targets->Acquire(scaled(_width, maximum), scaled(_height, maximum), GL_RGBA, GL_UNSIGNED_BYTE, _depth);
+  if (_scene == NULL)
+  {
+    // Drawn at full size straight to the output, without the passes
+    return;
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, _scene->framebuffer);
+  glViewport(0, 0, _render_width, _render_height);
+  width = _render_width;
+  height = _render_height;
+}
+
+void PostProcessChain::Draw(const Pass &pass, const RenderTargetPool::RenderTarget *source, int source_width, int source_height)
+{
+  _state->UseProgram(pass.program);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, source->texture);
+  glUniform4f(pass.source_rect_location,
+              (GLfloat)source_width / source->width, (GLfloat)source_height / source->height,
+              (source_width - 0.5f) / source->width, (source_height - 0.5f) / source->height);
+  glUniform2f(pass.texel_location, 1.0f / source_width, 1.0f / source_height);
+  glUniform4f(pass.scene_rect_location,
+              (GLfloat)_render_width / _scene->width, (GLfloat)_render_height / _scene->height,
+              (_render_width - 0.5f) / _scene->width, (_render_height - 0.5f) / _scene->height);
+  _state->BindArrayBuffer(_vertex_buffer.Get());
+  _state->SetEnabledVertexAttribArrays(GlStateCache::AttribBit(pass.position_location));
+  _state->VertexAttribPointer(pass.position_location, 2, GL_FLOAT, GL_FALSE, 0, 0);
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+void PostProcessChain::EndScene()
+{
+  if (_scene == NULL)
+  {
+    EndTimer();
+    return;
+  }
+
+  // Passes overwrite every pixel they cover
+  _state->SetBlend(false);
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, _scene->texture);
+
+  RenderTargetPool::RenderTarget *source = _scene;
+  int source_width = _render_width;
+  int source_height = _render_height;
+  size_t count = _passes.empty() ? 1 : _passes.size();
+  for (size_t i = 0; i < count; ++i)
+  {
+    const Pass &pass = _passes.empty() ? _copy : _passes[i];
+    RenderTargetPool::RenderTarget *target = NULL;
+    int target_width = _width;
+    int target_height = _height;
+    if (i + 1 < count)
+    {
+      float maximum = _resolution.GetMaximum();
+      target = _targets->Acquire(scaled(_width, maximum * pass.scale), scaled(_height, maximum * pass.scale));
+      if (target != NULL)
+      {
+        target_width = scaled(_render_width, pass.scale);
+        target_height = scaled(_render_height, pass.scale);
+      }
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, target != NULL ? target->framebuffer : (GLuint)_output_framebuffer);
+    glViewport(0, 0, target_width, target_height);
+    Draw(pass, source, source_width, source_height);
+    if (source != _scene)
+    {
+      _targets->Release(source);
+    }
+    if (target == NULL)
+    {
+      // Last pass, or no target left: the rest of the chain is skipped
+      source = NULL;
+      break;
+    }
+    source = target;
+    source_width = target_width;
+    source_height = target_height;
+  }
+  if (source != NULL && source != _scene)
+  {
+    _targets->Release(source);
+  }
+
+  // No texture stays bound to a unit while its framebuffer is drawn to next frame
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glActiveTexture(GL_TEXTURE0);
+  _targets->Release(_scene);
+  _scene = NULL;
+  EndTimer();
+}
@@ -0,0 +1,122 @@
+#ifndef POST_PROCESS_CHAIN_H
+#define POST_PROCESS_CHAIN_H
+
+#include <GLES2/gl2.h>
+#include <stdint.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "DynamicResolution.h"
+#include "GlHandle.h"
+#include "RenderTargetPool.h"
+
+namespace Common
+{
+  class FrameProfiler;
+  class GlStateCache;
+  class ShaderCache;
+
+  // Full screen passes run over a frame once it is drawn. BeginScene()
+  // redirects rendering to a pooled target at the render resolution,
+  // EndScene() runs the passes in order, each one reading the previous
+  // one's output (Source) and the scene (Scene), the last one writing to
+  // the framebuffer that was bound when the scene began. A pass may run at
+  // a fraction of the resolution, bloom blurs at half size for instance.
+  //
+  // The render resolution is the output size times a scale, fixed or
+  // picked by a DynamicResolution from the measured GPU time of the frame
+  // (GL_EXT_disjoint_timer_query timestamps, read back a few frames late
+  // and dropped when the FrameProfiler saw a disjoint operation meanwhile),
+  // or from the CPU frame interval without the extension. Targets are
+  // sized for the largest scale and drawn to in their lower left corner,
+  // a scale change reallocates nothing. With no pass and a scale of 1 the
+  // frame goes straight to the output framebuffer.
+  //
+  // Pass sources are the body of a fragment shader, after a prelude that
+  // declares v_uv (0 to 1 over the output), u_texel (size of a Source
+  // texel in v_uv units), Source(uv) and Scene(uv).
+  class PostProcessChain
+  {
+  public:
+    static const unsigned int FramesInFlight = 3;
+
+    PostProcessChain();
+    virtual ~PostProcessChain();
+
+    // Compiled right away when the chain is initialized
+    void AddPass(const std::string &name, const char *fragment_source, float scale = 1.0f);
+    // Built-in effects, comma separated: bloom, vignette, grayscale. False
+    // (and no pass added) when a name is unknown
+    bool AddEffects(const std::string &names);
+    void ClearPasses();
+    size_t GetPassCount() const { return _passes.size(); }
+    // Whether the scene target has a depth buffer
+    void SetDepth(bool depth) { _depth = depth; }
+
+    // A fixed fraction of the output size, disables dynamic resolution
+    void SetRenderScale(float scale);
+    // Scale between minimum and 1 that keeps frames under target milliseconds
+    void SetDynamicResolution(double target_milliseconds, float minimum = 0.5f);
+    float GetRenderScale() const { return _resolution.GetScale(); }
+    const DynamicResolution &GetDynamicResolution() const { return _resolution; }
+    bool IsGpuTimed() const { return _gpu_timed; }
+    // Whether frames are drawn through the scene target: passes, a scale below 1 or a dynamic one
+    bool IsActive() const { return !_passes.empty() || _resolution.IsEnabled() || _resolution.GetScale() < 1.0f; }
+
+    void InitializeGl();
+    void ReleaseGl();
+    // Output size
+    void SetViewport(int width, int height);
+    // Binds the scene target, width and height are set to the render size
+    void BeginScene(int &width, int &height);
+    void EndScene();
+  private:
+    struct Pass
+    {
+      std::string name;
+      std::string source;
+      float scale;
+      GLuint program;
+      GLint position_location;
+      GLint source_rect_location;
+      GLint scene_rect_location;
+      GLint texel_location;
+    };
+    struct Timer
+    {
+      GLuint queries[2];
+      bool waiting;
+      // FrameProfiler::GetDisjointCount() when the frame was timed
+      uint64_t disjoint_count;
+    };
+    void Compile(Pass &pass);
+    void Draw(const Pass &pass, const RenderTargetPool::RenderTarget *source, int source_width, int source_height);
+    void InitializeTimers();
+    void BeginTimer();
+    void EndTimer();
+    std::vector<Pass> _passes;
+    // Upscales the scene when there is no pass
+    Pass _copy;
+    bool _initialized;
+    bool _depth;
+    int _width;
+    int _height;
+    int _render_width;
+    int _render_height;
+    DynamicResolution _resolution;
+    GlBuffer _vertex_buffer;
+    GLint _output_framebuffer;
+    RenderTargetPool::RenderTarget *_scene;
+    bool _gpu_timed;
+    Timer _timers[FramesInFlight];
+    unsigned int _timer_index;
+    bool _timing;
+    std::chrono::steady_clock::time_point _last_scene;
+    GlStateCache *_state;
+    ShaderCache *_shaders;
+    RenderTargetPool *_targets;
+    FrameProfiler *_profiler;
+  };
+}
+
+#endif
@@ -0,0 +1,505 @@
+#include <iostream>
+#include "Compositor.h"
+#include "Context.h"
+#include "FrameProfiler.h"
+#include "GlResourceRegistry.h"
+#include "GlStateCache.h"
+#include "RenderLoop.h"
+#include "RenderTargetPool.h"
+#include "ShaderCache.h"
+#include "TextureManager.h"
+
+using namespace Common;
+
+namespace
+{
+  int64_t toNanoseconds(std::chrono::steady_clock::time_point time)
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+  }
+}
+
+RenderLoop::RenderLoop()
+{
+  _display = EGL_NO_DISPLAY;
+  _config = NULL;
+  _context = EGL_NO_CONTEXT;
+  _vsync = NULL;
+  _renderer = NULL;
+  ClearSurfaceRequest();
+  _request.surface_serial = 0;
+  _request.paused = false;
+  _request.stop = false;
+  _requested = 0;
+  _applied = 0;
+  _starting = false;
+  _running = false;
+  _surface = EGL_NO_SURFACE;
+  _window = (EGLNativeWindowType)0;
+  _offscreen_surface = false;
+  _surface_serial = 0;
+  _paused = false;
+  _frame_requested = false;
+  _gl_initialized = false;
+  _last_vsync = 0;
+  _period_milliseconds = 0.0;
+  _next_timing = 0;
+  ResetStats();
+}
+
+RenderLoop::~RenderLoop()
+{
+  Stop();
+}
+
+void RenderLoop::SetDamageTracking(bool enabled)
+{
+  _presenter.SetEnabled(enabled);
+}
+
+bool RenderLoop::Start(EGLDisplay display, IVsyncSource *vsync, Compositor *renderer)
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  if (_running || _starting)
+  {
+    return false;
+  }
+  _display = display;
+  _vsync = vsync;
+  _renderer = renderer;
+  _starting = true;
+  _thread = std::thread(&RenderLoop::Run, this);
+  while (_starting)
+  {
+    _changed.wait(lock);
+  }
+  bool running = _running;
+  lock.unlock();
+  if (!running)
+  {
+    _thread.join();
+  }
+  return running;
+}
+
+void RenderLoop::Stop()
+{
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _request.stop = true;
+    Submit(lock);
+  }
+  if (_thread.joinable())
+  {
+    _thread.join();
+  }
+  // A later Start begins without a surface
+  std::lock_guard<std::mutex> lock(_mutex);
+  ClearSurfaceRequest();
+  _request.stop = false;
+  _applied = _requested;
+}
+
+bool RenderLoop::IsRunning() const
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _running;
+}
+
+void RenderLoop::SetWindow(EGLNativeWindowType window)
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  ClearSurfaceRequest();
+  _request.window = window;
+  ++_request.surface_serial;
+  Submit(lock);
+}
+
+void RenderLoop::SetOffscreen(int width, int height)
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  ClearSurfaceRequest();
+  _request.offscreen = true;
+  _request.width = width;
+  _request.height = height;
+  ++_request.surface_serial;
+  Submit(lock);
+}
+
+void RenderLoop::SetPaused(bool paused)
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  _request.paused = paused;
+  Submit(lock);
+}
+
+void RenderLoop::ClearSurfaceRequest()
+{
+  _request.offscreen = false;
+  _request.window = (EGLNativeWindowType)0;
+  _request.width = 0;
+  _request.height = 0;
+}
+
+void RenderLoop::Submit(std::unique_lock<std::mutex> &lock)
+{
+  // Before Start the request waits for the loop, it is applied first thing
+  unsigned long ticket = ++_requested;
+  if (!_running)
+  {
+    return;
+  }
+  lock.unlock();
+  _vsync->Wake();
+  lock.lock();
+  while (_running && _applied < ticket)
+  {
+    _changed.wait(lock);
+  }
+}
+
+void RenderLoop::Run()
+{
+  _surface_serial = 0;
+  _paused = false;
+  _frame_requested = false;
+  _gl_initialized = false;
+  _last_vsync = 0;
+  bool created = _vsync->Attach() && CreateContext();
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _starting = false;
+    _running = created;
+    _changed.notify_all();
+  }
+  if (!created)
+  {
+    Release();
+    return;
+  }
+
+  while (ApplyRequests())
+  {
+    // Choreographer callbacks are one shot, a frame is asked for every blank
+    if (_surface != EGL_NO_SURFACE && !_paused && !_frame_requested)
+    {
+      _frame_requested = true;
+      _vsync->RequestFrame(this);
+    }
+    _vsync->Wait(-1);
+  }
+
+  Release();
+  std::lock_guard<std::mutex> lock(_mutex);
+  _running = false;
+  _changed.notify_all();
+}
+
+bool RenderLoop::CreateContext()
+{
+  // Windows on device, pbuffers off device: the first config with both, else either
+  const EGLint surface_types[] = { EGL_WINDOW_BIT | EGL_PBUFFER_BIT, EGL_WINDOW_BIT, EGL_PBUFFER_BIT };
+  EGLint configs_returned = 0;
+  for (size_t i = 0; i < sizeof(surface_types) / sizeof(surface_types[0]) && configs_returned != 1; ++i)
+  {
+    const EGLint configuration_attributes[] =
+    {
+      EGL_SURFACE_TYPE,     surface_types[i],
+      EGL_RENDERABLE_TYPE,  EGL_OPENGL_ES2_BIT,
+      EGL_RED_SIZE,         8,
+      EGL_GREEN_SIZE,       8,
+      EGL_BLUE_SIZE,        8,
+      EGL_NONE
+    };
+    if (!eglChooseConfig(_display, configuration_attributes, &_config, 1, &configs_returned))
+    {
+      configs_returned = 0;
+    }
+  }
+  if (configs_returned != 1)
+  {
+    std::cerr<<"Failed to choose a suitable config."<<std::endl;
+    return false;
+  }
+  // The API is bound per thread
+  if (eglBindAPI(EGL_OPENGL_ES_API) != EGL_TRUE)
+  {
+    std::cerr<<"eglBindAPI failed "<<eglGetError()<<std::endl;
+    return false;
+  }
+  const EGLint context_attributes[] =
+  {
+    EGL_CONTEXT_CLIENT_VERSION, 2,
+    EGL_NONE
+  };
+  _context = eglCreateContext(_display, _config, EGL_NO_CONTEXT, context_attributes);
+  if (_context == EGL_NO_CONTEXT)
+  {
+    std::cerr<<"eglCreateContext failed "<<eglGetError()<<std::endl;
+    return false;
+  }
+  // Programs and bindings the caches hold belong to another context
+  Context *context = Context::Instance();
+  context->GetShaderCache()->Reset();
+  context->GetGlStateCache()->Reset();
+  context->GetFrameProfiler()->Reset();
+  context->GetTextureManager()->Reset();
+  context->GetRenderTargetPool()->Reset();
+  context->GetGlResourceRegistry()->Reset();
+  return true;
+}
+
+bool RenderLoop::ApplyRequests()
+{
+  Request request;
+  unsigned long ticket;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    request = _request;
+    ticket = _requested;
+  }
+  if (request.stop)
+  {
+    return false;
+  }
+  if (request.paused != _paused)
+  {
+    // The time spent paused is neither simulated nor counted as missed blanks
+    _paused = request.paused;
+    _last_vsync = 0;
+    _timestep.Reset();
+  }
+  if (request.surface_serial != _surface_serial)
+  {
+    _surface_serial = request.surface_serial;
+    ChangeSurface(request);
+  }
+  std::lock_guard<std::mutex> lock(_mutex);
+  _applied = ticket;
+  _changed.notify_all();
+  return true;
+}
+
+void RenderLoop::ChangeSurface(const Request &request)
+{
+  bool window = !request.offscreen && request.window != (EGLNativeWindowType)0;
+  bool offscreen = request.offscreen && request.width > 0 && request.height > 0;
+  // The same window again was resized, the surface follows it
+  bool resized = window && _surface != EGL_NO_SURFACE && !_offscreen_surface && request.window == _window;
+  if (!resized)
+  {
+    DestroySurface();
+    if (!window && !offscreen)
+    {
+      return;
+    }
+    if (window)
+    {
+      _surface = eglCreateWindowSurface(_display, _config, request.window, NULL);
+    }
+    else
+    {
+      const EGLint surface_attributes[] =
+      {
+        EGL_WIDTH,  request.width,
+        EGL_HEIGHT, request.height,
+        EGL_NONE
+      };
+      _surface = eglCreatePbufferSurface(_display, _config, surface_attributes);
+    }
+    if (_surface == EGL_NO_SURFACE)
+    {
+      std::cerr<<"Failed to create the surface "<<eglGetError()<<std::endl;
+      return;
+    }
+    if (!eglMakeCurrent(_display, _surface, _surface, _context))
+    {
+      std::cerr<<"Failed to make the context current "<<eglGetError()<<std::endl;
+      DestroySurface();
+      return;
+    }
+    _window = request.window;
+    _offscreen_surface = offscreen;
+  }
+
+  EGLint width = 0;
+  EGLint height = 0;
+  eglQuerySurface(_display, _surface, EGL_WIDTH, &width);
+  eglQuerySurface(_display, _surface, EGL_HEIGHT, &height);
+  if (!_gl_initialized)
+  {
+    _renderer->InitializeGl();
+    _gl_initialized = true;
+  }
+  _renderer->SetViewport(width, height);
+  // A new surface holds none of the previous frames
+  _renderer->Invalidate();
+  if (_offscreen_surface)
+  {
+    _presenter.InitializeOffscreen(width, height);
+  }
+  else
+  {
+    _presenter.Initialize(_display, _surface);
+  }
+  _last_vsync = 0;
+  _timestep.Reset();
+  if (!resized)
+  {
+    std::lock_guard<std::mutex> lock(_stats_mutex);
+    ++_stats.surfaces;
+  }
+}
+
+void RenderLoop::DestroySurface()
+{
+  if (_surface == EGL_NO_SURFACE)
+  {
+    return;
+  }
+  // Not current anymore, the surface goes at once and its window with it
+  eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  eglDestroySurface(_display, _surface);
+  _surface = EGL_NO_SURFACE;
+  _window = (EGLNativeWindowType)0;
+}
+
+void RenderLoop::Release()
+{
+  if (_context != EGL_NO_CONTEXT)
+  {
+    // Without a surface, only a surfaceless context can release the renderer
+    bool current = _surface != EGL_NO_SURFACE
+      ? eglMakeCurrent(_display, _surface, _surface, _context) == EGL_TRUE
+      : eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, _context) == EGL_TRUE;
+    if (_gl_initialized && current)
+    {
+      _renderer->ReleaseGl();
+      Context::Instance()->GetFrameProfiler()->ReleaseGl();
+    }
+    else if (_gl_initialized)
+    {
+      std::cerr<<"No surface to release the renderers on, their resources go with the context"<<std::endl;
+    }
+    _gl_initialized = false;
+    DestroySurface();
+    eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(_display, _context);
+    _context = EGL_NO_CONTEXT;
+  }
+  _vsync->Detach();
+  eglReleaseThread();
+}
+
+void RenderLoop::OnVsync(int64_t vsync_nanoseconds)
+{
+  _frame_requested = false;
+  // Asked for before the surface went or the loop paused
+  if (_surface == EGL_NO_SURFACE || _paused)
+  {
+    return;
+  }
+  Clock::time_point start = Clock::now();
+  FrameTiming timing;
+  timing.latency_milliseconds = (toNanoseconds(start) - vsync_nanoseconds) / 1000000.0;
+  timing.interval_milliseconds = _last_vsync != 0 ? (vsync_nanoseconds - _last_vsync) / 1000000.0 : 0.0;
+  _last_vsync = vsync_nanoseconds;
+  unsigned long missed = 0;
+  if (timing.interval_milliseconds > 0.0)
+  {
+    if (_period_milliseconds <= 0.0 || timing.interval_milliseconds < _period_milliseconds)
+    {
+      _period_milliseconds = timing.interval_milliseconds;
+    }
+    double periods = timing.interval_milliseconds / _period_milliseconds;
+    if (periods > 1.5)
+    {
+      missed = (unsigned long)(periods + 0.5) - 1;
+    }
+  }
+
+  FrameProfiler *profiler = Context::Instance()->GetFrameProfiler();
+  profiler->BeginFrame();
+  profiler->BeginMarker("Update");
+  unsigned int steps = _timestep.Advance();
+  for (unsigned int step = 0; step < steps; ++step)
+  {
+    _renderer->Update(_timestep.GetStep());
+  }
+  profiler->EndMarker();
+  timing.presented = _presenter.BeginFrame(_renderer);
+  if (timing.presented)
+  {
+    _renderer->SetRepaintRegion(_presenter.GetRepaintRegion());
+    _renderer->DrawFrame();
+    profiler->BeginMarker("SwapBuffers");
+    if (!_presenter.Present())
+    {
+      std::cerr<<"eglSwapBuffers failed "<<eglGetError()<<std::endl;
+    }
+    profiler->EndMarker();
+  }
+  else
+  {
+    _renderer->SkipFrame();
+  }
+  profiler->EndFrame();
+  timing.frame_milliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  RecordFrame(timing, missed);
+}
+
+void RenderLoop::RecordFrame(const FrameTiming &timing, unsigned long missed)
+{
+  std::lock_guard<std::mutex> lock(_stats_mutex);
+  ++_stats.vsyncs;
+  if (timing.presented)
+  {
+    ++_stats.presented;
+  }
+  else
+  {
+    ++_stats.skipped;
+  }
+  _stats.missed += missed;
+  _stats.period_milliseconds = _period_milliseconds;
+  if (_timings.size() < MaxTimings)
+  {
+    _timings.push_back(timing);
+  }
+  else
+  {
+    _timings[_next_timing] = timing;
+  }
+  _next_timing = (_next_timing + 1) % MaxTimings;
+}
+
+RenderLoop::Stats RenderLoop::GetStats() const
+{
+  std::lock_guard<std::mutex> lock(_stats_mutex);
+  return _stats;
+}
+
+std::vector<RenderLoop::FrameTiming> RenderLoop::GetTimings() const
+{
+  std::lock_guard<std::mutex> lock(_stats_mutex);
+  if (_timings.size() < MaxTimings)
+  {
+    return _timings;
+  }
+  std::vector<FrameTiming> timings(_timings.begin() + _next_timing, _timings.end());
+  timings.insert(timings.end(), _timings.begin(), _timings.begin() + _next_timing);
+  return timings;
+}
+
+void RenderLoop::ResetStats()
+{
+  std::lock_guard<std::mutex> lock(_stats_mutex);
+  _stats.vsyncs = 0;
+  _stats.presented = 0;
+  _stats.skipped = 0;
+  _stats.missed = 0;
+  _stats.surfaces = 0;
+  _stats.period_milliseconds = 0.0;
+  _timings.clear();
+  _next_timing = 0;
+}
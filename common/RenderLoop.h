@@ -0,0 +1,149 @@
+#ifndef RENDER_LOOP_H
+#define RENDER_LOOP_H
+
+#include <EGL/egl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "FixedTimestep.h"
+#include "IVsyncSource.h"
+#include "PartialPresenter.h"
+
+namespace Common
+{
+  class Compositor;
+
+  // Draws a compositor on a thread of its own, one frame per vertical
+  // blank of an IVsyncSource: the loop asks for a frame, sleeps in the
+  // source until the blank and then runs the simulation steps due, draws
+  // and presents. The thread owns an EGL context on the host's display,
+  // created at Start and kept while windows come and go: SetWindow only
+  // swaps the surface and returns once the old one is destroyed, which is
+  // what Android asks of surfaceDestroyed. Renderers are initialized on
+  // the first surface and released at Stop.
+  //
+  // Every frame records the interval since the previous blank, the
+  // latency from the blank to the callback and the time to draw and swap.
+  // The refresh period is the shortest interval seen, a longer interval
+  // counts the blanks it skipped as missed.
+  class RenderLoop : public IVsyncListener
+  {
+  public:
+    // Frame timings kept, the last four seconds at 60 Hz
+    static const size_t MaxTimings = 240;
+
+    struct FrameTiming
+    {
+      // Since the previous blank, 0 for the first frame on a surface
+      double interval_milliseconds;
+      // From the blank to the start of the frame
+      double latency_milliseconds;
+      // From the start of the frame to the end of the swap
+      double frame_milliseconds;
+      // False when the frame had no damage
+      bool presented;
+    };
+
+    struct Stats
+    {
+      unsigned long vsyncs;
+      unsigned long presented;
+      unsigned long skipped;
+      unsigned long missed;
+      // Surfaces created
+      unsigned long surfaces;
+      double period_milliseconds;
+    };
+
+    RenderLoop();
+    virtual ~RenderLoop();
+    // Before Start: frames without damage are not drawn (PartialPresenter)
+    void SetDamageTracking(bool enabled);
+    // The display is initialized by the host and outlives the loop; the
+    // source and the renderer stay the caller's. False when the context
+    // cannot be created
+    bool Start(EGLDisplay display, IVsyncSource *vsync, Compositor *renderer);
+    // Releases the renderer's GL resources and the context
+    void Stop();
+    bool IsRunning() const;
+
+    // Draws on a window from the next blank, 0 stops drawing. Called again
+    // with the same window after it was resized
+    void SetWindow(EGLNativeWindowType window);
+    // Draws on a pbuffer, for hosts without windows; 0 by 0 stops drawing
+    void SetOffscreen(int width, int height);
+    // No frame is asked for while paused, the surface stays
+    void SetPaused(bool paused);
+
+    Stats GetStats() const;
+    // Oldest first
+    std::vector<FrameTiming> GetTimings() const;
+    void ResetStats();
+
+    virtual void OnVsync(int64_t vsync_nanoseconds);
+  private:
+    typedef std::chrono::steady_clock Clock;
+
+    // What the host asked for, applied by the loop thread between frames
+    struct Request
+    {
+      bool offscreen;
+      EGLNativeWindowType window;
+      int width;
+      int height;
+      // Incremented by every SetWindow and SetOffscreen
+      unsigned long surface_serial;
+      bool paused;
+      bool stop;
+    };
+
+    void Run();
+    void ClearSurfaceRequest();
+    void Submit(std::unique_lock<std::mutex> &lock);
+    bool CreateContext();
+    bool ApplyRequests();
+    void ChangeSurface(const Request &request);
+    void DestroySurface();
+    void Release();
+    void RecordFrame(const FrameTiming &timing, unsigned long missed);
+
+    EGLDisplay _display;
+    EGLConfig _config;
+    EGLContext _context;
+    IVsyncSource *_vsync;
+    Compositor *_renderer;
+    std::thread _thread;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _changed;
+    Request _request;
+    unsigned long _requested;
+    unsigned long _applied;
+    bool _starting;
+    bool _running;
+
+    // Loop thread only
+    EGLSurface _surface;
+    EGLNativeWindowType _window;
+    bool _offscreen_surface;
+    unsigned long _surface_serial;
+    bool _paused;
+    bool _frame_requested;
+    bool _gl_initialized;
+    int64_t _last_vsync;
+    double _period_milliseconds;
+    FixedTimestep _timestep;
+    PartialPresenter _presenter;
+
+    mutable std::mutex _stats_mutex;
+    Stats _stats;
+    std::vector<FrameTiming> _timings;
+    size_t _next_timing;
+  };
+}
+
+#endif
@@ -0,0 +1,204 @@
+#include <iostream>
+#include "RenderTargetPool.h"
+#include "Context.h"
+#include "GlResourceRegistry.h"
+
+using namespace Common;
+
+RenderTargetPool::RenderTargetPool(unsigned int max_idle_frames)
+{
+  _max_idle_frames = max_idle_frames;
+  _frame = 0;
+  ResetStats();
+}
+
+RenderTargetPool::~RenderTargetPool()
+{
+  Reset();
+}
+
+void RenderTargetPool::Reset()
+{
+  for (size_t i = 0; i < _slots.size(); ++i)
+  {
+    delete _slots[i];
+  }
+  _slots.clear();
+  _stats.targets = 0;
+  _stats.acquired = 0;
+  _stats.bytes = 0;
+}
+
+void RenderTargetPool::ReleaseGl()
+{
+  for (size_t i = 0; i < _slots.size(); ++i)
+  {
+    Delete(_slots[i]->target);
+  }
+  Reset();
+}
+
+uint64_t RenderTargetPool::GetBytes(const RenderTarget &target)
+{
+  uint64_t pixels = (uint64_t)target.width * target.height;
+  uint64_t color = target.format == GL_RGB ? (target.type == GL_UNSIGNED_SHORT_5_6_5 ? 2 : 3) : 4;
+  return pixels * (color + (target.depth ? 2 : 0));
+}
+
+bool RenderTargetPool::Create(RenderTarget &target)
+{
+  GlResourceRegistry *registry = Context::Instance()->GetGlResourceRegistry();
+  GLint framebuffer = 0;
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer);
+
+  // No mipmaps and clamped edges, which ES 2 requires of non power of two textures
+  target.texture = registry->Create(GlResourceRegistry::Texture, "targets");
+  glBindTexture(GL_TEXTURE_2D, target.texture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexImage2D(GL_TEXTURE_2D, 0, target.format, target.width, target.height, 0, target.format, target.type, NULL);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  target.framebuffer = registry->Create(GlResourceRegistry::Framebuffer, "targets");
+  glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.texture, 0);
+  target.depth_buffer = 0;
+  if (target.depth)
+  {
+    target.depth_buffer = registry->Create(GlResourceRegistry::Renderbuffer, "targets");
+    glBindRenderbuffer(GL_RENDERBUFFER, target.depth_buffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16, target.width, target.height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, target.depth_buffer);
+  }
+  // The depth buffer is counted with the color
+  registry->SetBytes(GlResourceRegistry::Texture, target.texture, GetBytes(target));
+  GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)framebuffer);
+  if (status != GL_FRAMEBUFFER_COMPLETE)
+  {
+    std::cerr<<"Render target "<<target.width<<"x"<<target.height<<" incomplete "<<status<<std::endl;
+    Delete(target);
+    return false;
+  }
+  return true;
+}
+
+void RenderTargetPool::Delete(RenderTarget &target)
+{
+  // Deleted once the frames that drew to or sampled the target are done
+  GlResourceRegistry *registry = Context::Instance()->GetGlResourceRegistry();
+  registry->Release(GlResourceRegistry::Framebuffer, target.framebuffer);
+  registry->Release(GlResourceRegistry::Texture, target.texture);
+  if (target.depth_buffer != 0)
+  {
+    registry->Release(GlResourceRegistry::Renderbuffer, target.depth_buffer);
+  }
+  target.framebuffer = 0;
+  target.texture = 0;
+  target.depth_buffer = 0;
+}
+
+RenderTargetPool::RenderTarget *RenderTargetPool::Acquire(int width, int height, GLenum format, GLenum type, bool depth)
+{
+  if (width <= 0 || height <= 0)
+  {
+    return NULL;
+  }
+  for (size_t i = 0; i < _slots.size(); ++i)
+  {
+    Slot &slot = *_slots[i];
+    const RenderTarget &target = slot.target;
+    if (!slot.acquired && target.width == width && target.height == height
+        && target.format == format && target.type == type && target.depth == depth)
+    {
+      slot.acquired = true;
+      slot.last_frame = _frame;
+      ++_stats.reuses;
+      ++_stats.acquired;
+      return &slot.target;
+    }
+  }
+
+  Slot *slot = new Slot();
+  slot->target.width = width;
+  slot->target.height = height;
+  slot->target.format = format;
+  slot->target.type = type;
+  slot->target.depth = depth;
+  if (!Create(slot->target))
+  {
+    delete slot;
+    return NULL;
+  }
+  slot->acquired = true;
+  slot->last_frame = _frame;
+  _slots.push_back(slot);
+  ++_stats.allocations;
+  ++_stats.targets;
+  ++_stats.acquired;
+  _stats.bytes += GetBytes(slot->target);
+  return &slot->target;
+}
+
+void RenderTargetPool::Release(RenderTarget *target)
+{
+  for (size_t i = 0; i < _slots.size(); ++i)
+  {
+    if (&_slots[i]->target == target && _slots[i]->acquired)
+    {
+      _slots[i]->acquired = false;
+      _slots[i]->last_frame = _frame;
+      --_stats.acquired;
+      return;
+    }
+  }
+}
+
+void RenderTargetPool::EndFrame()
+{
+  ++_frame;
+  for (size_t i = 0; i < _slots.size();)
+  {
+    Slot *slot = _slots[i];
+    if (slot->acquired || _frame - slot->last_frame <= _max_idle_frames)
+    {
+      ++i;
+      continue;
+    }
+    _stats.bytes -= GetBytes(slot->target);
+    --_stats.targets;
+    ++_stats.evictions;
+    Delete(slot->target);
+    delete slot;
+    _slots[i] = _slots.back();
+    _slots.pop_back();
+  }
+}
+
+RenderTargetPool::Stats RenderTargetPool::GetStats() const
+{
+  return _stats;
+}
+
+void RenderTargetPool::ResetStats()
+{
+  // Live counts describe the pool, they survive a reset
+  size_t targets = 0;
+  size_t acquired = 0;
+  uint64_t bytes = 0;
+  for (size_t i = 0; i < _slots.size(); ++i)
+  {
+    ++targets;
+    acquired += _slots[i]->acquired ? 1 : 0;
+    bytes += GetBytes(_slots[i]->target);
+  }
+  _stats.allocations = 0;
+  _stats.reuses = 0;
+  _stats.evictions = 0;
+  _stats.targets = targets;
+  _stats.acquired = acquired;
+  _stats.bytes = bytes;
+}
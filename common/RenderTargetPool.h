@@ -0,0 +1,76 @@
+#ifndef RENDER_TARGET_POOL_H
+#define RENDER_TARGET_POOL_H
+
+#include <GLES2/gl2.h>
+#include <stdint.h>
+#include <vector>
+
+namespace Common
+{
+  // Transient offscreen targets: a framebuffer with a color texture and an
+  // optional depth renderbuffer. Acquire() hands out a free target of the
+  // same size and format when there is one, so passes that need the same
+  // targets every frame allocate nothing once warmed up. Targets nobody
+  // acquired for a number of frames, after a resize for instance, are
+  // deleted by EndFrame(). Every method belongs to the GL thread.
+  class RenderTargetPool
+  {
+  public:
+    struct RenderTarget
+    {
+      GLuint framebuffer;
+      GLuint texture;
+      // 0 without depth
+      GLuint depth_buffer;
+      int width;
+      int height;
+      GLenum format;
+      GLenum type;
+      bool depth;
+    };
+
+    struct Stats
+    {
+      unsigned long allocations;
+      unsigned long reuses;
+      unsigned long evictions;
+      size_t targets;
+      size_t acquired;
+      uint64_t bytes;
+    };
+
+    explicit RenderTargetPool(unsigned int max_idle_frames = 60);
+    // Targets are left to the context
+    virtual ~RenderTargetPool();
+    // Forgets the targets without deleting them, for a lost context
+    void Reset();
+    void ReleaseGl();
+
+    // NULL when the driver cannot render to this format, the framebuffer
+    // binding is left unchanged
+    RenderTarget *Acquire(int width, int height, GLenum format = GL_RGBA, GLenum type = GL_UNSIGNED_BYTE, bool depth = false);
+    void Release(RenderTarget *target);
+    // Called once per frame, deletes the targets idle for too long
+    void EndFrame();
+
+    Stats GetStats() const;
+    void ResetStats();
+  private:
+    struct Slot
+    {
+      RenderTarget target;
+      bool acquired;
+      unsigned long last_frame;
+    };
+    bool Create(RenderTarget &target);
+    void Delete(RenderTarget &target);
+    static uint64_t GetBytes(const RenderTarget &target);
+    // Pointers handed out stay valid while other slots come and go
+    std::vector<Slot *> _slots;
+    unsigned int _max_idle_frames;
+    unsigned long _frame;
+    Stats _stats;
+  };
+}
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef RENDERER_PLUGIN_H
+#define RENDERER_PLUGIN_H
+
+#include "IRendererFactory.h"
+
+// Symbol a renderer module built as a shared object exports, a function
+// returning a new factory that the host takes ownership of
+#define COMMON_RENDERER_PLUGIN_ENTRY_POINT "CommonCreateRendererFactory"
+
+// Defines the entry point, in one source file of the module:
+//   COMMON_RENDERER_PLUGIN(Triangle::RendererFactory)
+// Modules are built with hidden visibility so that their classes do not
+// bind to the copies the host links in, the entry point stays visible.
+#define COMMON_RENDERER_PLUGIN(factory) \
+  extern "C" __attribute__((visibility("default"))) Common::IRendererFactory *CommonCreateRendererFactory() \
+  { \
+    return new factory(); \
+  }
+
+namespace Common
+{
+  typedef IRendererFactory *(*RendererPluginEntryPoint)();
+}
+
+#endif
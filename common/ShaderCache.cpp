@@ -0,0 +1,384 @@
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <chrono>
+#include <iostream>
+#include "ShaderCache.h"
+#include <EGL/egl.h>
+#include <GLES2/gl2ext.h>
+#include "Context.h"
+#include "Extensions.h"
+#include "GlResourceRegistry.h"
+#include "Hash.h"
+
+using namespace Common;
+
+namespace
+{
+  typedef std::chrono::steady_clock Clock;
+
+  const uint32_t BinaryMagic = 0x42504c47; // "GLPB"
+
+  struct BinaryHeader
+  {
+    uint32_t magic;
+    uint32_t format;
+    uint32_t length;
+  };
+
+  PFNGLGETPROGRAMBINARYOESPROC getProgramBinary = NULL;
+  PFNGLPROGRAMBINARYOESPROC programBinary = NULL;
+
+  double elapsedMilliseconds(Clock::time_point start)
+  {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  }
+
+  void logShader(const char *stage, GLuint shader)
+  {
+    GLint compiled = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    if (compiled)
+    {
+      return;
+    }
+    GLint length = 0;
+    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+    std::string log(length > 0 ? length : 1, '\0');
+    glGetShaderInfoLog(shader, (GLsizei)log.size(), NULL, &log[0]);
+    std::cerr<<stage<<" shader compile failed: "<<log.c_str()<<std::endl;
+  }
+
+  bool makeDirectories(const std::string &path)
+  {
+    for (size_t slash = path.find('/', 1); ; slash = path.find('/', slash + 1))
+    {
+      std::string prefix = path.substr(0, slash);
+      if (mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST)
+      {
+        return false;
+      }
+      if (slash == std::string::npos)
+      {
+        return true;
+      }
+    }
+  }
+}
+
+ShaderCache::ShaderCache()
+{
+  _extensions_initialized = false;
+  _binary_supported = false;
+  _parallel_supported = false;
+  _driver_hash = 0;
+}
+
+void ShaderCache::SetCacheDirectory(const std::string &path)
+{
+  if (!makeDirectories(path))
+  {
+    std::cerr<<"Unable to create shader cache directory "<<path<<std::endl;
+    return;
+  }
+  _directory = path;
+}
+
+void ShaderCache::Reset()
+{
+  _entries.clear();
+  _programs.clear();
+  _extensions_initialized = false;
+}
+
+void ShaderCache::InitializeExtensions()
+{
+  if (_extensions_initialized)
+  {
+    return;
+  }
+  _extensions_initialized = true;
+
+  GLint formats = 0;
+  if (HasGlExtension("GL_OES_get_program_binary"))
+  {
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS_OES, &formats);
+    getProgramBinary = (PFNGLGETPROGRAMBINARYOESPROC)eglGetProcAddress("glGetProgramBinaryOES");
+    programBinary = (PFNGLPROGRAMBINARYOESPROC)eglGetProcAddress("glProgramBinaryOES");
+  }
+  _binary_supported = formats > 0 && getProgramBinary != NULL && programBinary != NULL;
+
+  _parallel_supported = HasGlExtension("GL_KHR_parallel_shader_compile");
+  if (_parallel_supported)
+  {
+    PFNGLMAXSHADERCOMPILERTHREADSKHRPROC maxThreads =
+      (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)eglGetProcAddress("glMaxShaderCompilerThreadsKHR");
+    if (maxThreads != NULL)
+    {
+      // Let the driver pick the number of compiler threads
+      maxThreads(0xFFFFFFFF);
+    }
+  }
+
+  // Binaries are only valid for the driver that produced them
+  const char *renderer = (const char *)glGetString(GL_RENDERER);
+  const char *version = (const char *)glGetString(GL_VERSION);
+  _driver_hash = FnvOffset;
+  if (renderer != NULL)
+  {
+    _driver_hash = Fnv1a(_driver_hash, renderer, strlen(renderer));
+  }
+  if (version != NULL)
+  {
+    _driver_hash = Fnv1a(_driver_hash, version, strlen(version));
+  }
+}
+
+GLuint ShaderCache::Request(const char *vertex_source, const char *fragment_source)
+{
+  Clock::time_point start = Clock::now();
+  InitializeExtensions();
+
+  uint64_t hash = Fnv1a(FnvOffset, vertex_source, strlen(vertex_source) + 1);
+  hash = Fnv1a(hash, fragment_source, strlen(fragment_source));
+
+  // Probe past the (unlikely) programs whose sources collide on the hash
+  std::map<uint64_t, Entry>::iterator found;
+  while ((found = _entries.find(hash)) != _entries.end())
+  {
+    Entry &entry = found->second;
+    if (entry.vertex_source == vertex_source && entry.fragment_source == fragment_source)
+    {
+      ++entry.references;
+      return entry.program;
+    }
+    ++hash;
+  }
+
+  Entry &entry = _entries[hash];
+  entry.vertex_source = vertex_source;
+  entry.fragment_source = fragment_source;
+  entry.program = Context::Instance()->GetGlResourceRegistry()->Create(GlResourceRegistry::Program, "shaders");
+  entry.vertex_shader = 0;
+  entry.fragment_shader = 0;
+  entry.references = 1;
+  entry.resolved = false;
+  entry.stats.hash = hash;
+  entry.stats.linked = false;
+  entry.stats.warm = LoadBinary(entry);
+  if (!entry.stats.warm)
+  {
+    Compile(entry);
+  }
+  entry.stats.milliseconds = elapsedMilliseconds(start);
+  _programs[entry.program] = hash;
+  return entry.program;
+}
+
+void ShaderCache::Compile(Entry &entry)
+{
+  const char *vertex_source = entry.vertex_source.c_str();
+  const char *fragment_source = entry.fragment_source.c_str();
+  GlResourceRegistry *registry = Context::Instance()->GetGlResourceRegistry();
+  entry.vertex_shader = registry->Create(GlResourceRegistry::Shader, "shaders", GL_VERTEX_SHADER);
+  glShaderSource(entry.vertex_shader, 1, &vertex_source, NULL);
+  glCompileShader(entry.vertex_shader);
+  entry.fragment_shader = registry->Create(GlResourceRegistry::Shader, "shaders", GL_FRAGMENT_SHADER);
+  glShaderSource(entry.fragment_shader, 1, &fragment_source, NULL);
+  glCompileShader(entry.fragment_shader);
+  glAttachShader(entry.program, entry.vertex_shader);
+  glAttachShader(entry.program, entry.fragment_shader);
+  glLinkProgram(entry.program);
+}
+
+std::string ShaderCache::GetBinaryPath(uint64_t hash) const
+{
+  char name[64];
+  snprintf(name, sizeof(name), "/%016llx-%016llx.bin", (unsigned long long)hash, (unsigned long long)_driver_hash);
+  return _directory + name;
+}
+
+bool ShaderCache::LoadBinary(Entry &entry)
+{
+  if (!_binary_supported || _directory.empty())
+  {
+    return false;
+  }
+  std::string path = GetBinaryPath(entry.stats.hash);
+  FILE *file = fopen(path.c_str(), "rb");
+  if (file == NULL)
+  {
+    return false;
+  }
+  BinaryHeader header;
+  std::vector<char> binary;
+  struct stat status;
+  bool loaded = fread(&header, sizeof(header), 1, file) == 1 && header.magic == BinaryMagic
+             && fstat(fileno(file), &status) == 0;
+  // A truncated or corrupt file would size the binary from garbage: the
+  // length must account for the rest of the file exactly
+  loaded = loaded && header.length > 0 && (uint64_t)status.st_size == sizeof(header) + (uint64_t)header.length;
+  if (loaded)
+  {
+    binary.resize(header.length);
+    loaded = fread(&binary[0], 1, binary.size(), file) == binary.size();
+  }
+  fclose(file);
+  if (!loaded)
+  {
+    // A miss, the program is compiled and stored again
+    remove(path.c_str());
+    return false;
+  }
+  programBinary(entry.program, header.format, &binary[0], (GLint)binary.size());
+  return true;
+}
+
+void ShaderCache::StoreBinary(Entry &entry)
+{
+  if (!_binary_supported || _directory.empty())
+  {
+    return;
+  }
+  GLint length = 0;
+  glGetProgramiv(entry.program, GL_PROGRAM_BINARY_LENGTH_OES, &length);
+  if (length <= 0)
+  {
+    return;
+  }
+  std::vector<char> binary(length);
+  BinaryHeader header;
+  GLenum format = 0;
+  GLsizei written = 0;
+  getProgramBinary(entry.program, length, &written, &format, &binary[0]);
+  if (written <= 0)
+  {
+    return;
+  }
+  header.magic = BinaryMagic;
+  header.format = format;
+  header.length = (uint32_t)written;
+
+  // Written aside and renamed, a concurrent start never reads half a file
+  std::string path = GetBinaryPath(entry.stats.hash);
+  std::string temporary = path + ".tmp";
+  FILE *file = fopen(temporary.c_str(), "wb");
+  if (file == NULL)
+  {
+    return;
+  }
+  bool stored = fwrite(&header, sizeof(header), 1, file) == 1
+             && fwrite(&binary[0], 1, written, file) == (size_t)written;
+  stored = fclose(file) == 0 && stored;
+  if (!stored || rename(temporary.c_str(), path.c_str()) != 0)
+  {
+    remove(temporary.c_str());
+  }
+}
+
+bool ShaderCache::IsReady(GLuint program)
+{
+  if (!_parallel_supported)
+  {
+    return true;
+  }
+  GLint done = GL_TRUE;
+  glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &done);
+  return done == GL_TRUE;
+}
+
+bool ShaderCache::Resolve(GLuint program)
+{
+  std::map<GLuint, uint64_t>::iterator found = _programs.find(program);
+  if (found == _programs.end())
+  {
+    return false;
+  }
+  Entry &entry = _entries[found->second];
+  if (entry.resolved)
+  {
+    return entry.stats.linked;
+  }
+
+  Clock::time_point start = Clock::now();
+  GLint linked = GL_FALSE;
+  glGetProgramiv(entry.program, GL_LINK_STATUS, &linked);
+  if (!linked && entry.stats.warm)
+  {
+    // Binary rejected (driver update): compile from source and store it again
+    entry.stats.warm = false;
+    Compile(entry);
+    glGetProgramiv(entry.program, GL_LINK_STATUS, &linked);
+  }
+  if (!linked)
+  {
+    logShader("Vertex", entry.vertex_shader);
+    logShader("Fragment", entry.fragment_shader);
+    GLint length = 0;
+    glGetProgramiv(entry.program, GL_INFO_LOG_LENGTH, &length);
+    std::string log(length > 0 ? length : 1, '\0');
+    glGetProgramInfoLog(entry.program, (GLsizei)log.size(), NULL, &log[0]);
+    std::cerr<<"Program link failed: "<<log.c_str()<<std::endl;
+  }
+  else if (!entry.stats.warm)
+  {
+    StoreBinary(entry);
+  }
+
+  // The program keeps what it needs from linked shaders
+  GlResourceRegistry *registry = Context::Instance()->GetGlResourceRegistry();
+  if (entry.vertex_shader != 0)
+  {
+    glDetachShader(entry.program, entry.vertex_shader);
+    registry->Release(GlResourceRegistry::Shader, entry.vertex_shader);
+    entry.vertex_shader = 0;
+  }
+  if (entry.fragment_shader != 0)
+  {
+    glDetachShader(entry.program, entry.fragment_shader);
+    registry->Release(GlResourceRegistry::Shader, entry.fragment_shader);
+    entry.fragment_shader = 0;
+  }
+  entry.resolved = true;
+  entry.stats.linked = linked == GL_TRUE;
+  entry.stats.milliseconds += elapsedMilliseconds(start);
+  return entry.stats.linked;
+}
+
+void ShaderCache::Release(GLuint program)
+{
+  std::map<GLuint, uint64_t>::iterator found = _programs.find(program);
+  if (found == _programs.end())
+  {
+    return;
+  }
+  std::map<uint64_t, Entry>::iterator entry = _entries.find(found->second);
+  if (--entry->second.references > 0)
+  {
+    return;
+  }
+  // Deleted once the frames drawn with it are done
+  GlResourceRegistry *registry = Context::Instance()->GetGlResourceRegistry();
+  if (entry->second.vertex_shader != 0)
+  {
+    registry->Release(GlResourceRegistry::Shader, entry->second.vertex_shader);
+  }
+  if (entry->second.fragment_shader != 0)
+  {
+    registry->Release(GlResourceRegistry::Shader, entry->second.fragment_shader);
+  }
+  registry->Release(GlResourceRegistry::Program, program);
+  _entries.erase(entry);
+  _programs.erase(found);
+}
+
+std::vector<ShaderCache::ProgramStats> ShaderCache::GetStats() const
+{
+  std::vector<ProgramStats> stats;
+  for (std::map<uint64_t, Entry>::const_iterator i = _entries.begin(); i != _entries.end(); ++i)
+  {
+    stats.push_back(i->second.stats);
+  }
+  return stats;
+}
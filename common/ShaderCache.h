@@ -0,0 +1,75 @@
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+
+#include <GLES2/gl2.h>
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace Common
+{
+  // Programs keyed by a hash of their sources, shared by every renderer of
+  // a context. Request() only issues the compile and link commands so that
+  // drivers compiling in the background are not waited for; the status is
+  // queried by Resolve(), ideally once the renderer has done its other setup.
+  // With GL_OES_get_program_binary and a cache directory, linked programs
+  // are stored on disk and reloaded on the next start instead of compiled.
+  class ShaderCache
+  {
+  public:
+    struct ProgramStats
+    {
+      uint64_t hash;
+      // Loaded from a program binary rather than compiled
+      bool warm;
+      bool linked;
+      // CPU time spent in Request and Resolve
+      double milliseconds;
+    };
+
+    ShaderCache();
+    virtual ~ShaderCache(){}
+    // Enables the on-disk binary cache, created if missing
+    void SetCacheDirectory(const std::string &path);
+    // Forgets every program without deleting them, for a lost context
+    void Reset();
+
+    GLuint Request(const char *vertex_source, const char *fragment_source);
+    // Waits for the link, logs errors and stores the binary of a cold program
+    bool Resolve(GLuint program);
+    // Non blocking completion check (GL_KHR_parallel_shader_compile)
+    bool IsReady(GLuint program);
+    // Drops a reference, the program is deleted with the last one
+    void Release(GLuint program);
+
+    std::vector<ProgramStats> GetStats() const;
+  private:
+    struct Entry
+    {
+      std::string vertex_source;
+      std::string fragment_source;
+      GLuint program;
+      // Kept until Resolve for their info logs
+      GLuint vertex_shader;
+      GLuint fragment_shader;
+      unsigned int references;
+      bool resolved;
+      ProgramStats stats;
+    };
+    void InitializeExtensions();
+    void Compile(Entry &entry);
+    bool LoadBinary(Entry &entry);
+    void StoreBinary(Entry &entry);
+    std::string GetBinaryPath(uint64_t hash) const;
+    bool _extensions_initialized;
+    bool _binary_supported;
+    bool _parallel_supported;
+    uint64_t _driver_hash;
+    std::string _directory;
+    std::map<uint64_t, Entry> _entries;
+    std::map<GLuint, uint64_t> _programs;
+  };
+}
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+
+namespace Common
+{
+  // Bounded lock-free queue for exactly one producer thread and one consumer
+  // thread. Capacity must be a power of two.
+  template <typename T, size_t Capacity>
+  class SpscQueue
+  {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+  public:
+    SpscQueue() : _head(0), _tail(0) {}
+
+    // Producer side. Returns false when the queue is full.
+    bool Push(const T &value)
+    {
+      size_t tail = _tail.load(std::memory_order_relaxed);
+      if (tail - _head.load(std::memory_order_acquire) == Capacity)
+      {
+        return false;
+      }
+      _items[tail & (Capacity - 1)] = value;
+      _tail.store(tail + 1, std::memory_order_release);
+      return true;
+    }
+
+    // Consumer side. Returns false when the queue is empty.
+    bool Pop(T &value)
+    {
+      size_t head = _head.load(std::memory_order_relaxed);
+      if (head == _tail.load(std::memory_order_acquire))
+      {
+        return false;
+      }
+      value = _items[head & (Capacity - 1)];
+      _head.store(head + 1, std::memory_order_release);
+      return true;
+    }
+
+    bool IsEmpty() const
+    {
+      return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
+    }
+  private:
+    T _items[Capacity];
+    // Producer and consumer indices live on separate cache lines.
+    alignas(64) std::atomic<size_t> _head;
+    alignas(64) std::atomic<size_t> _tail;
+  };
+}
+
+#endif
@@ -0,0 +1,114 @@
+#include <stddef.h>
+#include "StreamingBuffer.h"
+#include "Context.h"
+#include "GlStateCache.h"
+
+using namespace Common;
+
+StreamingBuffer::StreamingBuffer(GLenum target, GLsizeiptr size, Strategy strategy)
+{
+  _target = target;
+  _size = size;
+  _strategy = strategy;
+  _position = 0;
+  _generation = 0;
+  for (unsigned int i = 0; i < FramesInFlight; ++i)
+  {
+    _frame_begin[i] = 0;
+  }
+  _frame = 0;
+  _bytes_uploaded = 0;
+  _wraps = 0;
+  _orphans = 0;
+  _stalls = 0;
+  _resizes = 0;
+  _state = Context::Instance()->GetGlStateCache();
+}
+
+void StreamingBuffer::InitializeGl(const char *owner)
+{
+  _buffer.Create(owner);
+  Bind();
+  Allocate();
+  _generation = _position;
+}
+
+void StreamingBuffer::ReleaseGl()
+{
+  _buffer.Reset();
+}
+
+void StreamingBuffer::Bind()
+{
+  if (_target == GL_ELEMENT_ARRAY_BUFFER)
+  {
+    _state->BindElementArrayBuffer(_buffer.Get());
+  }
+  else
+  {
+    _state->BindArrayBuffer(_buffer.Get());
+  }
+}
+
+void StreamingBuffer::Allocate()
+{
+  glBufferData(_target, _size, NULL, GL_STREAM_DRAW);
+  _buffer.SetBytes(_size);
+}
+
+void StreamingBuffer::NextFrame()
+{
+  ++_frame;
+  _frame_begin[_frame % FramesInFlight] = _position;
+}
+
+GLintptr StreamingBuffer::Upload(const GLvoid *data, GLsizeiptr size, GLsizeiptr alignment)
+{
+  Bind();
+  if (size > _size)
+  {
+    while (_size < size)
+    {
+      _size *= 2;
+    }
+    Allocate();
+    ++_resizes;
+    _generation = _position;
+  }
+
+  uint64_t offset = (_position - _generation) % _size;
+  uint64_t padding = (alignment - offset % alignment) % alignment;
+  if (offset + padding + size > (uint64_t)_size)
+  {
+    // Skip the tail, the upload restarts at the beginning of the buffer
+    ++_wraps;
+    _position += _size - offset;
+    offset = 0;
+    padding = 0;
+    if (_strategy == Orphan)
+    {
+      Allocate();
+      ++_orphans;
+      _generation = _position;
+    }
+  }
+  _position += padding;
+  offset += padding;
+
+  // The upload overwrites what was written one buffer size earlier in the
+  // same storage, a problem when that data belongs to a frame in flight.
+  uint64_t in_flight_begin = _frame_begin[(_frame + 1) % FramesInFlight];
+  if (in_flight_begin < _generation)
+  {
+    in_flight_begin = _generation;
+  }
+  if (_position + size > in_flight_begin + _size)
+  {
+    ++_stalls;
+  }
+
+  glBufferSubData(_target, (GLintptr)offset, size, data);
+  _position += size;
+  _bytes_uploaded += size;
+  return (GLintptr)offset;
+}
@@ -0,0 +1,67 @@
+#ifndef STREAMING_BUFFER_H
+#define STREAMING_BUFFER_H
+
+#include <GLES2/gl2.h>
+#include <stdint.h>
+#include "GlHandle.h"
+
+namespace Common
+{
+  class GlStateCache;
+
+  // Ring of per-frame dynamic data in one GL buffer object. Uploads are
+  // sub-allocated with glBufferSubData at increasing offsets, so a frame
+  // never overwrites a region the GPU may still read for an earlier one.
+  // On wrap the Orphan strategy reallocates the storage (glBufferData with
+  // NULL) so the driver hands out fresh memory instead of synchronising;
+  // the Ring strategy wraps in place and counts the uploads that land on
+  // data from a frame still in flight (a potential implicit sync).
+  class StreamingBuffer
+  {
+  public:
+    enum Strategy { Orphan, Ring };
+    static const unsigned int FramesInFlight = 3;
+
+    StreamingBuffer(GLenum target, GLsizeiptr size, Strategy strategy = Orphan);
+    virtual ~StreamingBuffer(){}
+    // The buffer is accounted to owner in the GlResourceRegistry
+    void InitializeGl(const char *owner = "stream");
+    void ReleaseGl();
+
+    // Marks the start of a frame, the oldest frame in flight is retired.
+    void NextFrame();
+    // Copies size bytes into the ring, binds the buffer and returns the
+    // offset of the data in it, suitable for glVertexAttribPointer or
+    // glDrawElements.
+    GLintptr Upload(const GLvoid *data, GLsizeiptr size, GLsizeiptr alignment = 4);
+
+    GLuint GetBuffer() const { return _buffer.Get(); }
+    GLsizeiptr GetSize() const { return _size; }
+    uint64_t GetBytesUploaded() const { return _bytes_uploaded; }
+    unsigned long GetWrapCount() const { return _wraps; }
+    unsigned long GetOrphanCount() const { return _orphans; }
+    unsigned long GetStallCount() const { return _stalls; }
+    unsigned long GetResizeCount() const { return _resizes; }
+  private:
+    void Bind();
+    void Allocate();
+    GLenum _target;
+    GLsizeiptr _size;
+    Strategy _strategy;
+    GlBuffer _buffer;
+    // Monotonic byte position, the buffer offset is relative to the
+    // position at which the current storage was allocated
+    uint64_t _position;
+    uint64_t _generation;
+    uint64_t _frame_begin[FramesInFlight];
+    unsigned long _frame;
+    uint64_t _bytes_uploaded;
+    unsigned long _wraps;
+    unsigned long _orphans;
+    unsigned long _stalls;
+    unsigned long _resizes;
+    GlStateCache *_state;
+  };
+}
+
+#endif
@@ -0,0 +1,493 @@
+#include <string.h>
+#include <zlib.h>
+#include "TextureDecoders.h"
+
+using namespace Common;
+
+namespace
+{
+  const uint8_t KtxIdentifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+  const uint32_t KtxEndianness = 0x04030201;
+
+  struct KtxHeader
+  {
+    uint8_t identifier[12];
+    uint32_t endianness;
+    uint32_t gl_type;
+    uint32_t gl_type_size;
+    uint32_t gl_format;
+    uint32_t gl_internal_format;
+    uint32_t gl_base_internal_format;
+    uint32_t pixel_width;
+    uint32_t pixel_height;
+    uint32_t pixel_depth;
+    uint32_t array_elements;
+    uint32_t faces;
+    uint32_t mip_levels;
+    uint32_t key_value_bytes;
+  };
+
+  const size_t PkmHeaderSize = 16;
+  const uint8_t PngSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+  // ETC1 intensity modifiers, indexed by table then by (msb << 1) | lsb
+  const int Etc1Modifiers[8][4] =
+  {
+    { 2, 8, -2, -8 },
+    { 5, 17, -5, -17 },
+    { 9, 29, -9, -29 },
+    { 13, 42, -13, -42 },
+    { 18, 60, -18, -60 },
+    { 24, 80, -24, -80 },
+    { 33, 106, -33, -106 },
+    { 47, 183, -47, -183 }
+  };
+
+  uint16_t readBigEndian16(const uint8_t *data)
+  {
+    return (uint16_t)((data[0] << 8) | data[1]);
+  }
+
+  uint32_t readBigEndian32(const uint8_t *data)
+  {
+    return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | data[3];
+  }
+
+  uint8_t clampByte(int value)
+  {
+    return (uint8_t)(value < 0 ? 0 : (value > 255 ? 255 : value));
+  }
+
+  int paeth(int a, int b, int c)
+  {
+    int p = a + b - c;
+    int pa = p > a ? p - a : a - p;
+    int pb = p > b ? p - b : b - p;
+    int pc = p > c ? p - c : c - p;
+    if (pa <= pb && pa <= pc)
+    {
+      return a;
+    }
+    return pb <= pc ? b : c;
+  }
+
+  // Sample x of a row packed at depth bits (1, 2, 4, 8 or 16, high byte)
+  int readSample(const uint8_t *row, size_t x, int depth)
+  {
+    if (depth == 8)
+    {
+      return row[x];
+    }
+    if (depth == 16)
+    {
+      return row[x * 2];
+    }
+    size_t bit = x * depth;
+    return (row[bit / 8] >> (8 - depth - bit % 8)) & ((1 << depth) - 1);
+  }
+
+  // Bytes per pixel of an uncompressed ES 2 format, 0 for an unknown one
+  size_t pixelBytes(uint32_t format, uint32_t type)
+  {
+    if (type == GL_UNSIGNED_SHORT_5_6_5 || type == GL_UNSIGNED_SHORT_4_4_4_4 || type == GL_UNSIGNED_SHORT_5_5_5_1)
+    {
+      return 2;
+    }
+    if (type != GL_UNSIGNED_BYTE)
+    {
+      return 0;
+    }
+    switch (format)
+    {
+    case GL_ALPHA: case GL_LUMINANCE: return 1;
+    case GL_LUMINANCE_ALPHA: return 2;
+    case GL_RGB: return 3;
+    case GL_RGBA: return 4;
+    default: return 0;
+    }
+  }
+}
+
+bool KtxDecoder::CanDecode(const uint8_t *data, size_t size) const
+{
+  return size >= sizeof(KtxIdentifier) && memcmp(data, KtxIdentifier, sizeof(KtxIdentifier)) == 0;
+}
+
+bool KtxDecoder::Decode(const uint8_t *data, size_t size, TextureImage &image) const
+{
+  KtxHeader header;
+  if (size < sizeof(header))
+  {
+    return false;
+  }
+  memcpy(&header, data, sizeof(header));
+  if (header.endianness != KtxEndianness || header.pixel_width == 0 || header.pixel_depth > 1
+      || header.array_elements > 1 || header.faces != 1)
+  {
+    return false;
+  }
+  image.compressed = header.gl_type == 0;
+  // OpenGL ES 2 wants the unsized format for uncompressed textures
+  image.internal_format = image.compressed ? header.gl_internal_format : header.gl_base_internal_format;
+  image.format = header.gl_format;
+  image.type = header.gl_type;
+  image.levels.clear();
+  // KTX rows are padded to 4 bytes, TextureImage rows are tight
+  size_t pixel_bytes = image.compressed ? 0 : pixelBytes(image.format, image.type);
+  if (!image.compressed && pixel_bytes == 0)
+  {
+    return false;
+  }
+
+  size_t offset = sizeof(header) + header.key_value_bytes;
+  uint32_t level_count = header.mip_levels > 0 ? header.mip_levels : 1;
+  for (uint32_t level = 0; level < level_count; ++level)
+  {
+    if (offset + 4 > size)
+    {
+      return false;
+    }
+    uint32_t image_size;
+    memcpy(&image_size, data + offset, sizeof(image_size));
+    offset += 4;
+    if (image_size > size - offset)
+    {
+      return false;
+    }
+    TextureImage::Level mip;
+    mip.width = header.pixel_width >> level > 0 ? header.pixel_width >> level : 1;
+    mip.height = header.pixel_height >> level > 0 ? header.pixel_height >> level : 1;
+    if (image.compressed)
+    {
+      mip.data.assign(data + offset, data + offset + image_size);
+    }
+    else
+    {
+      size_t row_bytes = (size_t)mip.width * pixel_bytes;
+      size_t padded_row_bytes = (row_bytes + 3) & ~(size_t)3;
+      if ((size_t)image_size < padded_row_bytes * mip.height)
+      {
+        return false;
+      }
+      mip.data.resize(row_bytes * mip.height);
+      for (int row = 0; row < mip.height; ++row)
+      {
+        memcpy(&mip.data[row * row_bytes], data + offset + row * padded_row_bytes, row_bytes);
+      }
+    }
+    image.levels.push_back(mip);
+    // Levels start on 4 byte boundaries
+    offset += (image_size + 3) & ~3u;
+  }
+  return true;
+}
+
+bool PkmDecoder::CanDecode(const uint8_t *data, size_t size) const
+{
+  return size >= PkmHeaderSize && memcmp(data, "PKM ", 4) == 0;
+}
+
+bool PkmDecoder::Decode(const uint8_t *data, size_t size, TextureImage &image) const
+{
+  bool etc2 = data[4] == '2';
+  uint16_t type = readBigEndian16(data + 6);
+  int padded_width = readBigEndian16(data + 8);
+  int padded_height = readBigEndian16(data + 10);
+  size_t block_size = 8;
+  if (!etc2 && type == 0)
+  {
+    image.internal_format = GL_ETC1_RGB8_OES;
+  }
+  else if (etc2 && type == 1)
+  {
+    image.internal_format = GL_COMPRESSED_RGB8_ETC2;
+  }
+  else if (etc2 && type == 3)
+  {
+    image.internal_format = GL_COMPRESSED_RGBA8_ETC2_EAC;
+    block_size = 16;
+  }
+  else if (etc2 && type == 4)
+  {
+    image.internal_format = GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2;
+  }
+  else
+  {
+    return false;
+  }
+
+  size_t data_size = (size_t)(padded_width / 4) * (padded_height / 4) * block_size;
+  if (data_size > size - PkmHeaderSize)
+  {
+    return false;
+  }
+  image.compressed = true;
+  image.format = 0;
+  image.type = 0;
+  image.levels.resize(1);
+  image.levels[0].width = readBigEndian16(data + 12);
+  image.levels[0].height = readBigEndian16(data + 14);
+  image.levels[0].data.assign(data + PkmHeaderSize, data + PkmHeaderSize + data_size);
+  return image.levels[0].width > 0 && image.levels[0].height > 0;
+}
+
+bool PngDecoder::CanDecode(const uint8_t *data, size_t size) const
+{
+  return size >= sizeof(PngSignature) && memcmp(data, PngSignature, sizeof(PngSignature)) == 0;
+}
+
+bool PngDecoder::Decode(const uint8_t *data, size_t size, TextureImage &image) const
+{
+  uint32_t width = 0;
+  uint32_t height = 0;
+  int depth = 0;
+  int color_type = 0;
+  std::vector<uint8_t> compressed;
+  uint8_t palette[256][4];
+  memset(palette, 255, sizeof(palette));
+
+  size_t offset = sizeof(PngSignature);
+  while (offset + 12 <= size)
+  {
+    uint32_t length = readBigEndian32(data + offset);
+    const uint8_t *type = data + offset + 4;
+    const uint8_t *chunk = data + offset + 8;
+    if (length > size - offset - 12)
+    {
+      return false;
+    }
+    if (memcmp(type, "IHDR", 4) == 0 && length >= 13)
+    {
+      width = readBigEndian32(chunk);
+      height = readBigEndian32(chunk + 4);
+      depth = chunk[8];
+      color_type = chunk[9];
+      // Adam7 interlacing is not supported
+      if (chunk[12] != 0)
+      {
+        return false;
+      }
+    }
+    else if (memcmp(type, "PLTE", 4) == 0)
+    {
+      for (uint32_t i = 0; i < length / 3 && i < 256; ++i)
+      {
+        memcpy(palette[i], chunk + i * 3, 3);
+      }
+    }
+    else if (memcmp(type, "tRNS", 4) == 0 && color_type == 3)
+    {
+      for (uint32_t i = 0; i < length && i < 256; ++i)
+      {
+        palette[i][3] = chunk[i];
+      }
+    }
+    else if (memcmp(type, "IDAT", 4) == 0)
+    {
+      compressed.insert(compressed.end(), chunk, chunk + length);
+    }
+    else if (memcmp(type, "IEND", 4) == 0)
+    {
+      break;
+    }
+    offset += length + 12;
+  }
+
+  int channels;
+  switch (color_type)
+  {
+  case 0: channels = 1; break;
+  case 2: channels = 3; break;
+  case 3: channels = 1; break;
+  case 4: channels = 2; break;
+  case 6: channels = 4; break;
+  default: return false;
+  }
+  if (width == 0 || height == 0 || (depth != 1 && depth != 2 && depth != 4 && depth != 8 && depth != 16))
+  {
+    return false;
+  }
+
+  // Every row starts with its filter type
+  size_t stride = ((size_t)width * channels * depth + 7) / 8;
+  size_t pixel_bytes = (channels * depth + 7) / 8;
+  std::vector<uint8_t> rows((stride + 1) * height);
+  uLongf inflated = rows.size();
+  if (uncompress(rows.data(), &inflated, compressed.data(), compressed.size()) != Z_OK || inflated != rows.size())
+  {
+    return false;
+  }
+
+  image.compressed = false;
+  image.internal_format = GL_RGBA;
+  image.format = GL_RGBA;
+  image.type = GL_UNSIGNED_BYTE;
+  image.levels.resize(1);
+  TextureImage::Level &level = image.levels[0];
+  level.width = width;
+  level.height = height;
+  level.data.resize((size_t)width * height * 4);
+
+  int sample_depth = depth == 16 ? 8 : depth;
+  int gray_scale = color_type == 3 ? 1 : 255 / ((1 << sample_depth) - 1);
+  const uint8_t *previous = NULL;
+  for (uint32_t y = 0; y < height; ++y)
+  {
+    uint8_t filter = rows[y * (stride + 1)];
+    uint8_t *row = &rows[y * (stride + 1) + 1];
+    for (size_t i = 0; i < stride; ++i)
+    {
+      int left = i >= pixel_bytes ? row[i - pixel_bytes] : 0;
+      int up = previous ? previous[i] : 0;
+      int up_left = previous && i >= pixel_bytes ? previous[i - pixel_bytes] : 0;
+      switch (filter)
+      {
+      case 0: break;
+      case 1: row[i] = (uint8_t)(row[i] + left); break;
+      case 2: row[i] = (uint8_t)(row[i] + up); break;
+      case 3: row[i] = (uint8_t)(row[i] + ((left + up) >> 1)); break;
+      case 4: row[i] = (uint8_t)(row[i] + paeth(left, up, up_left)); break;
+      default: return false;
+      }
+    }
+    previous = row;
+
+    uint8_t *out = &level.data[(size_t)y * width * 4];
+    for (uint32_t x = 0; x < width; ++x, out += 4)
+    {
+      if (color_type == 3)
+      {
+        memcpy(out, palette[readSample(row, x, depth)], 4);
+        continue;
+      }
+      int samples[4];
+      for (int c = 0; c < channels; ++c)
+      {
+        samples[c] = readSample(row, x * channels + c, depth) * gray_scale;
+      }
+      switch (channels)
+      {
+      case 1: out[0] = out[1] = out[2] = (uint8_t)samples[0]; out[3] = 255; break;
+      case 2: out[0] = out[1] = out[2] = (uint8_t)samples[0]; out[3] = (uint8_t)samples[1]; break;
+      case 3: out[0] = (uint8_t)samples[0]; out[1] = (uint8_t)samples[1]; out[2] = (uint8_t)samples[2]; out[3] = 255; break;
+      default: out[0] = (uint8_t)samples[0]; out[1] = (uint8_t)samples[1]; out[2] = (uint8_t)samples[2]; out[3] = (uint8_t)samples[3]; break;
+      }
+    }
+  }
+  return true;
+}
+
+bool Common::DecodeEtc1(const TextureImage &etc1, TextureImage &rgb)
+{
+  if (!etc1.compressed || etc1.internal_format != GL_ETC1_RGB8_OES)
+  {
+    return false;
+  }
+  rgb.compressed = false;
+  rgb.internal_format = GL_RGB;
+  rgb.format = GL_RGB;
+  rgb.type = GL_UNSIGNED_BYTE;
+  rgb.levels.resize(etc1.levels.size());
+  for (size_t l = 0; l < etc1.levels.size(); ++l)
+  {
+    const TextureImage::Level &in = etc1.levels[l];
+    TextureImage::Level &out = rgb.levels[l];
+    int blocks_x = (in.width + 3) / 4;
+    int blocks_y = (in.height + 3) / 4;
+    if (in.data.size() < (size_t)blocks_x * blocks_y * 8)
+    {
+      return false;
+    }
+    out.width = in.width;
+    out.height = in.height;
+    out.data.resize((size_t)in.width * in.height * 3);
+    const uint8_t *block = in.data.data();
+    for (int by = 0; by < blocks_y; ++by)
+    {
+      for (int bx = 0; bx < blocks_x; ++bx, block += 8)
+      {
+        // Two base colors, one per half block, differential or individual
+        int base[2][3];
+        bool differential = (block[3] & 2) != 0;
+        for (int c = 0; c < 3; ++c)
+        {
+          if (differential)
+          {
+            int first = block[c] >> 3;
+            int delta = block[c] & 7;
+            int second = first + (delta >= 4 ? delta - 8 : delta);
+            base[0][c] = (first << 3) | (first >> 2);
+            base[1][c] = ((second & 31) << 3) | ((second & 31) >> 2);
+          }
+          else
+          {
+            base[0][c] = (block[c] >> 4) * 17;
+            base[1][c] = (block[c] & 15) * 17;
+          }
+        }
+        int table[2] = { (block[3] >> 5) & 7, (block[3] >> 2) & 7 };
+        bool flip = (block[3] & 1) != 0;
+        int msb = readBigEndian16(block + 4);
+        int lsb = readBigEndian16(block + 6);
+        for (int x = 0; x < 4; ++x)
+        {
+          for (int y = 0; y < 4; ++y)
+          {
+            int px = bx * 4 + x;
+            int py = by * 4 + y;
+            if (px >= in.width || py >= in.height)
+            {
+              continue;
+            }
+            int half = flip ? y / 2 : x / 2;
+            int bit = x * 4 + y;
+            int modifier = Etc1Modifiers[table[half]][(((msb >> bit) & 1) << 1) | ((lsb >> bit) & 1)];
+            uint8_t *pixel = &out.data[((size_t)py * in.width + px) * 3];
+            for (int c = 0; c < 3; ++c)
+            {
+              pixel[c] = clampByte(base[half][c] + modifier);
+            }
+          }
+        }
+      }
+    }
+  }
+  return true;
+}
+
+void Common::GenerateMipmaps(TextureImage &image)
+{
+  if (image.compressed || image.type != GL_UNSIGNED_BYTE || image.levels.size() != 1
+      || (image.format != GL_RGBA && image.format != GL_RGB))
+  {
+    return;
+  }
+  size_t channels = image.format == GL_RGBA ? 4 : 3;
+  while (image.levels.back().width > 1 || image.levels.back().height > 1)
+  {
+    TextureImage::Level mip;
+    {
+      const TextureImage::Level &source = image.levels.back();
+      mip.width = source.width > 1 ? source.width / 2 : 1;
+      mip.height = source.height > 1 ? source.height / 2 : 1;
+      mip.data.resize(mip.width * mip.height * channels);
+      for (int y = 0; y < mip.height; ++y)
+      {
+        // Odd sizes drop the last row or column of the source
+        const uint8_t *row0 = &source.data[(size_t)(y * 2) * source.width * channels];
+        const uint8_t *row1 = source.height > 1 ? row0 + source.width * channels : row0;
+        for (int x = 0; x < mip.width; ++x)
+        {
+          size_t x0 = (size_t)x * 2 * channels;
+          size_t x1 = source.width > 1 ? x0 + channels : x0;
+          uint8_t *out = &mip.data[((size_t)y * mip.width + x) * channels];
+          for (size_t c = 0; c < channels; ++c)
+          {
+            out[c] = (uint8_t)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+          }
+        }
+      }
+    }
+    image.levels.push_back(mip);
+  }
+}
@@ -0,0 +1,52 @@
+#ifndef TEXTURE_DECODERS_H
+#define TEXTURE_DECODERS_H
+
+#include "ITextureDecoder.h"
+#include <GLES2/gl2ext.h>
+
+// OpenGL ES 3 core formats, the tree builds against the ES 2 headers
+#ifndef GL_COMPRESSED_RGB8_ETC2
+#define GL_COMPRESSED_RGB8_ETC2                      0x9274
+#define GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2  0x9276
+#define GL_COMPRESSED_RGBA8_ETC2_EAC                 0x9278
+#endif
+
+namespace Common
+{
+  // KTX 1.1 with a single face and layer, compressed or not, mip levels as
+  // stored in the file; uncompressed rows lose their padding to 4 bytes.
+  // Only files written in the host byte order.
+  class KtxDecoder : public ITextureDecoder
+  {
+  public:
+    bool CanDecode(const uint8_t *data, size_t size) const;
+    bool Decode(const uint8_t *data, size_t size, TextureImage &image) const;
+  };
+
+  // PKM as written by etcpack: version 10 is ETC1, version 20 is ETC2 RGB,
+  // RGB with punchthrough alpha or RGBA. One level.
+  class PkmDecoder : public ITextureDecoder
+  {
+  public:
+    bool CanDecode(const uint8_t *data, size_t size) const;
+    bool Decode(const uint8_t *data, size_t size, TextureImage &image) const;
+  };
+
+  // Non interlaced PNG of any color type to RGBA8, inflated with zlib.
+  // 16 bit samples keep their high byte, the tRNS chunk is only applied
+  // to palettes.
+  class PngDecoder : public ITextureDecoder
+  {
+  public:
+    bool CanDecode(const uint8_t *data, size_t size) const;
+    bool Decode(const uint8_t *data, size_t size, TextureImage &image) const;
+  };
+
+  // Software decode of an ETC1 image to RGB8, for drivers without
+  // GL_OES_compressed_ETC1_RGB8_texture nor OpenGL ES 3
+  bool DecodeEtc1(const TextureImage &etc1, TextureImage &rgb);
+  // Box filtered levels down to 1x1 for a single level RGBA8 or RGB8 image
+  void GenerateMipmaps(TextureImage &image);
+}
+
+#endif
@@ -0,0 +1,645 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include "TextureManager.h"
+#include "Context.h"
+#include "Extensions.h"
+#include "GlResourceRegistry.h"
+#include "Hash.h"
+#include "JobSystem.h"
+#include "TextureDecoders.h"
+
+using namespace Common;
+
+namespace
+{
+  typedef std::chrono::steady_clock Clock;
+
+  double elapsedMilliseconds(Clock::time_point start)
+  {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  }
+
+  bool readFile(const std::string &path, std::vector<uint8_t> &data)
+  {
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == NULL)
+    {
+      return false;
+    }
+    bool read = fseek(file, 0, SEEK_END) == 0;
+    long size = read ? ftell(file) : -1;
+    read = size >= 0 && fseek(file, 0, SEEK_SET) == 0;
+    if (read)
+    {
+      data.resize(size);
+      read = size == 0 || fread(&data[0], 1, size, file) == (size_t)size;
+    }
+    fclose(file);
+    return read;
+  }
+
+  bool isPowerOfTwo(int value)
+  {
+    return value > 0 && (value & (value - 1)) == 0;
+  }
+
+  size_t fullChainLength(int width, int height)
+  {
+    size_t levels = 1;
+    for (int size = std::max(width, height); size > 1; size /= 2)
+    {
+      ++levels;
+    }
+    return levels;
+  }
+
+  size_t imageBytes(const TextureImage &image)
+  {
+    size_t bytes = 0;
+    for (size_t i = 0; i < image.levels.size(); ++i)
+    {
+      bytes += image.levels[i].data.size();
+    }
+    return bytes;
+  }
+}
+
+TextureManager::TextureManager(JobSystem *jobs)
+{
+  _jobs = jobs;
+  _worker_count = std::min(std::max(jobs->GetWorkerCount(), 1u), 4u);
+  _decoding = 0;
+  _stopping = false;
+  _next_handle = 1;
+  _capabilities.etc1 = false;
+  _capabilities.etc2 = false;
+  _capabilities.npot_mipmaps = false;
+  _budget_milliseconds = 2.0;
+  _budget_bytes = 4 * 1024 * 1024;
+  _max_pending_uploads = 8;
+  _generate_mipmaps = true;
+  _decoders.push_back(new KtxDecoder());
+  _decoders.push_back(new PkmDecoder());
+  _decoders.push_back(new PngDecoder());
+  ResetStats();
+}
+
+TextureManager::~TextureManager()
+{
+  {
+    // Jobs running hold the entries, queued ones return at once
+    std::unique_lock<std::mutex> lock(_mutex);
+    _stopping = true;
+    while (_decoding > 0)
+    {
+      _decode_done.wait(lock);
+    }
+  }
+  for (size_t i = 0; i < _decoders.size(); ++i)
+  {
+    delete _decoders[i];
+  }
+}
+
+void TextureManager::SetWorkerCount(unsigned int count)
+{
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _worker_count = count > 0 ? count : 1;
+  }
+  Dispatch();
+}
+
+void TextureManager::RegisterDecoder(ITextureDecoder *decoder)
+{
+  _decoders.insert(_decoders.begin(), decoder);
+}
+
+void TextureManager::SetUploadBudget(double milliseconds, size_t bytes)
+{
+  _budget_milliseconds = milliseconds;
+  _budget_bytes = bytes > 0 ? bytes : 1;
+}
+
+void TextureManager::SetMaxPendingUploads(size_t count)
+{
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _max_pending_uploads = count > 0 ? count : 1;
+  }
+  Dispatch();
+}
+
+void TextureManager::SetGenerateMipmaps(bool generate)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  _generate_mipmaps = generate;
+}
+
+void TextureManager::InitializeGl()
+{
+  const char *version = (const char *)glGetString(GL_VERSION);
+  bool es3 = version != NULL && strncmp(version, "OpenGL ES ", 10) == 0 && version[10] >= '3';
+
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _capabilities.etc1 = HasGlExtension("GL_OES_compressed_ETC1_RGB8_texture");
+    // ETC2 is core in OpenGL ES 3 and reads ETC1 blocks too
+    _capabilities.etc2 = es3;
+    _capabilities.npot_mipmaps = es3 || HasGlExtension("GL_OES_texture_npot");
+    for (std::map<Handle, Entry>::iterator it = _entries.begin(); it != _entries.end(); ++it)
+    {
+      if (it->second.state == Lost)
+      {
+        it->second.state = Queued;
+        _decode_queue.push_back(it->first);
+      }
+    }
+  }
+  Dispatch();
+}
+
+void TextureManager::ReleaseGl()
+{
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    GlResourceRegistry *registry = Context::Instance()->GetGlResourceRegistry();
+    for (std::map<Handle, Entry>::iterator it = _entries.begin(); it != _entries.end(); ++it)
+    {
+      if (it->second.texture != 0)
+      {
+        registry->Release(GlResourceRegistry::Texture, it->second.texture);
+      }
+    }
+  }
+  Reset();
+}
+
+void TextureManager::Reset()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  // Images waiting for upload were decoded for the old context's formats
+  _upload_queue.clear();
+  for (std::map<Handle, Entry>::iterator it = _entries.begin(); it != _entries.end(); ++it)
+  {
+    Entry &entry = it->second;
+    entry.texture = 0;
+    if (entry.alias == InvalidHandle && (entry.state == Decoded || entry.state == Ready))
+    {
+      entry.state = Lost;
+      entry.image.levels.clear();
+    }
+  }
+}
+
+TextureManager::Handle TextureManager::Load(const std::string &path)
+{
+  Handle handle;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    ++_stats.loads;
+    std::map<std::string, Handle>::iterator it = _paths.find(path);
+    if (it != _paths.end())
+    {
+      ++_entries[it->second].references;
+      ++_stats.deduplicated;
+      return it->second;
+    }
+    std::vector<uint8_t> source;
+    handle = Add(path, source);
+    _paths[path] = handle;
+  }
+  Dispatch();
+  return handle;
+}
+
+TextureManager::Handle TextureManager::Load(const void *data, size_t size)
+{
+  std::vector<uint8_t> source((const uint8_t *)data, (const uint8_t *)data + size);
+  Handle handle;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    ++_stats.loads;
+    handle = Add(std::string(), source);
+  }
+  Dispatch();
+  return handle;
+}
+
+TextureManager::Handle TextureManager::Add(const std::string &path, std::vector<uint8_t> &source)
+{
+  Handle handle = _next_handle++;
+  Entry &entry = _entries[handle];
+  entry.path = path;
+  entry.source.swap(source);
+  entry.state = Queued;
+  entry.released = false;
+  entry.alias = InvalidHandle;
+  entry.references = 1;
+  entry.hash = 0;
+  entry.next_level = 0;
+  entry.next_row = 0;
+  entry.texture = 0;
+  _decode_queue.push_back(handle);
+  return handle;
+}
+
+void TextureManager::Release(Handle handle)
+{
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    Entry *entry = Find(handle);
+    if (entry != NULL && !entry->released && --entry->references == 0)
+    {
+      Free(handle);
+    }
+  }
+  // A texture waiting for upload may have made room
+  Dispatch();
+}
+
+void TextureManager::Free(Handle handle)
+{
+  Entry &entry = _entries[handle];
+  Handle alias = entry.alias;
+  std::map<std::string, Handle>::iterator path = _paths.find(entry.path);
+  if (path != _paths.end() && path->second == handle)
+  {
+    _paths.erase(path);
+  }
+  std::map<uint64_t, Handle>::iterator hash = _hashes.find(entry.hash);
+  if (hash != _hashes.end() && hash->second == handle)
+  {
+    _hashes.erase(hash);
+  }
+  _decode_queue.erase(std::remove(_decode_queue.begin(), _decode_queue.end(), handle), _decode_queue.end());
+  std::deque<Handle>::iterator upload = std::find(_upload_queue.begin(), _upload_queue.end(), handle);
+  if (upload != _upload_queue.end())
+  {
+    _upload_queue.erase(upload);
+  }
+  if (entry.texture != 0)
+  {
+    // Deleted once the frames drawn with it are done
+    Context::Instance()->GetGlResourceRegistry()->Release(GlResourceRegistry::Texture, entry.texture);
+  }
+  // A decode job holds on to the entry, it erases it when done
+  if (entry.state == Decoding)
+  {
+    entry.released = true;
+  }
+  else
+  {
+    _entries.erase(handle);
+  }
+
+  Entry *target = alias != InvalidHandle ? Find(alias) : NULL;
+  if (target != NULL && --target->references == 0)
+  {
+    Free(alias);
+  }
+}
+
+TextureManager::Entry *TextureManager::Find(Handle handle)
+{
+  std::map<Handle, Entry>::iterator it = _entries.find(handle);
+  return it != _entries.end() ? &it->second : NULL;
+}
+
+TextureManager::Entry *TextureManager::Resolve(Handle handle)
+{
+  Entry *entry = Find(handle);
+  while (entry != NULL && entry->alias != InvalidHandle)
+  {
+    entry = Find(entry->alias);
+  }
+  return entry;
+}
+
+GLuint TextureManager::GetTexture(Handle handle)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  Entry *entry = Resolve(handle);
+  return entry != NULL && entry->state == Ready ? entry->texture : 0;
+}
+
+bool TextureManager::IsReady(Handle handle)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  Entry *entry = Resolve(handle);
+  return entry != NULL && entry->state == Ready;
+}
+
+bool TextureManager::HasFailed(Handle handle)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  Entry *entry = Resolve(handle);
+  return entry == NULL || entry->state == Failed;
+}
+
+void TextureManager::Dispatch()
+{
+  for (;;)
+  {
+    Handle handle;
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      // Bounded hand over, a decode starts when its image has a place in the upload queue
+      if (_stopping || _decode_queue.empty() || _decoding >= _worker_count
+          || _decoding + _upload_queue.size() >= _max_pending_uploads)
+      {
+        return;
+      }
+      handle = _decode_queue.front();
+      _decode_queue.pop_front();
+      Find(handle)->state = Decoding;
+      ++_decoding;
+    }
+    // Outside the lock, a full deque runs the job right here
+    DecodeJob decode = { this, handle };
+    _jobs->Run(_jobs->Create(decode));
+  }
+}
+
+void TextureManager::Process(Handle handle)
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  // Only this job touches the entry until it leaves the Decoding state
+  Entry *entry = Find(handle);
+  Capabilities capabilities = _capabilities;
+  bool generate_mipmaps = _generate_mipmaps;
+  bool stopping = _stopping;
+  lock.unlock();
+
+  Clock::time_point start = Clock::now();
+  std::vector<uint8_t> file;
+  bool read = !stopping && (entry->path.empty() || readFile(entry->path, file));
+  const std::vector<uint8_t> &data = entry->path.empty() ? entry->source : file;
+  uint64_t hash = read ? Fnv1a(FnvOffset, data.data(), data.size()) : 0;
+
+  lock.lock();
+  // Released entries are not decoded, the job erases them below
+  bool skip = _stopping || !read || entry->released;
+  bool shared = false;
+  if (!skip)
+  {
+    std::map<uint64_t, Handle>::iterator it = _hashes.find(hash);
+    Entry *same = it != _hashes.end() && it->second != handle ? Find(it->second) : NULL;
+    if (same != NULL && !same->released && same->state != Failed)
+    {
+      // Same content under another name, share its texture
+      entry->alias = it->second;
+      entry->state = Ready;
+      entry->source.clear();
+      ++same->references;
+      ++_stats.deduplicated;
+      shared = true;
+    }
+    else
+    {
+      _hashes[hash] = handle;
+      entry->hash = hash;
+    }
+  }
+  lock.unlock();
+
+  TextureImage image;
+  bool decoded = !skip && !shared && Decode(data, capabilities, generate_mipmaps, image);
+  double milliseconds = elapsedMilliseconds(start);
+
+  lock.lock();
+  if (!shared && !stopping)
+  {
+    _stats.source_bytes += data.size();
+    _stats.decode_milliseconds += milliseconds;
+  }
+  if (_stopping || shared)
+  {
+    // Left as is, the manager is going away or the entry is an alias now
+  }
+  else if (entry->released)
+  {
+    _entries.erase(handle);
+  }
+  else if (!decoded)
+  {
+    std::cerr<<"Unable to "<<(read ? "decode" : "read")<<" texture "
+             <<(entry->path.empty() ? "from memory" : entry->path)<<std::endl;
+    entry->state = Failed;
+    ++_stats.failed;
+  }
+  else
+  {
+    ++_stats.decoded;
+    _stats.decoded_bytes += imageBytes(image);
+    entry->image.levels.swap(image.levels);
+    entry->image.internal_format = image.internal_format;
+    entry->image.format = image.format;
+    entry->image.type = image.type;
+    entry->image.compressed = image.compressed;
+    entry->next_level = 0;
+    entry->next_row = 0;
+    entry->state = Decoded;
+    _upload_queue.push_back(handle);
+  }
+  --_decoding;
+  _decode_done.notify_all();
+  lock.unlock();
+  Dispatch();
+}
+
+bool TextureManager::Decode(const std::vector<uint8_t> &data, const Capabilities &capabilities, bool generate_mipmaps,
+                            TextureImage &image) const
+{
+  const ITextureDecoder *decoder = NULL;
+  for (size_t i = 0; i < _decoders.size() && decoder == NULL; ++i)
+  {
+    if (_decoders[i]->CanDecode(data.data(), data.size()))
+    {
+      decoder = _decoders[i];
+    }
+  }
+  if (decoder == NULL || !decoder->Decode(data.data(), data.size(), image) || image.levels.empty())
+  {
+    return false;
+  }
+
+  if (image.compressed && image.internal_format == GL_ETC1_RGB8_OES && !capabilities.etc1)
+  {
+    if (capabilities.etc2)
+    {
+      image.internal_format = GL_COMPRESSED_RGB8_ETC2;
+    }
+    else
+    {
+      TextureImage rgb;
+      if (!DecodeEtc1(image, rgb))
+      {
+        return false;
+      }
+      image = rgb;
+    }
+  }
+  else if (image.compressed && !capabilities.etc2
+           && (image.internal_format == GL_COMPRESSED_RGB8_ETC2
+               || image.internal_format == GL_COMPRESSED_RGBA8_ETC2_EAC
+               || image.internal_format == GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2))
+  {
+    std::cerr<<"ETC2 textures need OpenGL ES 3"<<std::endl;
+    return false;
+  }
+
+  const TextureImage::Level &base = image.levels[0];
+  if (generate_mipmaps && (capabilities.npot_mipmaps || (isPowerOfTwo(base.width) && isPowerOfTwo(base.height))))
+  {
+    GenerateMipmaps(image);
+  }
+  return true;
+}
+
+void TextureManager::Upload()
+{
+  Clock::time_point start = Clock::now();
+  size_t bytes = 0;
+  bool uploaded = false;
+  std::unique_lock<std::mutex> lock(_mutex);
+  while (!_upload_queue.empty())
+  {
+    if (uploaded && (bytes >= _budget_bytes || elapsedMilliseconds(start) >= _budget_milliseconds))
+    {
+      break;
+    }
+    // Entries in the upload queue are only changed by the GL thread
+    Handle handle = _upload_queue.front();
+    Entry &entry = _entries[handle];
+    lock.unlock();
+    bytes += UploadStep(entry, _budget_bytes > bytes ? _budget_bytes - bytes : 1);
+    uploaded = true;
+    bool complete = entry.next_level == entry.image.levels.size();
+    GLenum error = complete ? glGetError() : GL_NO_ERROR;
+    lock.lock();
+    if (complete)
+    {
+      _upload_queue.pop_front();
+      entry.image.levels.clear();
+      entry.image.levels.shrink_to_fit();
+      if (error == GL_NO_ERROR)
+      {
+        entry.state = Ready;
+        ++_stats.uploaded;
+      }
+      else
+      {
+        std::cerr<<"Texture upload failed: GL error "<<error<<std::endl;
+        entry.state = Failed;
+        ++_stats.failed;
+      }
+    }
+  }
+  if (uploaded)
+  {
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    double milliseconds = elapsedMilliseconds(start);
+    ++_stats.upload_frames;
+    _stats.uploaded_bytes += bytes;
+    _stats.last_frame_upload_bytes = bytes;
+    _stats.max_frame_upload_bytes = std::max<uint64_t>(_stats.max_frame_upload_bytes, bytes);
+    _stats.max_frame_upload_milliseconds = std::max(_stats.max_frame_upload_milliseconds, milliseconds);
+  }
+  else
+  {
+    _stats.last_frame_upload_bytes = 0;
+  }
+  // Uploads made room for the next decodes
+  lock.unlock();
+  Dispatch();
+}
+
+size_t TextureManager::UploadStep(Entry &entry, size_t budget)
+{
+  const TextureImage &image = entry.image;
+  if (entry.texture == 0)
+  {
+    const TextureImage::Level &base = image.levels[0];
+    bool power_of_two = isPowerOfTwo(base.width) && isPowerOfTwo(base.height);
+    bool mipmapped = image.levels.size() == fullChainLength(base.width, base.height)
+                     && (power_of_two || _capabilities.npot_mipmaps);
+    GlResourceRegistry *registry = Context::Instance()->GetGlResourceRegistry();
+    entry.texture = registry->Create(GlResourceRegistry::Texture, "textures");
+    registry->SetBytes(GlResourceRegistry::Texture, entry.texture, imageBytes(image));
+    glBindTexture(GL_TEXTURE_2D, entry.texture);
+    // OpenGL ES 2 only repeats power of two textures
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, power_of_two ? GL_REPEAT : GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, power_of_two ? GL_REPEAT : GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mipmapped ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  }
+  else
+  {
+    glBindTexture(GL_TEXTURE_2D, entry.texture);
+  }
+  // Rows are tightly packed, RGB rows are rarely a multiple of 4 bytes
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+  GLint index = (GLint)entry.next_level;
+  const TextureImage::Level &level = image.levels[entry.next_level];
+  if (image.compressed)
+  {
+    // Compressed levels go whole, ETC1 has no sub-image updates
+    glCompressedTexImage2D(GL_TEXTURE_2D, index, image.internal_format, level.width, level.height, 0,
+                           (GLsizei)level.data.size(), level.data.data());
+    ++entry.next_level;
+    return level.data.size();
+  }
+  if (entry.next_row == 0 && level.data.size() <= budget)
+  {
+    glTexImage2D(GL_TEXTURE_2D, index, image.internal_format, level.width, level.height, 0,
+                 image.format, image.type, level.data.data());
+    ++entry.next_level;
+    return level.data.size();
+  }
+
+  // Larger than what is left of the budget, allocated then filled a band of rows per frame
+  if (entry.next_row == 0)
+  {
+    glTexImage2D(GL_TEXTURE_2D, index, image.internal_format, level.width, level.height, 0,
+                 image.format, image.type, NULL);
+  }
+  size_t row_bytes = level.data.size() / level.height;
+  int rows = (int)std::min<size_t>(std::max<size_t>(budget / row_bytes, 1), level.height - entry.next_row);
+  glTexSubImage2D(GL_TEXTURE_2D, index, 0, entry.next_row, level.width, rows, image.format, image.type,
+                  &level.data[entry.next_row * row_bytes]);
+  entry.next_row += rows;
+  if (entry.next_row == level.height)
+  {
+    entry.next_row = 0;
+    ++entry.next_level;
+  }
+  return rows * row_bytes;
+}
+
+TextureManager::Stats TextureManager::GetStats() const
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  Stats stats = _stats;
+  stats.pending = 0;
+  for (std::map<Handle, Entry>::const_iterator it = _entries.begin(); it != _entries.end(); ++it)
+  {
+    State state = it->second.state;
+    if (!it->second.released && (state == Queued || state == Decoding || state == Decoded))
+    {
+      ++stats.pending;
+    }
+  }
+  return stats;
+}
+
+void TextureManager::ResetStats()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  memset(&_stats, 0, sizeof(_stats));
+}
@@ -0,0 +1,158 @@
+#ifndef TEXTURE_MANAGER_H
+#define TEXTURE_MANAGER_H
+
+#include <GLES2/gl2.h>
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "ITextureDecoder.h"
+
+namespace Common
+{
+  class JobSystem;
+
+  // Textures loaded in the background. Load() returns a handle at once;
+  // jobs on the context's JobSystem read, hash and decode the file, then
+  // hand the mip chain to a bounded queue that Upload() drains on the GL
+  // thread within a time and byte budget per frame, large uncompressed
+  // levels a band of rows at a time. A file whose content was already
+  // loaded shares its texture. ETC1 and ETC2 stay compressed when the
+  // driver samples them, ETC1 is decoded in the job otherwise. A decode
+  // only starts while the queue has room for its result, so a slow GL
+  // thread holds decoding back without blocking a worker. Every method but
+  // the decoder and stats accessors belongs to the GL thread.
+  class TextureManager
+  {
+  public:
+    typedef uint32_t Handle;
+    static const Handle InvalidHandle = 0;
+
+    struct Stats
+    {
+      unsigned long loads;
+      // Loads served by a texture of the same path or content
+      unsigned long deduplicated;
+      unsigned long decoded;
+      unsigned long failed;
+      unsigned long uploaded;
+      // Queued, decoding or waiting for upload
+      size_t pending;
+      uint64_t source_bytes;
+      uint64_t decoded_bytes;
+      // Summed over workers, decoded_bytes / decode_milliseconds is the throughput
+      double decode_milliseconds;
+      uint64_t uploaded_bytes;
+      // Upload calls that had something to upload
+      unsigned long upload_frames;
+      uint64_t last_frame_upload_bytes;
+      uint64_t max_frame_upload_bytes;
+      double max_frame_upload_milliseconds;
+    };
+
+    explicit TextureManager(JobSystem *jobs);
+    // Waits for the decodes running, textures are left to the context
+    virtual ~TextureManager();
+    // Decodes running at once, the rest of the workers stay free for frame jobs
+    void SetWorkerCount(unsigned int count);
+    // Takes ownership, checked before the built-in KTX, PKM and PNG decoders
+    void RegisterDecoder(ITextureDecoder *decoder);
+    // Per Upload call, at least one level or band of rows goes through
+    void SetUploadBudget(double milliseconds, size_t bytes);
+    // Decoded images waiting for upload before decoding stops
+    void SetMaxPendingUploads(size_t count);
+    void SetGenerateMipmaps(bool generate);
+
+    // Queries the formats the context samples, textures lost with a
+    // previous context are decoded again
+    void InitializeGl();
+    // Deletes every texture, they come back after the next InitializeGl
+    void ReleaseGl();
+    // Forgets every texture without deleting it, for a lost context
+    void Reset();
+    // Once per frame, before drawing
+    void Upload();
+
+    Handle Load(const std::string &path);
+    // The data is copied
+    Handle Load(const void *data, size_t size);
+    // Drops a reference, the texture is deleted with the last one
+    void Release(Handle handle);
+    // 0 until every level is uploaded
+    GLuint GetTexture(Handle handle);
+    bool IsReady(Handle handle);
+    bool HasFailed(Handle handle);
+
+    Stats GetStats() const;
+    void ResetStats();
+  private:
+    enum State { Queued, Decoding, Decoded, Ready, Failed, Lost };
+    struct Entry
+    {
+      std::string path;
+      // Kept for memory loads, a lost context decodes them again
+      std::vector<uint8_t> source;
+      State state;
+      bool released;
+      // Entry holding the same content and the texture, this one holds a reference on it
+      Handle alias;
+      unsigned int references;
+      uint64_t hash;
+      TextureImage image;
+      size_t next_level;
+      int next_row;
+      GLuint texture;
+    };
+    struct Capabilities
+    {
+      bool etc1;
+      bool etc2;
+      bool npot_mipmaps;
+    };
+    struct DecodeJob
+    {
+      TextureManager *manager;
+      Handle handle;
+      void operator()() const { manager->Process(handle); }
+    };
+    Handle Add(const std::string &path, std::vector<uint8_t> &source);
+    Entry *Find(Handle handle);
+    // Follows aliases
+    Entry *Resolve(Handle handle);
+    void Free(Handle handle);
+    // Starts queued decodes while there is room, without holding the lock
+    void Dispatch();
+    // Reads, hashes and decodes one entry, in a job
+    void Process(Handle handle);
+    bool Decode(const std::vector<uint8_t> &data, const Capabilities &capabilities, bool generate_mipmaps,
+                TextureImage &image) const;
+    // One level or band of rows, returns the bytes uploaded
+    size_t UploadStep(Entry &entry, size_t budget);
+
+    mutable std::mutex _mutex;
+    // Signalled when a decode ends, for the destructor
+    std::condition_variable _decode_done;
+    JobSystem *_jobs;
+    unsigned int _worker_count;
+    unsigned int _decoding;
+    bool _stopping;
+    std::vector<ITextureDecoder *> _decoders;
+    std::map<Handle, Entry> _entries;
+    std::map<std::string, Handle> _paths;
+    std::map<uint64_t, Handle> _hashes;
+    std::deque<Handle> _decode_queue;
+    std::deque<Handle> _upload_queue;
+    Handle _next_handle;
+    Capabilities _capabilities;
+    double _budget_milliseconds;
+    size_t _budget_bytes;
+    size_t _max_pending_uploads;
+    bool _generate_mipmaps;
+    Stats _stats;
+  };
+}
+
+#endif
@@ -0,0 +1,81 @@
+#include "TimerVsyncSource.h"
+
+using namespace Common;
+
+TimerVsyncSource::TimerVsyncSource(double rate)
+{
+  _listener = NULL;
+  _woken = false;
+  SetRate(rate);
+}
+
+void TimerVsyncSource::SetRate(double rate)
+{
+  _rate = rate > 0.0 ? rate : 60.0;
+  _period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / _rate));
+}
+
+bool TimerVsyncSource::Attach()
+{
+  _origin = Clock::now();
+  _listener = NULL;
+  return true;
+}
+
+void TimerVsyncSource::Detach()
+{
+  _listener = NULL;
+}
+
+void TimerVsyncSource::RequestFrame(IVsyncListener *listener)
+{
+  _listener = listener;
+}
+
+void TimerVsyncSource::Wait(int timeout_milliseconds)
+{
+  Clock::time_point now = Clock::now();
+  bool forever = timeout_milliseconds < 0;
+  Clock::time_point deadline = now + std::chrono::milliseconds(forever ? 0 : timeout_milliseconds);
+  Clock::time_point vsync = now;
+  if (_listener != NULL)
+  {
+    // The first blank after now, whole periods from the origin
+    vsync = _origin + ((now - _origin) / _period + 1) * _period;
+    if (forever || vsync < deadline)
+    {
+      deadline = vsync;
+      forever = false;
+    }
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (!_woken && (forever || Clock::now() < deadline))
+    {
+      if (forever)
+      {
+        _wakeup.wait(lock);
+      }
+      else
+      {
+        _wakeup.wait_until(lock, deadline);
+      }
+    }
+    _woken = false;
+  }
+
+  if (_listener != NULL && Clock::now() >= vsync)
+  {
+    IVsyncListener *listener = _listener;
+    _listener = NULL;
+    listener->OnVsync(std::chrono::duration_cast<std::chrono::nanoseconds>(vsync.time_since_epoch()).count());
+  }
+}
+
+void TimerVsyncSource::Wake()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  _woken = true;
+  _wakeup.notify_one();
+}
@@ -0,0 +1,42 @@
+#ifndef TIMER_VSYNC_SOURCE_H
+#define TIMER_VSYNC_SOURCE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include "IVsyncSource.h"
+
+namespace Common
+{
+  // Stand-in for a display: vertical blanks every period from Attach,
+  // timed with the steady clock. A frame asked for is delivered at the
+  // next blank after the request, a frame that takes longer than a period
+  // misses the following ones like it would on a panel. Hosts without
+  // Choreographer use it, and it drives the render loop off device.
+  class TimerVsyncSource : public IVsyncSource
+  {
+  public:
+    TimerVsyncSource(double rate = 60.0);
+    // Refreshes per second, before Attach
+    void SetRate(double rate);
+    double GetRate() const { return _rate; }
+
+    virtual bool Attach();
+    virtual void Detach();
+    virtual void RequestFrame(IVsyncListener *listener);
+    virtual void Wait(int timeout_milliseconds);
+    virtual void Wake();
+  private:
+    typedef std::chrono::steady_clock Clock;
+    double _rate;
+    Clock::duration _period;
+    Clock::time_point _origin;
+    // Frame asked for, only touched on the loop thread
+    IVsyncListener *_listener;
+    std::mutex _mutex;
+    std::condition_variable _wakeup;
+    bool _woken;
+  };
+}
+
+#endif
@@ -0,0 +1,333 @@
+#include <math.h>
+#include <string.h>
+#include "TransformSystem.h"
+#include "JobSystem.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define TRANSFORM_SSE
+#define TRANSFORM_SIMD
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define TRANSFORM_NEON
+#define TRANSFORM_SIMD
+#endif
+
+using namespace Common;
+
+namespace
+{
+  // Nodes are allocated by groups of four, one SIMD register per component
+  const size_t GroupSize = 4;
+  // Per job, a few tens of microseconds of work with the SIMD kernel
+  const size_t JobGroups = 256;
+
+  const float Identity[16] =
+  {
+    1.0f, 0.0f, 0.0f, 0.0f,
+    0.0f, 1.0f, 0.0f, 0.0f,
+    0.0f, 0.0f, 1.0f, 0.0f,
+    0.0f, 0.0f, 0.0f, 1.0f
+  };
+
+#if defined(TRANSFORM_SSE)
+  typedef __m128 Lanes;
+  inline Lanes load(const float *p) { return _mm_loadu_ps(p); }
+  inline Lanes splat(float value) { return _mm_set1_ps(value); }
+  inline Lanes add(Lanes a, Lanes b) { return _mm_add_ps(a, b); }
+  inline Lanes sub(Lanes a, Lanes b) { return _mm_sub_ps(a, b); }
+  inline Lanes mul(Lanes a, Lanes b) { return _mm_mul_ps(a, b); }
+  // r0..r3 hold one matrix column (rows 0 to 3) of four nodes, each node's
+  // column is written to out + node * 16
+  inline void storeColumn(Lanes r0, Lanes r1, Lanes r2, Lanes r3, float *out)
+  {
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    _mm_storeu_ps(out, r0);
+    _mm_storeu_ps(out + 16, r1);
+    _mm_storeu_ps(out + 32, r2);
+    _mm_storeu_ps(out + 48, r3);
+  }
+#elif defined(TRANSFORM_NEON)
+  typedef float32x4_t Lanes;
+  inline Lanes load(const float *p) { return vld1q_f32(p); }
+  inline Lanes splat(float value) { return vdupq_n_f32(value); }
+  inline Lanes add(Lanes a, Lanes b) { return vaddq_f32(a, b); }
+  inline Lanes sub(Lanes a, Lanes b) { return vsubq_f32(a, b); }
+  inline Lanes mul(Lanes a, Lanes b) { return vmulq_f32(a, b); }
+  inline void storeColumn(Lanes r0, Lanes r1, Lanes r2, Lanes r3, float *out)
+  {
+    float32x4x2_t t01 = vtrnq_f32(r0, r1);
+    float32x4x2_t t23 = vtrnq_f32(r2, r3);
+    vst1q_f32(out, vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0])));
+    vst1q_f32(out + 16, vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1])));
+    vst1q_f32(out + 32, vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0])));
+    vst1q_f32(out + 48, vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1])));
+  }
+#endif
+}
+
+TransformSystem::TransformSystem()
+{
+  _count = 0;
+  _all_dirty = false;
+  memcpy(_view_projection, Identity, sizeof(Identity));
+}
+
+bool TransformSystem::HasSimd()
+{
+#ifdef TRANSFORM_SIMD
+  return true;
+#else
+  return false;
+#endif
+}
+
+TransformSystem::Handle TransformSystem::Create()
+{
+  if (_count % GroupSize == 0)
+  {
+    // Padding nodes are identities, kernels read and write whole groups
+    size_t size = _count + GroupSize;
+    _position_x.resize(size, 0.0f);
+    _position_y.resize(size, 0.0f);
+    _position_z.resize(size, 0.0f);
+    _rotation_x.resize(size, 0.0f);
+    _rotation_y.resize(size, 0.0f);
+    _rotation_z.resize(size, 0.0f);
+    _rotation_w.resize(size, 1.0f);
+    _scale_x.resize(size, 1.0f);
+    _scale_y.resize(size, 1.0f);
+    _scale_z.resize(size, 1.0f);
+    _dirty.resize(size, 0);
+    _world.resize(size * 16);
+    _clip.resize(size * 16);
+    for (size_t node = _count; node < size; ++node)
+    {
+      memcpy(&_world[node * 16], Identity, sizeof(Identity));
+      memcpy(&_clip[node * 16], Identity, sizeof(Identity));
+    }
+  }
+  _dirty[_count] = 1;
+  return (Handle)_count++;
+}
+
+void TransformSystem::Clear()
+{
+  _count = 0;
+  _position_x.clear();
+  _position_y.clear();
+  _position_z.clear();
+  _rotation_x.clear();
+  _rotation_y.clear();
+  _rotation_z.clear();
+  _rotation_w.clear();
+  _scale_x.clear();
+  _scale_y.clear();
+  _scale_z.clear();
+  _dirty.clear();
+  _world.clear();
+  _clip.clear();
+}
+
+void TransformSystem::SetPosition(Handle node, float x, float y, float z)
+{
+  _position_x[node] = x;
+  _position_y[node] = y;
+  _position_z[node] = z;
+  _dirty[node] = 1;
+}
+
+void TransformSystem::SetRotation(Handle node, float x, float y, float z, float w)
+{
+  _rotation_x[node] = x;
+  _rotation_y[node] = y;
+  _rotation_z[node] = z;
+  _rotation_w[node] = w;
+  _dirty[node] = 1;
+}
+
+void TransformSystem::SetRotationZ(Handle node, float angle)
+{
+  SetRotation(node, 0.0f, 0.0f, sinf(angle * 0.5f), cosf(angle * 0.5f));
+}
+
+void TransformSystem::SetScale(Handle node, float x, float y, float z)
+{
+  _scale_x[node] = x;
+  _scale_y[node] = y;
+  _scale_z[node] = z;
+  _dirty[node] = 1;
+}
+
+void TransformSystem::SetViewProjection(const float *matrix)
+{
+  memcpy(_view_projection, matrix, sizeof(_view_projection));
+  _all_dirty = true;
+}
+
+size_t TransformSystem::Update(Kernel kernel)
+{
+  size_t updated = UpdateGroups(0, _dirty.size() / GroupSize, kernel);
+  _all_dirty = false;
+  return updated;
+}
+
+size_t TransformSystem::Update(JobSystem *jobs, Kernel kernel)
+{
+  std::atomic<size_t> updated(0);
+  RangeUpdate update = { this, kernel, &updated };
+  // Ranges of whole groups, a group is never split between threads
+  jobs->ParallelFor(_dirty.size() / GroupSize, JobGroups, update);
+  _all_dirty = false;
+  return updated;
+}
+
+void TransformSystem::RangeUpdate::operator()(size_t begin, size_t end) const
+{
+  *updated += system->UpdateGroups(begin, end, kernel);
+}
+
+size_t TransformSystem::UpdateGroups(size_t begin, size_t end, Kernel kernel)
+{
+  size_t updated = 0;
+  for (size_t first = begin * GroupSize; first < end * GroupSize; first += GroupSize)
+  {
+    // A group is rebuilt as a whole, four flags checked at once
+    uint32_t flags;
+    memcpy(&flags, &_dirty[first], sizeof(flags));
+    if (flags == 0 && !_all_dirty)
+    {
+      continue;
+    }
+#ifdef TRANSFORM_SIMD
+    if (kernel == Simd)
+    {
+      UpdateGroupSimd(first);
+    }
+    else
+#endif
+    {
+      UpdateGroupScalar(first);
+    }
+    memset(&_dirty[first], 0, GroupSize);
+    updated += GroupSize;
+  }
+  return updated;
+}
+
+void TransformSystem::UpdateGroupScalar(size_t first)
+{
+  const float *vp = _view_projection;
+  for (size_t node = first; node < first + GroupSize; ++node)
+  {
+    float x2 = _rotation_x[node] + _rotation_x[node];
+    float y2 = _rotation_y[node] + _rotation_y[node];
+    float z2 = _rotation_z[node] + _rotation_z[node];
+    float xx = _rotation_x[node] * x2;
+    float yy = _rotation_y[node] * y2;
+    float zz = _rotation_z[node] * z2;
+    float xy = _rotation_x[node] * y2;
+    float xz = _rotation_x[node] * z2;
+    float yz = _rotation_y[node] * z2;
+    float wx = _rotation_w[node] * x2;
+    float wy = _rotation_w[node] * y2;
+    float wz = _rotation_w[node] * z2;
+
+    float *world = &_world[node * 16];
+    world[0] = (1.0f - (yy + zz)) * _scale_x[node];
+    world[1] = (xy + wz) * _scale_x[node];
+    world[2] = (xz - wy) * _scale_x[node];
+    world[3] = 0.0f;
+    world[4] = (xy - wz) * _scale_y[node];
+    world[5] = (1.0f - (xx + zz)) * _scale_y[node];
+    world[6] = (yz + wx) * _scale_y[node];
+    world[7] = 0.0f;
+    world[8] = (xz + wy) * _scale_z[node];
+    world[9] = (yz - wx) * _scale_z[node];
+    world[10] = (1.0f - (xx + yy)) * _scale_z[node];
+    world[11] = 0.0f;
+    world[12] = _position_x[node];
+    world[13] = _position_y[node];
+    world[14] = _position_z[node];
+    world[15] = 1.0f;
+
+    float *clip = &_clip[node * 16];
+    for (int column = 0; column < 4; ++column)
+    {
+      const float *w = &world[column * 4];
+      for (int row = 0; row < 4; ++row)
+      {
+        clip[column * 4 + row] = vp[row] * w[0] + vp[row + 4] * w[1] + vp[row + 8] * w[2] + vp[row + 12] * w[3];
+      }
+    }
+  }
+}
+
+#ifdef TRANSFORM_SIMD
+void TransformSystem::UpdateGroupSimd(size_t first)
+{
+  Lanes qx = load(&_rotation_x[first]);
+  Lanes qy = load(&_rotation_y[first]);
+  Lanes qz = load(&_rotation_z[first]);
+  Lanes qw = load(&_rotation_w[first]);
+  Lanes x2 = add(qx, qx);
+  Lanes y2 = add(qy, qy);
+  Lanes z2 = add(qz, qz);
+  Lanes xx = mul(qx, x2);
+  Lanes yy = mul(qy, y2);
+  Lanes zz = mul(qz, z2);
+  Lanes xy = mul(qx, y2);
+  Lanes xz = mul(qx, z2);
+  Lanes yz = mul(qy, z2);
+  Lanes wx = mul(qw, x2);
+  Lanes wy = mul(qw, y2);
+  Lanes wz = mul(qw, z2);
+  Lanes one = splat(1.0f);
+  Lanes zero = splat(0.0f);
+  Lanes sx = load(&_scale_x[first]);
+  Lanes sy = load(&_scale_y[first]);
+  Lanes sz = load(&_scale_z[first]);
+
+  // world[column][row], one lane per node
+  Lanes world[4][4];
+  world[0][0] = mul(sub(one, add(yy, zz)), sx);
+  world[0][1] = mul(add(xy, wz), sx);
+  world[0][2] = mul(sub(xz, wy), sx);
+  world[0][3] = zero;
+  world[1][0] = mul(sub(xy, wz), sy);
+  world[1][1] = mul(sub(one, add(xx, zz)), sy);
+  world[1][2] = mul(add(yz, wx), sy);
+  world[1][3] = zero;
+  world[2][0] = mul(add(xz, wy), sz);
+  world[2][1] = mul(sub(yz, wx), sz);
+  world[2][2] = mul(sub(one, add(xx, yy)), sz);
+  world[2][3] = zero;
+  world[3][0] = load(&_position_x[first]);
+  world[3][1] = load(&_position_y[first]);
+  world[3][2] = load(&_position_z[first]);
+  world[3][3] = one;
+
+  const float *vp = _view_projection;
+  for (int column = 0; column < 4; ++column)
+  {
+    Lanes clip[4];
+    for (int row = 0; row < 4; ++row)
+    {
+      // The last row of the world matrix is 0 0 0 1
+      clip[row] = add(add(mul(splat(vp[row]), world[column][0]), mul(splat(vp[row + 4]), world[column][1])),
+                      mul(splat(vp[row + 8]), world[column][2]));
+      if (column == 3)
+      {
+        clip[row] = add(clip[row], splat(vp[row + 12]));
+      }
+    }
+    storeColumn(world[column][0], world[column][1], world[column][2], world[column][3], &_world[first * 16 + column * 4]);
+    storeColumn(clip[0], clip[1], clip[2], clip[3], &_clip[first * 16 + column * 4]);
+  }
+}
+#else
+void TransformSystem::UpdateGroupSimd(size_t first)
+{
+  UpdateGroupScalar(first);
+}
+#endif
@@ -0,0 +1,83 @@
+#ifndef TRANSFORM_SYSTEM_H
+#define TRANSFORM_SYSTEM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+
+namespace Common
+{
+  class JobSystem;
+
+  // Model to clip transforms of many nodes. Positions, rotations (unit
+  // quaternions) and scales are kept as structure of arrays so that four
+  // nodes fill one SIMD register per component; Update() rebuilds the
+  // world (translation * rotation * scale) and clip (view projection *
+  // world) matrices of the changed nodes four at a time, with SSE on x86,
+  // NEON on ARM and plain C++ elsewhere. Matrices are packed column major,
+  // 16 floats per node, ready for glUniformMatrix4fv or a vertex stream.
+  class TransformSystem
+  {
+  public:
+    enum Kernel { Scalar, Simd };
+    typedef uint32_t Handle;
+
+    TransformSystem();
+    virtual ~TransformSystem(){}
+    // Identity transform, handles are indices and stay valid until Clear
+    Handle Create();
+    void Clear();
+    size_t GetCount() const { return _count; }
+
+    void SetPosition(Handle node, float x, float y, float z);
+    void SetRotation(Handle node, float x, float y, float z, float w);
+    // Rotation around the z axis, for 2D scenes
+    void SetRotationZ(Handle node, float angle);
+    void SetScale(Handle node, float x, float y, float z);
+    // Column major, every clip matrix is rebuilt on the next Update
+    void SetViewProjection(const float *matrix);
+
+    // Rebuilds the matrices of the nodes changed since the last call,
+    // returns how many were rebuilt (rounded up to groups of four).
+    size_t Update(Kernel kernel = Simd);
+    // Same, ranges of groups run as jobs and the call returns when all are done
+    size_t Update(JobSystem *jobs, Kernel kernel = Simd);
+    const float *GetWorldMatrix(Handle node) const { return &_world[node * 16]; }
+    const float *GetClipMatrix(Handle node) const { return &_clip[node * 16]; }
+    const float *GetClipMatrices() const { return _clip.data(); }
+
+    // Whether Simd runs a vector kernel rather than falling back to Scalar
+    static bool HasSimd();
+  private:
+    struct RangeUpdate
+    {
+      TransformSystem *system;
+      Kernel kernel;
+      std::atomic<size_t> *updated;
+      void operator()(size_t begin, size_t end) const;
+    };
+    // Groups begin to end, returns the nodes rebuilt
+    size_t UpdateGroups(size_t begin, size_t end, Kernel kernel);
+    void UpdateGroupScalar(size_t first);
+    void UpdateGroupSimd(size_t first);
+    size_t _count;
+    std::vector<float> _position_x;
+    std::vector<float> _position_y;
+    std::vector<float> _position_z;
+    std::vector<float> _rotation_x;
+    std::vector<float> _rotation_y;
+    std::vector<float> _rotation_z;
+    std::vector<float> _rotation_w;
+    std::vector<float> _scale_x;
+    std::vector<float> _scale_y;
+    std::vector<float> _scale_z;
+    std::vector<uint8_t> _dirty;
+    bool _all_dirty;
+    float _view_projection[16];
+    std::vector<float> _world;
+    std::vector<float> _clip;
+  };
+}
+
+#endif
@@ -0,0 +1,213 @@
+#include <iostream>
+#include "HeadlessContext.h"
+#include <EGL/eglext.h>
+#include <Extensions.h>
+
+using namespace Headless;
+using Common::HasExtension;
+
+HeadlessContext::HeadlessContext()
+{
+  _display = EGL_NO_DISPLAY;
+  _config = NULL;
+  _surface = EGL_NO_SURFACE;
+  _context = EGL_NO_CONTEXT;
+  _framebuffer = 0;
+  _colorbuffer = 0;
+  _surfaceless = false;
+  _width = 0;
+  _height = 0;
+}
+
+HeadlessContext::~HeadlessContext()
+{
+  Release();
+}
+
+bool HeadlessContext::Create(int width, int height)
+{
+  _width = width;
+  _height = height;
+  if (!CreateDisplay())
+  {
+    return false;
+  }
+  if (eglBindAPI(EGL_OPENGL_ES_API) != EGL_TRUE)
+  {
+    std::cerr<<"eglBindAPI failed "<<eglGetError()<<std::endl;
+    return false;
+  }
+  if (CreatePbuffer())
+  {
+    return true;
+  }
+  return CreateSurfaceless();
+}
+
+bool HeadlessContext::CreateDisplay()
+{
+  _display = OpenDisplay();
+  return _display != EGL_NO_DISPLAY;
+}
+
+EGLDisplay HeadlessContext::OpenDisplay()
+{
+  // Prefer the Mesa surfaceless platform: it needs no X server and no GPU
+  // (llvmpipe). Fall back to the default display otherwise.
+  EGLDisplay display = EGL_NO_DISPLAY;
+  const char *client_extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+  if (HasExtension(client_extensions, "EGL_MESA_platform_surfaceless"))
+  {
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+      (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay != NULL)
+    {
+      display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    }
+  }
+  if (display == EGL_NO_DISPLAY)
+  {
+    display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  }
+  if (display == EGL_NO_DISPLAY)
+  {
+    std::cerr<<"Failed to get an EGLDisplay"<<std::endl;
+    return EGL_NO_DISPLAY;
+  }
+  EGLint major, minor;
+  if (!eglInitialize(display, &major, &minor))
+  {
+    std::cerr<<"Failed to initialize the EGLDisplay"<<std::endl;
+    return EGL_NO_DISPLAY;
+  }
+  return display;
+}
+
+bool HeadlessContext::CreatePbuffer()
+{
+  const EGLint configuration_attributes[] =
+  {
+    EGL_SURFACE_TYPE,     EGL_PBUFFER_BIT,
+    EGL_RENDERABLE_TYPE,  EGL_OPENGL_ES2_BIT,
+    EGL_RED_SIZE,         8,
+    EGL_GREEN_SIZE,       8,
+    EGL_BLUE_SIZE,        8,
+    EGL_NONE
+  };
+  EGLint configs_returned = 0;
+  if (!eglChooseConfig(_display, configuration_attributes, &_config, 1, &configs_returned) || configs_returned != 1)
+  {
+    return false;
+  }
+  const EGLint surface_attributes[] =
+  {
+    EGL_WIDTH,  _width,
+    EGL_HEIGHT, _height,
+    EGL_NONE
+  };
+  _surface = eglCreatePbufferSurface(_display, _config, surface_attributes);
+  if (_surface == EGL_NO_SURFACE)
+  {
+    return false;
+  }
+  const EGLint context_attributes[] =
+  {
+    EGL_CONTEXT_CLIENT_VERSION, 2,
+    EGL_NONE
+  };
+  _context = eglCreateContext(_display, _config, EGL_NO_CONTEXT, context_attributes);
+  if (_context == EGL_NO_CONTEXT || !eglMakeCurrent(_display, _surface, _surface, _context))
+  {
+    std::cerr<<"Failed to make the pbuffer context current "<<eglGetError()<<std::endl;
+    return false;
+  }
+  _surfaceless = false;
+  return true;
+}
+
+bool HeadlessContext::CreateSurfaceless()
+{
+  if (!HasExtension(eglQueryString(_display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context"))
+  {
+    std::cerr<<"Neither pbuffer nor surfaceless contexts are supported"<<std::endl;
+    return false;
+  }
+  if (_surface != EGL_NO_SURFACE)
+  {
+    eglDestroySurface(_display, _surface);
+    _surface = EGL_NO_SURFACE;
+  }
+  if (_context != EGL_NO_CONTEXT)
+  {
+    eglDestroyContext(_display, _context);
+    _context = EGL_NO_CONTEXT;
+  }
+  const EGLint configuration_attributes[] =
+  {
+    EGL_RENDERABLE_TYPE,  EGL_OPENGL_ES2_BIT,
+    EGL_NONE
+  };
+  EGLint configs_returned = 0;
+  if (!eglChooseConfig(_display, configuration_attributes, &_config, 1, &configs_returned) || configs_returned != 1)
+  {
+    std::cerr<<"Failed to choose a suitable config."<<std::endl;
+    return false;
+  }
+  const EGLint context_attributes[] =
+  {
+    EGL_CONTEXT_CLIENT_VERSION, 2,
+    EGL_NONE
+  };
+  _context = eglCreateContext(_display, _config, EGL_NO_CONTEXT, context_attributes);
+  if (_context == EGL_NO_CONTEXT || !eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, _context))
+  {
+    std::cerr<<"Failed to make the surfaceless context current "<<eglGetError()<<std::endl;
+    return false;
+  }
+  _surfaceless = true;
+  return CreateFramebuffer();
+}
+
+bool HeadlessContext::CreateFramebuffer()
+{
+  // Without a surface there is no default framebuffer: renderers draw into
+  // this FBO, which stays bound for the whole run.
+  glGenRenderbuffers(1, &_colorbuffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, _colorbuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGB565, _width, _height);
+  glGenFramebuffers(1, &_framebuffer);
+  glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, _colorbuffer);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+  {
+    std::cerr<<"Offscreen framebuffer is incomplete"<<std::endl;
+    return false;
+  }
+  return true;
+}
+
+const char *HeadlessContext::GetSurfaceName() const
+{
+  return _surfaceless ? "surfaceless" : "pbuffer";
+}
+
+void HeadlessContext::Release()
+{
+  if (_display == EGL_NO_DISPLAY)
+  {
+    return;
+  }
+  if (_framebuffer != 0)
+  {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &_framebuffer);
+    glDeleteRenderbuffers(1, &_colorbuffer);
+    _framebuffer = 0;
+    _colorbuffer = 0;
+  }
+  eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  eglTerminate(_display);
+  _display = EGL_NO_DISPLAY;
+  _surface = EGL_NO_SURFACE;
+  _context = EGL_NO_CONTEXT;
+}
@@ -0,0 +1,44 @@
+#ifndef HEADLESS_CONTEXT_H
+#define HEADLESS_CONTEXT_H
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+
+namespace Headless
+{
+  // EGL context that needs neither a display server nor a window.
+  // A pbuffer surface is used when the driver offers one, otherwise the
+  // context is made current without a surface and rendering goes to an FBO.
+  class HeadlessContext
+  {
+  public:
+    HeadlessContext();
+    virtual ~HeadlessContext();
+    // The display Create uses, initialized, for contexts made elsewhere; EGL_NO_DISPLAY on failure
+    static EGLDisplay OpenDisplay();
+    bool Create(int width, int height);
+    void Release();
+    bool IsSurfaceless() const { return _surfaceless; }
+    const char *GetSurfaceName() const;
+    int GetWidth() const { return _width; }
+    int GetHeight() const { return _height; }
+    // What is drawn to when framebuffer 0 is meant: 0 with a pbuffer, the offscreen FBO otherwise
+    GLuint GetFramebuffer() const { return _framebuffer; }
+  private:
+    bool CreateDisplay();
+    bool CreatePbuffer();
+    bool CreateSurfaceless();
+    bool CreateFramebuffer();
+    EGLDisplay _display;
+    EGLConfig _config;
+    EGLSurface _surface;
+    EGLContext _context;
+    GLuint _framebuffer;
+    GLuint _colorbuffer;
+    bool _surfaceless;
+    int _width;
+    int _height;
+  };
+}
+
+#endif
@@ -0,0 +1,313 @@
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+
+#include <IRendererFactory.h>
+#include <IRenderer.h>
+#include <AssetArchive.h>
+#include <Context.h>
+#include <Compositor.h>
+#include <PostProcessChain.h>
+#include <RenderTargetPool.h>
+#include <GlStateCache.h>
+#include <ShaderCache.h>
+#include <FrameProfiler.h>
+#include <PluginLoader.h>
+
+#include <benchmark/Statistics.h>
+
+#include <Bootstrap.h>
+#include "HeadlessContext.h"
+
+// Default benchmark parameters
+const int DefaultFrames        = 600;
+const int DefaultWarmupFrames  = 30;
+const int DefaultWidth         = 1024;
+const int DefaultHeight        = 768;
+// One simulation step per frame, the animation does not depend on how fast frames are drawn
+const double SimulationStep    = 1.0 / 60.0;
+
+typedef std::chrono::steady_clock Clock;
+
+void usage(const char* program)
+{
+	std::cerr<<"usage: "<<program<<" [-r renderer[,renderer...]] [-l plugin.so[,plugin.so...]] [-k reload period] [-a assets.pak] [-e effect[,effect...]] [-x scale] [-g milliseconds] [-d disabled layer] [-n frames] [-u warmup frames] [-w width] [-h height] [-c shader cache directory] [-p trace.json] [-o output.json]"<<std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	int frames = DefaultFrames;
+	int warmupFrames = DefaultWarmupFrames;
+	int width = DefaultWidth;
+	int height = DefaultHeight;
+	const char* outputPath = NULL;
+	const char* rendererName = "triangle";
+	const char* shaderCacheDirectory = NULL;
+	const char* tracePath = NULL;
+	const char* archivePath = NULL;
+	const char* effects = NULL;
+	const char* pluginPaths = NULL;
+	// Frames between forced reloads of the plugins, 0 reloads them only when rebuilt
+	int reloadPeriod = 0;
+	float renderScale = 1.0f;
+	double resolutionTarget = 0.0;
+	std::vector<int> disabledLayers;
+
+	int option;
+	while ((option = getopt(argc, argv, "r:l:k:a:e:x:g:d:n:u:w:h:c:p:o:")) != -1)
+	{
+		switch (option)
+		{
+		case 'r': rendererName = optarg; break;
+		case 'l': pluginPaths = optarg; break;
+		case 'k': reloadPeriod = atoi(optarg); break;
+		case 'a': archivePath = optarg; break;
+		case 'e': effects = optarg; break;
+		case 'x': renderScale = atof(optarg); break;
+		case 'g': resolutionTarget = atof(optarg); break;
+		case 'd': disabledLayers.push_back(atoi(optarg)); break;
+		case 'n': frames = atoi(optarg); break;
+		case 'u': warmupFrames = atoi(optarg); break;
+		case 'w': width = atoi(optarg); break;
+		case 'h': height = atoi(optarg); break;
+		case 'c': shaderCacheDirectory = optarg; break;
+		case 'p': tracePath = optarg; break;
+		case 'o': outputPath = optarg; break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (frames <= 0 || warmupFrames < 0 || width <= 0 || height <= 0 || renderScale <= 0.0f || reloadPeriod < 0)
+	{
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	Bootstrap::Startup();
+	if (archivePath != NULL && !Common::Context::Instance()->GetAssetArchive()->Open(archivePath))
+	{
+		return EXIT_FAILURE;
+	}
+	// Outlives the context, whose factories come from the plugins
+	Common::PluginLoader plugins;
+	if (pluginPaths != NULL && !plugins.LoadPlugins(pluginPaths))
+	{
+		return EXIT_FAILURE;
+	}
+	// Layers are drawn in the order they are named, the first one at the back
+	Common::Compositor* renderer = new Common::Compositor();
+	if (!renderer->AddLayers(rendererName))
+	{
+		delete renderer;
+		return EXIT_FAILURE;
+	}
+	for (size_t i = 0; i < disabledLayers.size(); ++i)
+	{
+		renderer->SetLayerEnabled(disabledLayers[i], false);
+	}
+	Common::PostProcessChain* postProcess = renderer->GetPostProcessChain();
+	if (effects != NULL && !postProcess->AddEffects(effects))
+	{
+		delete renderer;
+		return EXIT_FAILURE;
+	}
+	// The render scale is picked from the GPU time of the frames, or fixed
+	if (resolutionTarget > 0.0)
+	{
+		postProcess->SetDynamicResolution(resolutionTarget);
+	}
+	else
+	{
+		postProcess->SetRenderScale(renderScale);
+	}
+
+	// Without a directory every program is compiled cold, runs stay comparable
+	if (shaderCacheDirectory != NULL)
+	{
+		Common::Context::Instance()->GetShaderCache()->SetCacheDirectory(shaderCacheDirectory);
+	}
+
+	Headless::HeadlessContext context;
+	if (!context.Create(width, height))
+	{
+		delete renderer;
+		return EXIT_FAILURE;
+	}
+
+	// Profiling markers add their own cost (a glFinish per marker without timer queries), off unless asked for
+	Common::FrameProfiler* profiler = Common::Context::Instance()->GetFrameProfiler();
+	profiler->SetEnabled(tracePath != NULL);
+
+	renderer->InitializeGl();
+	renderer->SetViewport(width, height);
+
+	std::vector<double> cpuTimes;
+	std::vector<double> finishTimes;
+	std::vector<double> renderScales;
+	cpuTimes.reserve(frames);
+	finishTimes.reserve(frames);
+	renderScales.reserve(frames);
+	Common::RenderTargetPool* targetPool = Common::Context::Instance()->GetRenderTargetPool();
+
+	Clock::time_point runStart = Clock::now();
+	for (int frame = 0; frame < warmupFrames + frames; ++frame)
+	{
+		if (frame == warmupFrames)
+		{
+			runStart = Clock::now();
+			Common::Context::Instance()->GetGlStateCache()->ResetCounters();
+			renderer->ResetLayerStats();
+			// Render targets are created during the warmup, none should be afterwards
+			targetPool->ResetStats();
+		}
+
+		// Swaps happen between frames and are reported on their own
+		if (reloadPeriod > 0 && frame > 0 && frame % reloadPeriod == 0)
+		{
+			plugins.ReloadAll(renderer);
+		}
+		else
+		{
+			plugins.Update(renderer);
+		}
+
+		// CPU time is what DrawFrame costs the calling thread, glFinish latency is the remaining
+		// time until the driver has executed the submitted work.
+		profiler->BeginFrame();
+		Clock::time_point frameStart = Clock::now();
+		renderer->Update(SimulationStep);
+		renderer->DrawFrame();
+		Clock::time_point submitted = Clock::now();
+		glFinish();
+		Clock::time_point finished = Clock::now();
+		profiler->EndFrame();
+
+		if (frame >= warmupFrames)
+		{
+			cpuTimes.push_back(std::chrono::duration<double, std::milli>(submitted - frameStart).count());
+			finishTimes.push_back(std::chrono::duration<double, std::milli>(finished - submitted).count());
+			renderScales.push_back(postProcess->GetRenderScale());
+		}
+	}
+	double elapsed = std::chrono::duration<double>(Clock::now() - runStart).count();
+
+	Common::GlStateCache* stateCache = Common::Context::Instance()->GetGlStateCache();
+	double stateIssued = (double)stateCache->GetIssuedCount() / frames;
+	double stateElided = (double)stateCache->GetElidedCount() / frames;
+
+	std::vector<Common::Compositor::LayerStats> layers = renderer->GetLayerStats();
+	std::vector<Common::ShaderCache::ProgramStats> programs = Common::Context::Instance()->GetShaderCache()->GetStats();
+	Common::RenderTargetPool::Stats targetStats = targetPool->GetStats();
+	size_t passCount = postProcess->GetPassCount();
+	bool gpuTimed = postProcess->IsGpuTimed();
+	unsigned long scaleChanges = postProcess->GetDynamicResolution().GetChangeCount();
+	const std::vector<Common::PluginLoader::Swap>& swaps = plugins.GetSwaps();
+	std::vector<double> swapTimes;
+	std::vector<double> swapGlTimes;
+	unsigned long failedSwaps = 0;
+	for (size_t i = 0; i < swaps.size(); ++i)
+	{
+		if (!swaps[i].loaded)
+		{
+			++failedSwaps;
+			continue;
+		}
+		swapTimes.push_back(swaps[i].load_milliseconds + swaps[i].gl_milliseconds);
+		swapGlTimes.push_back(swaps[i].gl_milliseconds);
+	}
+
+	GLenum glError = glGetError();
+	const char* glRenderer = (const char*)glGetString(GL_RENDERER);
+	std::string glRendererName = glRenderer ? glRenderer : "unknown";
+
+	renderer->ReleaseGl();
+	delete renderer;
+	profiler->ReleaseGl();
+	if (tracePath != NULL && !profiler->WriteChromeTrace(tracePath))
+	{
+		std::cerr<<"Unable to write "<<tracePath<<std::endl;
+	}
+	context.Release();
+	Common::Context::Release();
+
+	std::ofstream file;
+	if (outputPath != NULL)
+	{
+		file.open(outputPath);
+		if (!file)
+		{
+			std::cerr<<"Unable to open "<<outputPath<<std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+	std::ostream& output = outputPath != NULL ? file : std::cout;
+	output<<"{"<<std::endl;
+	output<<"  \"renderer\": \""<<rendererName<<"\","<<std::endl;
+	output<<"  \"gl_renderer\": \""<<glRendererName<<"\","<<std::endl;
+	output<<"  \"surface\": \""<<context.GetSurfaceName()<<"\","<<std::endl;
+	output<<"  \"width\": "<<width<<","<<std::endl;
+	output<<"  \"height\": "<<height<<","<<std::endl;
+	output<<"  \"frames\": "<<frames<<","<<std::endl;
+	output<<"  \"warmup_frames\": "<<warmupFrames<<","<<std::endl;
+	output<<"  \"gl_error\": "<<glError<<","<<std::endl;
+	output<<"  \"fps\": "<<(elapsed > 0.0 ? frames / elapsed : 0.0)<<","<<std::endl;
+	output<<"  \"gl_state_calls_per_frame\": {\"issued\": "<<stateIssued<<", \"elided\": "<<stateElided<<"},"<<std::endl;
+	output<<"  \"layers\": [";
+	for (size_t i = 0; i < layers.size(); ++i)
+	{
+		output<<(i > 0 ? ", " : "")<<"{\"name\": \""<<layers[i].name<<"\""
+		      <<", \"enabled\": "<<(layers[i].enabled ? "true" : "false")
+		      <<", \"cpu_ms_mean\": "<<(layers[i].frames > 0 ? layers[i].total_milliseconds / layers[i].frames : 0.0);
+		for (size_t j = 0; j < layers[i].counters.size(); ++j)
+		{
+			output<<", \""<<layers[i].counters[j].first<<"\": "<<layers[i].counters[j].second;
+		}
+		output<<"}";
+	}
+	output<<"],"<<std::endl;
+	output<<"  \"post_process\": {\"passes\": "<<passCount
+	      <<", \"dynamic_resolution\": "<<(resolutionTarget > 0.0 ? "true" : "false")
+	      <<", \"target_ms\": "<<resolutionTarget
+	      <<", \"timing\": \""<<(gpuTimed ? "gpu" : "cpu")<<"\""
+	      <<", \"scale_changes\": "<<scaleChanges<<"},"<<std::endl;
+	output<<"  \"render_targets\": {\"allocations\": "<<targetStats.allocations
+	      <<", \"reuses\": "<<targetStats.reuses
+	      <<", \"targets\": "<<targetStats.targets
+	      <<", \"mb\": "<<targetStats.bytes / 1048576.0<<"},"<<std::endl;
+	output<<"  \"plugin_swaps\": {\"plugins\": "<<plugins.GetPluginCount()
+	      <<", \"swaps\": "<<swapTimes.size()
+	      <<", \"failed\": "<<failedSwaps<<", ";
+	Benchmark::WriteDistribution(output, "ms", swapTimes);
+	output<<", ";
+	Benchmark::WriteDistribution(output, "gl_ms", swapGlTimes);
+	output<<"},"<<std::endl;
+	output<<"  \"programs\": [";
+	for (size_t i = 0; i < programs.size(); ++i)
+	{
+		char hash[17];
+		snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)programs[i].hash);
+		output<<(i > 0 ? ", " : "")<<"{\"hash\": \""<<hash<<"\""
+		      <<", \"start\": \""<<(programs[i].warm ? "warm" : "cold")<<"\""
+		      <<", \"linked\": "<<(programs[i].linked ? "true" : "false")
+		      <<", \"ms\": "<<programs[i].milliseconds<<"}";
+	}
+	output<<"],"<<std::endl;
+	output<<"  ";
+	Benchmark::WriteDistribution(output, "cpu_frame_ms", cpuTimes);
+	output<<","<<std::endl<<"  ";
+	Benchmark::WriteDistribution(output, "finish_ms", finishTimes);
+	output<<","<<std::endl<<"  ";
+	Benchmark::WriteDistribution(output, "render_scale", renderScales);
+	output<<std::endl<<"}"<<std::endl;
+
+	return glError == GL_NO_ERROR ? EXIT_SUCCESS : EXIT_FAILURE;
+}
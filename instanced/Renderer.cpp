@@ -0,0 +1,413 @@
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <random>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <Context.h>
+#include <Extensions.h>
+#include <GlStateCache.h>
+#include <ShaderCache.h>
+#include <FrameProfiler.h>
+#include "Renderer.h"
+#include <GLES2/gl2ext.h>
+
+using namespace Instanced;
+
+namespace
+{
+  const char* const instanced_vertex_source = R"glsl(
+    attribute highp vec2 position;
+    attribute lowp float shade;
+    attribute highp vec4 transform;
+    attribute lowp vec4 color;
+    uniform mediump mat4 projection;
+    varying lowp vec4 linear_color;
+    void main()
+    {
+      highp float c = cos(transform.w);
+      highp float s = sin(transform.w);
+      highp vec2 world = mat2(c, s, -s, c) * position * transform.z + transform.xy;
+      gl_Position = projection * vec4(world, 0.0, 1.0);
+      linear_color = vec4(color.rgb * shade, color.a);
+    }
+  )glsl";
+
+  // Preceded by the definition of BATCH_SIZE
+  const char* const pseudo_vertex_source = R"glsl(
+    attribute highp vec2 position;
+    attribute lowp float shade;
+    attribute mediump float copy;
+    uniform highp vec4 transforms[BATCH_SIZE];
+    uniform lowp vec4 colors[BATCH_SIZE];
+    uniform mediump mat4 projection;
+    varying lowp vec4 linear_color;
+    void main()
+    {
+      int index = int(copy);
+      highp vec4 transform = transforms[index];
+      highp float c = cos(transform.w);
+      highp float s = sin(transform.w);
+      highp vec2 world = mat2(c, s, -s, c) * position * transform.z + transform.xy;
+      gl_Position = projection * vec4(world, 0.0, 1.0);
+      linear_color = vec4(colors[index].rgb * shade, colors[index].a);
+    }
+  )glsl";
+
+  const char* const fragment_source = R"glsl(
+    varying lowp vec4 linear_color;
+    void main(void)
+    {
+      gl_FragColor = linear_color;
+    }
+  )glsl";
+
+  // Hexagon fan, a bright center fading to the rim
+  struct MeshVertex
+  {
+    GLfloat x, y;
+    GLfloat shade;
+    // Copy the vertex belongs to in a pseudo-instancing batch
+    GLfloat copy;
+  };
+  const int MeshVertexCount = 7;
+  const int MeshIndexCount = 18;
+
+  const float Pi = 3.14159265f;
+  // Holds the field, x in [-1.8, 1.8] and y in [-1, 1]
+  const float FieldCenter[3] = { 0.0f, 0.0f, 0.0f };
+  const float FieldHalfSize = 2.0f;
+
+  PFNGLVERTEXATTRIBDIVISOREXTPROC vertexAttribDivisor = NULL;
+  PFNGLDRAWELEMENTSINSTANCEDEXTPROC drawElementsInstanced = NULL;
+
+  // Same entry points under three names: the EXT and ANGLE extensions, and core OpenGL ES 3
+  bool loadInstancedArrays()
+  {
+    const char *suffix = NULL;
+    const char *version = (const char *)glGetString(GL_VERSION);
+    if (Common::HasGlExtension("GL_EXT_instanced_arrays"))
+    {
+      suffix = "EXT";
+    }
+    else if (Common::HasGlExtension("GL_ANGLE_instanced_arrays"))
+    {
+      suffix = "ANGLE";
+    }
+    else if (version != NULL && strncmp(version, "OpenGL ES ", 10) == 0 && version[10] >= '3')
+    {
+      suffix = "";
+    }
+    else
+    {
+      return false;
+    }
+    char name[64];
+    snprintf(name, sizeof(name), "glVertexAttribDivisor%s", suffix);
+    vertexAttribDivisor = (PFNGLVERTEXATTRIBDIVISOREXTPROC)eglGetProcAddress(name);
+    snprintf(name, sizeof(name), "glDrawElementsInstanced%s", suffix);
+    drawElementsInstanced = (PFNGLDRAWELEMENTSINSTANCEDEXTPROC)eglGetProcAddress(name);
+    return vertexAttribDivisor != NULL && drawElementsInstanced != NULL;
+  }
+}
+
+Renderer::Renderer(int instance_count, Path path)
+  : _culling(FieldCenter, FieldHalfSize),
+    _instance_stream(GL_ARRAY_BUFFER, (GLsizeiptr)instance_count * (4 * sizeof(GLfloat) + 4) * Common::StreamingBuffer::FramesInFlight)
+{
+  _state = Common::Context::Instance()->GetGlStateCache();
+  _shaders = Common::Context::Instance()->GetShaderCache();
+  _profiler = Common::Context::Instance()->GetFrameProfiler();
+  _requested_path = path;
+  _path = path;
+  _instance_count = instance_count;
+  _batch_size = 1;
+  _time = 0.0;
+  _ratio = 1.0f;
+  _projection_dirty = true;
+  _draw_calls = 0;
+
+  // Deterministic field so that runs can be compared, sized to roughly fill the view
+  std::mt19937 generator(1234);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  float size = 1.5f / sqrtf((float)instance_count);
+  _transforms.resize(instance_count * 4);
+  _colors.resize(instance_count * 4);
+  _color_vectors.resize(instance_count * 4);
+  _angles.resize(instance_count);
+  _speeds.resize(instance_count);
+  for (int i = 0; i < instance_count; ++i)
+  {
+    _transforms[i * 4 + 0] = (unit(generator) * 2.0f - 1.0f) * 1.8f;
+    _transforms[i * 4 + 1] = unit(generator) * 2.0f - 1.0f;
+    _transforms[i * 4 + 2] = size * (0.5f + unit(generator));
+    _angles[i] = unit(generator) * 2.0f * Pi;
+    _speeds[i] = (unit(generator) * 2.0f - 1.0f) * 3.0f;
+    for (int c = 0; c < 3; ++c)
+    {
+      _colors[i * 4 + c] = (GLubyte)(64 + unit(generator) * 191.0f);
+    }
+    _colors[i * 4 + 3] = 255;
+    for (int c = 0; c < 4; ++c)
+    {
+      _color_vectors[i * 4 + c] = _colors[i * 4 + c] / 255.0f;
+    }
+    // The hexagon's corners are at the scale, whatever the angle
+    float center[3] = { _transforms[i * 4 + 0], _transforms[i * 4 + 1], 0.0f };
+    float extent[3] = { _transforms[i * 4 + 2], _transforms[i * 4 + 2], 0.0f };
+    _culling.Insert(center, extent);
+  }
+  _visible.resize(instance_count);
+  _visible_transforms.resize(instance_count * 4);
+  _visible_colors.resize(instance_count * 4);
+  _visible_color_vectors.resize(instance_count * 4);
+  Animate();
+}
+
+const char *Renderer::GetPathName(Path path)
+{
+  switch (path)
+  {
+  case InstancedArrays: return "instanced_arrays";
+  case PseudoInstancing: return "pseudo_instancing";
+  case PerInstance: return "per_instance";
+  default: return "auto";
+  }
+}
+
+void Renderer::InitializeGl()
+{
+
+  bool instanced_arrays = loadInstancedArrays();
+  _path = _requested_path;
+  if (_path == Auto || (_path == InstancedArrays && !instanced_arrays))
+  {
+    _path = instanced_arrays ? InstancedArrays : PseudoInstancing;
+  }
+
+  // Two uniform vectors per copy, the projection and some slack for the driver
+  _batch_size = 1;
+  if (_path == PseudoInstancing)
+  {
+    GLint vectors = 0;
+    glGetIntegerv(GL_MAX_VERTEX_UNIFORM_VECTORS, &vectors);
+    _batch_size = (vectors - 8) / 2;
+    if (_batch_size > MaxBatchSize)
+    {
+      _batch_size = MaxBatchSize;
+    }
+    if (_batch_size < 1)
+    {
+      _batch_size = 1;
+    }
+  }
+
+  std::string pseudo_source;
+  if (_path == InstancedArrays)
+  {
+    _program = _shaders->Request(instanced_vertex_source, fragment_source);
+  }
+  else
+  {
+    char define[32];
+    snprintf(define, sizeof(define), "#define BATCH_SIZE %d\n", _batch_size);
+    pseudo_source = std::string(define) + pseudo_vertex_source;
+    _program = _shaders->Request(pseudo_source.c_str(), fragment_source);
+  }
+
+  // One copy of the mesh for instanced arrays, a batch of tagged copies otherwise
+  int copies = _path == InstancedArrays ? 1 : _batch_size;
+  std::vector<MeshVertex> vertices(copies * MeshVertexCount);
+  std::vector<GLushort> indices(copies * MeshIndexCount);
+  for (int copy = 0; copy < copies; ++copy)
+  {
+    MeshVertex *vertex = &vertices[copy * MeshVertexCount];
+    vertex[0].x = 0.0f;
+    vertex[0].y = 0.0f;
+    vertex[0].shade = 1.0f;
+    for (int corner = 0; corner < 6; ++corner)
+    {
+      float a = corner * Pi / 3.0f;
+      vertex[corner + 1].x = cosf(a);
+      vertex[corner + 1].y = sinf(a);
+      vertex[corner + 1].shade = 0.55f;
+    }
+    GLushort base = (GLushort)(copy * MeshVertexCount);
+    GLushort *index = &indices[copy * MeshIndexCount];
+    for (int corner = 0; corner < 6; ++corner)
+    {
+      vertex[corner].copy = (GLfloat)copy;
+      index[corner * 3 + 0] = base;
+      index[corner * 3 + 1] = base + 1 + corner;
+      index[corner * 3 + 2] = base + 1 + (corner + 1) % 6;
+    }
+    vertex[6].copy = (GLfloat)copy;
+  }
+  _mesh_vbo.Create("instanced");
+  _state->BindArrayBuffer(_mesh_vbo.Get());
+  glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(MeshVertex), vertices.data(), GL_STATIC_DRAW);
+  _mesh_vbo.SetBytes(vertices.size() * sizeof(MeshVertex));
+  _mesh_ibo.Create("instanced");
+  _state->BindElementArrayBuffer(_mesh_ibo.Get());
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort), indices.data(), GL_STATIC_DRAW);
+  _mesh_ibo.SetBytes(indices.size() * sizeof(GLushort));
+  if (_path == InstancedArrays)
+  {
+    _instance_stream.InitializeGl("instanced");
+  }
+
+  _shaders->Resolve(_program);
+  _position_location = glGetAttribLocation(_program, "position");
+  _shade_location = glGetAttribLocation(_program, "shade");
+  _transform_location = glGetAttribLocation(_program, "transform");
+  _color_location = glGetAttribLocation(_program, "color");
+  _copy_location = glGetAttribLocation(_program, "copy");
+  _transforms_location = glGetUniformLocation(_program, "transforms");
+  _colors_location = glGetUniformLocation(_program, "colors");
+  _projection_location = glGetUniformLocation(_program, "projection");
+  _projection_dirty = true;
+}
+
+void Renderer::SetViewport(int width, int height)
+{
+  glViewport(0, 0, width, height);
+  _ratio = (float) width / height;
+  _projection_dirty = true;
+}
+
+void Renderer::Update(double seconds)
+{
+  _time += seconds;
+}
+
+void Renderer::Animate()
+{
+  for (int i = 0; i < _instance_count; ++i)
+  {
+    _transforms[i * 4 + 3] = _angles[i] + _speeds[i] * (float)_time;
+  }
+}
+
+int Renderer::Cull()
+{
+  Common::FrameProfiler::Scope scope(_profiler, "Cull");
+  if (_projection_dirty)
+  {
+    glm::mat4 projection = glm::ortho(-_ratio, _ratio, -1.0f, 1.0f, -1.0f, 1.0f);
+    _culling.SetViewProjection(glm::value_ptr(projection));
+  }
+  int count = (int)_culling.Cull(_visible.data());
+  for (int i = 0; i < count; ++i)
+  {
+    Common::CullingSystem::Handle instance = _visible[i];
+    memcpy(&_visible_transforms[i * 4], &_transforms[instance * 4], 4 * sizeof(GLfloat));
+    if (_path == InstancedArrays)
+    {
+      memcpy(&_visible_colors[i * 4], &_colors[instance * 4], 4);
+    }
+    else
+    {
+      memcpy(&_visible_color_vectors[i * 4], &_color_vectors[instance * 4], 4 * sizeof(GLfloat));
+    }
+  }
+  return count;
+}
+
+void Renderer::SetProjection(GLint location)
+{
+  if (!_projection_dirty)
+  {
+    return;
+  }
+  glm::mat4 projection = glm::ortho(-_ratio, _ratio, -1.0f, 1.0f, -1.0f, 1.0f);
+  glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(projection));
+  _projection_dirty = false;
+}
+
+void Renderer::DrawFrame()
+{
+  {
+    Common::FrameProfiler::Scope scope(_profiler, "Animate");
+    Animate();
+  }
+  int count = Cull();
+  _draw_calls = 0;
+  _state->SetBlend(false);
+  _state->UseProgram(_program);
+  SetProjection(_projection_location);
+  if (count == 0)
+  {
+    return;
+  }
+  if (_path == InstancedArrays)
+  {
+    DrawInstancedArrays(count);
+  }
+  else
+  {
+    DrawPseudoInstancing(count);
+  }
+}
+
+void Renderer::DrawInstancedArrays(int count)
+{
+  Common::FrameProfiler::Scope scope(_profiler, "InstancedArrays");
+  // Transforms and colors of the frame go up as two blocks of the same stream
+  _instance_stream.NextFrame();
+  GLintptr transforms = _instance_stream.Upload(_visible_transforms.data(), count * 4 * sizeof(GLfloat), sizeof(GLfloat));
+  GLintptr colors = _instance_stream.Upload(_visible_colors.data(), count * 4, 4);
+  _state->VertexAttribPointer(_transform_location, 4, GL_FLOAT, GL_FALSE, 0, (const GLvoid *)transforms);
+  _state->VertexAttribPointer(_color_location, 4, GL_UNSIGNED_BYTE, GL_TRUE, 0, (const GLvoid *)colors);
+
+  _state->BindArrayBuffer(_mesh_vbo.Get());
+  _state->VertexAttribPointer(_position_location, 2, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (const GLvoid *)offsetof(MeshVertex, x));
+  _state->VertexAttribPointer(_shade_location, 1, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (const GLvoid *)offsetof(MeshVertex, shade));
+  _state->SetEnabledVertexAttribArrays(Common::GlStateCache::AttribBit(_position_location)
+                                       | Common::GlStateCache::AttribBit(_shade_location)
+                                       | Common::GlStateCache::AttribBit(_transform_location)
+                                       | Common::GlStateCache::AttribBit(_color_location));
+  _state->BindElementArrayBuffer(_mesh_ibo.Get());
+
+  vertexAttribDivisor(_transform_location, 1);
+  vertexAttribDivisor(_color_location, 1);
+  drawElementsInstanced(GL_TRIANGLES, MeshIndexCount, GL_UNSIGNED_SHORT, 0, count);
+  ++_draw_calls;
+  // The state cache does not know about divisors, other renderers expect them at 0
+  vertexAttribDivisor(_transform_location, 0);
+  vertexAttribDivisor(_color_location, 0);
+}
+
+void Renderer::DrawPseudoInstancing(int count)
+{
+  Common::FrameProfiler::Scope scope(_profiler, _path == PerInstance ? "PerInstance" : "PseudoInstancing");
+  _state->BindArrayBuffer(_mesh_vbo.Get());
+  _state->VertexAttribPointer(_position_location, 2, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (const GLvoid *)offsetof(MeshVertex, x));
+  _state->VertexAttribPointer(_shade_location, 1, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (const GLvoid *)offsetof(MeshVertex, shade));
+  _state->VertexAttribPointer(_copy_location, 1, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (const GLvoid *)offsetof(MeshVertex, copy));
+  _state->SetEnabledVertexAttribArrays(Common::GlStateCache::AttribBit(_position_location)
+                                       | Common::GlStateCache::AttribBit(_shade_location)
+                                       | Common::GlStateCache::AttribBit(_copy_location));
+  _state->BindElementArrayBuffer(_mesh_ibo.Get());
+
+  for (int first = 0; first < count; first += _batch_size)
+  {
+    int batch = count - first < _batch_size ? count - first : _batch_size;
+    glUniform4fv(_transforms_location, batch, &_visible_transforms[first * 4]);
+    glUniform4fv(_colors_location, batch, &_visible_color_vectors[first * 4]);
+    glDrawElements(GL_TRIANGLES, batch * MeshIndexCount, GL_UNSIGNED_SHORT, 0);
+    ++_draw_calls;
+  }
+}
+
+void Renderer::ReleaseGl()
+{
+  if (_path == InstancedArrays)
+  {
+    _instance_stream.ReleaseGl();
+  }
+  _mesh_vbo.Reset();
+  _mesh_ibo.Reset();
+  _shaders->Release(_program);
+}
@@ -0,0 +1,97 @@
+#ifndef INSTANCED_RENDERER_H
+#define INSTANCED_RENDERER_H
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+#include <vector>
+#include <CullingSystem.h>
+#include <GlHandle.h>
+#include <IRenderer.h>
+#include <StreamingBuffer.h>
+
+namespace Common
+{
+  class GlStateCache;
+  class ShaderCache;
+  class FrameProfiler;
+}
+
+namespace Instanced
+{
+  // Many spinning copies of one small mesh. With instanced arrays
+  // (GL_EXT_instanced_arrays, GL_ANGLE_instanced_arrays or OpenGL ES 3)
+  // the per-instance transforms and colors are streamed as attributes
+  // with a divisor and the whole field is one draw call. Without them,
+  // pseudo-instancing replicates the mesh in a vertex buffer tagged with
+  // a copy index, and the instances go through uniform arrays a batch at
+  // a time. PerInstance is the one draw per copy baseline. Instances are
+  // culled against the view first, only the visible ones are drawn.
+  class Renderer : public Common::IRenderer
+  {
+  public:
+    enum Path { Auto, InstancedArrays, PseudoInstancing, PerInstance };
+    static const int DefaultInstanceCount = 10000;
+    // Copies per pseudo-instancing draw, two uniform vectors each
+    static const int MaxBatchSize = 64;
+
+    Renderer(int instance_count = DefaultInstanceCount, Path path = Auto);
+    ~Renderer(){};
+    void InitializeGl();
+    void ReleaseGl();
+    void SetViewport(int width, int height);
+    void DrawFrame();
+    void Update(double seconds);
+
+    // The path actually used, known once InitializeGl has run
+    Path GetPath() const { return _path; }
+    static const char *GetPathName(Path path);
+    int GetDrawCallCount() const { return _draw_calls; }
+    const Common::CullingSystem::Stats &GetCullStats() const { return _culling.GetStats(); }
+  private:
+    void Animate();
+    // Gathers the visible instances, returns how many
+    int Cull();
+    void DrawInstancedArrays(int count);
+    void DrawPseudoInstancing(int count);
+    void SetProjection(GLint location);
+
+    Path _requested_path;
+    Path _path;
+    int _instance_count;
+    int _batch_size;
+    // Per instance, x y scale angle and rgba
+    std::vector<GLfloat> _transforms;
+    std::vector<GLubyte> _colors;
+    std::vector<GLfloat> _color_vectors;
+    std::vector<GLfloat> _angles;
+    std::vector<GLfloat> _speeds;
+    // Handles are instance indices, the field does not move
+    Common::CullingSystem _culling;
+    std::vector<Common::CullingSystem::Handle> _visible;
+    std::vector<GLfloat> _visible_transforms;
+    std::vector<GLubyte> _visible_colors;
+    std::vector<GLfloat> _visible_color_vectors;
+    double _time;
+    GLfloat _ratio;
+    bool _projection_dirty;
+
+    GLuint _program;
+    Common::GlBuffer _mesh_vbo;
+    Common::GlBuffer _mesh_ibo;
+    Common::StreamingBuffer _instance_stream;
+    GLint _position_location;
+    GLint _shade_location;
+    GLint _transform_location;
+    GLint _color_location;
+    GLint _copy_location;
+    GLint _transforms_location;
+    GLint _colors_location;
+    GLint _projection_location;
+    int _draw_calls;
+    Common::GlStateCache *_state;
+    Common::ShaderCache *_shaders;
+    Common::FrameProfiler *_profiler;
+  };
+}
+
+#endif
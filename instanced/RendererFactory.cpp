@@ -0,0 +1,9 @@
+#include "RendererFactory.h"
+#include "Renderer.h"
+
+using namespace Instanced;
+
+Common::IRenderer *RendererFactory::Create()
+{
+  return new Renderer();
+}
@@ -0,0 +1,14 @@
+#ifndef INSTANCED_RENDERER_FACTORY_H
+#define INSTANCED_RENDERER_FACTORY_H
+
+#include <IRendererFactory.h>
+
+namespace Instanced
+{
+  class RendererFactory : public Common::IRendererFactory
+  {
+  public:
+    virtual Common::IRenderer *Create();
+  };
+}
+#endif
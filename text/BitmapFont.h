@@ -0,0 +1,27 @@
+#ifndef TEXT_BITMAP_FONT_H
+#define TEXT_BITMAP_FONT_H
+
+#include <stdint.h>
+
+namespace Text
+{
+  // The printable ASCII characters of an embedded 8x8 pixel font,
+  // rasterized at any size with 4x4 supersampling: downscaled glyphs get
+  // antialiased edges, upscaled ones stay blocky. Cells are square and the
+  // font is monospaced, a glyph advances the pen by its pixel size.
+  class BitmapFont
+  {
+  public:
+    static const int CellSize = 8;
+
+    // Characters without a glyph draw as nothing but still advance the pen
+    static bool HasGlyph(uint32_t code);
+    // Coverage of pixel_size x pixel_size pixels, 0 to 255, rows stride bytes apart
+    static void Rasterize(uint32_t code, int pixel_size, uint8_t *pixels, int stride);
+    static float GetAdvance(int pixel_size) { return (float)pixel_size; }
+    // Baseline to baseline
+    static float GetLineHeight(int pixel_size) { return pixel_size * 1.25f; }
+  };
+}
+
+#endif
@@ -0,0 +1,303 @@
+#include <string.h>
+#include <algorithm>
+#include <climits>
+#include <utility>
+#include "BitmapFont.h"
+#include "GlyphAtlas.h"
+
+using namespace Text;
+
+namespace
+{
+  uint64_t makeKey(uint32_t code, int pixel_size)
+  {
+    return ((uint64_t)(uint32_t)pixel_size << 32) | code;
+  }
+
+  // Most recently used first
+  bool moreRecent(const std::pair<uint64_t, uint64_t> &a, const std::pair<uint64_t, uint64_t> &b)
+  {
+    return a.first > b.first;
+  }
+}
+
+GlyphAtlas::GlyphAtlas(int width, int height)
+{
+  _width = width;
+  _height = height;
+  _pixels.assign((size_t)width * height, 0);
+  Segment empty = { 0, 0, width };
+  _skyline.push_back(empty);
+  // Frame 0 is never a full one
+  _frame = 1;
+  _full_frame = 0;
+  _generation = 0;
+  _used_area = 0;
+  _dirty_top = 0;
+  _dirty_bottom = 0;
+  _rasterized = 0;
+  _evicted = 0;
+  _repacks = 0;
+  _dropped = 0;
+  _uploaded_bytes = 0;
+}
+
+void GlyphAtlas::BeginFrame()
+{
+  ++_frame;
+}
+
+GlyphAtlas::Glyph *GlyphAtlas::Find(uint32_t code, int pixel_size)
+{
+  if (!BitmapFont::HasGlyph(code) || pixel_size <= 0)
+  {
+    return NULL;
+  }
+  uint64_t key = makeKey(code, pixel_size);
+  std::unordered_map<uint64_t, Glyph>::iterator found = _glyphs.find(key);
+  if (found != _glyphs.end())
+  {
+    found->second.last_used = _frame;
+    return &found->second;
+  }
+
+  // Repacking again would not make room and would move the frame's glyphs once more
+  int cell = pixel_size + 2 * Padding;
+  if (cell > _width || cell > _height || _full_frame == _frame)
+  {
+    ++_dropped;
+    return NULL;
+  }
+  int x, y;
+  if (!Pack(cell, cell, x, y))
+  {
+    // A failed repack leaves the atlas as it was, the new glyph is dropped
+    if (!Repack() || !Pack(cell, cell, x, y))
+    {
+      _full_frame = _frame;
+      ++_dropped;
+      return NULL;
+    }
+  }
+  _used_area += (size_t)cell * cell;
+
+  Glyph &glyph = _glyphs[key];
+  glyph.size = pixel_size;
+  glyph.last_used = _frame;
+  Place(glyph, x, y);
+  // The cell was free, its padding is already clear
+  BitmapFont::Rasterize(code, pixel_size, &_pixels[(size_t)glyph.y * _width + glyph.x], _width);
+  ++_rasterized;
+  return &glyph;
+}
+
+bool GlyphAtlas::Pack(int width, int height, int &x, int &y)
+{
+  size_t best = _skyline.size();
+  int best_y = INT_MAX;
+  for (size_t i = 0; i < _skyline.size(); ++i)
+  {
+    int left = _skyline[i].x;
+    if (left + width > _width)
+    {
+      break;
+    }
+    // Resting on the highest of the segments under the rectangle
+    int top = 0;
+    int remaining = width;
+    for (size_t j = i; remaining > 0; ++j)
+    {
+      top = std::max(top, _skyline[j].y);
+      remaining -= _skyline[j].width;
+    }
+    if (top + height <= _height && top < best_y)
+    {
+      best = i;
+      best_y = top;
+    }
+  }
+  if (best == _skyline.size())
+  {
+    return false;
+  }
+
+  Segment placed = { _skyline[best].x, best_y + height, width };
+  _skyline.insert(_skyline.begin() + best, placed);
+  // Segments now under the rectangle shrink or go
+  int right = placed.x + placed.width;
+  size_t next = best + 1;
+  while (next < _skyline.size() && _skyline[next].x < right)
+  {
+    int covered = right - _skyline[next].x;
+    if (covered < _skyline[next].width)
+    {
+      _skyline[next].x += covered;
+      _skyline[next].width -= covered;
+      break;
+    }
+    _skyline.erase(_skyline.begin() + next);
+  }
+  for (size_t i = 0; i + 1 < _skyline.size();)
+  {
+    if (_skyline[i].y == _skyline[i + 1].y)
+    {
+      _skyline[i].width += _skyline[i + 1].width;
+      _skyline.erase(_skyline.begin() + i + 1);
+    }
+    else
+    {
+      ++i;
+    }
+  }
+  x = placed.x;
+  y = best_y;
+  return true;
+}
+
+bool GlyphAtlas::Repack()
+{
+  std::vector<std::pair<uint64_t, uint64_t> > order;
+  order.reserve(_glyphs.size());
+  for (std::unordered_map<uint64_t, Glyph>::iterator it = _glyphs.begin(); it != _glyphs.end(); ++it)
+  {
+    order.push_back(std::make_pair(it->second.last_used, it->first));
+  }
+  std::sort(order.begin(), order.end(), moreRecent);
+
+  // Packed again from empty, the most recent first so that the glyphs of
+  // the frame get their place before any other. Nothing moves until all
+  // of the frame's glyphs have one: runs of the frame point to them
+  std::vector<Segment> skyline;
+  skyline.swap(_skyline);
+  Segment empty = { 0, 0, _width };
+  _skyline.push_back(empty);
+  size_t used_area = 0;
+  size_t kept_area = (size_t)_width * _height / 2;
+  std::vector<std::pair<uint64_t, std::pair<int, int> > > placed;
+  std::vector<uint64_t> evicted;
+  for (size_t i = 0; i < order.size(); ++i)
+  {
+    const Glyph &glyph = _glyphs.find(order[i].second)->second;
+    int cell = glyph.size + 2 * Padding;
+    size_t area = (size_t)cell * cell;
+    bool current = glyph.last_used == _frame;
+    int x, y;
+    if ((current || used_area + area <= kept_area) && Pack(cell, cell, x, y))
+    {
+      used_area += area;
+      placed.push_back(std::make_pair(order[i].second, std::make_pair(x, y)));
+    }
+    else if (current)
+    {
+      _skyline.swap(skyline);
+      return false;
+    }
+    else
+    {
+      evicted.push_back(order[i].second);
+    }
+  }
+
+  std::vector<uint8_t> previous(_pixels.size(), 0);
+  previous.swap(_pixels);
+  for (size_t i = 0; i < placed.size(); ++i)
+  {
+    Glyph &glyph = _glyphs.find(placed[i].first)->second;
+    int from_x = glyph.x;
+    int from_y = glyph.y;
+    Place(glyph, placed[i].second.first, placed[i].second.second);
+    for (int row = 0; row < glyph.size; ++row)
+    {
+      memcpy(&_pixels[(size_t)(glyph.y + row) * _width + glyph.x],
+             &previous[(size_t)(from_y + row) * _width + from_x], glyph.size);
+    }
+  }
+  for (size_t i = 0; i < evicted.size(); ++i)
+  {
+    _glyphs.erase(evicted[i]);
+  }
+  _evicted += evicted.size();
+  _used_area = used_area;
+  ++_generation;
+  ++_repacks;
+  MarkDirty(0, _height);
+  return true;
+}
+
+void GlyphAtlas::Place(Glyph &glyph, int x, int y)
+{
+  glyph.x = x + Padding;
+  glyph.y = y + Padding;
+  glyph.u0 = (GLfloat)glyph.x / _width;
+  glyph.v0 = (GLfloat)glyph.y / _height;
+  glyph.u1 = (GLfloat)(glyph.x + glyph.size) / _width;
+  glyph.v1 = (GLfloat)(glyph.y + glyph.size) / _height;
+  MarkDirty(glyph.y, glyph.y + glyph.size);
+}
+
+void GlyphAtlas::MarkDirty(int top, int bottom)
+{
+  if (_dirty_top == _dirty_bottom)
+  {
+    _dirty_top = top;
+    _dirty_bottom = bottom;
+    return;
+  }
+  _dirty_top = std::min(_dirty_top, top);
+  _dirty_bottom = std::max(_dirty_bottom, bottom);
+}
+
+void GlyphAtlas::InitializeGl()
+{
+  _texture.Create("text");
+  glBindTexture(GL_TEXTURE_2D, _texture.Get());
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  // Rows of single bytes
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  // Everything rasterized so far, also after a lost context
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, _width, _height, 0, GL_ALPHA, GL_UNSIGNED_BYTE, _pixels.data());
+  // Back to the default, other uploads on the context assume it
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  _texture.SetBytes(_pixels.size());
+  _uploaded_bytes += _pixels.size();
+  _dirty_top = 0;
+  _dirty_bottom = 0;
+}
+
+void GlyphAtlas::ReleaseGl()
+{
+  _texture.Reset();
+}
+
+void GlyphAtlas::Upload()
+{
+  if (_texture.Get() == 0 || _dirty_top == _dirty_bottom)
+  {
+    return;
+  }
+  // Whole rows, they are contiguous in memory
+  glBindTexture(GL_TEXTURE_2D, _texture.Get());
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, _dirty_top, _width, _dirty_bottom - _dirty_top,
+                  GL_ALPHA, GL_UNSIGNED_BYTE, &_pixels[(size_t)_dirty_top * _width]);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  _uploaded_bytes += (uint64_t)(_dirty_bottom - _dirty_top) * _width;
+  _dirty_top = 0;
+  _dirty_bottom = 0;
+}
+
+GlyphAtlas::Stats GlyphAtlas::GetStats() const
+{
+  Stats stats;
+  stats.glyphs = _glyphs.size();
+  stats.rasterized = _rasterized;
+  stats.evicted = _evicted;
+  stats.repacks = _repacks;
+  stats.dropped = _dropped;
+  stats.uploaded_bytes = _uploaded_bytes;
+  stats.filled = (float)_used_area / ((float)_width * _height);
+  return stats;
+}
@@ -0,0 +1,112 @@
+#ifndef TEXT_GLYPH_ATLAS_H
+#define TEXT_GLYPH_ATLAS_H
+
+#include <GLES2/gl2.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+#include <GlHandle.h>
+
+namespace Text
+{
+  // Glyphs of the BitmapFont rasterized on demand into one alpha texture.
+  // Glyphs are packed with a skyline: the atlas keeps the height of its
+  // filled part along x and a glyph goes where its top is the lowest. A
+  // glyph that does not fit repacks the atlas: the glyphs used this frame
+  // stay, the others stay from the most recently used until half the
+  // atlas is filled, the rest are evicted. A repack that cannot place
+  // every glyph of the frame is abandoned and the new glyph dropped.
+  // Glyphs move when the atlas is repacked, GetGeneration() changes then
+  // and texture coordinates taken before must be looked up again; the
+  // glyphs of the frame keep their address. The pixels are kept in memory,
+  // Upload() sends the rows changed since the last call; everything but
+  // the GL methods works without a context.
+  class GlyphAtlas
+  {
+  public:
+    static const int DefaultSize = 512;
+    // Empty pixels around a glyph, bilinear filtering does not bleed
+    static const int Padding = 1;
+
+    struct Glyph
+    {
+      GLfloat u0, v0, u1, v1;
+      // Top left in the atlas, glyphs are size pixels square
+      int x, y;
+      int size;
+      uint64_t last_used;
+    };
+
+    struct Stats
+    {
+      size_t glyphs;
+      unsigned long rasterized;
+      unsigned long evicted;
+      unsigned long repacks;
+      // Did not fit along with the glyphs of their frame
+      unsigned long dropped;
+      uint64_t uploaded_bytes;
+      // Part of the atlas under glyphs, padding included
+      float filled;
+    };
+
+    explicit GlyphAtlas(int width = DefaultSize, int height = DefaultSize);
+    virtual ~GlyphAtlas(){}
+    // The glyphs found or touched from now on are this frame's
+    void BeginFrame();
+    // Rasterizes the glyph on a miss. NULL for a glyph without pixels,
+    // larger than the atlas or that does not fit with the frame's others.
+    // The pointer stays valid until the generation changes
+    Glyph *Find(uint32_t code, int pixel_size);
+    // Marks a glyph found before as used this frame, without a lookup
+    void Touch(Glyph *glyph) { glyph->last_used = _frame; }
+    uint32_t GetGeneration() const { return _generation; }
+
+    // GL thread
+    void InitializeGl();
+    void ReleaseGl();
+    void Upload();
+    GLuint GetTexture() const { return _texture.Get(); }
+
+    int GetWidth() const { return _width; }
+    int GetHeight() const { return _height; }
+    const uint8_t *GetPixels() const { return _pixels.data(); }
+    Stats GetStats() const;
+  private:
+    struct Segment
+    {
+      int x;
+      int y;
+      int width;
+    };
+    // Top left of a free rectangle, false when there is none
+    bool Pack(int width, int height, int &x, int &y);
+    // False, and nothing moved, when the frame's glyphs do not all fit again
+    bool Repack();
+    void Place(Glyph &glyph, int x, int y);
+    void MarkDirty(int top, int bottom);
+
+    int _width;
+    int _height;
+    std::vector<uint8_t> _pixels;
+    // Left to right, covering the width
+    std::vector<Segment> _skyline;
+    std::unordered_map<uint64_t, Glyph> _glyphs;
+    uint64_t _frame;
+    // A repack did not make room, the frame's misses are dropped
+    uint64_t _full_frame;
+    uint32_t _generation;
+    size_t _used_area;
+    int _dirty_top;
+    int _dirty_bottom;
+    Common::GlTexture _texture;
+    unsigned long _rasterized;
+    unsigned long _evicted;
+    unsigned long _repacks;
+    unsigned long _dropped;
+    uint64_t _uploaded_bytes;
+  };
+}
+
+#endif
@@ -0,0 +1,266 @@
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <Context.h>
+#include <GlStateCache.h>
+#include <ShaderCache.h>
+#include <FrameProfiler.h>
+#include "BitmapFont.h"
+#include "Renderer.h"
+
+using namespace Text;
+
+namespace
+{
+  const char* const vertex_source = R"glsl(
+    attribute highp vec2 position;
+    attribute mediump vec2 texcoord;
+    attribute lowp vec4 color;
+    uniform highp mat4 projection;
+    varying mediump vec2 linear_texcoord;
+    varying lowp vec4 linear_color;
+    void main()
+    {
+      gl_Position = projection * vec4(position, 0.0, 1.0);
+      linear_texcoord = texcoord;
+      linear_color = color;
+    }
+  )glsl";
+
+  // The atlas is coverage only
+  const char* const fragment_source = R"glsl(
+    varying mediump vec2 linear_texcoord;
+    varying lowp vec4 linear_color;
+    uniform sampler2D sampler;
+    void main(void)
+    {
+      gl_FragColor = vec4(linear_color.rgb, linear_color.a * texture2D(sampler, linear_texcoord).a);
+    }
+  )glsl";
+
+  const GLsizeiptr VertexStreamSize = 4 * 1024 * 1024;
+  const double RefreshSeconds = 0.5;
+  const int HudSize = 16;
+  const float Margin = 8.0f;
+  const int SampleSizes[] = { 8, 12, 16, 24, 32 };
+  const char* const Sample = "!\"#$%&'()*+,-./0123456789:;<=>?@ABCDEFGHIJKLMNO\n"
+                             "PQRSTUVWXYZ[\\]^_`abcdefghijklmnopqrstuvwxyz{|}~";
+  const GLubyte White[4] = { 255, 255, 255, 255 };
+  const GLubyte Yellow[4] = { 255, 220, 64, 255 };
+}
+
+Renderer::Renderer()
+  : _batch(&_atlas)
+  , _vertex_stream(GL_ARRAY_BUFFER, VertexStreamSize)
+{
+  _state = Common::Context::Instance()->GetGlStateCache();
+  _shaders = Common::Context::Instance()->GetShaderCache();
+  _profiler = Common::Context::Instance()->GetFrameProfiler();
+  _last_refresh = Clock::now();
+  _frames = 0;
+  _time = 0.0;
+  _next_refresh = 0.0;
+  _program = 0;
+  _index_count = 0;
+  _projection_dirty = true;
+  _width = 1;
+  _height = 1;
+}
+
+void Renderer::InitializeGl()
+{
+  _program = _shaders->Request(vertex_source, fragment_source);
+  // The atlas keeps its pixels, a new context gets all of them again
+  _atlas.InitializeGl();
+  _vertex_stream.InitializeGl("text");
+  _index_buffer.Create("text");
+  _index_count = 0;
+
+  _shaders->Resolve(_program);
+  _position_location = glGetAttribLocation(_program, "position");
+  _texcoord_location = glGetAttribLocation(_program, "texcoord");
+  _color_location = glGetAttribLocation(_program, "color");
+  _projection_location = glGetUniformLocation(_program, "projection");
+  _sampler_location = glGetUniformLocation(_program, "sampler");
+  _state->UseProgram(_program);
+  glUniform1i(_sampler_location, 0);
+  _projection_dirty = true;
+}
+
+void Renderer::SetViewport(int width, int height)
+{
+  glViewport(0, 0, width, height);
+  _width = width;
+  _height = height;
+  _projection_dirty = true;
+}
+
+void Renderer::UpdateLines()
+{
+  const TextBatch::Stats &batch = _batch.GetStats();
+  GlyphAtlas::Stats atlas = _atlas.GetStats();
+  Clock::time_point now = Clock::now();
+  double elapsed = std::chrono::duration<double>(now - _last_refresh).count();
+  char line[128];
+  _lines.clear();
+  _lines.push_back("common-gles text");
+  if (_frames > 0 && elapsed > 0.0)
+  {
+    snprintf(line, sizeof(line), "%.1f fps  %.2f ms", _frames / elapsed, elapsed * 1000.0 / _frames);
+  }
+  else
+  {
+    snprintf(line, sizeof(line), "- fps  - ms");
+  }
+  _lines.push_back(line);
+  snprintf(line, sizeof(line), "glyphs %lu  runs %lu  shaped %lu  cached %lu",
+           (unsigned long)batch.glyphs, (unsigned long)batch.runs,
+           (unsigned long)batch.shaped, (unsigned long)batch.cached_runs);
+  _lines.push_back(line);
+  snprintf(line, sizeof(line), "atlas %lu glyphs  %.0f%% filled  %lu evicted  %lu repacks",
+           (unsigned long)atlas.glyphs, atlas.filled * 100.0f, atlas.evicted, atlas.repacks);
+  _lines.push_back(line);
+  snprintf(line, sizeof(line), "time %.1f s", _time);
+  _lines.push_back(line);
+  _last_refresh = now;
+  _frames = 0;
+}
+
+void Renderer::RefreshLines()
+{
+  if (!_lines.empty() && _time < _next_refresh)
+  {
+    return;
+  }
+  std::vector<std::string> previous;
+  previous.swap(_lines);
+  UpdateLines();
+  _next_refresh = _time + RefreshSeconds;
+  // A line is damaged over the widest of its old and new text
+  _changed_widths.resize(std::max(previous.size(), _lines.size()), 0.0f);
+  for (size_t i = 0; i < _changed_widths.size(); ++i)
+  {
+    size_t before = i < previous.size() ? previous[i].size() : 0;
+    size_t after = i < _lines.size() ? _lines[i].size() : 0;
+    if (i < previous.size() && i < _lines.size() && previous[i] == _lines[i])
+    {
+      continue;
+    }
+    float width = std::max(before, after) * BitmapFont::GetAdvance(HudSize) + HudSize;
+    _changed_widths[i] = std::max(_changed_widths[i], width);
+  }
+}
+
+void Renderer::GetDamage(Common::DamageRegion &damage)
+{
+  RefreshLines();
+  float line_height = BitmapFont::GetLineHeight(HudSize);
+  for (size_t i = 0; i < _changed_widths.size(); ++i)
+  {
+    if (_changed_widths[i] <= 0.0f)
+    {
+      continue;
+    }
+    // Lines are laid out from the top, the damage counts from the bottom
+    int top = (int)floorf(Margin + i * line_height);
+    int bottom = (int)ceilf(Margin + i * line_height + std::max(line_height, (float)HudSize));
+    damage.Add((int)floorf(Margin), _height - bottom, (int)ceilf(_changed_widths[i]) + 1, bottom - top);
+  }
+  _changed_widths.assign(_changed_widths.size(), 0.0f);
+}
+
+void Renderer::DrawFrame()
+{
+  // Without a GetDamage call the host redraws everything anyway
+  RefreshLines();
+  _changed_widths.assign(_changed_widths.size(), 0.0f);
+  ++_frames;
+
+  {
+    Common::FrameProfiler::Scope scope(_profiler, "Text");
+    _batch.Begin();
+    float y = Margin;
+    for (size_t i = 0; i < _lines.size(); ++i)
+    {
+      _batch.Add(_lines[i], Margin, y, HudSize, White);
+      y += BitmapFont::GetLineHeight(HudSize);
+    }
+    for (size_t i = 0; i < sizeof(SampleSizes) / sizeof(SampleSizes[0]); ++i)
+    {
+      y += BitmapFont::GetLineHeight(SampleSizes[i]) * 0.5f;
+      _batch.Add(Sample, Margin, y, SampleSizes[i], Yellow);
+      y += BitmapFont::GetLineHeight(SampleSizes[i]) * 2.0f;
+    }
+    _batch.Build();
+  }
+
+  const std::vector<Vertex> &vertices = _batch.GetVertices();
+  const std::vector<GLushort> &indices = _batch.GetIndices();
+  if (vertices.empty())
+  {
+    return;
+  }
+  _profiler->BeginMarker("Upload");
+  _atlas.Upload();
+  _vertex_stream.NextFrame();
+  GLintptr vertex_offset = _vertex_stream.Upload(vertices.data(), vertices.size() * sizeof(Vertex), sizeof(GLfloat));
+  // The index pattern is the same every frame, it only goes up when it grows
+  _state->BindElementArrayBuffer(_index_buffer.Get());
+  if (indices.size() > _index_count)
+  {
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort), indices.data(), GL_STATIC_DRAW);
+    _index_buffer.SetBytes(indices.size() * sizeof(GLushort));
+    _index_count = indices.size();
+  }
+  _profiler->EndMarker();
+  Common::FrameProfiler::Scope scope(_profiler, "Draw");
+
+  _state->SetBlend(true);
+  _state->BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  _state->UseProgram(_program);
+  if (_projection_dirty)
+  {
+    glm::mat4 projection = glm::ortho(0.0f, (float)_width, (float)_height, 0.0f, -1.0f, 1.0f);
+    glUniformMatrix4fv(_projection_location, 1, GL_FALSE, glm::value_ptr(projection));
+    _projection_dirty = false;
+  }
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, _atlas.GetTexture());
+
+  const GLchar *base = (const GLchar *)0 + vertex_offset;
+  _state->VertexAttribPointer(_position_location, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), base + offsetof(Vertex, x));
+  _state->VertexAttribPointer(_texcoord_location, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), base + offsetof(Vertex, u));
+  _state->VertexAttribPointer(_color_location, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), base + offsetof(Vertex, color));
+  _state->SetEnabledVertexAttribArrays(Common::GlStateCache::AttribBit(_position_location)
+                                       | Common::GlStateCache::AttribBit(_texcoord_location)
+                                       | Common::GlStateCache::AttribBit(_color_location));
+  glDrawElements(GL_TRIANGLES, (GLsizei)(_batch.GetGlyphCount() * 6), GL_UNSIGNED_SHORT, 0);
+}
+
+void Renderer::Update(double seconds)
+{
+  _time += seconds;
+}
+
+void Renderer::GetCounters(std::vector<std::pair<std::string, double> > &counters) const
+{
+  GlyphAtlas::Stats atlas = _atlas.GetStats();
+  counters.push_back(std::make_pair("atlas_glyphs", (double)atlas.glyphs));
+  counters.push_back(std::make_pair("atlas_rasterized", (double)atlas.rasterized));
+  counters.push_back(std::make_pair("atlas_evicted", (double)atlas.evicted));
+  counters.push_back(std::make_pair("atlas_repacks", (double)atlas.repacks));
+  counters.push_back(std::make_pair("atlas_dropped", (double)atlas.dropped));
+  counters.push_back(std::make_pair("atlas_uploaded_bytes", (double)atlas.uploaded_bytes));
+}
+
+void Renderer::ReleaseGl()
+{
+  _vertex_stream.ReleaseGl();
+  _index_buffer.Reset();
+  _atlas.ReleaseGl();
+  _shaders->Release(_program);
+}
@@ -0,0 +1,76 @@
+#ifndef TEXT_RENDERER_H
+#define TEXT_RENDERER_H
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <GlHandle.h>
+#include <IRenderer.h>
+#include <StreamingBuffer.h>
+#include "GlyphAtlas.h"
+#include "TextBatch.h"
+
+namespace Common
+{
+  class GlStateCache;
+  class ShaderCache;
+  class FrameProfiler;
+}
+
+namespace Text
+{
+  // Frame statistics drawn as a HUD in pixel coordinates over a sample of
+  // the font at a few sizes. The statistics are refreshed twice a second
+  // of simulation time, in between every string comes from the run cache;
+  // the whole frame is one glDrawElements call. Only the lines a refresh
+  // changes are damaged, frames in between have no damage.
+  class Renderer : public Common::IRenderer
+  {
+  public:
+    Renderer();
+    ~Renderer(){};
+    void InitializeGl();
+    void ReleaseGl();
+    void SetViewport(int width, int height);
+    void DrawFrame();
+    void Update(double seconds);
+    void GetDamage(Common::DamageRegion &damage);
+    void GetCounters(std::vector<std::pair<std::string, double> > &counters) const;
+  private:
+    typedef std::chrono::steady_clock Clock;
+    // Refreshes the statistics when they are due, remembering the lines that changed
+    void RefreshLines();
+    void UpdateLines();
+
+    GlyphAtlas _atlas;
+    TextBatch _batch;
+    std::vector<std::string> _lines;
+    // Widest text each line held since the last damage, 0 for the lines unchanged
+    std::vector<float> _changed_widths;
+    Clock::time_point _last_refresh;
+    // Frames drawn since the lines were refreshed
+    unsigned int _frames;
+    double _time;
+    double _next_refresh;
+    GLuint _program;
+    Common::StreamingBuffer _vertex_stream;
+    Common::GlBuffer _index_buffer;
+    // Indices in the buffer, grows with the batch
+    size_t _index_count;
+    GLint _position_location;
+    GLint _texcoord_location;
+    GLint _color_location;
+    GLint _projection_location;
+    GLint _sampler_location;
+    bool _projection_dirty;
+    int _width;
+    int _height;
+    Common::GlStateCache *_state;
+    Common::ShaderCache *_shaders;
+    Common::FrameProfiler *_profiler;
+  };
+}
+
+#endif
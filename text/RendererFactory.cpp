@@ -0,0 +1,9 @@
+#include "RendererFactory.h"
+#include "Renderer.h"
+
+using namespace Text;
+
+Common::IRenderer *RendererFactory::Create()
+{
+  return new Renderer();
+}
@@ -0,0 +1,15 @@
+#ifndef TEXT_RENDERER_FACTORY_H
+#define TEXT_RENDERER_FACTORY_H
+
+#include <IRendererFactory.h>
+
+namespace Text
+{
+  class RendererFactory : public Common::IRendererFactory
+  {
+  public:
+    virtual Common::IRenderer *Create();
+  };
+}
+
+#endif
@@ -0,0 +1,169 @@
+#include <string.h>
+#include <algorithm>
+#include <utility>
+#include "BitmapFont.h"
+#include "TextBatch.h"
+
+using namespace Text;
+
+TextBatch::TextBatch(GlyphAtlas *atlas)
+{
+  _atlas = atlas;
+  _frame = 0;
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+void TextBatch::Begin()
+{
+  ++_frame;
+  _atlas->BeginFrame();
+  _placements.clear();
+  _stats.runs = 0;
+  _stats.shaped = 0;
+  _stats.glyphs = 0;
+  _stats.dropped = 0;
+
+  // Nothing points at the runs between frames
+  if (_frame % RunLifetime == 0)
+  {
+    std::unordered_map<std::string, Run>::iterator it = _runs.begin();
+    while (it != _runs.end())
+    {
+      if (it->second.last_used + RunLifetime < _frame)
+      {
+        it = _runs.erase(it);
+      }
+      else
+      {
+        ++it;
+      }
+    }
+  }
+}
+
+float TextBatch::Add(const std::string &text, float x, float y, int pixel_size, const GLubyte *color)
+{
+  _key.assign((const char *)&pixel_size, sizeof(pixel_size));
+  _key.append(text);
+  std::unordered_map<std::string, Run>::iterator it = _runs.find(_key);
+  if (it == _runs.end())
+  {
+    it = _runs.insert(std::make_pair(_key, Run())).first;
+    Shape(it->first, it->second);
+  }
+  else if (it->second.generation != _atlas->GetGeneration() || it->second.missing != 0)
+  {
+    Shape(it->first, it->second);
+  }
+  else
+  {
+    // The glyphs are this frame's, a repack keeps them in the atlas
+    std::vector<Quad> &quads = it->second.quads;
+    for (size_t i = 0; i < quads.size(); ++i)
+    {
+      _atlas->Touch(quads[i].glyph);
+    }
+  }
+  Run &run = it->second;
+  run.last_used = _frame;
+
+  Placement placement;
+  placement.key = &it->first;
+  placement.run = &run;
+  placement.x = x;
+  placement.y = y;
+  memcpy(placement.color, color, sizeof(placement.color));
+  _placements.push_back(placement);
+  ++_stats.runs;
+  return run.width;
+}
+
+void TextBatch::Shape(const std::string &key, Run &run)
+{
+  int pixel_size;
+  memcpy(&pixel_size, key.data(), sizeof(pixel_size));
+  float advance = BitmapFont::GetAdvance(pixel_size);
+  float line_height = BitmapFont::GetLineHeight(pixel_size);
+
+  run.quads.clear();
+  run.width = 0.0f;
+  run.missing = 0;
+  float pen_x = 0.0f;
+  float pen_y = 0.0f;
+  for (size_t i = sizeof(pixel_size); i < key.size(); ++i)
+  {
+    uint32_t code = (unsigned char)key[i];
+    if (code == '\n')
+    {
+      pen_x = 0.0f;
+      pen_y += line_height;
+      continue;
+    }
+    if (BitmapFont::HasGlyph(code))
+    {
+      GlyphAtlas::Glyph *glyph = _atlas->Find(code, pixel_size);
+      if (glyph != NULL)
+      {
+        Quad quad = { pen_x, pen_y, pen_x + pixel_size, pen_y + pixel_size, glyph };
+        run.quads.push_back(quad);
+      }
+      else
+      {
+        ++run.missing;
+      }
+    }
+    pen_x += advance;
+    run.width = std::max(run.width, pen_x);
+  }
+  // Repacks during the frame keep the glyphs found in it, the pointers stay valid until the next one
+  run.generation = _atlas->GetGeneration();
+  ++_stats.shaped;
+}
+
+void TextBatch::Build()
+{
+  _vertices.clear();
+  for (size_t i = 0; i < _placements.size(); ++i)
+  {
+    const Placement &placement = _placements[i];
+    const std::vector<Quad> &quads = placement.run->quads;
+    _stats.dropped += placement.run->missing;
+    size_t room = MaxGlyphs - _vertices.size() / 4;
+    size_t count = std::min(quads.size(), room);
+    _stats.dropped += quads.size() - count;
+
+    size_t first = _vertices.size();
+    _vertices.resize(first + count * 4);
+    Vertex *vertex = &_vertices[first];
+    for (size_t j = 0; j < count; ++j)
+    {
+      const Quad &quad = quads[j];
+      const GlyphAtlas::Glyph *glyph = quad.glyph;
+      GLfloat x0 = placement.x + quad.x0;
+      GLfloat y0 = placement.y + quad.y0;
+      GLfloat x1 = placement.x + quad.x1;
+      GLfloat y1 = placement.y + quad.y1;
+      // Top left, top right, bottom right, bottom left
+      vertex[0].x = x0; vertex[0].y = y0; vertex[0].u = glyph->u0; vertex[0].v = glyph->v0;
+      vertex[1].x = x1; vertex[1].y = y0; vertex[1].u = glyph->u1; vertex[1].v = glyph->v0;
+      vertex[2].x = x1; vertex[2].y = y1; vertex[2].u = glyph->u1; vertex[2].v = glyph->v1;
+      vertex[3].x = x0; vertex[3].y = y1; vertex[3].u = glyph->u0; vertex[3].v = glyph->v1;
+      for (int corner = 0; corner < 4; ++corner)
+      {
+        memcpy(vertex[corner].color, placement.color, sizeof(vertex[corner].color));
+      }
+      vertex += 4;
+    }
+  }
+
+  size_t glyphs = _vertices.size() / 4;
+  for (size_t glyph = _indices.size() / 6; glyph < glyphs; ++glyph)
+  {
+    GLushort base = (GLushort)(glyph * 4);
+    GLushort quad[6] = { base, (GLushort)(base + 1), (GLushort)(base + 2),
+                         base, (GLushort)(base + 2), (GLushort)(base + 3) };
+    _indices.insert(_indices.end(), quad, quad + 6);
+  }
+  _stats.glyphs = glyphs;
+  _stats.cached_runs = _runs.size();
+}
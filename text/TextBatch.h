@@ -0,0 +1,98 @@
+#ifndef TEXT_TEXT_BATCH_H
+#define TEXT_TEXT_BATCH_H
+
+#include <GLES2/gl2.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "GlyphAtlas.h"
+
+namespace Text
+{
+  struct Vertex
+  {
+    GLfloat x, y;
+    GLfloat u, v;
+    GLubyte color[4];
+  };
+
+  // Collects the text of a frame into one vertex array, drawn with one
+  // glDrawElements call over the atlas texture. Strings are shaped once
+  // into runs of quads relative to their origin and cached by text and
+  // size: drawing an unchanged string again only copies its quads. Quads
+  // point at their atlas glyph, whose texture coordinates are read when
+  // the vertices are built. A run is shaped again when the atlas evicted
+  // glyphs since and dropped when it was not drawn for a while.
+  // Positions are pixels, y down.
+  class TextBatch
+  {
+  public:
+    // Four vertices a glyph, the indices are 16 bit
+    static const size_t MaxGlyphs = 16384;
+    // Frames a run stays cached without being drawn
+    static const uint64_t RunLifetime = 64;
+
+    struct Stats
+    {
+      // This frame
+      size_t runs;
+      size_t shaped;
+      size_t glyphs;
+      // Over MaxGlyphs or not in the atlas
+      size_t dropped;
+      size_t cached_runs;
+    };
+
+    explicit TextBatch(GlyphAtlas *atlas);
+    virtual ~TextBatch(){}
+    void Begin();
+    // First line's top left at x, y, '\n' starts a line. Returns the
+    // widest line's width
+    float Add(const std::string &text, float x, float y, int pixel_size, const GLubyte *color);
+    void Build();
+
+    const std::vector<Vertex> &GetVertices() const { return _vertices; }
+    // Six a glyph, the same for every frame, only grows
+    const std::vector<GLushort> &GetIndices() const { return _indices; }
+    size_t GetGlyphCount() const { return _vertices.size() / 4; }
+    const Stats &GetStats() const { return _stats; }
+  private:
+    struct Quad
+    {
+      GLfloat x0, y0, x1, y1;
+      GlyphAtlas::Glyph *glyph;
+    };
+    struct Run
+    {
+      std::vector<Quad> quads;
+      float width;
+      uint32_t generation;
+      // Glyphs the atlas had no room for, shaped again next frame
+      size_t missing;
+      uint64_t last_used;
+    };
+    struct Placement
+    {
+      // Map nodes do not move, the key holds the size and the text
+      const std::string *key;
+      Run *run;
+      GLfloat x, y;
+      GLubyte color[4];
+    };
+    void Shape(const std::string &key, Run &run);
+
+    GlyphAtlas *_atlas;
+    std::unordered_map<std::string, Run> _runs;
+    // Reused to build the lookup key without allocating
+    std::string _key;
+    std::vector<Placement> _placements;
+    std::vector<Vertex> _vertices;
+    std::vector<GLushort> _indices;
+    uint64_t _frame;
+    Stats _stats;
+  };
+}
+
+#endif
@@ -0,0 +1,1960 @@
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+#include "GlTrace.h"
+
+// Preloaded in front of the GLES and EGL libraries (LD_PRELOAD), captures
+// frames of any host into a GlTrace file for gl-replay. It interposes the
+// entry points the renderers use, extensions included through
+// eglGetProcAddress, and keeps a copy of every object they create:
+// buffer and texture contents, shader sources, program attributes and
+// uniforms, framebuffer attachments. When the capture starts the live
+// objects and the bindings are written first, then every call of the
+// captured frames with the data it passes. Frames end at eglSwapBuffers
+// (or eglSwapBuffersWithDamageKHR/EXT), or at glFinish for hosts that do
+// not swap. Nothing is kept or written
+// unless GL_CAPTURE_FILE is set:
+//   GL_CAPTURE_FILE      trace to write
+//   GL_CAPTURE_FRAME     frames drawn before the capture starts (default 60)
+//   GL_CAPTURE_FRAMES    frames captured (default 1)
+//   GL_CAPTURE_BOUNDARY  swap (default) or finish
+// One thread draws. What the GPU rendered before the capture (render
+// targets, the back buffer a partial update keeps), client side vertex
+// arrays and eglSetDamageRegionKHR are not captured.
+
+namespace
+{
+	typedef std::vector<uint32_t> Words;
+
+	const int DefaultFirstFrame = 60;
+	const GLuint SnapshotShaderNames = 0xffff0000u;
+
+	struct Buffer
+	{
+		bool defined;
+		GLenum usage;
+		std::vector<uint8_t> data;
+	};
+
+	struct Level
+	{
+		GLenum internalFormat;
+		GLsizei width;
+		GLsizei height;
+		GLenum format;
+		GLenum type;
+		bool compressed;
+		// Rows packed without padding, empty when the image was given no data
+		std::vector<uint8_t> data;
+	};
+
+	struct Texture
+	{
+		GLenum target;
+		bool mipmapped;
+		// By face target and level
+		std::map<std::pair<GLenum, GLint>, Level> levels;
+		std::map<GLenum, GLint> parameters;
+	};
+
+	struct Shader
+	{
+		GLenum type;
+		std::string source;
+	};
+
+	struct Program
+	{
+		std::vector<GLuint> attached;
+		// Sources of the shaders attached when it was linked
+		std::vector<Shader> linked;
+		bool binary;
+		GLenum binaryFormat;
+		std::vector<uint8_t> binaryData;
+		std::map<std::string, GLint> attributes;
+		std::map<GLint, std::string> uniforms;
+		// Last call setting each location
+		std::map<GLint, Words> values;
+	};
+
+	struct Attribute
+	{
+		bool enabled;
+		GLuint buffer;
+		Words pointer;
+		GLuint divisor;
+	};
+
+	struct Capture
+	{
+		bool enabled;
+		std::string path;
+		int firstFrame;
+		int frameCount;
+		bool finishBoundary;
+
+		FILE* file;
+		bool recording;
+		int framesSeen;
+		int framesWritten;
+		uint32_t records;
+		uint64_t bytes;
+		bool clientArraysWarned;
+		Words scratch;
+
+		std::map<GLuint, Buffer> buffers;
+		std::map<GLuint, Texture> textures;
+		std::map<GLuint, Shader> shaders;
+		std::map<GLuint, Program> programs;
+		std::map<GLuint, std::map<GLenum, Words> > framebuffers;
+		std::map<GLuint, Words> renderbuffers;
+
+		GLuint program;
+		GLuint arrayBuffer;
+		GLuint elementBuffer;
+		GLuint framebuffer;
+		GLuint renderbuffer;
+		GLuint activeTexture;
+		// By texture unit and target
+		std::map<std::pair<GLuint, GLenum>, GLuint> boundTextures;
+		std::map<GLuint, Attribute> attributes;
+		std::map<GLenum, bool> capabilities;
+		std::map<GLenum, GLint> pixelStore;
+		Words blendFunc;
+		Words viewport;
+		Words clearColor;
+		GLsizei viewportWidth;
+		GLsizei viewportHeight;
+
+		// Reads the environment, before the host's first GL call
+		Capture()
+		{
+			const char* output = getenv("GL_CAPTURE_FILE");
+			enabled = output != NULL && output[0] != '\0';
+			path = enabled ? output : "";
+			const char* first = getenv("GL_CAPTURE_FRAME");
+			firstFrame = first != NULL && atoi(first) > 0 ? atoi(first) : DefaultFirstFrame;
+			const char* count = getenv("GL_CAPTURE_FRAMES");
+			frameCount = count != NULL && atoi(count) > 0 ? atoi(count) : 1;
+			const char* boundary = getenv("GL_CAPTURE_BOUNDARY");
+			finishBoundary = boundary != NULL && strcmp(boundary, "finish") == 0;
+			file = NULL;
+			recording = false;
+			framesSeen = 0;
+			framesWritten = 0;
+			records = 0;
+			bytes = 0;
+			clientArraysWarned = false;
+			program = 0;
+			arrayBuffer = 0;
+			elementBuffer = 0;
+			framebuffer = 0;
+			renderbuffer = 0;
+			activeTexture = 0;
+			viewportWidth = 0;
+			viewportHeight = 0;
+		}
+	};
+
+	Capture capture;
+
+	/*!*****************************************************************************************************************
+	\param[in]			name                        Entry point
+	\return		The next definition of the entry point, the driver's
+	\brief	Looks an entry point up past this library, aborts when there is none.
+	*******************************************************************************************************************/
+	void* lookup(const char* name)
+	{
+		void* function = dlsym(RTLD_NEXT, name);
+		if (function == NULL)
+		{
+			fprintf(stderr, "gl-capture: no %s to forward to\n", name);
+			abort();
+		}
+		return function;
+	}
+
+	#define REAL(function) static decltype(&function) real = (decltype(&function))lookup(#function)
+
+	void begin(Words& record, uint32_t opcode)
+	{
+		record.clear();
+		record.push_back(opcode);
+		record.push_back(0);
+	}
+
+	void put(Words& record, uint32_t value)
+	{
+		record.push_back(value);
+	}
+
+	void putFloat(Words& record, GLfloat value)
+	{
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		record.push_back(bits);
+	}
+
+	void putBlob(Words& record, const void* data, size_t size)
+	{
+		record.push_back((uint32_t)size);
+		size_t first = record.size();
+		record.resize(first + (size + 3) / 4, 0);
+		if (size > 0)
+		{
+			memcpy(&record[first], data, size);
+		}
+	}
+
+	void putString(Words& record, const std::string& value)
+	{
+		putBlob(record, value.data(), value.size());
+	}
+
+	void end(Words& record)
+	{
+		record[1] = (uint32_t)(record.size() - 2);
+	}
+
+	void write(Words& record)
+	{
+		end(record);
+		fwrite(record.data(), sizeof(uint32_t), record.size(), capture.file);
+		++capture.records;
+		capture.bytes += record.size() * sizeof(uint32_t);
+	}
+
+	// Writes the record when a frame is being captured
+	void record(Words& record)
+	{
+		if (capture.recording)
+		{
+			write(record);
+		}
+	}
+
+	void writeMarker(uint32_t opcode)
+	{
+		Words record;
+		begin(record, opcode);
+		write(record);
+	}
+
+	void writeCall(uint32_t opcode, uint32_t a)
+	{
+		Words record;
+		begin(record, opcode);
+		put(record, a);
+		write(record);
+	}
+
+	void writeCall(uint32_t opcode, uint32_t a, uint32_t b)
+	{
+		Words record;
+		begin(record, opcode);
+		put(record, a);
+		put(record, b);
+		write(record);
+	}
+
+	void writeCall(uint32_t opcode, uint32_t a, uint32_t b, uint32_t c)
+	{
+		Words record;
+		begin(record, opcode);
+		put(record, a);
+		put(record, b);
+		put(record, c);
+		write(record);
+	}
+
+	/*!*****************************************************************************************************************
+	\brief	Writes the objects alive now with their contents, then the bindings and uniform values.
+	*******************************************************************************************************************/
+	void writeSnapshot()
+	{
+		Words record;
+		// Images are kept without row padding
+		writeCall(GlTrace::PixelStorei, GL_UNPACK_ALIGNMENT, 1);
+		for (std::map<GLuint, Buffer>::iterator it = capture.buffers.begin(); it != capture.buffers.end(); ++it)
+		{
+			writeCall(GlTrace::GenBuffer, it->first);
+			if (!it->second.defined)
+			{
+				continue;
+			}
+			writeCall(GlTrace::BindBuffer, GL_ARRAY_BUFFER, it->first);
+			begin(record, GlTrace::BufferData);
+			put(record, GL_ARRAY_BUFFER);
+			put(record, (uint32_t)it->second.data.size());
+			put(record, it->second.usage);
+			put(record, 1);
+			putBlob(record, it->second.data.data(), it->second.data.size());
+			write(record);
+		}
+
+		writeCall(GlTrace::ActiveTexture, GL_TEXTURE0);
+		for (std::map<GLuint, Texture>::iterator it = capture.textures.begin(); it != capture.textures.end(); ++it)
+		{
+			const Texture& texture = it->second;
+			writeCall(GlTrace::GenTexture, it->first);
+			if (texture.target == 0)
+			{
+				continue;
+			}
+			writeCall(GlTrace::BindTexture, texture.target, it->first);
+			for (std::map<GLenum, GLint>::const_iterator parameter = texture.parameters.begin(); parameter != texture.parameters.end(); ++parameter)
+			{
+				writeCall(GlTrace::TexParameteri, texture.target, parameter->first, (uint32_t)parameter->second);
+			}
+			for (std::map<std::pair<GLenum, GLint>, Level>::const_iterator level = texture.levels.begin(); level != texture.levels.end(); ++level)
+			{
+				const Level& image = level->second;
+				begin(record, image.compressed ? GlTrace::CompressedTexImage2D : GlTrace::TexImage2D);
+				put(record, level->first.first);
+				put(record, (uint32_t)level->first.second);
+				put(record, image.internalFormat);
+				put(record, (uint32_t)image.width);
+				put(record, (uint32_t)image.height);
+				put(record, 0);
+				if (!image.compressed)
+				{
+					put(record, image.format);
+					put(record, image.type);
+					put(record, image.data.empty() ? 0 : 1);
+				}
+				putBlob(record, image.data.data(), image.data.size());
+				write(record);
+			}
+			if (texture.mipmapped)
+			{
+				writeCall(GlTrace::GenerateMipmap, texture.target);
+			}
+		}
+
+		for (std::map<GLuint, Words>::iterator it = capture.renderbuffers.begin(); it != capture.renderbuffers.end(); ++it)
+		{
+			writeCall(GlTrace::GenRenderbuffer, it->first);
+			if (!it->second.empty())
+			{
+				writeCall(GlTrace::BindRenderbuffer, GL_RENDERBUFFER, it->first);
+				record = it->second;
+				write(record);
+			}
+		}
+		for (std::map<GLuint, std::map<GLenum, Words> >::iterator it = capture.framebuffers.begin(); it != capture.framebuffers.end(); ++it)
+		{
+			writeCall(GlTrace::GenFramebuffer, it->first);
+			if (it->second.empty())
+			{
+				continue;
+			}
+			writeCall(GlTrace::BindFramebuffer, GL_FRAMEBUFFER, it->first);
+			for (std::map<GLenum, Words>::iterator attachment = it->second.begin(); attachment != it->second.end(); ++attachment)
+			{
+				record = attachment->second;
+				write(record);
+			}
+		}
+
+		// Shaders still alive, then programs linked from the sources they had at link time
+		for (std::map<GLuint, Shader>::iterator it = capture.shaders.begin(); it != capture.shaders.end(); ++it)
+		{
+			writeCall(GlTrace::CreateShader, it->first, it->second.type);
+			begin(record, GlTrace::ShaderSource);
+			put(record, it->first);
+			putString(record, it->second.source);
+			write(record);
+			writeCall(GlTrace::CompileShader, it->first);
+		}
+		for (std::map<GLuint, Program>::iterator it = capture.programs.begin(); it != capture.programs.end(); ++it)
+		{
+			const Program& program = it->second;
+			writeCall(GlTrace::CreateProgram, it->first);
+			if (program.binary)
+			{
+				begin(record, GlTrace::ProgramBinary);
+				put(record, it->first);
+				put(record, program.binaryFormat);
+				putBlob(record, program.binaryData.data(), program.binaryData.size());
+				write(record);
+			}
+			else if (!program.linked.empty())
+			{
+				for (size_t i = 0; i < program.linked.size(); ++i)
+				{
+					GLuint shader = SnapshotShaderNames + (GLuint)i;
+					writeCall(GlTrace::CreateShader, shader, program.linked[i].type);
+					begin(record, GlTrace::ShaderSource);
+					put(record, shader);
+					putString(record, program.linked[i].source);
+					write(record);
+					writeCall(GlTrace::CompileShader, shader);
+					writeCall(GlTrace::AttachShader, it->first, shader);
+				}
+				// The attributes keep the locations the renderer was given
+				for (std::map<std::string, GLint>::const_iterator attribute = program.attributes.begin(); attribute != program.attributes.end(); ++attribute)
+				{
+					if (attribute->second < 0)
+					{
+						continue;
+					}
+					begin(record, GlTrace::BindAttribLocation);
+					put(record, it->first);
+					put(record, (uint32_t)attribute->second);
+					putString(record, attribute->first);
+					write(record);
+				}
+				writeCall(GlTrace::LinkProgram, it->first);
+				for (size_t i = 0; i < program.linked.size(); ++i)
+				{
+					writeCall(GlTrace::DetachShader, it->first, SnapshotShaderNames + (GLuint)i);
+					writeCall(GlTrace::DeleteShader, SnapshotShaderNames + (GLuint)i);
+				}
+			}
+			for (std::map<GLint, std::string>::const_iterator uniform = program.uniforms.begin(); uniform != program.uniforms.end(); ++uniform)
+			{
+				begin(record, GlTrace::UniformLocation);
+				put(record, it->first);
+				put(record, (uint32_t)uniform->first);
+				putString(record, uniform->second);
+				write(record);
+			}
+		}
+
+		writeMarker(GlTrace::StateBegin);
+		for (std::map<GLuint, Program>::iterator it = capture.programs.begin(); it != capture.programs.end(); ++it)
+		{
+			if (it->second.values.empty())
+			{
+				continue;
+			}
+			writeCall(GlTrace::UseProgram, it->first);
+			for (std::map<GLint, Words>::iterator value = it->second.values.begin(); value != it->second.values.end(); ++value)
+			{
+				record = value->second;
+				write(record);
+			}
+		}
+		writeCall(GlTrace::UseProgram, capture.program);
+
+		for (std::map<std::pair<GLuint, GLenum>, GLuint>::iterator it = capture.boundTextures.begin(); it != capture.boundTextures.end(); ++it)
+		{
+			writeCall(GlTrace::ActiveTexture, GL_TEXTURE0 + it->first.first);
+			writeCall(GlTrace::BindTexture, it->first.second, it->second);
+		}
+		writeCall(GlTrace::ActiveTexture, GL_TEXTURE0 + capture.activeTexture);
+
+		for (std::map<GLuint, Attribute>::iterator it = capture.attributes.begin(); it != capture.attributes.end(); ++it)
+		{
+			const Attribute& attribute = it->second;
+			if (!attribute.pointer.empty())
+			{
+				writeCall(GlTrace::BindBuffer, GL_ARRAY_BUFFER, attribute.buffer);
+				record = attribute.pointer;
+				write(record);
+			}
+			writeCall(attribute.enabled ? GlTrace::EnableVertexAttribArray : GlTrace::DisableVertexAttribArray, it->first);
+			if (attribute.divisor != 0)
+			{
+				writeCall(GlTrace::VertexAttribDivisor, it->first, attribute.divisor);
+			}
+		}
+		writeCall(GlTrace::BindBuffer, GL_ARRAY_BUFFER, capture.arrayBuffer);
+		writeCall(GlTrace::BindBuffer, GL_ELEMENT_ARRAY_BUFFER, capture.elementBuffer);
+		writeCall(GlTrace::BindFramebuffer, GL_FRAMEBUFFER, capture.framebuffer);
+		writeCall(GlTrace::BindRenderbuffer, GL_RENDERBUFFER, capture.renderbuffer);
+
+		for (std::map<GLenum, bool>::iterator it = capture.capabilities.begin(); it != capture.capabilities.end(); ++it)
+		{
+			writeCall(it->second ? GlTrace::Enable : GlTrace::Disable, it->first);
+		}
+		Words* fixed[3] = { &capture.blendFunc, &capture.viewport, &capture.clearColor };
+		for (int i = 0; i < 3; ++i)
+		{
+			if (!fixed[i]->empty())
+			{
+				record = *fixed[i];
+				write(record);
+			}
+		}
+		if (capture.pixelStore.find(GL_UNPACK_ALIGNMENT) == capture.pixelStore.end())
+		{
+			capture.pixelStore[GL_UNPACK_ALIGNMENT] = 4;
+		}
+		for (std::map<GLenum, GLint>::iterator it = capture.pixelStore.begin(); it != capture.pixelStore.end(); ++it)
+		{
+			writeCall(GlTrace::PixelStorei, it->first, (uint32_t)it->second);
+		}
+	}
+
+	void writeHeader(uint32_t width, uint32_t height)
+	{
+		GlTrace::Header header;
+		header.magic = GlTrace::Magic;
+		header.version = GlTrace::Version;
+		header.width = width;
+		header.height = height;
+		header.frames = (uint32_t)capture.framesWritten;
+		header.records = capture.records;
+		fseek(capture.file, 0, SEEK_SET);
+		fwrite(&header, sizeof(header), 1, capture.file);
+	}
+
+	/*!*****************************************************************************************************************
+	\param[in]			width                       Width of the surface drawn to
+	\param[in]			height                      Height of the surface drawn to
+	\brief	Frame boundary: starts the capture, ends a captured frame or the capture.
+	*******************************************************************************************************************/
+	void endFrame(uint32_t width, uint32_t height)
+	{
+		if (!capture.enabled)
+		{
+			return;
+		}
+		++capture.framesSeen;
+		if (capture.recording)
+		{
+			writeMarker(GlTrace::FrameEnd);
+			++capture.framesWritten;
+			if (capture.framesWritten < capture.frameCount)
+			{
+				writeMarker(GlTrace::FrameBegin);
+				return;
+			}
+			capture.recording = false;
+			capture.enabled = false;
+			fseek(capture.file, 0, SEEK_END);
+			long size = ftell(capture.file);
+			writeHeader(width, height);
+			fclose(capture.file);
+			fprintf(stderr, "gl-capture: %d frames, %u records, %ld bytes written to %s\n",
+			        capture.framesWritten, capture.records, size, capture.path.c_str());
+			return;
+		}
+		if (capture.framesSeen != capture.firstFrame)
+		{
+			return;
+		}
+		capture.file = fopen(capture.path.c_str(), "wb");
+		if (capture.file == NULL)
+		{
+			fprintf(stderr, "gl-capture: unable to open %s\n", capture.path.c_str());
+			capture.enabled = false;
+			return;
+		}
+		writeHeader(width, height);
+		writeSnapshot();
+		writeMarker(GlTrace::FrameBegin);
+		capture.recording = true;
+	}
+
+	/*!*****************************************************************************************************************
+	\param[in]			display                     Display of the surface about to be swapped
+	\param[in]			surface                     Surface about to be swapped
+	\brief	Swap boundary: ends the frame at the size of the surface, unless frames end at glFinish.
+	*******************************************************************************************************************/
+	void endSwappedFrame(EGLDisplay display, EGLSurface surface)
+	{
+		if (!capture.enabled || capture.finishBoundary)
+		{
+			return;
+		}
+		EGLint width = 0;
+		EGLint height = 0;
+		eglQuerySurface(display, surface, EGL_WIDTH, &width);
+		eglQuerySurface(display, surface, EGL_HEIGHT, &height);
+		endFrame(width, height);
+	}
+
+	void warnClientArrays()
+	{
+		if (!capture.clientArraysWarned)
+		{
+			fprintf(stderr, "gl-capture: client side arrays are not captured, the trace draws from buffer 0\n");
+			capture.clientArraysWarned = true;
+		}
+	}
+
+	Texture* boundTexture(GLenum target)
+	{
+		// Cube faces are images of the cube map bound
+		GLenum binding = target == GL_TEXTURE_2D ? GL_TEXTURE_2D : GL_TEXTURE_CUBE_MAP;
+		std::map<std::pair<GLuint, GLenum>, GLuint>::iterator bound =
+			capture.boundTextures.find(std::make_pair(capture.activeTexture, binding));
+		if (bound == capture.boundTextures.end() || bound->second == 0)
+		{
+			return NULL;
+		}
+		Texture& texture = capture.textures[bound->second];
+		texture.target = binding;
+		return &texture;
+	}
+
+	GLint unpackAlignment()
+	{
+		std::map<GLenum, GLint>::iterator alignment = capture.pixelStore.find(GL_UNPACK_ALIGNMENT);
+		return alignment != capture.pixelStore.end() ? alignment->second : 4;
+	}
+
+	// Unpadded copy of an image read with the current unpack alignment
+	void packImage(const void* pixels, GLsizei width, GLsizei height, GLenum format, GLenum type, std::vector<uint8_t>& data)
+	{
+		size_t row = GlTrace::ImageSize(width, 1, format, type, 1);
+		size_t stride = GlTrace::ImageSize(width, 2, format, type, unpackAlignment()) - row;
+		data.resize(row * height);
+		for (GLsizei y = 0; y < height; ++y)
+		{
+			memcpy(&data[y * row], (const uint8_t*)pixels + y * stride, row);
+		}
+	}
+
+	void recordUniform(GLint location, Words& record)
+	{
+		end(record);
+		if (location >= 0 && capture.program != 0)
+		{
+			capture.programs[capture.program].values[location] = record;
+		}
+		::record(record);
+	}
+
+	void recordAttributeDivisor(GLuint index, GLuint divisor)
+	{
+		capture.attributes[index].divisor = divisor;
+		Words& record = capture.scratch;
+		begin(record, GlTrace::VertexAttribDivisor);
+		put(record, index);
+		put(record, divisor);
+		::record(record);
+	}
+
+	void recordDrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instances)
+	{
+		Words& record = capture.scratch;
+		begin(record, GlTrace::DrawArraysInstanced);
+		put(record, mode);
+		put(record, (uint32_t)first);
+		put(record, (uint32_t)count);
+		put(record, (uint32_t)instances);
+		::record(record);
+	}
+
+	void recordDrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instances)
+	{
+		if (capture.elementBuffer == 0)
+		{
+			warnClientArrays();
+		}
+		Words& record = capture.scratch;
+		begin(record, GlTrace::DrawElementsInstanced);
+		put(record, mode);
+		put(record, (uint32_t)count);
+		put(record, type);
+		put(record, (uint32_t)(uintptr_t)indices);
+		put(record, (uint32_t)instances);
+		::record(record);
+	}
+
+	// Extension entry points handed out by eglGetProcAddress, one slot per name
+	enum ExtensionVariant { Core, Ext, Angle, VariantCount };
+	const char* const VariantSuffixes[VariantCount] = { "", "EXT", "ANGLE" };
+	PFNGLVERTEXATTRIBDIVISOREXTPROC realVertexAttribDivisor[VariantCount];
+	PFNGLDRAWARRAYSINSTANCEDEXTPROC realDrawArraysInstanced[VariantCount];
+	PFNGLDRAWELEMENTSINSTANCEDEXTPROC realDrawElementsInstanced[VariantCount];
+	PFNGLPROGRAMBINARYOESPROC realProgramBinary = NULL;
+	enum DamageVariant { DamageKhr, DamageExt, DamageVariantCount };
+	const char* const SwapWithDamageNames[DamageVariantCount] = { "eglSwapBuffersWithDamageKHR", "eglSwapBuffersWithDamageEXT" };
+	PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC realSwapBuffersWithDamage[DamageVariantCount];
+
+	template <int Variant>
+	void GL_APIENTRY vertexAttribDivisor(GLuint index, GLuint divisor)
+	{
+		realVertexAttribDivisor[Variant](index, divisor);
+		if (capture.enabled)
+		{
+			recordAttributeDivisor(index, divisor);
+		}
+	}
+
+	template <int Variant>
+	void GL_APIENTRY drawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instances)
+	{
+		realDrawArraysInstanced[Variant](mode, first, count, instances);
+		if (capture.enabled)
+		{
+			recordDrawArraysInstanced(mode, first, count, instances);
+		}
+	}
+
+	template <int Variant>
+	void GL_APIENTRY drawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instances)
+	{
+		realDrawElementsInstanced[Variant](mode, count, type, indices, instances);
+		if (capture.enabled)
+		{
+			recordDrawElementsInstanced(mode, count, type, indices, instances);
+		}
+	}
+
+	// The damage only limits what the compositor presents, the frame is replayed whole
+	template <int Variant>
+	EGLBoolean EGLAPIENTRY swapBuffersWithDamage(EGLDisplay display, EGLSurface surface, const EGLint* rects, EGLint count)
+	{
+		endSwappedFrame(display, surface);
+		return realSwapBuffersWithDamage[Variant](display, surface, rects, count);
+	}
+
+	void GL_APIENTRY programBinary(GLuint program, GLenum format, const void* binary, GLint length)
+	{
+		realProgramBinary(program, format, binary, length);
+		if (!capture.enabled)
+		{
+			return;
+		}
+		Program& shadow = capture.programs[program];
+		shadow.binary = true;
+		shadow.binaryFormat = format;
+		shadow.binaryData.assign((const uint8_t*)binary, (const uint8_t*)binary + length);
+		shadow.linked.clear();
+		Words& record = capture.scratch;
+		begin(record, GlTrace::ProgramBinary);
+		put(record, program);
+		put(record, format);
+		putBlob(record, binary, length);
+		::record(record);
+	}
+}
+
+extern "C"
+{
+
+__eglMustCastToProperFunctionPointerType EGLAPIENTRY eglGetProcAddress(const char* name)
+{
+	REAL(eglGetProcAddress);
+	__eglMustCastToProperFunctionPointerType function = real(name);
+	if (function == NULL || name == NULL)
+	{
+		return function;
+	}
+	if (strcmp(name, "glProgramBinaryOES") == 0)
+	{
+		realProgramBinary = (PFNGLPROGRAMBINARYOESPROC)function;
+		return (__eglMustCastToProperFunctionPointerType)programBinary;
+	}
+	for (int variant = 0; variant < DamageVariantCount; ++variant)
+	{
+		if (strcmp(name, SwapWithDamageNames[variant]) == 0)
+		{
+			realSwapBuffersWithDamage[variant] = (PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC)function;
+			__eglMustCastToProperFunctionPointerType wrappers[DamageVariantCount] =
+			{
+				(__eglMustCastToProperFunctionPointerType)swapBuffersWithDamage<DamageKhr>,
+				(__eglMustCastToProperFunctionPointerType)swapBuffersWithDamage<DamageExt>
+			};
+			return wrappers[variant];
+		}
+	}
+	for (int variant = 0; variant < VariantCount; ++variant)
+	{
+		std::string suffix = VariantSuffixes[variant];
+		if (name == "glVertexAttribDivisor" + suffix)
+		{
+			realVertexAttribDivisor[variant] = (PFNGLVERTEXATTRIBDIVISOREXTPROC)function;
+			__eglMustCastToProperFunctionPointerType wrappers[VariantCount] =
+			{
+				(__eglMustCastToProperFunctionPointerType)vertexAttribDivisor<Core>,
+				(__eglMustCastToProperFunctionPointerType)vertexAttribDivisor<Ext>,
+				(__eglMustCastToProperFunctionPointerType)vertexAttribDivisor<Angle>
+			};
+			return wrappers[variant];
+		}
+		if (name == "glDrawArraysInstanced" + suffix)
+		{
+			realDrawArraysInstanced[variant] = (PFNGLDRAWARRAYSINSTANCEDEXTPROC)function;
+			__eglMustCastToProperFunctionPointerType wrappers[VariantCount] =
+			{
+				(__eglMustCastToProperFunctionPointerType)drawArraysInstanced<Core>,
+				(__eglMustCastToProperFunctionPointerType)drawArraysInstanced<Ext>,
+				(__eglMustCastToProperFunctionPointerType)drawArraysInstanced<Angle>
+			};
+			return wrappers[variant];
+		}
+		if (name == "glDrawElementsInstanced" + suffix)
+		{
+			realDrawElementsInstanced[variant] = (PFNGLDRAWELEMENTSINSTANCEDEXTPROC)function;
+			__eglMustCastToProperFunctionPointerType wrappers[VariantCount] =
+			{
+				(__eglMustCastToProperFunctionPointerType)drawElementsInstanced<Core>,
+				(__eglMustCastToProperFunctionPointerType)drawElementsInstanced<Ext>,
+				(__eglMustCastToProperFunctionPointerType)drawElementsInstanced<Angle>
+			};
+			return wrappers[variant];
+		}
+	}
+	return function;
+}
+
+EGLBoolean EGLAPIENTRY eglSwapBuffers(EGLDisplay display, EGLSurface surface)
+{
+	REAL(eglSwapBuffers);
+	endSwappedFrame(display, surface);
+	return real(display, surface);
+}
+
+void GL_APIENTRY glFinish()
+{
+	REAL(glFinish);
+	real();
+	if (!capture.enabled)
+	{
+		return;
+	}
+	Words& record = capture.scratch;
+	begin(record, GlTrace::Finish);
+	::record(record);
+	if (capture.finishBoundary)
+	{
+		// Surfaceless contexts draw to a framebuffer, the viewport tells its size
+		EGLint width = capture.viewportWidth;
+		EGLint height = capture.viewportHeight;
+		EGLSurface surface = eglGetCurrentSurface(EGL_DRAW);
+		if (surface != EGL_NO_SURFACE)
+		{
+			eglQuerySurface(eglGetCurrentDisplay(), surface, EGL_WIDTH, &width);
+			eglQuerySurface(eglGetCurrentDisplay(), surface, EGL_HEIGHT, &height);
+		}
+		endFrame(width, height);
+	}
+}
+
+void GL_APIENTRY glFlush()
+{
+	REAL(glFlush);
+	real();
+	if (!capture.enabled)
+	{
+		return;
+	}
+	Words& record = capture.scratch;
+	begin(record, GlTrace::Flush);
+	::record(record);
+}
+
+void GL_APIENTRY glGenBuffers(GLsizei count, GLuint* buffers)
+{
+	REAL(glGenBuffers);
+	real(count, buffers);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	for (GLsizei i = 0; i < count; ++i)
+	{
+		Buffer& buffer = capture.buffers[buffers[i]];
+		buffer.defined = false;
+		buffer.usage = GL_STATIC_DRAW;
+		Words& record = capture.scratch;
+		begin(record, GlTrace::GenBuffer);
+		put(record, buffers[i]);
+		::record(record);
+	}
+}
+
+void GL_APIENTRY glDeleteBuffers(GLsizei count, const GLuint* buffers)
+{
+	REAL(glDeleteBuffers);
+	real(count, buffers);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	for (GLsizei i = 0; i < count; ++i)
+	{
+		capture.buffers.erase(buffers[i]);
+		if (capture.arrayBuffer == buffers[i]) { capture.arrayBuffer = 0; }
+		if (capture.elementBuffer == buffers[i]) { capture.elementBuffer = 0; }
+		Words& record = capture.scratch;
+		begin(record, GlTrace::DeleteBuffer);
+		put(record, buffers[i]);
+		::record(record);
+	}
+}
+
+void GL_APIENTRY glBindBuffer(GLenum target, GLuint buffer)
+{
+	REAL(glBindBuffer);
+	real(target, buffer);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	if (target == GL_ARRAY_BUFFER) { capture.arrayBuffer = buffer; }
+	if (target == GL_ELEMENT_ARRAY_BUFFER) { capture.elementBuffer = buffer; }
+	Words& record = capture.scratch;
+	begin(record, GlTrace::BindBuffer);
+	put(record, target);
+	put(record, buffer);
+	::record(record);
+}
+
+void GL_APIENTRY glBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+{
+	REAL(glBufferData);
+	real(target, size, data, usage);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	GLuint name = target == GL_ARRAY_BUFFER ? capture.arrayBuffer : target == GL_ELEMENT_ARRAY_BUFFER ? capture.elementBuffer : 0;
+	if (name != 0)
+	{
+		Buffer& buffer = capture.buffers[name];
+		buffer.defined = true;
+		buffer.usage = usage;
+		if (data != NULL)
+		{
+			buffer.data.assign((const uint8_t*)data, (const uint8_t*)data + size);
+		}
+		else
+		{
+			buffer.data.assign(size, 0);
+		}
+	}
+	Words& record = capture.scratch;
+	begin(record, GlTrace::BufferData);
+	put(record, target);
+	put(record, (uint32_t)size);
+	put(record, usage);
+	put(record, data != NULL ? 1 : 0);
+	putBlob(record, data, data != NULL ? size : 0);
+	::record(record);
+}
+
+void GL_APIENTRY glBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data)
+{
+	REAL(glBufferSubData);
+	real(target, offset, size, data);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	GLuint name = target == GL_ARRAY_BUFFER ? capture.arrayBuffer : target == GL_ELEMENT_ARRAY_BUFFER ? capture.elementBuffer : 0;
+	std::map<GLuint, Buffer>::iterator buffer = capture.buffers.find(name);
+	if (buffer != capture.buffers.end() && (size_t)(offset + size) <= buffer->second.data.size())
+	{
+		memcpy(&buffer->second.data[offset], data, size);
+	}
+	Words& record = capture.scratch;
+	begin(record, GlTrace::BufferSubData);
+	put(record, target);
+	put(record, (uint32_t)offset);
+	putBlob(record, data, size);
+	::record(record);
+}
+
+void GL_APIENTRY glGenTextures(GLsizei count, GLuint* textures)
+{
+	REAL(glGenTextures);
+	real(count, textures);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	for (GLsizei i = 0; i < count; ++i)
+	{
+		Texture& texture = capture.textures[textures[i]];
+		texture.target = 0;
+		texture.mipmapped = false;
+		Words& record = capture.scratch;
+		begin(record, GlTrace::GenTexture);
+		put(record, textures[i]);
+		::record(record);
+	}
+}
+
+void GL_APIENTRY glDeleteTextures(GLsizei count, const GLuint* textures)
+{
+	REAL(glDeleteTextures);
+	real(count, textures);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	for (GLsizei i = 0; i < count; ++i)
+	{
+		capture.textures.erase(textures[i]);
+		for (std::map<std::pair<GLuint, GLenum>, GLuint>::iterator it = capture.boundTextures.begin(); it != capture.boundTextures.end(); ++it)
+		{
+			if (it->second == textures[i]) { it->second = 0; }
+		}
+		Words& record = capture.scratch;
+		begin(record, GlTrace::DeleteTexture);
+		put(record, textures[i]);
+		::record(record);
+	}
+}
+
+void GL_APIENTRY glActiveTexture(GLenum texture)
+{
+	REAL(glActiveTexture);
+	real(texture);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	capture.activeTexture = texture - GL_TEXTURE0;
+	Words& record = capture.scratch;
+	begin(record, GlTrace::ActiveTexture);
+	put(record, texture);
+	::record(record);
+}
+
+void GL_APIENTRY glBindTexture(GLenum target, GLuint texture)
+{
+	REAL(glBindTexture);
+	real(target, texture);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	capture.boundTextures[std::make_pair(capture.activeTexture, target)] = texture;
+	if (texture != 0)
+	{
+		capture.textures[texture].target = target;
+	}
+	Words& record = capture.scratch;
+	begin(record, GlTrace::BindTexture);
+	put(record, target);
+	put(record, texture);
+	::record(record);
+}
+
+void GL_APIENTRY glTexParameteri(GLenum target, GLenum name, GLint value)
+{
+	REAL(glTexParameteri);
+	real(target, name, value);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	Texture* texture = boundTexture(target);
+	if (texture != NULL)
+	{
+		texture->parameters[name] = value;
+	}
+	Words& record = capture.scratch;
+	begin(record, GlTrace::TexParameteri);
+	put(record, target);
+	put(record, name);
+	put(record, (uint32_t)value);
+	::record(record);
+}
+
+void GL_APIENTRY glTexImage2D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height,
+                              GLint border, GLenum format, GLenum type, const void* pixels)
+{
+	REAL(glTexImage2D);
+	real(target, level, internalFormat, width, height, border, format, type, pixels);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	Texture* texture = boundTexture(target);
+	if (texture != NULL)
+	{
+		Level& image = texture->levels[std::make_pair(target, level)];
+		image.internalFormat = internalFormat;
+		image.width = width;
+		image.height = height;
+		image.format = format;
+		image.type = type;
+		image.compressed = false;
+		image.data.clear();
+		if (pixels != NULL)
+		{
+			packImage(pixels, width, height, format, type, image.data);
+		}
+	}
+	size_t size = pixels != NULL ? GlTrace::ImageSize(width, height, format, type, unpackAlignment()) : 0;
+	Words& record = capture.scratch;
+	begin(record, GlTrace::TexImage2D);
+	put(record, target);
+	put(record, (uint32_t)level);
+	put(record, (uint32_t)internalFormat);
+	put(record, (uint32_t)width);
+	put(record, (uint32_t)height);
+	put(record, (uint32_t)border);
+	put(record, format);
+	put(record, type);
+	put(record, pixels != NULL ? 1 : 0);
+	putBlob(record, pixels, size);
+	::record(record);
+}
+
+void GL_APIENTRY glTexSubImage2D(GLenum target, GLint level, GLint x, GLint y, GLsizei width, GLsizei height,
+                                 GLenum format, GLenum type, const void* pixels)
+{
+	REAL(glTexSubImage2D);
+	real(target, level, x, y, width, height, format, type, pixels);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	Texture* texture = boundTexture(target);
+	std::map<std::pair<GLenum, GLint>, Level>::iterator found;
+	if (texture != NULL && (found = texture->levels.find(std::make_pair(target, level))) != texture->levels.end()
+	    && !found->second.compressed && x >= 0 && y >= 0 && x + width <= found->second.width && y + height <= found->second.height)
+	{
+		Level& image = found->second;
+		size_t pixel = GlTrace::ImageSize(1, 1, image.format, image.type, 1);
+		size_t row = GlTrace::ImageSize(image.width, 1, image.format, image.type, 1);
+		if (image.data.empty())
+		{
+			image.data.assign(row * image.height, 0);
+		}
+		std::vector<uint8_t> rectangle;
+		packImage(pixels, width, height, format, type, rectangle);
+		for (GLsizei line = 0; line < height; ++line)
+		{
+			memcpy(&image.data[(y + line) * row + x * pixel], &rectangle[line * width * pixel], width * pixel);
+		}
+	}
+	Words& record = capture.scratch;
+	begin(record, GlTrace::TexSubImage2D);
+	put(record, target);
+	put(record, (uint32_t)level);
+	put(record, (uint32_t)x);
+	put(record, (uint32_t)y);
+	put(record, (uint32_t)width);
+	put(record, (uint32_t)height);
+	put(record, format);
+	put(record, type);
+	putBlob(record, pixels, GlTrace::ImageSize(width, height, format, type, unpackAlignment()));
+	::record(record);
+}
+
+void GL_APIENTRY glCompressedTexImage2D(GLenum target, GLint level, GLenum internalFormat, GLsizei width, GLsizei height,
+                                        GLint border, GLsizei size, const void* data)
+{
+	REAL(glCompressedTexImage2D);
+	real(target, level, internalFormat, width, height, border, size, data);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	Texture* texture = boundTexture(target);
+	if (texture != NULL)
+	{
+		Level& image = texture->levels[std::make_pair(target, level)];
+		image.internalFormat = internalFormat;
+		image.width = width;
+		image.height = height;
+		image.format = 0;
+		image.type = 0;
+		image.compressed = true;
+		image.data.assign((const uint8_t*)data, (const uint8_t*)data + size);
+	}
+	Words& record = capture.scratch;
+	begin(record, GlTrace::CompressedTexImage2D);
+	put(record, target);
+	put(record, (uint32_t)level);
+	put(record, internalFormat);
+	put(record, (uint32_t)width);
+	put(record, (uint32_t)height);
+	put(record, (uint32_t)border);
+	putBlob(record, data, size);
+	::record(record);
+}
+
+void GL_APIENTRY glPixelStorei(GLenum name, GLint value)
+{
+	REAL(glPixelStorei);
+	real(name, value);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	capture.pixelStore[name] = value;
+	Words& record = capture.scratch;
+	begin(record, GlTrace::PixelStorei);
+	put(record, name);
+	put(record, (uint32_t)value);
+	::record(record);
+}
+
+void GL_APIENTRY glGenerateMipmap(GLenum target)
+{
+	REAL(glGenerateMipmap);
+	real(target);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	Texture* texture = boundTexture(target);
+	if (texture != NULL)
+	{
+		texture->mipmapped = true;
+	}
+	Words& record = capture.scratch;
+	begin(record, GlTrace::GenerateMipmap);
+	put(record, target);
+	::record(record);
+}
+
+GLuint GL_APIENTRY glCreateShader(GLenum type)
+{
+	REAL(glCreateShader);
+	GLuint shader = real(type);
+	if (!capture.enabled || shader == 0)
+	{
+		return shader;
+	}
+	capture.shaders[shader].type = type;
+	Words& record = capture.scratch;
+	begin(record, GlTrace::CreateShader);
+	put(record, shader);
+	put(record, type);
+	::record(record);
+	return shader;
+}
+
+void GL_APIENTRY glDeleteShader(GLuint shader)
+{
+	REAL(glDeleteShader);
+	real(shader);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	capture.shaders.erase(shader);
+	Words& record = capture.scratch;
+	begin(record, GlTrace::DeleteShader);
+	put(record, shader);
+	::record(record);
+}
+
+void GL_APIENTRY glShaderSource(GLuint shader, GLsizei count, const GLchar* const* strings, const GLint* lengths)
+{
+	REAL(glShaderSource);
+	real(shader, count, strings, lengths);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	std::string source;
+	for (GLsizei i = 0; i < count; ++i)
+	{
+		if (lengths != NULL && lengths[i] >= 0)
+		{
+			source.append(strings[i], lengths[i]);
+		}
+		else
+		{
+			source.append(strings[i]);
+		}
+	}
+	capture.shaders[shader].source = source;
+	Words& record = capture.scratch;
+	begin(record, GlTrace::ShaderSource);
+	put(record, shader);
+	putString(record, source);
+	::record(record);
+}
+
+void GL_APIENTRY glCompileShader(GLuint shader)
+{
+	REAL(glCompileShader);
+	real(shader);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	Words& record = capture.scratch;
+	begin(record, GlTrace::CompileShader);
+	put(record, shader);
+	::record(record);
+}
+
+GLuint GL_APIENTRY glCreateProgram()
+{
+	REAL(glCreateProgram);
+	GLuint program = real();
+	if (!capture.enabled || program == 0)
+	{
+		return program;
+	}
+	capture.programs[program].binary = false;
+	Words& record = capture.scratch;
+	begin(record, GlTrace::CreateProgram);
+	put(record, program);
+	::record(record);
+	return program;
+}
+
+void GL_APIENTRY glDeleteProgram(GLuint program)
+{
+	REAL(glDeleteProgram);
+	real(program);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	capture.programs.erase(program);
+	Words& record = capture.scratch;
+	begin(record, GlTrace::DeleteProgram);
+	put(record, program);
+	::record(record);
+}
+
+void GL_APIENTRY glAttachShader(GLuint program, GLuint shader)
+{
+	REAL(glAttachShader);
+	real(program, shader);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	capture.programs[program].attached.push_back(shader);
+	Words& record = capture.scratch;
+	begin(record, GlTrace::AttachShader);
+	put(record, program);
+	put(record, shader);
+	::record(record);
+}
+
+void GL_APIENTRY glDetachShader(GLuint program, GLuint shader)
+{
+	REAL(glDetachShader);
+	real(program, shader);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	std::vector<GLuint>& attached = capture.programs[program].attached;
+	for (size_t i = 0; i < attached.size(); ++i)
+	{
+		if (attached[i] == shader)
+		{
+			attached.erase(attached.begin() + i);
+			break;
+		}
+	}
+	Words& record = capture.scratch;
+	begin(record, GlTrace::DetachShader);
+	put(record, program);
+	put(record, shader);
+	::record(record);
+}
+
+void GL_APIENTRY glBindAttribLocation(GLuint program, GLuint index, const GLchar* name)
+{
+	REAL(glBindAttribLocation);
+	real(program, index, name);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	capture.programs[program].attributes[name] = index;
+	Words& record = capture.scratch;
+	begin(record, GlTrace::BindAttribLocation);
+	put(record, program);
+	put(record, index);
+	putString(record, name);
+	::record(record);
+}
+
+void GL_APIENTRY glLinkProgram(GLuint program)
+{
+	REAL(glLinkProgram);
+	real(program);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	Program& shadow = capture.programs[program];
+	shadow.binary = false;
+	shadow.linked.clear();
+	for (size_t i = 0; i < shadow.attached.size(); ++i)
+	{
+		std::map<GLuint, Shader>::iterator shader = capture.shaders.find(shadow.attached[i]);
+		if (shader != capture.shaders.end())
+		{
+			shadow.linked.push_back(shader->second);
+		}
+	}
+	Words& record = capture.scratch;
+	begin(record, GlTrace::LinkProgram);
+	put(record, program);
+	::record(record);
+}
+
+void GL_APIENTRY glUseProgram(GLuint program)
+{
+	REAL(glUseProgram);
+	real(program);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	capture.program = program;
+	Words& record = capture.scratch;
+	begin(record, GlTrace::UseProgram);
+	put(record, program);
+	::record(record);
+}
+
+GLint GL_APIENTRY glGetAttribLocation(GLuint program, const GLchar* name)
+{
+	REAL(glGetAttribLocation);
+	GLint location = real(program, name);
+	if (capture.enabled && location >= 0)
+	{
+		capture.programs[program].attributes[name] = location;
+	}
+	return location;
+}
+
+GLint GL_APIENTRY glGetUniformLocation(GLuint program, const GLchar* name)
+{
+	REAL(glGetUniformLocation);
+	GLint location = real(program, name);
+	if (!capture.enabled || location < 0)
+	{
+		return location;
+	}
+	capture.programs[program].uniforms[location] = name;
+	Words& record = capture.scratch;
+	begin(record, GlTrace::UniformLocation);
+	put(record, program);
+	put(record, (uint32_t)location);
+	putString(record, name);
+	::record(record);
+	return location;
+}
+
+void GL_APIENTRY glUniform1i(GLint location, GLint x)
+{
+	REAL(glUniform1i);
+	real(location, x);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	Words& record = capture.scratch;
+	begin(record, GlTrace::Uniform1i);
+	put(record, (uint32_t)location);
+	put(record, (uint32_t)x);
+	recordUniform(location, record);
+}
+
+void GL_APIENTRY glUniform1f(GLint location, GLfloat x)
+{
+	REAL(glUniform1f);
+	real(location, x);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	Words& record = capture.scratch;
+	begin(record, GlTrace::Uniform1f);
+	put(record, (uint32_t)location);
+	putFloat(record, x);
+	recordUniform(location, record);
+}
+
+void GL_APIENTRY glUniform2f(GLint location, GLfloat x, GLfloat y)
+{
+	REAL(glUniform2f);
+	real(location, x, y);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	Words& record = capture.scratch;
+	begin(record, GlTrace::Uniform2f);
+	put(record, (uint32_t)location);
+	putFloat(record, x);
+	putFloat(record, y);
+	recordUniform(location, record);
+}
+
+void GL_APIENTRY glUniform3f(GLint location, GLfloat x, GLfloat y, GLfloat z)
+{
+	REAL(glUniform3f);
+	real(location, x, y, z);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	Words& record = capture.scratch;
+	begin(record, GlTrace::Uniform3f);
+	put(record, (uint32_t)location);
+	putFloat(record, x);
+	putFloat(record, y);
+	putFloat(record, z);
+	recordUniform(location, record);
+}
+
+void GL_APIENTRY glUniform4f(GLint location, GLfloat x, GLfloat y, GLfloat z, GLfloat w)
+{
+	REAL(glUniform4f);
+	real(location, x, y, z, w);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	Words& record = capture.scratch;
+	begin(record, GlTrace::Uniform4f);
+	put(record, (uint32_t)location);
+	putFloat(record, x);
+	putFloat(record, y);
+	putFloat(record, z);
+	putFloat(record, w);
+	recordUniform(location, record);
+}
+
+/*!*********************************************************************************************************************
+\param[in]			opcode                      One of the vector uniform opcodes
+\param[in]			location                    Uniform location
+\param[in]			count                       Vectors or matrices set
+\param[in]			values                      count times components floats
+\param[in]			components                  Floats per vector or matrix
+\brief	Records a call setting an array of uniform vectors or matrices.
+***********************************************************************************************************************/
+static void recordUniformArray(uint32_t opcode, GLint location, GLsizei count, const GLfloat* values, size_t components)
+{
+	Words& record = capture.scratch;
+	begin(record, opcode);
+	put(record, (uint32_t)location);
+	put(record, (uint32_t)count);
+	putBlob(record, values, count * components * sizeof(GLfloat));
+	recordUniform(location, record);
+}
+
+void GL_APIENTRY glUniform1fv(GLint location, GLsizei count, const GLfloat* values)
+{
+	REAL(glUniform1fv);
+	real(location, count, values);
+	if (capture.enabled)
+	{
+		recordUniformArray(GlTrace::Uniform1fv, location, count, values, 1);
+	}
+}
+
+void GL_APIENTRY glUniform2fv(GLint location, GLsizei count, const GLfloat* values)
+{
+	REAL(glUniform2fv);
+	real(location, count, values);
+	if (capture.enabled)
+	{
+		recordUniformArray(GlTrace::Uniform2fv, location, count, values, 2);
+	}
+}
+
+void GL_APIENTRY glUniform3fv(GLint location, GLsizei count, const GLfloat* values)
+{
+	REAL(glUniform3fv);
+	real(location, count, values);
+	if (capture.enabled)
+	{
+		recordUniformArray(GlTrace::Uniform3fv, location, count, values, 3);
+	}
+}
+
+void GL_APIENTRY glUniform4fv(GLint location, GLsizei count, const GLfloat* values)
+{
+	REAL(glUniform4fv);
+	real(location, count, values);
+	if (capture.enabled)
+	{
+		recordUniformArray(GlTrace::Uniform4fv, location, count, values, 4);
+	}
+}
+
+void GL_APIENTRY glUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* values)
+{
+	REAL(glUniformMatrix4fv);
+	real(location, count, transpose, values);
+	if (capture.enabled)
+	{
+		// ES 2 only accepts untransposed matrices
+		recordUniformArray(GlTrace::UniformMatrix4fv, location, count, values, 16);
+	}
+}
+
+void GL_APIENTRY glGenFramebuffers(GLsizei count, GLuint* framebuffers)
+{
+	REAL(glGenFramebuffers);
+	real(count, framebuffers);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	for (GLsizei i = 0; i < count; ++i)
+	{
+		capture.framebuffers[framebuffers[i]].clear();
+		Words& record = capture.scratch;
+		begin(record, GlTrace::GenFramebuffer);
+		put(record, framebuffers[i]);
+		::record(record);
+	}
+}
+
+void GL_APIENTRY glDeleteFramebuffers(GLsizei count, const GLuint* framebuffers)
+{
+	REAL(glDeleteFramebuffers);
+	real(count, framebuffers);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	for (GLsizei i = 0; i < count; ++i)
+	{
+		capture.framebuffers.erase(framebuffers[i]);
+		if (capture.framebuffer == framebuffers[i]) { capture.framebuffer = 0; }
+		Words& record = capture.scratch;
+		begin(record, GlTrace::DeleteFramebuffer);
+		put(record, framebuffers[i]);
+		::record(record);
+	}
+}
+
+void GL_APIENTRY glBindFramebuffer(GLenum target, GLuint framebuffer)
+{
+	REAL(glBindFramebuffer);
+	real(target, framebuffer);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	capture.framebuffer = framebuffer;
+	Words& record = capture.scratch;
+	begin(record, GlTrace::BindFramebuffer);
+	put(record, target);
+	put(record, framebuffer);
+	::record(record);
+}
+
+void GL_APIENTRY glFramebufferTexture2D(GLenum target, GLenum attachment, GLenum textureTarget, GLuint texture, GLint level)
+{
+	REAL(glFramebufferTexture2D);
+	real(target, attachment, textureTarget, texture, level);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	Words& record = capture.scratch;
+	begin(record, GlTrace::FramebufferTexture2D);
+	put(record, target);
+	put(record, attachment);
+	put(record, textureTarget);
+	put(record, texture);
+	put(record, (uint32_t)level);
+	end(record);
+	if (capture.framebuffer != 0)
+	{
+		capture.framebuffers[capture.framebuffer][attachment] = record;
+	}
+	::record(record);
+}
+
+void GL_APIENTRY glFramebufferRenderbuffer(GLenum target, GLenum attachment, GLenum renderbufferTarget, GLuint renderbuffer)
+{
+	REAL(glFramebufferRenderbuffer);
+	real(target, attachment, renderbufferTarget, renderbuffer);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	Words& record = capture.scratch;
+	begin(record, GlTrace::FramebufferRenderbuffer);
+	put(record, target);
+	put(record, attachment);
+	put(record, renderbufferTarget);
+	put(record, renderbuffer);
+	end(record);
+	if (capture.framebuffer != 0)
+	{
+		capture.framebuffers[capture.framebuffer][attachment] = record;
+	}
+	::record(record);
+}
+
+void GL_APIENTRY glGenRenderbuffers(GLsizei count, GLuint* renderbuffers)
+{
+	REAL(glGenRenderbuffers);
+	real(count, renderbuffers);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	for (GLsizei i = 0; i < count; ++i)
+	{
+		capture.renderbuffers[renderbuffers[i]].clear();
+		Words& record = capture.scratch;
+		begin(record, GlTrace::GenRenderbuffer);
+		put(record, renderbuffers[i]);
+		::record(record);
+	}
+}
+
+void GL_APIENTRY glDeleteRenderbuffers(GLsizei count, const GLuint* renderbuffers)
+{
+	REAL(glDeleteRenderbuffers);
+	real(count, renderbuffers);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	for (GLsizei i = 0; i < count; ++i)
+	{
+		capture.renderbuffers.erase(renderbuffers[i]);
+		if (capture.renderbuffer == renderbuffers[i]) { capture.renderbuffer = 0; }
+		Words& record = capture.scratch;
+		begin(record, GlTrace::DeleteRenderbuffer);
+		put(record, renderbuffers[i]);
+		::record(record);
+	}
+}
+
+void GL_APIENTRY glBindRenderbuffer(GLenum target, GLuint renderbuffer)
+{
+	REAL(glBindRenderbuffer);
+	real(target, renderbuffer);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	capture.renderbuffer = renderbuffer;
+	Words& record = capture.scratch;
+	begin(record, GlTrace::BindRenderbuffer);
+	put(record, target);
+	put(record, renderbuffer);
+	::record(record);
+}
+
+void GL_APIENTRY glRenderbufferStorage(GLenum target, GLenum internalFormat, GLsizei width, GLsizei height)
+{
+	REAL(glRenderbufferStorage);
+	real(target, internalFormat, width, height);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	Words& record = capture.scratch;
+	begin(record, GlTrace::RenderbufferStorage);
+	put(record, target);
+	put(record, internalFormat);
+	put(record, (uint32_t)width);
+	put(record, (uint32_t)height);
+	end(record);
+	if (capture.renderbuffer != 0)
+	{
+		capture.renderbuffers[capture.renderbuffer] = record;
+	}
+	::record(record);
+}
+
+void GL_APIENTRY glEnable(GLenum capability)
+{
+	REAL(glEnable);
+	real(capability);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	capture.capabilities[capability] = true;
+	Words& record = capture.scratch;
+	begin(record, GlTrace::Enable);
+	put(record, capability);
+	::record(record);
+}
+
+void GL_APIENTRY glDisable(GLenum capability)
+{
+	REAL(glDisable);
+	real(capability);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	capture.capabilities[capability] = false;
+	Words& record = capture.scratch;
+	begin(record, GlTrace::Disable);
+	put(record, capability);
+	::record(record);
+}
+
+void GL_APIENTRY glBlendFunc(GLenum source, GLenum destination)
+{
+	REAL(glBlendFunc);
+	real(source, destination);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	Words& record = capture.blendFunc;
+	begin(record, GlTrace::BlendFunc);
+	put(record, source);
+	put(record, destination);
+	end(record);
+	::record(record);
+}
+
+void GL_APIENTRY glViewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	REAL(glViewport);
+	real(x, y, width, height);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	capture.viewportWidth = width;
+	capture.viewportHeight = height;
+	Words& record = capture.viewport;
+	begin(record, GlTrace::Viewport);
+	put(record, (uint32_t)x);
+	put(record, (uint32_t)y);
+	put(record, (uint32_t)width);
+	put(record, (uint32_t)height);
+	end(record);
+	::record(record);
+}
+
+void GL_APIENTRY glClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha)
+{
+	REAL(glClearColor);
+	real(red, green, blue, alpha);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	Words& record = capture.clearColor;
+	begin(record, GlTrace::ClearColor);
+	putFloat(record, red);
+	putFloat(record, green);
+	putFloat(record, blue);
+	putFloat(record, alpha);
+	end(record);
+	::record(record);
+}
+
+void GL_APIENTRY glClear(GLbitfield mask)
+{
+	REAL(glClear);
+	real(mask);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	Words& record = capture.scratch;
+	begin(record, GlTrace::Clear);
+	put(record, mask);
+	::record(record);
+}
+
+void GL_APIENTRY glEnableVertexAttribArray(GLuint index)
+{
+	REAL(glEnableVertexAttribArray);
+	real(index);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	capture.attributes[index].enabled = true;
+	Words& record = capture.scratch;
+	begin(record, GlTrace::EnableVertexAttribArray);
+	put(record, index);
+	::record(record);
+}
+
+void GL_APIENTRY glDisableVertexAttribArray(GLuint index)
+{
+	REAL(glDisableVertexAttribArray);
+	real(index);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	capture.attributes[index].enabled = false;
+	Words& record = capture.scratch;
+	begin(record, GlTrace::DisableVertexAttribArray);
+	put(record, index);
+	::record(record);
+}
+
+void GL_APIENTRY glVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer)
+{
+	REAL(glVertexAttribPointer);
+	real(index, size, type, normalized, stride, pointer);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	if (capture.arrayBuffer == 0)
+	{
+		warnClientArrays();
+	}
+	Attribute& attribute = capture.attributes[index];
+	attribute.buffer = capture.arrayBuffer;
+	Words& record = attribute.pointer;
+	begin(record, GlTrace::VertexAttribPointer);
+	put(record, index);
+	put(record, (uint32_t)size);
+	put(record, type);
+	put(record, normalized);
+	put(record, (uint32_t)stride);
+	put(record, (uint32_t)(uintptr_t)pointer);
+	end(record);
+	::record(record);
+}
+
+void GL_APIENTRY glDrawArrays(GLenum mode, GLint first, GLsizei count)
+{
+	REAL(glDrawArrays);
+	real(mode, first, count);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	Words& record = capture.scratch;
+	begin(record, GlTrace::DrawArrays);
+	put(record, mode);
+	put(record, (uint32_t)first);
+	put(record, (uint32_t)count);
+	::record(record);
+}
+
+void GL_APIENTRY glDrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices)
+{
+	REAL(glDrawElements);
+	real(mode, count, type, indices);
+	if (!capture.enabled)
+	{
+		return;
+	}
+	if (capture.elementBuffer == 0)
+	{
+		warnClientArrays();
+	}
+	Words& record = capture.scratch;
+	begin(record, GlTrace::DrawElements);
+	put(record, mode);
+	put(record, (uint32_t)count);
+	put(record, type);
+	put(record, (uint32_t)(uintptr_t)indices);
+	::record(record);
+}
+
+}
@@ -0,0 +1,634 @@
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+#include <benchmark/Statistics.h>
+#include <headless/HeadlessContext.h>
+
+#include "GlTrace.h"
+
+// Replays a trace written by the gl-capture library on a headless context
+// (pbuffer, or an FBO when surfaceless) sized like the captured surface.
+// The objects alive at capture time are recreated once, then the bindings,
+// uniform values and captured frames are replayed in a loop. Every call is
+// timed on its own; with -s each one is followed by a glFinish so that its
+// time includes the work it queued on the GPU. The report gives the time
+// of an iteration, the share of each entry point and, with -c, the time of
+// every call in trace order, so that two captures of a frame (renderer
+// versions, drivers) can be compared call by call.
+
+// Default replay parameters
+const int DefaultIterations    = 200;
+const int DefaultWarmup        = 10;
+
+typedef std::chrono::steady_clock Clock;
+
+void usage(const char* program)
+{
+	std::cerr<<"usage: "<<program<<" [-n iterations] [-u warmup iterations] [-s] [-c] [-o output.json] trace"<<std::endl;
+	std::cerr<<"  -s  glFinish after every call, the call's time includes its GPU work"<<std::endl;
+	std::cerr<<"  -c  report the time of every call"<<std::endl;
+}
+
+struct Call
+{
+	uint32_t opcode;
+	const uint32_t* arguments;
+	uint32_t words;
+};
+
+/*!*********************************************************************************************************************
+\param[in]			path                        Trace file
+\param[out]		words                       File content
+\param[out]		header                      Validated header
+\param[out]		calls                       Records, pointing into words
+\return		Whether the file is a trace of this version whose records fit in it
+\brief	Reads a trace.
+***********************************************************************************************************************/
+bool readTrace(const char* path, std::vector<uint32_t>& words, GlTrace::Header& header, std::vector<Call>& calls)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file)
+	{
+		std::cerr<<"Unable to open "<<path<<std::endl;
+		return false;
+	}
+	size_t size = (size_t)file.tellg();
+	if (size < sizeof(header) || size % sizeof(uint32_t) != 0)
+	{
+		std::cerr<<path<<" is not a trace"<<std::endl;
+		return false;
+	}
+	words.resize(size / sizeof(uint32_t));
+	file.seekg(0);
+	file.read((char*)words.data(), size);
+	memcpy(&header, words.data(), sizeof(header));
+	if (header.magic != GlTrace::Magic || header.version != GlTrace::Version)
+	{
+		std::cerr<<path<<" is not a version "<<GlTrace::Version<<" trace"<<std::endl;
+		return false;
+	}
+	if (header.frames == 0)
+	{
+		std::cerr<<path<<" was not finished, no frame in it"<<std::endl;
+		return false;
+	}
+	size_t offset = sizeof(header) / sizeof(uint32_t);
+	calls.reserve(header.records);
+	while (offset < words.size())
+	{
+		if (offset + 2 > words.size() || offset + 2 + words[offset + 1] > words.size() || words[offset] >= GlTrace::OpcodeCount)
+		{
+			std::cerr<<path<<" is truncated or corrupt at word "<<offset<<std::endl;
+			return false;
+		}
+		Call call = { words[offset], &words[offset + 2], words[offset + 1] };
+		calls.push_back(call);
+		offset += 2 + call.words;
+	}
+	return true;
+}
+
+float toFloat(uint32_t bits)
+{
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+// Size in bytes of the blob at argument index, its data follows
+const void* blobData(const Call& call, uint32_t index)
+{
+	return &call.arguments[index + 1];
+}
+
+uint32_t blobSize(const Call& call, uint32_t index)
+{
+	return call.arguments[index];
+}
+
+std::string blobString(const Call& call, uint32_t index)
+{
+	return std::string((const char*)blobData(call, index), blobSize(call, index));
+}
+
+// Issues the calls of a trace with the names of this context
+class Replayer
+{
+public:
+	explicit Replayer(GLuint defaultFramebuffer)
+	{
+		_defaultFramebuffer = defaultFramebuffer;
+		_program = 0;
+		_arrayBuffer = 0;
+		_elementBuffer = 0;
+		_skipped = 0;
+		const char* suffixes[] = { "", "EXT", "ANGLE" };
+		_vertexAttribDivisor = NULL;
+		_drawArraysInstanced = NULL;
+		_drawElementsInstanced = NULL;
+		for (int i = 0; i < 3; ++i)
+		{
+			std::string suffix = suffixes[i];
+			if (_vertexAttribDivisor == NULL)
+			{
+				_vertexAttribDivisor = (PFNGLVERTEXATTRIBDIVISOREXTPROC)eglGetProcAddress(("glVertexAttribDivisor" + suffix).c_str());
+			}
+			if (_drawArraysInstanced == NULL)
+			{
+				_drawArraysInstanced = (PFNGLDRAWARRAYSINSTANCEDEXTPROC)eglGetProcAddress(("glDrawArraysInstanced" + suffix).c_str());
+			}
+			if (_drawElementsInstanced == NULL)
+			{
+				_drawElementsInstanced = (PFNGLDRAWELEMENTSINSTANCEDEXTPROC)eglGetProcAddress(("glDrawElementsInstanced" + suffix).c_str());
+			}
+		}
+		_programBinary = (PFNGLPROGRAMBINARYOESPROC)eglGetProcAddress("glProgramBinaryOES");
+	}
+
+	// Calls skipped because this context lacks the entry point or the trace lacks the data
+	unsigned long GetSkippedCount() const { return _skipped; }
+
+	void Execute(const Call& call)
+	{
+		const uint32_t* a = call.arguments;
+		switch (call.opcode)
+		{
+		case GlTrace::StateBegin:
+		case GlTrace::FrameBegin:
+		case GlTrace::FrameEnd:
+			break;
+		case GlTrace::GenBuffer:
+			glGenBuffers(1, &_buffers[a[0]]);
+			break;
+		case GlTrace::DeleteBuffer:
+			glDeleteBuffers(1, &_buffers[a[0]]);
+			_buffers.erase(a[0]);
+			break;
+		case GlTrace::BindBuffer:
+			if (a[0] == GL_ARRAY_BUFFER) { _arrayBuffer = a[1]; }
+			if (a[0] == GL_ELEMENT_ARRAY_BUFFER) { _elementBuffer = a[1]; }
+			glBindBuffer(a[0], Map(_buffers, a[1]));
+			break;
+		case GlTrace::BufferData:
+			glBufferData(a[0], a[1], a[3] != 0 ? blobData(call, 4) : NULL, a[2]);
+			break;
+		case GlTrace::BufferSubData:
+			glBufferSubData(a[0], a[1], blobSize(call, 2), blobData(call, 2));
+			break;
+		case GlTrace::GenTexture:
+			glGenTextures(1, &_textures[a[0]]);
+			break;
+		case GlTrace::DeleteTexture:
+			glDeleteTextures(1, &_textures[a[0]]);
+			_textures.erase(a[0]);
+			break;
+		case GlTrace::ActiveTexture:
+			glActiveTexture(a[0]);
+			break;
+		case GlTrace::BindTexture:
+			glBindTexture(a[0], Map(_textures, a[1]));
+			break;
+		case GlTrace::TexParameteri:
+			glTexParameteri(a[0], a[1], (GLint)a[2]);
+			break;
+		case GlTrace::TexImage2D:
+			glTexImage2D(a[0], (GLint)a[1], (GLint)a[2], (GLsizei)a[3], (GLsizei)a[4], (GLint)a[5], a[6], a[7],
+			             a[8] != 0 ? blobData(call, 9) : NULL);
+			break;
+		case GlTrace::TexSubImage2D:
+			glTexSubImage2D(a[0], (GLint)a[1], (GLint)a[2], (GLint)a[3], (GLsizei)a[4], (GLsizei)a[5], a[6], a[7], blobData(call, 8));
+			break;
+		case GlTrace::CompressedTexImage2D:
+			glCompressedTexImage2D(a[0], (GLint)a[1], a[2], (GLsizei)a[3], (GLsizei)a[4], (GLint)a[5], blobSize(call, 6), blobData(call, 6));
+			break;
+		case GlTrace::PixelStorei:
+			glPixelStorei(a[0], (GLint)a[1]);
+			break;
+		case GlTrace::GenerateMipmap:
+			glGenerateMipmap(a[0]);
+			break;
+		case GlTrace::CreateShader:
+			_shaders[a[0]] = glCreateShader(a[1]);
+			break;
+		case GlTrace::DeleteShader:
+			glDeleteShader(Map(_shaders, a[0]));
+			_shaders.erase(a[0]);
+			break;
+		case GlTrace::ShaderSource:
+		{
+			const GLchar* source = (const GLchar*)blobData(call, 1);
+			GLint length = (GLint)blobSize(call, 1);
+			glShaderSource(Map(_shaders, a[0]), 1, &source, &length);
+			break;
+		}
+		case GlTrace::CompileShader:
+			glCompileShader(Map(_shaders, a[0]));
+			break;
+		case GlTrace::CreateProgram:
+			_programs[a[0]] = glCreateProgram();
+			break;
+		case GlTrace::DeleteProgram:
+			glDeleteProgram(Map(_programs, a[0]));
+			_programs.erase(a[0]);
+			break;
+		case GlTrace::AttachShader:
+			glAttachShader(Map(_programs, a[0]), Map(_shaders, a[1]));
+			break;
+		case GlTrace::DetachShader:
+			glDetachShader(Map(_programs, a[0]), Map(_shaders, a[1]));
+			break;
+		case GlTrace::BindAttribLocation:
+			glBindAttribLocation(Map(_programs, a[0]), a[1], blobString(call, 2).c_str());
+			break;
+		case GlTrace::LinkProgram:
+			glLinkProgram(Map(_programs, a[0]));
+			break;
+		case GlTrace::ProgramBinary:
+			if (_programBinary != NULL)
+			{
+				_programBinary(Map(_programs, a[0]), a[1], blobData(call, 2), (GLint)blobSize(call, 2));
+			}
+			else
+			{
+				++_skipped;
+			}
+			break;
+		case GlTrace::UseProgram:
+			_program = a[0];
+			glUseProgram(Map(_programs, a[0]));
+			break;
+		case GlTrace::UniformLocation:
+			_locations[std::make_pair(a[0], a[1])] = glGetUniformLocation(Map(_programs, a[0]), blobString(call, 2).c_str());
+			break;
+		case GlTrace::Uniform1i:
+			glUniform1i(Location(a[0]), (GLint)a[1]);
+			break;
+		case GlTrace::Uniform1f:
+			glUniform1f(Location(a[0]), toFloat(a[1]));
+			break;
+		case GlTrace::Uniform2f:
+			glUniform2f(Location(a[0]), toFloat(a[1]), toFloat(a[2]));
+			break;
+		case GlTrace::Uniform3f:
+			glUniform3f(Location(a[0]), toFloat(a[1]), toFloat(a[2]), toFloat(a[3]));
+			break;
+		case GlTrace::Uniform4f:
+			glUniform4f(Location(a[0]), toFloat(a[1]), toFloat(a[2]), toFloat(a[3]), toFloat(a[4]));
+			break;
+		case GlTrace::Uniform1fv:
+			glUniform1fv(Location(a[0]), (GLsizei)a[1], (const GLfloat*)blobData(call, 2));
+			break;
+		case GlTrace::Uniform2fv:
+			glUniform2fv(Location(a[0]), (GLsizei)a[1], (const GLfloat*)blobData(call, 2));
+			break;
+		case GlTrace::Uniform3fv:
+			glUniform3fv(Location(a[0]), (GLsizei)a[1], (const GLfloat*)blobData(call, 2));
+			break;
+		case GlTrace::Uniform4fv:
+			glUniform4fv(Location(a[0]), (GLsizei)a[1], (const GLfloat*)blobData(call, 2));
+			break;
+		case GlTrace::UniformMatrix4fv:
+			glUniformMatrix4fv(Location(a[0]), (GLsizei)a[1], GL_FALSE, (const GLfloat*)blobData(call, 2));
+			break;
+		case GlTrace::GenFramebuffer:
+			glGenFramebuffers(1, &_framebuffers[a[0]]);
+			break;
+		case GlTrace::DeleteFramebuffer:
+			glDeleteFramebuffers(1, &_framebuffers[a[0]]);
+			_framebuffers.erase(a[0]);
+			break;
+		case GlTrace::BindFramebuffer:
+			// The captured surface is this context's
+			glBindFramebuffer(a[0], a[1] == 0 ? _defaultFramebuffer : Map(_framebuffers, a[1]));
+			break;
+		case GlTrace::FramebufferTexture2D:
+			glFramebufferTexture2D(a[0], a[1], a[2], Map(_textures, a[3]), (GLint)a[4]);
+			break;
+		case GlTrace::FramebufferRenderbuffer:
+			glFramebufferRenderbuffer(a[0], a[1], a[2], Map(_renderbuffers, a[3]));
+			break;
+		case GlTrace::GenRenderbuffer:
+			glGenRenderbuffers(1, &_renderbuffers[a[0]]);
+			break;
+		case GlTrace::DeleteRenderbuffer:
+			glDeleteRenderbuffers(1, &_renderbuffers[a[0]]);
+			_renderbuffers.erase(a[0]);
+			break;
+		case GlTrace::BindRenderbuffer:
+			glBindRenderbuffer(a[0], Map(_renderbuffers, a[1]));
+			break;
+		case GlTrace::RenderbufferStorage:
+			glRenderbufferStorage(a[0], a[1], (GLsizei)a[2], (GLsizei)a[3]);
+			break;
+		case GlTrace::Enable:
+			glEnable(a[0]);
+			break;
+		case GlTrace::Disable:
+			glDisable(a[0]);
+			break;
+		case GlTrace::BlendFunc:
+			glBlendFunc(a[0], a[1]);
+			break;
+		case GlTrace::Viewport:
+			glViewport((GLint)a[0], (GLint)a[1], (GLsizei)a[2], (GLsizei)a[3]);
+			break;
+		case GlTrace::ClearColor:
+			glClearColor(toFloat(a[0]), toFloat(a[1]), toFloat(a[2]), toFloat(a[3]));
+			break;
+		case GlTrace::Clear:
+			glClear(a[0]);
+			break;
+		case GlTrace::EnableVertexAttribArray:
+			glEnableVertexAttribArray(a[0]);
+			break;
+		case GlTrace::DisableVertexAttribArray:
+			glDisableVertexAttribArray(a[0]);
+			break;
+		case GlTrace::VertexAttribPointer:
+			// A client side array was not captured, its address means nothing here
+			if (_arrayBuffer == 0)
+			{
+				++_skipped;
+				break;
+			}
+			glVertexAttribPointer(a[0], (GLint)a[1], a[2], (GLboolean)a[3], (GLsizei)a[4], (const void*)(uintptr_t)a[5]);
+			break;
+		case GlTrace::VertexAttribDivisor:
+			if (_vertexAttribDivisor == NULL) { ++_skipped; break; }
+			_vertexAttribDivisor(a[0], a[1]);
+			break;
+		case GlTrace::DrawArrays:
+			glDrawArrays(a[0], (GLint)a[1], (GLsizei)a[2]);
+			break;
+		case GlTrace::DrawElements:
+			if (_elementBuffer == 0) { ++_skipped; break; }
+			glDrawElements(a[0], (GLsizei)a[1], a[2], (const void*)(uintptr_t)a[3]);
+			break;
+		case GlTrace::DrawArraysInstanced:
+			if (_drawArraysInstanced == NULL) { ++_skipped; break; }
+			_drawArraysInstanced(a[0], (GLint)a[1], (GLsizei)a[2], (GLsizei)a[3]);
+			break;
+		case GlTrace::DrawElementsInstanced:
+			if (_drawElementsInstanced == NULL || _elementBuffer == 0) { ++_skipped; break; }
+			_drawElementsInstanced(a[0], (GLsizei)a[1], a[2], (const void*)(uintptr_t)a[3], (GLsizei)a[4]);
+			break;
+		case GlTrace::Finish:
+			glFinish();
+			break;
+		case GlTrace::Flush:
+			glFlush();
+			break;
+		}
+	}
+
+private:
+	static GLuint Map(std::map<uint32_t, GLuint>& names, uint32_t name)
+	{
+		if (name == 0)
+		{
+			return 0;
+		}
+		std::map<uint32_t, GLuint>::iterator found = names.find(name);
+		return found != names.end() ? found->second : 0;
+	}
+
+	GLint Location(uint32_t location)
+	{
+		std::map<std::pair<uint32_t, uint32_t>, GLint>::iterator found = _locations.find(std::make_pair(_program, location));
+		return found != _locations.end() ? found->second : -1;
+	}
+
+	GLuint _defaultFramebuffer;
+	std::map<uint32_t, GLuint> _buffers;
+	std::map<uint32_t, GLuint> _textures;
+	std::map<uint32_t, GLuint> _shaders;
+	std::map<uint32_t, GLuint> _programs;
+	std::map<uint32_t, GLuint> _framebuffers;
+	std::map<uint32_t, GLuint> _renderbuffers;
+	// By trace program and location
+	std::map<std::pair<uint32_t, uint32_t>, GLint> _locations;
+	uint32_t _program;
+	uint32_t _arrayBuffer;
+	uint32_t _elementBuffer;
+	unsigned long _skipped;
+	PFNGLVERTEXATTRIBDIVISOREXTPROC _vertexAttribDivisor;
+	PFNGLDRAWARRAYSINSTANCEDEXTPROC _drawArraysInstanced;
+	PFNGLDRAWELEMENTSINSTANCEDEXTPROC _drawElementsInstanced;
+	PFNGLPROGRAMBINARYOESPROC _programBinary;
+};
+
+struct OpcodeTime
+{
+	uint32_t opcode;
+	unsigned long calls;
+	double milliseconds;
+};
+
+bool slowerFirst(const OpcodeTime& left, const OpcodeTime& right)
+{
+	return left.milliseconds > right.milliseconds;
+}
+
+int main(int argc, char** argv)
+{
+	int iterations = DefaultIterations;
+	int warmup = DefaultWarmup;
+	bool synchronous = false;
+	bool perCall = false;
+	const char* outputPath = NULL;
+
+	int option;
+	while ((option = getopt(argc, argv, "n:u:sco:")) != -1)
+	{
+		switch (option)
+		{
+		case 'n': iterations = atoi(optarg); break;
+		case 'u': warmup = atoi(optarg); break;
+		case 's': synchronous = true; break;
+		case 'c': perCall = true; break;
+		case 'o': outputPath = optarg; break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (optind != argc - 1 || iterations <= 0 || warmup < 0)
+	{
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+	const char* tracePath = argv[optind];
+
+	std::vector<uint32_t> words;
+	GlTrace::Header header;
+	std::vector<Call> calls;
+	if (!readTrace(tracePath, words, header, calls))
+	{
+		return EXIT_FAILURE;
+	}
+	// Objects first, then what is replayed each iteration: bindings, uniform values and frames
+	size_t loopStart = 0;
+	while (loopStart < calls.size() && calls[loopStart].opcode != GlTrace::StateBegin)
+	{
+		++loopStart;
+	}
+	if (loopStart == calls.size())
+	{
+		std::cerr<<tracePath<<" has no state section"<<std::endl;
+		return EXIT_FAILURE;
+	}
+	size_t loopCalls = calls.size() - loopStart;
+
+	Headless::HeadlessContext context;
+	if (!context.Create(header.width, header.height))
+	{
+		return EXIT_FAILURE;
+	}
+	Replayer replayer(context.GetFramebuffer());
+
+	Clock::time_point setupStart = Clock::now();
+	for (size_t i = 0; i < loopStart; ++i)
+	{
+		replayer.Execute(calls[i]);
+	}
+	glFinish();
+	double setupTime = std::chrono::duration<double, std::milli>(Clock::now() - setupStart).count();
+	GLenum setupError = glGetError();
+
+	std::vector<double> iterationTimes;
+	std::vector<double> finishTimes;
+	iterationTimes.reserve(iterations);
+	finishTimes.reserve(iterations);
+	std::vector<OpcodeTime> opcodes(GlTrace::OpcodeCount);
+	for (uint32_t opcode = 0; opcode < GlTrace::OpcodeCount; ++opcode)
+	{
+		opcodes[opcode].opcode = opcode;
+		opcodes[opcode].calls = 0;
+		opcodes[opcode].milliseconds = 0.0;
+	}
+	// By call then iteration
+	std::vector<std::vector<double> > callTimes(perCall ? loopCalls : 0);
+	for (size_t i = 0; i < callTimes.size(); ++i)
+	{
+		callTimes[i].reserve(iterations);
+	}
+
+	for (int iteration = 0; iteration < warmup + iterations; ++iteration)
+	{
+		bool measured = iteration >= warmup;
+		Clock::time_point iterationStart = Clock::now();
+		for (size_t i = 0; i < loopCalls; ++i)
+		{
+			const Call& call = calls[loopStart + i];
+			Clock::time_point callStart = Clock::now();
+			replayer.Execute(call);
+			if (synchronous)
+			{
+				glFinish();
+			}
+			if (measured)
+			{
+				double milliseconds = std::chrono::duration<double, std::milli>(Clock::now() - callStart).count();
+				opcodes[call.opcode].milliseconds += milliseconds;
+				++opcodes[call.opcode].calls;
+				if (perCall)
+				{
+					callTimes[i].push_back(milliseconds);
+				}
+			}
+		}
+		Clock::time_point submitted = Clock::now();
+		glFinish();
+		Clock::time_point finished = Clock::now();
+		if (measured)
+		{
+			iterationTimes.push_back(std::chrono::duration<double, std::milli>(submitted - iterationStart).count());
+			finishTimes.push_back(std::chrono::duration<double, std::milli>(finished - submitted).count());
+		}
+	}
+	GLenum glError = setupError != GL_NO_ERROR ? setupError : glGetError();
+	const char* glRenderer = (const char*)glGetString(GL_RENDERER);
+	std::string glRendererName = glRenderer ? glRenderer : "unknown";
+	context.Release();
+
+	double callTotal = 0.0;
+	for (size_t i = 0; i < opcodes.size(); ++i)
+	{
+		callTotal += opcodes[i].milliseconds;
+	}
+	std::sort(opcodes.begin(), opcodes.end(), slowerFirst);
+
+	std::ofstream file;
+	if (outputPath != NULL)
+	{
+		file.open(outputPath);
+		if (!file)
+		{
+			std::cerr<<"Unable to open "<<outputPath<<std::endl;
+			return EXIT_FAILURE;
+		}
+	}
+	std::ostream& output = outputPath != NULL ? file : std::cout;
+	output<<"{"<<std::endl;
+	output<<"  \"trace\": \""<<tracePath<<"\","<<std::endl;
+	output<<"  \"gl_renderer\": \""<<glRendererName<<"\","<<std::endl;
+	output<<"  \"surface\": \""<<context.GetSurfaceName()<<"\","<<std::endl;
+	output<<"  \"width\": "<<header.width<<","<<std::endl;
+	output<<"  \"height\": "<<header.height<<","<<std::endl;
+	output<<"  \"frames\": "<<header.frames<<","<<std::endl;
+	output<<"  \"records\": "<<calls.size()<<","<<std::endl;
+	output<<"  \"calls_per_iteration\": "<<loopCalls<<","<<std::endl;
+	output<<"  \"iterations\": "<<iterations<<","<<std::endl;
+	output<<"  \"synchronous\": "<<(synchronous ? "true" : "false")<<","<<std::endl;
+	output<<"  \"skipped_calls\": "<<replayer.GetSkippedCount()<<","<<std::endl;
+	output<<"  \"gl_error\": "<<glError<<","<<std::endl;
+	output<<"  \"setup_ms\": "<<setupTime<<","<<std::endl;
+	output<<"  \"opcodes\": [";
+	bool first = true;
+	for (size_t i = 0; i < opcodes.size(); ++i)
+	{
+		if (opcodes[i].calls == 0)
+		{
+			continue;
+		}
+		output<<(first ? "" : ",")<<std::endl<<"    {\"name\": \""<<GlTrace::GetOpcodeName(opcodes[i].opcode)<<"\""
+		      <<", \"calls\": "<<(double)opcodes[i].calls / iterations
+		      <<", \"ms\": "<<opcodes[i].milliseconds / iterations
+		      <<", \"share\": "<<(callTotal > 0.0 ? opcodes[i].milliseconds / callTotal : 0.0)<<"}";
+		first = false;
+	}
+	output<<"],"<<std::endl;
+	if (perCall)
+	{
+		output<<"  \"calls\": [";
+		for (size_t i = 0; i < callTimes.size(); ++i)
+		{
+			std::sort(callTimes[i].begin(), callTimes[i].end());
+			output<<(i > 0 ? "," : "")<<std::endl<<"    {\"index\": "<<loopStart + i
+			      <<", \"name\": \""<<GlTrace::GetOpcodeName(calls[loopStart + i].opcode)<<"\""
+			      <<", \"p50_us\": "<<Benchmark::Percentile(callTimes[i], 50.0) * 1000.0
+			      <<", \"max_us\": "<<callTimes[i].back() * 1000.0<<"}";
+		}
+		output<<"],"<<std::endl;
+	}
+	output<<"  ";
+	Benchmark::WriteDistribution(output, "iteration_ms", iterationTimes);
+	output<<","<<std::endl<<"  ";
+	Benchmark::WriteDistribution(output, "finish_ms", finishTimes);
+	output<<std::endl<<"}"<<std::endl;
+
+	return glError == GL_NO_ERROR ? EXIT_SUCCESS : EXIT_FAILURE;
+}
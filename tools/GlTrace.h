@@ -0,0 +1,184 @@
+#ifndef TOOLS_GL_TRACE_H
+#define TOOLS_GL_TRACE_H
+
+#include <GLES2/gl2.h>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace GlTrace
+{
+  // A capture of one or more frames, written by the gl-capture library
+  // and read by gl-replay. After the header come records: an opcode and
+  // a payload size in 32 bit words, then the payload. Arguments are one
+  // word each, floats by their bits; a blob (data, source, name) is its
+  // size in bytes followed by the bytes, padded to a word. Object names
+  // and uniform locations are the ones seen at capture time, the replayer
+  // maps them to its own. The records before StateBegin recreate the
+  // objects alive when the capture started, with their contents; the
+  // ones up to the first FrameBegin restore the bindings and uniform
+  // values; then each frame's calls sit between FrameBegin and FrameEnd.
+  // Little endian hosts only.
+  const uint32_t Magic = 0x52544c47; // "GLTR"
+  const uint32_t Version = 1;
+
+  struct Header
+  {
+    uint32_t magic;
+    uint32_t version;
+    // Size of the surface the frames were drawn to
+    uint32_t width;
+    uint32_t height;
+    uint32_t frames;
+    uint32_t records;
+  };
+
+  struct Record
+  {
+    uint32_t opcode;
+    uint32_t words;
+  };
+
+  enum Opcode
+  {
+    StateBegin,
+    FrameBegin,
+    FrameEnd,
+    GenBuffer,
+    DeleteBuffer,
+    BindBuffer,
+    BufferData,
+    BufferSubData,
+    GenTexture,
+    DeleteTexture,
+    ActiveTexture,
+    BindTexture,
+    TexParameteri,
+    TexImage2D,
+    TexSubImage2D,
+    CompressedTexImage2D,
+    PixelStorei,
+    GenerateMipmap,
+    CreateShader,
+    DeleteShader,
+    ShaderSource,
+    CompileShader,
+    CreateProgram,
+    DeleteProgram,
+    AttachShader,
+    DetachShader,
+    BindAttribLocation,
+    LinkProgram,
+    ProgramBinary,
+    UseProgram,
+    UniformLocation,
+    Uniform1i,
+    Uniform1f,
+    Uniform2f,
+    Uniform3f,
+    Uniform4f,
+    Uniform1fv,
+    Uniform2fv,
+    Uniform3fv,
+    Uniform4fv,
+    UniformMatrix4fv,
+    GenFramebuffer,
+    DeleteFramebuffer,
+    BindFramebuffer,
+    FramebufferTexture2D,
+    FramebufferRenderbuffer,
+    GenRenderbuffer,
+    DeleteRenderbuffer,
+    BindRenderbuffer,
+    RenderbufferStorage,
+    Enable,
+    Disable,
+    BlendFunc,
+    Viewport,
+    ClearColor,
+    Clear,
+    EnableVertexAttribArray,
+    DisableVertexAttribArray,
+    VertexAttribPointer,
+    VertexAttribDivisor,
+    DrawArrays,
+    DrawElements,
+    DrawArraysInstanced,
+    DrawElementsInstanced,
+    Finish,
+    Flush,
+    OpcodeCount
+  };
+
+  inline const char *GetOpcodeName(uint32_t opcode)
+  {
+    static const char *const names[OpcodeCount] =
+    {
+      "StateBegin", "FrameBegin", "FrameEnd",
+      "GenBuffer", "DeleteBuffer", "BindBuffer", "BufferData", "BufferSubData",
+      "GenTexture", "DeleteTexture", "ActiveTexture", "BindTexture", "TexParameteri", "TexImage2D",
+      "TexSubImage2D", "CompressedTexImage2D", "PixelStorei", "GenerateMipmap",
+      "CreateShader", "DeleteShader", "ShaderSource", "CompileShader",
+      "CreateProgram", "DeleteProgram", "AttachShader", "DetachShader", "BindAttribLocation",
+      "LinkProgram", "ProgramBinary", "UseProgram", "UniformLocation",
+      "Uniform1i", "Uniform1f", "Uniform2f", "Uniform3f", "Uniform4f",
+      "Uniform1fv", "Uniform2fv", "Uniform3fv", "Uniform4fv", "UniformMatrix4fv",
+      "GenFramebuffer", "DeleteFramebuffer", "BindFramebuffer", "FramebufferTexture2D",
+      "FramebufferRenderbuffer", "GenRenderbuffer", "DeleteRenderbuffer", "BindRenderbuffer",
+      "RenderbufferStorage",
+      "Enable", "Disable", "BlendFunc", "Viewport", "ClearColor", "Clear",
+      "EnableVertexAttribArray", "DisableVertexAttribArray", "VertexAttribPointer", "VertexAttribDivisor",
+      "DrawArrays", "DrawElements", "DrawArraysInstanced", "DrawElementsInstanced",
+      "Finish", "Flush"
+    };
+    return opcode < OpcodeCount ? names[opcode] : "Unknown";
+  }
+
+  // Bytes glTexImage2D reads for an uncompressed image, rows padded to
+  // the unpack alignment. 0 for a format or type it does not know
+  inline size_t ImageSize(GLsizei width, GLsizei height, GLenum format, GLenum type, GLint alignment)
+  {
+    size_t components;
+    switch (format)
+    {
+      case GL_ALPHA:
+      case GL_LUMINANCE:
+        components = 1;
+        break;
+      case GL_LUMINANCE_ALPHA:
+        components = 2;
+        break;
+      case GL_RGB:
+        components = 3;
+        break;
+      case GL_RGBA:
+        components = 4;
+        break;
+      default:
+        return 0;
+    }
+    size_t pixel;
+    switch (type)
+    {
+      case GL_UNSIGNED_BYTE:
+        pixel = components;
+        break;
+      case GL_UNSIGNED_SHORT_5_6_5:
+      case GL_UNSIGNED_SHORT_4_4_4_4:
+      case GL_UNSIGNED_SHORT_5_5_5_1:
+        pixel = 2;
+        break;
+      default:
+        return 0;
+    }
+    if (width <= 0 || height <= 0)
+    {
+      return 0;
+    }
+    size_t row = (size_t)width * pixel;
+    size_t padded = alignment > 1 ? (row + alignment - 1) / alignment * alignment : row;
+    // The last row is not padded
+    return padded * (height - 1) + row;
+  }
+}
+
+#endif
@@ -0,0 +1,168 @@
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <AssetArchive.h>
+
+// Builds a Common::AssetArchive from loose files. Entries are named after
+// their path relative to the -C directory; directories are packed
+// recursively. Text files ending in .floats (numbers separated by blanks or
+// commas, # comments) are stored as packed 32 bit floats under the same
+// name ending in .f32, ready for glBufferData.
+
+const char* FloatsExtension = ".floats";
+const char* PackedFloatsExtension = ".f32";
+
+void usage(const char* program)
+{
+	std::cerr<<"usage: "<<program<<" -o archive [-a alignment] [-C directory] path..."<<std::endl;
+	std::cerr<<"  -a  blob alignment in bytes, a power of two (default 16)"<<std::endl;
+	std::cerr<<"  -C  directory the paths and entry names are relative to"<<std::endl;
+}
+
+bool endsWith(const std::string& value, const char* suffix)
+{
+	size_t length = strlen(suffix);
+	return value.size() >= length && value.compare(value.size() - length, length, suffix) == 0;
+}
+
+/*!*********************************************************************************************************************
+\param[in]			path                        Text file of numbers
+\param[out]		values                      Parsed values
+\return		Whether the file was read and only holds numbers
+\brief	Parses a .floats file.
+***********************************************************************************************************************/
+bool readFloats(const std::string& path, std::vector<float>& values)
+{
+	std::ifstream file(path.c_str());
+	if (!file)
+	{
+		return false;
+	}
+	std::string line;
+	while (std::getline(file, line))
+	{
+		line = line.substr(0, line.find('#'));
+		for (size_t i = 0; i < line.size(); ++i)
+		{
+			if (line[i] == ',') { line[i] = ' '; }
+		}
+		const char* cursor = line.c_str();
+		for (;;)
+		{
+			char* end;
+			float value = strtof(cursor, &end);
+			if (end == cursor) { break; }
+			values.push_back(value);
+			cursor = end;
+		}
+		while (*cursor == ' ' || *cursor == '\t' || *cursor == '\r') { ++cursor; }
+		if (*cursor != '\0')
+		{
+			std::cerr<<path<<": not a number: "<<cursor<<std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+/*!*********************************************************************************************************************
+\param[in]			builder                     Archive being built
+\param[in]			root                        Directory names are relative to
+\param[in]			name                        Path of the file or directory relative to root
+\return		Whether every file was added
+\brief	Adds a file, or every file below a directory.
+***********************************************************************************************************************/
+bool addPath(Common::AssetArchiveBuilder& builder, const std::string& root, const std::string& name)
+{
+	std::string path = root.empty() ? name : root + "/" + name;
+	struct stat status;
+	if (stat(path.c_str(), &status) != 0)
+	{
+		std::cerr<<"Unable to read "<<path<<std::endl;
+		return false;
+	}
+	if (S_ISDIR(status.st_mode))
+	{
+		DIR* directory = opendir(path.c_str());
+		if (directory == NULL)
+		{
+			std::cerr<<"Unable to read "<<path<<std::endl;
+			return false;
+		}
+		bool added = true;
+		for (struct dirent* entry = readdir(directory); entry != NULL && added; entry = readdir(directory))
+		{
+			if (entry->d_name[0] == '.') { continue; }
+			added = addPath(builder, root, name == "." ? std::string(entry->d_name) : name + "/" + entry->d_name);
+		}
+		closedir(directory);
+		return added;
+	}
+
+	if (endsWith(name, FloatsExtension))
+	{
+		std::vector<float> values;
+		if (!readFloats(path, values))
+		{
+			return false;
+		}
+		std::string packed = name.substr(0, name.size() - strlen(FloatsExtension)) + PackedFloatsExtension;
+		builder.Add(packed, values.data(), values.size() * sizeof(float));
+		return true;
+	}
+	if (!builder.AddFile(name, path))
+	{
+		std::cerr<<"Unable to read "<<path<<std::endl;
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	std::string output;
+	std::string root;
+	int alignment = 16;
+
+	int option;
+	while ((option = getopt(argc, argv, "o:a:C:")) != -1)
+	{
+		switch (option)
+		{
+		case 'o': output = optarg; break;
+		case 'a': alignment = atoi(optarg); break;
+		case 'C': root = optarg; break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (output.empty() || optind == argc || alignment <= 0 || (alignment & (alignment - 1)) != 0)
+	{
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	Common::AssetArchiveBuilder builder(alignment);
+	for (int i = optind; i < argc; ++i)
+	{
+		if (!addPath(builder, root, argv[i]))
+		{
+			return EXIT_FAILURE;
+		}
+	}
+	if (!builder.Write(output))
+	{
+		std::cerr<<"Unable to write "<<output<<std::endl;
+		return EXIT_FAILURE;
+	}
+	std::cout<<builder.GetEntryCount()<<" entries packed in "<<output<<std::endl;
+	return EXIT_SUCCESS;
+}
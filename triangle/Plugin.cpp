@@ -0,0 +1,4 @@
+#include <RendererPlugin.h>
+#include "RendererFactory.h"
+
+COMMON_RENDERER_PLUGIN(Triangle::RendererFactory)
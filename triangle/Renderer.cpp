@@ -2,29 +2,32 @@
 // Created by jm on 29/01/17.
 //
 #include <math.h>
-#include <iostream>
+#include <string.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <AssetArchive.h>
+#include <Context.h>
+#include <GlStateCache.h>
+#include <ShaderCache.h>
 #include "Renderer.h"
 
 using namespace Triangle;
 
-void Renderer::InitializeGl()
+Renderer::Renderer()
 {
-    _start = std::chrono::system_clock::now();
+    _time = 0.0;
+    _vertex_count = 3;
+    _ratio = 1.0f;
+    _node = _transforms.Create();
+    _pvm_dirty = true;
+    _state = Common::Context::Instance()->GetGlStateCache();
+    _shaders = Common::Context::Instance()->GetShaderCache();
+}
 
-    GLfloat vertices_colors[] = {
-            -0.5f, -0.5, 0.0f
-            ,  1.0f, 1.0f, 0.0f
-            ,  0.5f, -0.5f, 0.0f
-            ,  1.0f, 0.0f, 0.0f
-            ,  0.0f, 0.5f, 0.0f
-            ,  0.0f, 1.0f, 0.0f
-    };
-    glGenBuffers(1,&_triangle_vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, _triangle_vbo);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices_colors) ,vertices_colors, GL_STATIC_DRAW);
+void Renderer::InitializeGl()
+{
+    _time = 0.0;
 
     const char* const fragment_source = R"glsl(
         varying lowp vec3 linear_color;
@@ -34,9 +37,6 @@ void Renderer::InitializeGl()
           gl_FragColor = vec4(linear_color.x,linear_color.y,linear_color.z,fade);
         }
       )glsl";
-    _fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(_fragment_shader, 1, (const char**)&fragment_source, NULL);
-    glCompileShader(_fragment_shader);
 
     const char* const vertex_source =R"glsl(
       attribute highp vec4 vertex;
@@ -49,65 +49,102 @@ void Renderer::InitializeGl()
         linear_color = color;
       }
     )glsl";
-    _vertex_shader= glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(_vertex_shader, 1, (const char**)&vertex_source, NULL);
-    glCompileShader(_vertex_shader);
+    GLfloat vertices_colors[] = {
+            -0.5f, -0.5, 0.0f
+            ,  1.0f, 1.0f, 0.0f
+            ,  0.5f, -0.5f, 0.0f
+            ,  1.0f, 0.0f, 0.0f
+            ,  0.0f, 0.5f, 0.0f
+            ,  0.0f, 1.0f, 0.0f
+    };
+
+    // The asset archive, when the host opened one, overrides the embedded sources and vertices.
+    // Its blobs are read in place from the mapping, without a copy.
+    const char *vertex = vertex_source;
+    const char *fragment = fragment_source;
+    const void *vertices = vertices_colors;
+    size_t vertices_size = sizeof(vertices_colors);
+    Common::AssetArchive *assets = Common::Context::Instance()->GetAssetArchive();
+    if (assets->IsOpen())
+    {
+        const char *archived_vertex = (const char *)assets->Find("triangle/vertex.glsl");
+        const char *archived_fragment = (const char *)assets->Find("triangle/fragment.glsl");
+        size_t archived_size = 0;
+        const void *archived_vertices = assets->Find("triangle/vertices.f32", &archived_size);
+        if (archived_vertex != NULL && archived_fragment != NULL)
+        {
+            vertex = archived_vertex;
+            fragment = archived_fragment;
+        }
+        if (archived_vertices != NULL && archived_size >= 3 * 6 * sizeof(GLfloat))
+        {
+            vertices = archived_vertices;
+            vertices_size = archived_size;
+        }
+    }
+    _vertex_count = (GLsizei)(vertices_size / (6 * sizeof(GLfloat)));
 
-    _program_shader = glCreateProgram();
-    glAttachShader(_program_shader, _fragment_shader);
-    glAttachShader(_program_shader, _vertex_shader);
-    glLinkProgram(_program_shader);
+    // The link runs while the vertex buffer is set up, its status is only checked by Resolve
+    _program_shader = _shaders->Request(vertex, fragment);
+    _triangle_vbo.Create("triangle");
+    _state->BindArrayBuffer(_triangle_vbo.Get());
+    glBufferData(GL_ARRAY_BUFFER, vertices_size, vertices, GL_STATIC_DRAW);
+    _triangle_vbo.SetBytes(vertices_size);
 
+    _shaders->Resolve(_program_shader);
     _vertex_location = glGetAttribLocation(_program_shader, "vertex");
     _color_location = glGetAttribLocation(_program_shader,"color");
     _pmv_matrix_location = glGetUniformLocation(_program_shader, "pmv_matrix");
     _fade_location = glGetUniformLocation(_program_shader, "fade");
-
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    // The program is new, it has never seen the matrix
+    _pvm_dirty = true;
 }
 
 void Renderer::SetViewport(int width, int height)
 {
   glViewport(0,0,width,height);
   _ratio = (float) width / height;
-  std::cout<<width<<" "<<height<<" "<<_ratio<<std::endl;
+  // The view is the identity, the model is the node's transform
+  glm::mat4 projection = glm::ortho(-_ratio, _ratio , -1.0f, 1.0f, -1.0f, 1.0f);
+  _transforms.SetViewProjection(glm::value_ptr(projection));
 }
 
 void Renderer::DrawFrame() {
-    std::chrono::duration< double, std::ratio<1l> > duration = std::chrono::system_clock::now() - _start;
-    float fade = (float)cos( duration.count() * 2.0 * 3.141592 * 1/10.0);
+    float fade = (float)cos( _time * 2.0 * 3.141592 * 1/10.0);
     fade *= fade;
-    glClearColor(0.2,0.2,0.2,1.0);
-    glClear(GL_COLOR_BUFFER_BIT);
-    glm::mat4 pvm_matrix = glm::mat4(1.0f);
-    glm::mat4 model = glm::mat4(1.0f);
-    glm::mat4 view = glm::mat4(1.0f);
-    //glm::mat4 view =  glm::translate(glm::mat4(1.0f),glm::vec3(0.0f,0.0f,-1.0f));
-    glm::mat4 projection = glm::ortho(-_ratio, _ratio , -1.0f, 1.0f, -1.0f, 1.0f);
-    pvm_matrix = projection * view * model;
+    // The frame is cleared by the compositor, the triangle may be drawn over other layers
 
-    glUseProgram(_program_shader);
-    glUniformMatrix4fv(_pmv_matrix_location, 1, GL_FALSE, glm::value_ptr(pvm_matrix) );
+    // Bindings are left in place, the state cache skips them on the next frame.
+    _state->SetBlend(true);
+    _state->BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    _state->UseProgram(_program_shader);
+    // Uniforms live in the program, the matrix only changes with the viewport
+    if (_transforms.Update() > 0 || _pvm_dirty)
+    {
+        glUniformMatrix4fv(_pmv_matrix_location, 1, GL_FALSE, _transforms.GetClipMatrix(_node));
+        _pvm_dirty = false;
+    }
     glUniform1f(_fade_location,fade);
-    glEnableVertexAttribArray(_vertex_location);
-    glEnableVertexAttribArray(_color_location);
-    glBindBuffer(GL_ARRAY_BUFFER, _triangle_vbo);
-    glVertexAttribPointer(_vertex_location, 3, GL_FLOAT, GL_FALSE
+    _state->SetEnabledVertexAttribArrays(Common::GlStateCache::AttribBit(_vertex_location)
+            | Common::GlStateCache::AttribBit(_color_location));
+    _state->BindArrayBuffer(_triangle_vbo.Get());
+    _state->VertexAttribPointer(_vertex_location, 3, GL_FLOAT, GL_FALSE
             , (3+3)*sizeof(GLfloat)
             , 0);
-    glVertexAttribPointer(_color_location, 3, GL_FLOAT, GL_FALSE
+    _state->VertexAttribPointer(_color_location, 3, GL_FLOAT, GL_FALSE
             , (3+3)*sizeof(GLfloat)
             , (GLvoid*)(3*sizeof(GLfloat))
     );
-    glDrawArrays(GL_TRIANGLES, 0, 3);
-    glDisableVertexAttribArray(_vertex_location);
-    glDisableVertexAttribArray(_color_location);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glDrawArrays(GL_TRIANGLES, 0, _vertex_count);
+}
+
+void Renderer::Update(double seconds)
+{
+    _time += seconds;
 }
 
 void Renderer::ReleaseGl()  {
-    glDeleteShader(_program_shader);
-    glDeleteShader(_vertex_shader);
-    glDeleteShader(_fragment_shader);
+    _shaders->Release(_program_shader);
+    // Deleted once the frames drawn with it are done
+    _triangle_vbo.Reset();
 }
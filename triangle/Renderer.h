@@ -7,8 +7,15 @@
 
 #include <EGL/egl.h>
 #include <GLES2/gl2.h>
-#include <chrono>
+#include <GlHandle.h>
 #include <IRenderer.h>
+#include <TransformSystem.h>
+
+namespace Common
+{
+  class GlStateCache;
+  class ShaderCache;
+}
 
 namespace Triangle
 {
@@ -18,23 +25,30 @@ namespace Triangle
   //
 
   public:
-      Renderer(){}
+      Renderer();
       ~Renderer(){};
       void InitializeGl();
       void ReleaseGl();
       void SetViewport(int width, int height);
       void DrawFrame();
+      void Update(double seconds);
   private:
-      GLuint _vertex_shader;
-      GLuint _fragment_shader;
       GLuint _program_shader;
-      GLuint _triangle_vbo;
+      Common::GlBuffer _triangle_vbo;
+      GLsizei _vertex_count;
       GLint _vertex_location;
       GLint _color_location;
       GLint _fade_location;
       GLint _pmv_matrix_location;
-      std::chrono::time_point<std::chrono::system_clock> _start;
+      double _time;
       GLfloat _ratio;
+      // The triangle's node, its clip matrix is rebuilt when the viewport changes
+      Common::TransformSystem _transforms;
+      Common::TransformSystem::Handle _node;
+      // The program has not seen the current matrix
+      bool _pvm_dirty;
+      Common::GlStateCache *_state;
+      Common::ShaderCache *_shaders;
   };
 }
 